@@ -0,0 +1,512 @@
+#include "andor2k.hpp"
+#include "cpp_socket.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <poll.h>
+#include <string>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// End-to-end benchmark of the daemon: start dandor2kd (linked against the
+// simulated SDK, see sim/), drive it over its socket protocol and measure:
+// * command round-trip latency ("status"),
+// * sustained frames/sec of run-till-abort and kinetic series, across frame
+//   sizes and binnings, and the latency from an image being reported as
+//   acquired to its FITS file being closed on disk,
+// * abort-to-idle latency, i.e. from an abort request to the acquisition
+//   being reported as done,
+// * frame-loop jitter, i.e. the change in the interval between consecutive
+//   frames, as seen by the client (and by the daemon, see "stats").
+// The simulated camera runs time_scale times faster than a real one and
+// exposures are 0 sec, so that frame rates are limited by the daemon. Results
+// are written as JSON, to compare builds or daemon settings (passed with
+// --env, e.g. --env ANDOR2KD_ACQ_FIFO_PRIORITY=50).
+//
+// usage: benchDaemon [--daemon PATH] [--dir DIR] [--out FILE] [--images N]
+//                    [--repeat N] [--time-scale X] [--env NAME=VALUE ...]
+
+namespace fs = std::filesystem;
+using andor2k::ClientSocket;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  const char *daemon = "../bin/dandor2kd";
+  const char *dir = "/tmp/andor2k_bench";
+  const char *out = nullptr; // stdout
+  int images = 20;           // per series
+  int repeat = 10;           // abort requests; x50 status commands
+  double time_scale = 1e-3;
+  std::vector<const char *> env; // NAME=VALUE, for the daemon
+}; // Options
+
+double ms(Clock::duration d) noexcept {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+/// @brief Summary of a sample (in milliseconds), as a JSON object
+std::string summary(std::vector<double> v) {
+  if (v.empty())
+    return "null";
+  std::sort(v.begin(), v.end());
+  auto pct = [&](double q) {
+    return v[std::min(v.size() - 1, static_cast<std::size_t>(q * v.size()))];
+  };
+  char buf[256];
+  std::snprintf(buf, sizeof(buf),
+                "{\"n\":%zu,\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,"
+                "\"p99\":%.3f,\"max\":%.3f}",
+                v.size(),
+                std::accumulate(v.begin(), v.end(), 0e0) / v.size(), pct(.5),
+                pct(.9), pct(.99), v.back());
+  return buf;
+}
+
+int count(const std::string &str, const char *what) noexcept {
+  int n = 0;
+  for (auto pos = str.find(what); pos != std::string::npos;
+       pos = str.find(what, pos + 1))
+    ++n;
+  return n;
+}
+
+/// @brief A connection to the daemon; replies (which are not delimited) are
+///        accumulated until the next command is sent
+class Connection {
+public:
+  explicit Connection(int port) : m_sock("localhost", port) {
+    timeval tv{1, 0};
+    setsockopt(m_sock.sockid(), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  }
+
+  int send(const char *command) {
+    m_data.clear();
+    return m_sock.send(command);
+  }
+
+  /// @brief Read until the replies contain what, or until deadline; the
+  ///        arrival time of every occurrence of marker (if any) is appended
+  ///        to times
+  bool wait_for(const char *what, Clock::time_point deadline,
+                const char *marker = nullptr,
+                std::vector<Clock::time_point> *times = nullptr) {
+    char buf[1024];
+    auto now = Clock::now();
+    for (;;) {
+      if (marker)
+        for (int n = count(m_data, marker); (int)times->size() < n;)
+          times->push_back(now);
+      if (m_data.find(what) != std::string::npos)
+        return true;
+      if (now > deadline)
+        return false;
+      int bytes = m_sock.recv(buf, sizeof(buf));
+      now = Clock::now();
+      if (bytes == 0)
+        return false;
+      if (bytes > 0)
+        m_data.append(buf, bytes);
+    }
+  }
+
+  const std::string &data() const noexcept { return m_data; }
+
+private:
+  ClientSocket m_sock;
+  std::string m_data;
+}; // Connection
+
+std::unique_ptr<Connection> connect_to(int port, Clock::duration timeout) {
+  auto deadline = Clock::now() + timeout;
+  for (;;) {
+    try {
+      return std::make_unique<Connection>(port);
+    } catch (std::exception &) {
+    }
+    if (Clock::now() > deadline)
+      return nullptr;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+}
+
+/// @brief Records when FITS files are closed (after writing) in a directory
+class FitsWatcher {
+public:
+  ~FitsWatcher() { stop(); }
+
+  int start(const char *dir) {
+    if (m_fd = inotify_init1(IN_NONBLOCK); m_fd < 0)
+      return 1;
+    if (inotify_add_watch(m_fd, dir, IN_CLOSE_WRITE) < 0)
+      return 1;
+    m_worker = std::thread([this] { work(); });
+    return 0;
+  }
+
+  void stop() {
+    m_stop = true;
+    if (m_worker.joinable())
+      m_worker.join();
+    if (m_fd >= 0)
+      close(m_fd);
+    m_fd = -1;
+  }
+
+  std::size_t size() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_closed.size();
+  }
+
+  std::vector<Clock::time_point> since(std::size_t first) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return std::vector<Clock::time_point>(m_closed.begin() + first,
+                                          m_closed.end());
+  }
+
+private:
+  int m_fd = -1;
+  std::atomic<bool> m_stop{false};
+  std::thread m_worker;
+  std::mutex m_mtx;
+  std::vector<Clock::time_point> m_closed;
+
+  void work() {
+    alignas(inotify_event) char buf[4096];
+    pollfd pfd{m_fd, POLLIN, 0};
+    while (!m_stop) {
+      if (poll(&pfd, 1, 100) < 1)
+        continue;
+      ssize_t len = read(m_fd, buf, sizeof(buf));
+      auto now = Clock::now();
+      for (ssize_t i = 0; i < len;) {
+        auto *e = reinterpret_cast<inotify_event *>(buf + i);
+        std::size_t n = e->len ? std::strlen(e->name) : 0;
+        if (n > 5 && !std::strcmp(e->name + n - 5, ".fits")) {
+          std::lock_guard<std::mutex> lock(m_mtx);
+          m_closed.push_back(now);
+        }
+        i += sizeof(inotify_event) + e->len;
+      }
+    }
+  }
+}; // FitsWatcher
+
+/// @brief Remove the FITS files in dir; returns their total size
+uint64_t clean_fits(const char *dir) {
+  uint64_t bytes = 0;
+  std::error_code ec;
+  for (auto const &entry : fs::directory_iterator(dir, ec)) {
+    if (entry.path().extension() == ".fits") {
+      bytes += entry.file_size(ec);
+      fs::remove(entry.path(), ec);
+    }
+  }
+  return bytes;
+}
+
+/// @brief setparam has no reply; give the daemon the time to read it, so
+///        that it is not merged with the next command
+void set_param(Connection &conn, const char *param) {
+  char cmd[MAX_SOCKET_BUFFER_SIZE];
+  std::snprintf(cmd, sizeof(cmd), "setparam %s", param);
+  conn.send(cmd);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+pid_t start_daemon(const Options &opts) {
+  char log[512];
+  std::snprintf(log, sizeof(log), "%s/dandor2kd.log", opts.dir);
+  char state[512];
+  std::snprintf(state, sizeof(state), "%s/andor2kd.state", opts.dir);
+  char scale[32];
+  std::snprintf(scale, sizeof(scale), "%g", opts.time_scale);
+
+  pid_t pid = fork();
+  if (pid)
+    return pid;
+  setenv("ANDOR_SIM_TIME_SCALE", scale, 1);
+  // the simulated buffer costs no memory; never overrun it, so that the
+  // daemon alone limits the frame rate
+  setenv("ANDOR_SIM_BUFFER_MB", "1048576", 1);
+  setenv("ANDOR2KD_STATE_FILE", state, 1);
+  setenv("ANDOR2KD_NTP_SERVERS", "none", 1);
+  std::remove(state);
+  for (const char *var : opts.env)
+    putenv(const_cast<char *>(var));
+  if (FILE *fp = std::freopen(log, "w", stdout); fp)
+    dup2(fileno(fp), STDERR_FILENO);
+  execl(opts.daemon, opts.daemon, (char *)nullptr);
+  std::_Exit(127);
+}
+
+int stop_daemon(pid_t pid, Connection *conn) {
+  if (conn)
+    conn->send("shutdown");
+  int status;
+  auto deadline = Clock::now() + std::chrono::seconds(60);
+  while (waitpid(pid, &status, WNOHANG) == 0) {
+    if (Clock::now() > deadline) {
+      kill(pid, SIGKILL);
+      waitpid(pid, &status, 0);
+      return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  return 0;
+}
+
+struct Geometry {
+  const char *name;
+  const char *args;
+  int width, height; // binned
+};
+
+struct Mode {
+  const char *name;
+  int acqmode;
+  const char *frame_marker; // reported for every frame acquired
+};
+
+int main(int argc, char *argv[]) {
+  Options opts;
+  for (int i = 1; i < argc; i++) {
+    bool has_arg = (i + 1 < argc);
+    if (!std::strcmp(argv[i], "--daemon") && has_arg)
+      opts.daemon = argv[++i];
+    else if (!std::strcmp(argv[i], "--dir") && has_arg)
+      opts.dir = argv[++i];
+    else if (!std::strcmp(argv[i], "--out") && has_arg)
+      opts.out = argv[++i];
+    else if (!std::strcmp(argv[i], "--images") && has_arg)
+      opts.images = std::max(2, std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--repeat") && has_arg)
+      opts.repeat = std::max(1, std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--time-scale") && has_arg)
+      opts.time_scale = std::atof(argv[++i]);
+    else if (!std::strcmp(argv[i], "--env") && has_arg &&
+             std::strchr(argv[i + 1], '='))
+      opts.env.push_back(argv[++i]);
+    else {
+      fprintf(stderr,
+              "usage: %s [--daemon PATH] [--dir DIR] [--out FILE] [--images "
+              "N] [--repeat N] [--time-scale X] [--env NAME=VALUE ...]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (opts.time_scale <= 0) {
+    fprintf(stderr, "[ERROR] Time scale must be positive\n");
+    return 1;
+  }
+
+  std::error_code ec;
+  fs::create_directories(opts.dir, ec);
+  clean_fits(opts.dir);
+  if (connect_to(SOCKET_PORT, Clock::duration::zero())) {
+    fprintf(stderr, "[ERROR] A daemon is already listening on port %d\n",
+            SOCKET_PORT);
+    return 1;
+  }
+
+  FitsWatcher watcher;
+  if (watcher.start(opts.dir)) {
+    fprintf(stderr, "[ERROR] Failed to watch directory %s\n", opts.dir);
+    return 1;
+  }
+
+  auto daemon_start = Clock::now();
+  pid_t pid = start_daemon(opts);
+  if (pid < 0) {
+    fprintf(stderr, "[ERROR] Failed to start daemon %s\n", opts.daemon);
+    return 1;
+  }
+  auto conn = connect_to(SOCKET_PORT, std::chrono::seconds(30));
+  if (!conn) {
+    fprintf(stderr, "[ERROR] Daemon not listening; see %s/dandor2kd.log\n",
+            opts.dir);
+    stop_daemon(pid, nullptr);
+    return 1;
+  }
+
+  // wait for the camera to be usable
+  bool ready = false;
+  while (!ready && Clock::now() - daemon_start < std::chrono::seconds(60)) {
+    conn->send("status");
+    if (conn->wait_for("time:", Clock::now() + std::chrono::seconds(5)))
+      ready = conn->data().find("state:cooling") != std::string::npos ||
+              conn->data().find("state:ready") != std::string::npos;
+    if (!ready)
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  if (!ready) {
+    fprintf(stderr, "[ERROR] Camera not initialized; see %s/dandor2kd.log\n",
+            opts.dir);
+    stop_daemon(pid, conn.get());
+    return 1;
+  }
+  double startup_ms = ms(Clock::now() - daemon_start);
+  char param[512];
+  std::snprintf(param, sizeof(param), "savedir=%s", opts.dir);
+  set_param(*conn, param);
+
+  // command round trip
+  std::vector<double> roundtrip;
+  for (int i = 0; i < 50 * opts.repeat; i++) {
+    auto t0 = Clock::now();
+    conn->send("status");
+    if (conn->wait_for("time:", t0 + std::chrono::seconds(5)))
+      roundtrip.push_back(ms(Clock::now() - t0));
+  }
+
+  // sustained frame rates
+  const Geometry geometries[] = {
+      {"2048x2048", "--bin 1", 2048, 2048},
+      {"2048x2048 bin 2", "--bin 2", 1024, 1024},
+      {"2048x2048 bin 4", "--bin 4", 512, 512},
+      {"1024x1024",
+       "--bin 1 --hstart 513 --hend 1536 --vstart 513 --vend 1536", 1024,
+       1024}};
+  const Mode modes[] = {{"rta", 5, "Acquired image "},
+                        {"kinetic", 3, "status:acquired;image:"}};
+  std::string series;
+  std::vector<double> to_fits_all;
+  std::vector<double> jitter_all;
+  for (const auto &m : modes) {
+    for (const auto &g : geometries) {
+      std::snprintf(param, sizeof(param), "acqmode=%d kineticcycletime=0",
+                    m.acqmode);
+      set_param(*conn, param);
+      char cmd[MAX_SOCKET_BUFFER_SIZE];
+      std::snprintf(cmd, sizeof(cmd),
+                    "image --nimages %d --exposure 0 --type object --filename "
+                    "bench --ar-tries 0 %s",
+                    opts.images, g.args);
+
+      std::size_t closed0 = watcher.size();
+      std::vector<Clock::time_point> frames;
+      auto t0 = Clock::now();
+      conn->send(cmd);
+      bool done = conn->wait_for("done;", t0 + std::chrono::seconds(300),
+                                 m.frame_marker, &frames);
+      auto t1 = Clock::now();
+      bool ok = done && conn->data().find("error:0") != std::string::npos;
+      // the last file may be closed right after the reply
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      auto closed = watcher.since(closed0);
+      uint64_t bytes = clean_fits(opts.dir);
+
+      double fps = frames.size() > 1
+                       ? (frames.size() - 1) * 1e3 /
+                             ms(frames.back() - frames.front())
+                       : 0;
+      double fits_fps = closed.size() > 1
+                            ? (closed.size() - 1) * 1e3 /
+                                  ms(closed.back() - closed.front())
+                            : 0;
+      // pair frames and files, if every frame was saved
+      std::vector<double> to_fits;
+      if (closed.size() == frames.size())
+        for (std::size_t i = 0; i < frames.size(); i++)
+          to_fits.push_back(ms(closed[i] - frames[i]));
+      to_fits_all.insert(to_fits_all.end(), to_fits.begin(), to_fits.end());
+      std::vector<double> jitter;
+      for (std::size_t i = 2; i < frames.size(); i++)
+        jitter.push_back(std::abs(ms(frames[i] - frames[i - 1]) -
+                                  ms(frames[i - 1] - frames[i - 2])));
+      jitter_all.insert(jitter_all.end(), jitter.begin(), jitter.end());
+
+      char buf[1024];
+      std::snprintf(
+          buf, sizeof(buf),
+          "%s\n    {\"mode\":\"%s\",\"geometry\":\"%s\",\"width\":%d,"
+          "\"height\":%d,\"images\":%d,\"ok\":%s,\"frames\":%zu,"
+          "\"files\":%zu,\"elapsed_s\":%.3f,\"fps\":%.2f,\"fits_fps\":%.2f,"
+          "\"mb_per_s\":%.1f,\"frame_to_fits_ms\":%s,\"jitter_ms\":%s}",
+          series.empty() ? "" : ",", m.name, g.name, g.width, g.height,
+          opts.images, ok ? "true" : "false", frames.size(), closed.size(),
+          ms(t1 - t0) / 1e3, fps, fits_fps, bytes / 1e3 / ms(t1 - t0),
+          summary(to_fits).c_str(), summary(jitter).c_str());
+      series += buf;
+      fprintf(stderr,
+              "[DEBUG] %-8s %-16s %6.2f frames/sec, max jitter %.3f ms%s\n",
+              m.name, g.name, fps,
+              jitter.empty() ? 0e0
+                             : *std::max_element(jitter.begin(), jitter.end()),
+              ok ? "" : " (failed)");
+    }
+  }
+
+  // abort to idle; each frame takes 1 sec
+  std::vector<double> abort_ms;
+  for (int i = 0; i < opts.repeat; i++) {
+    set_param(*conn, "acqmode=5");
+    char cmd[MAX_SOCKET_BUFFER_SIZE];
+    std::snprintf(cmd, sizeof(cmd),
+                  "image --nimages 100 --exposure %.3f --type object "
+                  "--filename bench --ar-tries 0 --bin 4",
+                  1e0 / opts.time_scale);
+    conn->send(cmd);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    auto abort_conn =
+        connect_to(SOCKET_PORT + 1, std::chrono::seconds(5));
+    if (!abort_conn)
+      continue;
+    auto t0 = Clock::now();
+    abort_conn->send("abort");
+    if (conn->wait_for("done;", t0 + std::chrono::seconds(30)))
+      abort_ms.push_back(ms(Clock::now() - t0));
+  }
+  clean_fits(opts.dir);
+
+  // the daemon's own view (per-phase latencies)
+  std::string stats;
+  conn->send("stats");
+  if (conn->wait_for("done;", Clock::now() + std::chrono::seconds(5)))
+    for (char c : conn->data())
+      if (c != '"' && c != '\\' && c >= ' ')
+        stats += c;
+
+  int stop_error = stop_daemon(pid, conn.get());
+  watcher.stop();
+
+  FILE *fp = opts.out ? std::fopen(opts.out, "w") : stdout;
+  if (!fp) {
+    fprintf(stderr, "[ERROR] Failed to open %s\n", opts.out);
+    return 1;
+  }
+  std::string env;
+  for (const char *var : opts.env)
+    env += std::string(env.empty() ? "\"" : ",\"") + var + "\"";
+  char date[32];
+  std::time_t now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+  std::fprintf(fp,
+               "{\n  \"benchmark\": \"andor2kd\",\n  \"date\": \"%s\",\n"
+               "  \"time_scale\": %g,\n  \"env\": [%s],\n"
+               "  \"startup_ms\": %.1f,\n"
+               "  \"roundtrip_ms\": %s,\n  \"series\": [%s\n  ],\n"
+               "  \"frame_to_fits_ms\": %s,\n  \"jitter_ms\": %s,\n"
+               "  \"abort_to_idle_ms\": %s,\n"
+               "  \"daemon_stats\": \"%s\",\n  \"clean_shutdown\": %s\n}\n",
+               date, opts.time_scale, env.c_str(), startup_ms,
+               summary(roundtrip).c_str(), series.c_str(),
+               summary(to_fits_all).c_str(), summary(jitter_all).c_str(),
+               summary(abort_ms).c_str(), stats.c_str(),
+               stop_error ? "false" : "true");
+  if (fp != stdout)
+    std::fclose(fp);
+  return 0;
+}
@@ -0,0 +1,413 @@
+#include "andor2k.hpp"
+#include "andor2kd.hpp"
+#include "andor_time_utils.hpp"
+#include "aristarchos.hpp"
+#include "cbase64.hpp"
+#include "cppfits.hpp"
+#include "fits_header.hpp"
+#include "frame_times.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Micro-benchmarks of the library's hot functions (FITS writing, FITS
+// filenames, headers, FCC message decoding, command parsing, date strings,
+// socket replies). Every benchmark runs for at least --min-time seconds and
+// reports ns/op, heap bytes/op and allocations/op (counted by replacing the
+// global operator new) and, where it applies, MB/s. These are the baseline to
+// compare against, before and after any optimization.
+//
+// usage: benchMicro [--data DIR] [--dir DIR] [--min-time SEC] [--json FILE]
+//                   [FILTER]
+// DIR holds the FCC captures (test/fccmsg*); only benchmarks whose name
+// contains FILTER are run. Functions built with -DDEBUG print to stdout, so
+// stdout is redirected to /dev/null while benchmarking; results are written
+// to stderr (and FILE, as JSON).
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// defined in fits_filenames.cpp
+std::optional<fs::path>
+make_fits_filename(const AndorParameters *params) noexcept;
+
+// heap usage, counted for all threads
+std::atomic<uint64_t> g_alloc_bytes{0};
+std::atomic<uint64_t> g_allocs{0};
+
+void *operator new(std::size_t sz) {
+  g_alloc_bytes.fetch_add(sz, std::memory_order_relaxed);
+  g_allocs.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(sz ? sz : 1))
+    return p;
+  throw std::bad_alloc();
+}
+// not inlined, else gcc warns of free on memory from operator new
+[[gnu::noinline]] void operator delete(void *p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+struct Options {
+  const char *data = "../test";
+  const char *dir = "/tmp/andor2k_microbench";
+  const char *json = nullptr;
+  const char *filter = nullptr;
+  double min_time = 0.5;
+}; // Options
+
+struct Result {
+  std::string name;
+  uint64_t iterations;
+  double ns_per_op;
+  double bytes_per_op;
+  double allocs_per_op;
+  double mb_per_s; // 0 if not applicable
+}; // Result
+
+class Bench {
+public:
+  explicit Bench(const Options &opts) : m_opts(opts) {}
+
+  /// @brief Run fn (one op per call) until min_time has passed; bytes is
+  ///        the payload processed per op (for MB/s), if any
+  template <typename F>
+  void run(const char *name, F &&fn, uint64_t bytes = 0) {
+    if (m_opts.filter && !std::strstr(name, m_opts.filter))
+      return;
+    fn(); // warm up
+    uint64_t n = 1;
+    for (;;) {
+      uint64_t bytes0 = g_alloc_bytes.load();
+      uint64_t allocs0 = g_allocs.load();
+      auto t0 = Clock::now();
+      for (uint64_t i = 0; i < n; i++)
+        fn();
+      double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0)
+                      .count();
+      if (ns >= m_opts.min_time * 1e9 || n >= (1ULL << 40)) {
+        Result r{name,
+                 n,
+                 ns / n,
+                 static_cast<double>(g_alloc_bytes.load() - bytes0) / n,
+                 static_cast<double>(g_allocs.load() - allocs0) / n,
+                 bytes ? bytes * 1e3 / (ns / n) : 0};
+        fprintf(stderr, "%-44s %10llu %14.1f ns/op %12.1f B/op %8.2f "
+                        "allocs/op",
+                r.name.c_str(), (unsigned long long)r.iterations,
+                r.ns_per_op, r.bytes_per_op, r.allocs_per_op);
+        if (bytes)
+          fprintf(stderr, " %9.1f MB/s", r.mb_per_s);
+        fprintf(stderr, "\n");
+        m_results.push_back(r);
+        return;
+      }
+      // aim past min_time, growing at most 100x
+      double target = m_opts.min_time * 1.2e9 / std::max(ns / n, 1e0);
+      n = std::clamp(static_cast<uint64_t>(target), n + 1, 100 * n);
+    }
+  }
+
+  int write_json(const char *fn) const {
+    FILE *fp = std::fopen(fn, "w");
+    if (!fp)
+      return 1;
+    fprintf(fp, "{\n  \"benchmark\": \"andor2k-micro\",\n  \"results\": [");
+    for (std::size_t i = 0; i < m_results.size(); i++) {
+      const auto &r = m_results[i];
+      fprintf(fp,
+              "%s\n    {\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":"
+              "%.1f,\"bytes_per_op\":%.1f,\"allocs_per_op\":%.2f,"
+              "\"mb_per_s\":%.1f}",
+              i ? "," : "", r.name.c_str(),
+              (unsigned long long)r.iterations, r.ns_per_op, r.bytes_per_op,
+              r.allocs_per_op, r.mb_per_s);
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    return std::fclose(fp);
+  }
+
+private:
+  const Options &m_opts;
+  std::vector<Result> m_results;
+}; // Bench
+
+/// @brief Keep the compiler from optimizing away a result
+template <typename T> void keep(T &&value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+/// @brief Read an FCC capture (a reply to 0003RD) into buf
+int read_capture(const char *fn, char *buf, int size) {
+  std::memset(buf, 0, size);
+  std::ifstream fin(fn, std::ios::binary);
+  if (!fin.is_open())
+    return 1;
+  fin.read(buf, size - 1);
+  return 0;
+}
+
+/// @brief Headers as written by the daemon to every FITS file
+void typical_headers(FitsHeaders &headers) {
+  headers.update("INSTRUME", "Andor iKon-L 936", "Instrument");
+  headers.update("OBSERVER", "andor2k", "Observer");
+  headers.update("OBJECT", "M31", "Object");
+  headers.update("FILTER", "R", "Filter");
+  headers.update("IMAGETYP", "object", "Image type");
+  headers.update("EXPOSURE", 30.0f, "Exposure time (sec)");
+  headers.update("CCD-TEMP", -60, "CCD temperature (C)");
+  headers.update("HBIN", 1, "Horizontal binning");
+  headers.update("VBIN", 1, "Vertical binning");
+  headers.update("HSSPEED", 3.0f, "Horizontal shift speed (MHz)");
+  headers.update("VSSPEED", 8.25f, "Vertical shift speed (usec)");
+  headers.update("PREAMP", 1, "Pre-amplifier gain");
+  headers.update("DATE-OBS", "2026-01-01T00:00:00.000", "Start of exposure");
+  headers.update("JD", 2461041.5, "Julian date");
+}
+
+int main(int argc, char *argv[]) {
+  Options opts;
+  for (int i = 1; i < argc; i++) {
+    bool has_arg = (i + 1 < argc);
+    if (!std::strcmp(argv[i], "--data") && has_arg)
+      opts.data = argv[++i];
+    else if (!std::strcmp(argv[i], "--dir") && has_arg)
+      opts.dir = argv[++i];
+    else if (!std::strcmp(argv[i], "--json") && has_arg)
+      opts.json = argv[++i];
+    else if (!std::strcmp(argv[i], "--min-time") && has_arg)
+      opts.min_time = std::atof(argv[++i]);
+    else if (argv[i][0] != '-' && !opts.filter)
+      opts.filter = argv[i];
+    else {
+      fprintf(stderr,
+              "usage: %s [--data DIR] [--dir DIR] [--min-time SEC] [--json "
+              "FILE] [FILTER]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  std::error_code ec;
+  fs::remove_all(opts.dir, ec);
+  if (!fs::create_directories(opts.dir, ec)) {
+    fprintf(stderr, "[ERROR] Failed to create directory %s\n", opts.dir);
+    return 1;
+  }
+
+  // FCC captures, and what they decode to
+  std::vector<std::string> captures;
+  for (const char *fn : {"fccmsg", "fccmsg.1", "fccmsg.2"}) {
+    char raw[ARISTARCHOS_MAX_HEADER_SIZE];
+    std::string path = std::string(opts.data) + "/" + fn;
+    if (read_capture(path.c_str(), raw, sizeof(raw))) {
+      fprintf(stderr, "[ERROR] Failed to read FCC capture %s\n",
+              path.c_str());
+      return 1;
+    }
+    captures.emplace_back(raw);
+  }
+
+  // silence the debug output of the library
+  fflush(stdout);
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+    fprintf(stderr, "[ERROR] Failed to redirect stdout\n");
+    return 1;
+  }
+
+  constexpr int ASCII_SIZE = 16384;
+  char raw[ARISTARCHOS_MAX_HEADER_SIZE];
+  char ascii[ASCII_SIZE];
+  unsigned ascii_len = 0;
+  std::strcpy(raw, captures[0].c_str());
+  if (!decode_message(raw, ascii, ASCII_SIZE, ascii_len)) {
+    fprintf(stderr, "[ERROR] Failed to decode FCC capture\n");
+    return 1;
+  }
+  std::string decoded(ascii);
+  unsigned decoded_len = ascii_len - 1;
+  std::vector<FitsHeader> fcc_headers;
+  decoded_str_to_header(decoded.c_str(), decoded_len, fcc_headers);
+
+  Bench bench(opts);
+
+  // FCC messages
+  bench.run(
+      "decode_message",
+      [&, k = 0]() mutable {
+        // decoding modifies the message
+        std::strcpy(raw, captures[k++ % captures.size()].c_str());
+        keep(decode_message(raw, ascii, ASCII_SIZE, ascii_len));
+      },
+      captures[0].size());
+  const char *b64 = std::strstr(captures[0].c_str(), "BF=") + 3;
+  std::string block(b64, std::strchr(b64, ';'));
+  std::vector<char> plain(base64decode_len(block.c_str()));
+  bench.run(
+      "base64decode",
+      [&] { keep(base64decode(plain.data(), block.c_str())); },
+      block.size());
+  std::vector<FitsHeader> hvec;
+  bench.run(
+      "decoded_str_to_header",
+      [&] {
+        keep(decoded_str_to_header(decoded.c_str(), decoded_len, hvec));
+      },
+      decoded.size());
+
+  // headers
+  FitsHeaders headers;
+  bench.run("FitsHeaders::update (14 headers)", [&] {
+    headers.clear();
+    typical_headers(headers);
+  });
+  bench.run("FitsHeaders::merge (14 + FCC headers)", [&] {
+    headers.clear();
+    typical_headers(headers);
+    keep(headers.merge(fcc_headers, false));
+  });
+  fprintf(stderr, "[DEBUG] %d headers after merging %d from FCC\n",
+          (int)headers.mvec.size(), (int)fcc_headers.size());
+
+  // FITS files
+  for (int size : {512, 1024, 2048}) {
+    std::vector<int> image(size * size);
+    for (int i = 0; i < size * size; i++)
+      image[i] = 300 + (i * 7919) % 1000;
+    std::string fn = std::string("!") + opts.dir + "/write.fits";
+    char name[64];
+    std::snprintf(name, sizeof(name), "FitsImage::write %dx%d", size, size);
+    bench.run(
+        name,
+        [&] {
+          FitsImage<int32_t> fits(fn.c_str(), size, size);
+          keep(fits.write(image.data()));
+          fits.close();
+        },
+        image.size() * sizeof(int));
+  }
+  {
+    std::string fn = std::string("!") + opts.dir + "/headers.fits";
+    FitsImage<int32_t> fits(fn.c_str(), 16, 16);
+    std::vector<int> image(16 * 16, 0);
+    fits.write(image.data());
+    char name[64];
+    std::snprintf(name, sizeof(name), "FitsImage::apply_headers (%d headers)",
+                  (int)headers.mvec.size());
+    bench.run(name, [&] { keep(fits.apply_headers(headers, false)); });
+    fits.close();
+  }
+
+  // FITS filenames, in directories of 10, 1k and 10k files, half of which
+  // belong to the series
+  AndorParameters params;
+  std::strcpy(params.image_filename_, "bench");
+  for (int files : {10, 1000, 10000}) {
+    std::string dir = std::string(opts.dir) + "/fn" + std::to_string(files);
+    fs::create_directories(dir, ec);
+    char date[16];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y%m%d", std::gmtime(&now));
+    for (int i = 0; i < files; i++) {
+      char fn[256];
+      std::snprintf(fn, sizeof(fn), "%s/%s%s%d.fits", dir.c_str(),
+                    (i % 2) ? "other" : "bench", date, i);
+      std::ofstream(fn).put('\0');
+    }
+    std::strcpy(params.save_dir_, dir.c_str());
+    char name[64];
+    std::snprintf(name, sizeof(name), "make_fits_filename (%d files)", files);
+    bench.run(name, [&] { keep(make_fits_filename(&params)); });
+  }
+
+  // command parsing
+  const char *command = "image --nimages 10 --bin 2 --hstart 513 --hend 1536 "
+                        "--vstart 513 --vend 1536 --exposure 30 --type object "
+                        "--filename m31_r --object M31 --filter R --ar-tries "
+                        "0";
+  bench.run("resolve_image_parameters", [&] {
+    params.set_defaults();
+    keep(resolve_image_parameters(command, params));
+  });
+
+  // date strings
+  char dbuf[64];
+  bench.run("date_str", [&] { keep(date_str(dbuf)); });
+  auto tp = std::chrono::system_clock::now();
+  bench.run("strfdt<YMDHMfS> (1 ms steps)", [&] {
+    tp += std::chrono::milliseconds(1);
+    keep(strfdt<DateTimeFormat::YMDHMfS>(tp, dbuf));
+  });
+  bench.run("strfdt<YMDHMfS> (1 sec steps)", [&] {
+    tp += std::chrono::seconds(1);
+    keep(strfdt<DateTimeFormat::YMDHMfS>(tp, dbuf));
+  });
+
+  // frame times; capturing is on the acquisition path, right after
+  // WaitForAcquisition returns (refilling the reserved storage is no
+  // allocation)
+  {
+    ClockMonitor monitor;
+    FrameTimes times(&monitor);
+    times.begin(1 << 16, 1e0, 1500000000l);
+    bench.run("FrameTimes::capture", [&] {
+      FrameTime *ft = times.capture();
+      if (!ft)
+        times.begin(1 << 16, 1e0, 1500000000l);
+      keep(ft);
+    });
+    FitsHeaders fheaders;
+    int64_t ns = 1600000000000000000ll;
+    bench.run("FrameTimes::apply_headers", [&] {
+      FrameTime ft;
+      ft.start_utc_ns = ns += 1000000;
+      ft.end_utc_ns = ns + 1000000000;
+      keep(times.apply_headers(ft, fheaders));
+    });
+  }
+
+  // socket replies, to a local peer drained by another thread
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+    fprintf(stderr, "[ERROR] Failed to create socket pair\n");
+    return 1;
+  }
+  std::thread drain([fd = sv[1]] {
+    char buf[4096];
+    while (::recv(fd, buf, sizeof(buf), 0) > 0)
+      ;
+  });
+  {
+    andor2k::Socket socket(sv[0], sockaddr_in{});
+    char sbuf[MAX_SOCKET_BUFFER_SIZE];
+    bench.run("socket_sprintf", [&, k = 0]() mutable {
+      keep(socket_sprintf(socket, sbuf,
+                          "status:acquired;image:%03d/%03d;progress:%.1f",
+                          k % 100, 100, k * 1e0));
+      ++k;
+    });
+  } // closes sv[0]; the drain thread sees EOF
+  drain.join();
+  close(sv[1]);
+
+  fs::remove_all(opts.dir, ec);
+  if (opts.json && bench.write_json(opts.json)) {
+    fprintf(stderr, "[ERROR] Failed to write %s\n", opts.json);
+    return 1;
+  }
+  return 0;
+}
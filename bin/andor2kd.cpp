@@ -1,19 +1,45 @@
 #include "andor2kd.hpp"
+#include "acquisition_state.hpp"
 #include "andor2k.hpp"
+#include "async_logger.hpp"
 #include "atmcdLXd.h"
+#include "clock_monitor.hpp"
+#include "command_parser.hpp"
 #include "cpp_socket.hpp"
 #include "cppfits.hpp"
+#include "daemon_state.hpp"
 #include "fits_header.hpp"
+#include "frame_ring.hpp"
+#include "latency_stats.hpp"
+#include "metrics.hpp"
+#include "obs_queue.hpp"
+#include "readout_plan.hpp"
+#include "sdk_owner.hpp"
+#include "setup_cache.hpp"
+#include "task_pool.hpp"
+#include "telemetry.hpp"
+#include "temperature_controller.hpp"
+#include "thread_setup.hpp"
+#include "timer_service.hpp"
+#include "trace_recorder.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <csignal>
 #include <cstdio>
 #include <cstring>
+#include <climits>
+#include <cstdlib>
 #include <ctime>
 #include <fstream>
+#include <limits>
+#include <mutex>
 #include <pthread.h>
+#include <sys/stat.h>
 #include <thread>
 #include <unistd.h>
+#include <vector>
 
 using andor2k::ServerSocket;
 using andor2k::Socket;
@@ -22,13 +48,39 @@ using namespace std::chrono_literals;
 // Global constants for abort/interrupt
 extern int sig_abort_set;
 extern int sig_interrupt_set;
-extern int abort_exposure_set;
+extern FrameRingWriter g_frame_ring;
+extern std::mutex g_camera_mtx;
+extern TemperatureController g_temp_controller;
+extern std::atomic<CameraState> g_camera_state;
+extern TimerService g_timer_service;
+extern AcquisitionState g_acq_state;
+extern AsyncLogger g_logger;
+extern ClockMonitor g_clock_monitor;
+extern LatencyStats g_latency_stats;
+extern DaemonMetrics g_metrics;
+extern TraceRecorder g_tracer;
+extern TelemetrySampler g_telemetry;
+extern SdkOwner g_sdk;
+extern ThreadSetup g_thread_setup;
+extern TaskPool g_task_pool;
+extern SetupCache g_setup_cache;
 
 // buffers and constants for socket communication
 constexpr int INTITIALIZE_TO_TEMP = -50;
+constexpr std::chrono::seconds ABORT_WAIT{10};
 char fits_file[MAX_FITS_FILE_SIZE] = {'\0'};
 char now_str[32] = {'\0'}; // YYYY-MM-DD HH:MM:SS
 char buffer[MAX_SOCKET_BUFFER_SIZE];
+// where the daemon's state is persisted; may be relocated via the
+// ANDOR2KD_STATE_FILE environment variable (e.g. for benchmark runs)
+const char *state_file = DAEMON_STATE_FILE;
+// serializes writes of the state file; guards state_params, the parameters
+// as last persisted by the thread serving clients
+std::mutex state_mtx;
+AndorParameters state_params;
+
+// server-side queue of image jobs
+ObservationQueue obs_queue;
 
 /// Signal handler to kill daemon (calls shutdown() and then exits)
 void kill_daemon(int signal) noexcept {
@@ -36,6 +88,7 @@ void kill_daemon(int signal) noexcept {
       "[DEBUG][%s] Caught signal (#%d); shutting down daemon (traceback: %s)\n",
       date_str(now_str), signal, __func__);
   system_shutdown(); // RUN
+  g_logger.stop();
   printf("[DEBUG][%s] Goodbye!\n", date_str(now_str));
   exit(signal);
 }
@@ -50,7 +103,34 @@ void segfault_sigaction(int signal, siginfo_t *si, void *arg) {
   exit(signal);
 }
 
+/// @brief Persist the daemon's configuration and target temperature (see
+///        DAEMON_STATE_FILE), with the parameters last persisted by the
+///        thread serving clients; other threads (e.g. initialisation) use
+///        this, so that they never write a stale copy of the parameters
+int persist_state(bool planned_restart = false) noexcept {
+  std::lock_guard<std::mutex> lock(state_mtx);
+  DaemonState state;
+  state.target_temp = g_temp_controller.reading().target;
+  state.planned_restart = planned_restart;
+  state.saved_at = std::time(nullptr);
+  return save_daemon_state(state_params, state, state_file);
+}
+
+/// @brief Persist the daemon's configuration (the live parameters of the
+///        thread serving clients) and target temperature
+int persist_state(const AndorParameters &params,
+                  bool planned_restart = false) noexcept {
+  {
+    std::lock_guard<std::mutex> lock(state_mtx);
+    state_params = params;
+  }
+  return persist_state(planned_restart);
+}
+
 /// Set ANDOR2K temperature via a command of type: "settemp [ITEMP]"
+/// The command returns immediately, replying with the id of the request;
+/// cooling progress is then reported to the client as events of type
+/// "temp;id:[ID];..." (see TemperatureController).
 /// @param[in] command A (char) buffer holding the command to be executed (null
 ///            terminated). The command should be a c-string of type:
 ///            "settemp [ITEMP]" where ITEMP is an integer denoting the
@@ -87,170 +167,928 @@ int set_temperature(const char *command, const Socket &socket) noexcept {
     return 1;
   }
 
-  // command seems ok .... do it!
-  return cool_to_temperature(target_temp, &socket);
+  // command seems ok .... hand it over to the temperature controller
+  uint64_t id;
+  if (g_temp_controller.set_target(target_temp, &socket, id)) {
+    socket_sprintf(socket, buffer,
+                   "done;error:2;status:Temperature controller not running!");
+    return 2;
+  }
+  socket_sprintf(socket, buffer, "done;error:0;id:%lu;target:%+d;status:cooling",
+                 id, target_temp);
+  return 0;
+}
+
+/// @brief Setup and perform an acquisition, given already resolved image
+///        parameters (see resolve_image_parameters). Used both for plain
+///        "image" commands and for jobs executed by the observation queue.
+int acquire_image(AndorParameters &params, const Socket &socket) noexcept {
+  // if requested, wait for the temperature to settle
+  if (params.temp_tolerance_ >= 0e0) {
+    char sbuf[MAX_SOCKET_BUFFER_SIZE];
+    socket_sprintf(socket, sbuf,
+                   "info;status:waiting for temperature within %.1fC of target",
+                   params.temp_tolerance_);
+    int tstatus = g_temp_controller.wait_within(
+        params.temp_tolerance_, std::chrono::minutes{MAX_COOLING_DURATION});
+    if (tstatus) {
+      fprintf(stderr,
+              "[ERROR][%s] Temperature not within %.1fC of target; aborting "
+              "request! (traceback: %s)\n",
+              date_str(now_str), params.temp_tolerance_, __func__);
+      socket_sprintf(socket, sbuf, "done;error:%d;status:%s", tstatus,
+                     tstatus == 1 ? "Temperature not stabilized in time"
+                                  : "No target temperature set");
+      return 4;
+    }
+  }
+
+  // setup the acquisition process for the image(s) and acquire them, on the
+  // SDK owner; while acquiring, it only serves queries (e.g. status and
+  // temperature) between frames, other SDK requests wait
+  int width, height;
+  float vsspeed, hsspeed;
+  FitsHeaders fheaders;
+  at_32 *data = nullptr; // remember to free this
+  bool locked = false;
+  int status = g_sdk.call([&] {
+    // also prepare FITS headers for later use in the file(s) to be saved
+    if (setup_acquisition(&params, &fheaders, width, height, vsspeed, hsspeed,
+                          data))
+      return 2;
+    // keep the frame buffer in RAM (if so configured)
+    locked = !g_thread_setup.lock_memory(data, sizeof(at_32) * width * height);
+    return 0;
+  });
+  if (!status) {
+    // a scheduled start is waited for here, with the SDK owner free; an
+    // abort meanwhile is reported by get_acquisition
+    wait_scheduled_start(&params, socket);
+    status = g_sdk.call([&] {
+      return get_acquisition(&params, &fheaders, width, height, data, socket)
+                 ? 3
+                 : 0;
+    });
+  }
+  if (status == 2)
+    fprintf(stderr,
+            "[ERROR][%s] Failed to setup acquisition; aborting request! "
+            "(traceback: %s)\n",
+            date_str(now_str), __func__);
+  else if (status == 3)
+    fprintf(stderr,
+            "[ERROR][%s] Failed to get/save image(s); aborting request now "
+            "(traceback: %s)\n",
+            date_str(now_str), __func__);
+
+  // write the timeline of the request (if tracing)
+  if (g_tracer.enabled())
+    g_tracer.flush(params.save_dir_);
+
+  // free memory and return
+  if (locked)
+    g_thread_setup.unlock_memory(data, sizeof(at_32) * width * height);
+  delete[] data;
+  return status;
 }
 
 int get_image(const char *command, const Socket &socket,
               AndorParameters &params) noexcept {
 
   // first try to resolve the image parameters of the command
-  if (resolve_image_parameters(command, params)) {
+  CommandError error;
+  if (resolve_image_parameters(command, params, &error)) {
     fprintf(stderr,
             "[ERROR][%s] Failed to resolve image parameters; aborting request! "
             "(traceback: %s)\n",
             date_str(now_str), __func__);
+    char sbuf[MAX_SOCKET_BUFFER_SIZE], ebuf[256] = "invalid image parameters";
+    if (error.error != ParseError::None)
+      error.format(ebuf, sizeof(ebuf));
+    socket_sprintf(socket, sbuf, "done;error:1;status:%s;time:%s;", ebuf,
+                   date_str(now_str));
     return 1;
   }
 
-  // setup the acquisition process for the image(s); also prepare FITS headers
-  // for later use in the file(s) to be saved
-  int width, height;
-  float vsspeed, hsspeed;
-  FitsHeaders fheaders;
-  at_32 *data = nullptr; // remember to free this
-  int status = 0;
-  if (setup_acquisition(&params, &fheaders, width, height, vsspeed, hsspeed,
-                        data)) {
+  // run it as a job, ahead of the queued ones (but after any plain image
+  // still waiting), so that clients are still served (status, queue, abort,
+  // ...) while it is acquired; progress and the final "done" are reported
+  // by the job, tagged with its id
+  uint64_t id;
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  if (obs_queue.insert_immediate(command, params, socket, id)) {
+    socket_sprintf(socket, sbuf, "done;error:2;status:Queue full or stopped");
+    return 2;
+  }
+  // (tell the client if it has to wait for another job, or a paused queue)
+  uint64_t running = obs_queue.running();
+  if (obs_queue.paused() || (running && running != id))
+    socket_sprintf(socket, sbuf, "info;status:queued;id:%lu;paused:%d", id,
+                   (int)obs_queue.paused());
+  return 0;
+}
+
+/// @brief Bring up the camera, while the daemon is already serving clients.
+/// Progress is tracked in g_camera_state: Initialising -> Cooling (camera
+/// usable, cooling in the background) -> Ready (temperature stabilized). On
+/// failure the state is set to Error and the daemon keeps running, so that
+/// clients can query the status and shut it down.
+/// @param[in] target_temp Temperature (Celsius) to cool the camera to
+/// @param[in] warm_restart Set if the daemon was stopped for a planned
+///            restart (and is back within WARM_RESTART_MAX_AGE)
+void initialize_camera(AndorParameters params, int target_temp,
+                       bool warm_restart) noexcept {
+  char buf[32];
+  g_thread_setup.setup_this_thread("andor-init", ThreadRole::Service);
+  g_camera_state = CameraState::Initialising;
+
+  // select the camera; the selection only holds for the calling thread,
+  // hence on the SDK owner
+  if (g_sdk.call([&] { return select_camera(params.camera_num_); }) < 0) {
+    fprintf(stderr, "[FATAL][%s] Failed to select camera\n", date_str(buf));
+    g_camera_state = CameraState::Error;
+    return;
+  }
+
+  // initialize CCD
+  printf("[DEBUG][%s] Initializing CCD ...\n", date_str(buf));
+  unsigned int error =
+      g_sdk.call([&] { return Initialize(params.initialization_dir_); });
+  if (error != DRV_SUCCESS) {
+    fprintf(stderr, "[FATAL][%s] Initialisation error (%u)\n", date_str(buf),
+            error);
+    g_camera_state = CameraState::Error;
+    return;
+  }
+  // allow initialization ... go to sleep for two seconds
+  std::this_thread::sleep_for(2000ms);
+  printf("[DEBUG][%s] CCD initialized\n", date_str(buf));
+
+  // query what does not change (detector size, speeds, gains) once; without
+  // it, every acquisition setup asks the camera
+  if (g_sdk.call([] { return g_setup_cache.load(); }))
     fprintf(stderr,
-            "[ERROR][%s] Failed to setup acquisition; aborting request! "
-            "(traceback: %s)\n",
-            date_str(now_str), __func__);
-    status = 2;
+            "[WRNNG][%s] Failed to cache camera capabilities; they will be "
+            "queried for every acquisition\n",
+            date_str(buf));
+
+  // sample temperature and status in the background; status requests and
+  // headers read the latest sample instead of querying the SDK
+  auto interval = TELEMETRY_SAMPLE_INTERVAL;
+  if (const char *ms = std::getenv("ANDOR2KD_TELEMETRY_INTERVAL_MS");
+      ms && std::atol(ms) > 0)
+    interval = std::chrono::milliseconds(std::atol(ms));
+  if (g_telemetry.start(interval))
+    fprintf(stderr,
+            "[WRNNG][%s] Failed to start telemetry sampler; status requests "
+            "will query the camera\n",
+            date_str(buf));
+
+  // is the camera already cold (e.g. warm restart, where the cooler kept
+  // running)? then there is no need to wait for it to cool down
+  float ctemp;
+  unsigned terror = g_sdk.call([&] { return GetTemperatureF(&ctemp); });
+  bool cold = (terror != DRV_NOT_INITIALIZED && terror != DRV_ERROR_ACK &&
+               terror != DRV_ACQUIRING) &&
+              std::abs(ctemp - target_temp) <= COLD_CAMERA_TOLERANCE;
+  if (cold)
+    printf("[DEBUG][%s] Camera is already at %+.1fC (target %+dC, %s "
+           "restart); skipping cool-down\n",
+           date_str(buf), ctemp, target_temp, warm_restart ? "warm" : "cold");
+  else if (warm_restart)
+    fprintf(stderr,
+            "[WRNNG][%s] Planned restart, but the camera is at %+.1fC (target "
+            "%+dC); cooling down\n",
+            date_str(buf), ctemp, target_temp);
+
+  // start cooling down in the background; the camera is usable meanwhile
+  uint64_t temp_job;
+  if (g_temp_controller.start() ||
+      g_temp_controller.set_target(target_temp, nullptr, temp_job, cold)) {
+    fprintf(stderr, "[FATAL][%s] Failed to set target temperature\n",
+            date_str(buf));
+    g_camera_state = CameraState::Error;
+    return;
   }
+  g_camera_state = CameraState::Cooling;
+  obs_queue.resume();
 
-  if (!status) {
-    if (status =
-            get_acquisition(&params, &fheaders, width, height, data, socket);
-        status != 0) {
-      fprintf(stderr,
-              "[ERROR][%s] Failed to get/save image(s); aborting request now "
-              "(traceback: %s)\n",
-              date_str(now_str), __func__);
-      status = 3;
-    }
+  // from now on, an exit is not a planned restart (unless told otherwise);
+  // (saved with the parameters of the thread serving clients, which may have
+  // changed since params was copied)
+  persist_state();
+
+  if (!g_temp_controller.wait_stabilized(
+          std::chrono::minutes{MAX_COOLING_DURATION})) {
+    g_camera_state = CameraState::Ready;
+    printf("[DEBUG][%s] Camera is ready\n", date_str(buf));
   }
+}
 
-  // free memory and return
-  delete[] data;
-  return status;
+/// @brief Abort the acquisition in progress, if any (e.g. a job run by the
+///        observation queue), and wait for it to wind down
+int abort_acquisition(const Socket &socket) noexcept {
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  auto acq = g_acq_state.snapshot();
+  if (!acquisition_active(acq.phase)) {
+    socket_sprintf(socket, sbuf,
+                   "done;error:0;acq:%s;status:no acquisition in progress",
+                   AcquisitionPhase2str(acq.phase));
+    return 0;
+  }
+
+  // mark the abort and interrupt WaitForAcquisition (if waiting)
+  printf("[DEBUG][%s] Aborting acquisition (image %d/%d)\n",
+         date_str(now_str), acq.cur_image, acq.num_images);
+  g_acq_state.request_abort();
+  CancelWait();
+
+  // the acquiring thread publishes the end of the acquisition
+  auto deadline = std::chrono::steady_clock::now() + ABORT_WAIT;
+  acq = g_acq_state.snapshot();
+  while (acquisition_active(acq.phase)) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0)
+      break;
+    acq = g_acq_state.wait(acq.seq, left);
+  }
+
+  if (acquisition_active(acq.phase)) {
+    fprintf(stderr,
+            "[ERROR][%s] Acquisition still running %ld sec after abort "
+            "request (traceback: %s)\n",
+            date_str(now_str), (long)ABORT_WAIT.count(), __func__);
+    socket_sprintf(socket, sbuf,
+                   "done;error:1;acq:%s;status:abort requested, acquisition "
+                   "still running",
+                   AcquisitionPhase2str(acq.phase));
+    return 1;
+  }
+  socket_sprintf(socket, sbuf,
+                 "done;error:0;acq:%s;status:acquisition aborted after %d/%d "
+                 "images",
+                 AcquisitionPhase2str(acq.phase), acq.images_done,
+                 acq.num_images);
+  return 0;
 }
 
-int set_param_value(const char *command, AndorParameters &params) noexcept {
-  if (std::strncmp(command, "setparam", 8))
+/// @brief Collect the daemon's metrics in Prometheus text format (served by
+///        the metrics endpoint). Only in-memory state is read; the SDK is
+///        never called, so that scraping cannot interfere with acquisitions.
+int collect_metrics(char *buf, int buf_sz) noexcept {
+  char labels[64];
+  int len = 0;
+  if (buf_sz > 0)
+    buf[0] = '\0';
+  auto load = [](const auto &a) {
+    return static_cast<double>(a.load(std::memory_order_relaxed));
+  };
+
+  len = prometheus_append(buf, buf_sz, len, "andor2k_frames_acquired_total",
+                          "counter", "Frames acquired.",
+                          load(g_metrics.frames_acquired));
+  len = prometheus_append(buf, buf_sz, len, "andor2k_frames_written_total",
+                          "counter", "Frames written to FITS files.",
+                          load(g_metrics.frames_written));
+  len = prometheus_append(buf, buf_sz, len, "andor2k_bytes_written_total",
+                          "counter", "Image data written to FITS files.",
+                          load(g_metrics.bytes_written));
+  len = prometheus_append(
+      buf, buf_sz, len, "andor2k_frame_interval_seconds", "gauge",
+      "Interval between the last two frames of an acquisition (cadence).",
+      load(g_metrics.frame_interval_ns) / 1e9);
+  len = prometheus_append(buf, buf_sz, len, "andor2k_fits_write_seconds",
+                          "gauge",
+                          "Time to write (data, headers, close) the last "
+                          "FITS file.",
+                          load(g_metrics.last_write_ns) / 1e9);
+  len = prometheus_append(buf, buf_sz, len, "andor2k_queue_depth", "gauge",
+                          "Jobs pending in the observation queue.",
+                          obs_queue.pending());
+  len = prometheus_append(buf, buf_sz, len, "andor2k_acquisition_active",
+                          "gauge", "Whether an acquisition is in progress.",
+                          acquisition_active(g_acq_state.snapshot().phase));
+  len = prometheus_append(buf, buf_sz, len, "andor2k_sdk_commands_total",
+                          "counter", "Commands executed by the SDK owner.",
+                          static_cast<double>(g_sdk.executed()));
+  len = prometheus_append(buf, buf_sz, len, "andor2k_sdk_queue_depth", "gauge",
+                          "Commands waiting for the SDK owner.",
+                          g_sdk.pending());
+  len = prometheus_append(buf, buf_sz, len, "andor2k_locked_memory_bytes",
+                          "gauge", "Frame memory locked in RAM.",
+                          static_cast<double>(g_thread_setup.locked_bytes()));
+  len = prometheus_append(buf, buf_sz, len, "andor2k_thread_setup_failures",
+                          "gauge",
+                          "Thread/memory settings that failed to take effect.",
+                          g_thread_setup.failures());
+
+  len = prometheus_append(buf, buf_sz, len, "andor2k_setup_steps_total",
+                          "counter",
+                          "Acquisition setup steps, skipped if the camera "
+                          "was already set up so.",
+                          static_cast<double>(g_setup_cache.skipped()),
+                          "result=\"skipped\"");
+  len = prometheus_append(buf, buf_sz, len, "andor2k_setup_steps_total",
+                          nullptr, nullptr,
+                          static_cast<double>(g_setup_cache.issued()),
+                          "result=\"issued\"");
+
+  // post-readout processing on the task pool, per task type
+  len = prometheus_append(buf, buf_sz, len, "andor2k_task_queue_depth",
+                          "gauge", "Tasks waiting for a pool thread.",
+                          g_task_pool.pending());
+  const char *task_help[] = {"Tasks run by the task pool.",
+                             "CPU time spent running tasks.",
+                             "Time tasks spent waiting for a pool thread."};
+  for (int i = 0; i < NUM_TASK_TYPES; i++) {
+    TaskTypeStats ts = g_task_pool.stats(static_cast<TaskType>(i));
+    std::snprintf(labels, sizeof(labels), "type=\"%s\"",
+                  TaskType2str(static_cast<TaskType>(i)));
+    len = prometheus_append(buf, buf_sz, len, "andor2k_tasks_total",
+                            i ? nullptr : "counter", task_help[0],
+                            static_cast<double>(ts.completed), labels);
+  }
+  for (int i = 0; i < NUM_TASK_TYPES; i++) {
+    TaskTypeStats ts = g_task_pool.stats(static_cast<TaskType>(i));
+    std::snprintf(labels, sizeof(labels), "type=\"%s\"",
+                  TaskType2str(static_cast<TaskType>(i)));
+    len = prometheus_append(buf, buf_sz, len, "andor2k_task_cpu_seconds_total",
+                            i ? nullptr : "counter", task_help[1],
+                            ts.cpu_ns / 1e9, labels);
+  }
+  for (int i = 0; i < NUM_TASK_TYPES; i++) {
+    TaskTypeStats ts = g_task_pool.stats(static_cast<TaskType>(i));
+    std::snprintf(labels, sizeof(labels), "type=\"%s\"",
+                  TaskType2str(static_cast<TaskType>(i)));
+    len = prometheus_append(buf, buf_sz, len,
+                            "andor2k_task_wait_seconds_total",
+                            i ? nullptr : "counter", task_help[2],
+                            ts.wait_ns / 1e9, labels);
+  }
+
+  // temperature, as last sampled (or else as last read by the temperature
+  // controller)
+  TemperatureReading tr = g_temp_controller.reading();
+  TelemetrySnapshot tel = g_telemetry.snapshot();
+  len = prometheus_append(buf, buf_sz, len, "andor2k_ccd_temperature_celsius",
+                          "gauge", "Last CCD temperature read.",
+                          tel.valid() ? tel.temp : tr.ctemp);
+  len = prometheus_append(buf, buf_sz, len, "andor2k_cooler_on", "gauge",
+                          "Whether the cooler is on (as last sampled).",
+                          tel.cooler_on);
+  len = prometheus_append(
+      buf, buf_sz, len, "andor2k_ccd_target_temperature_celsius", "gauge",
+      "Target CCD temperature.", tr.target);
+  for (int i = 0; i <= static_cast<int>(TempControlState::Failed); i++) {
+    auto s = static_cast<TempControlState>(i);
+    std::snprintf(labels, sizeof(labels), "state=\"%s\"",
+                  TempControlState2str(s));
+    len = prometheus_append(buf, buf_sz, len, "andor2k_cooler_state",
+                            i ? nullptr : "gauge",
+                            "State of the temperature control.",
+                            tr.state == s, labels);
+  }
+  for (int i = 0; i <= static_cast<int>(CameraState::Error); i++) {
+    auto s = static_cast<CameraState>(i);
+    std::snprintf(labels, sizeof(labels), "state=\"%s\"", CameraState2str(s));
+    len = prometheus_append(buf, buf_sz, len, "andor2k_camera_state",
+                            i ? nullptr : "gauge", "State of the camera.",
+                            g_camera_state == s, labels);
+  }
+
+  len = prometheus_append(buf, buf_sz, len, "andor2k_aristarchos_fetch_total",
+                          "counter", "Attempts to fetch Aristarchos headers.",
+                          load(g_metrics.aristarchos_ok), "result=\"ok\"");
+  len = prometheus_append(buf, buf_sz, len, "andor2k_aristarchos_fetch_total",
+                          nullptr, nullptr, load(g_metrics.aristarchos_failed),
+                          "result=\"failed\"");
+  len = prometheus_append(buf, buf_sz, len, "andor2k_clients_connected",
+                          "gauge", "Clients currently connected.",
+                          load(g_metrics.clients));
+
+  // clock correction applied to frame timestamps
+  ClockMonitor::Estimate ce = g_clock_monitor.estimate();
+  len = prometheus_append(buf, buf_sz, len, "andor2k_clock_synchronized",
+                          "gauge", "Whether an NTP server has been reached.",
+                          g_clock_monitor.synchronized());
+  len = prometheus_append(buf, buf_sz, len, "andor2k_clock_offset_seconds",
+                          "gauge",
+                          "Correction applied to the system clock (NTP "
+                          "time minus system time).",
+                          g_clock_monitor.correction_ns() / 1e9);
+  len = prometheus_append(buf, buf_sz, len, "andor2k_clock_drift_ppm",
+                          "gauge", "Estimated drift of the system clock.",
+                          ce.drift_ppm);
+  len = prometheus_append(buf, buf_sz, len, "andor2k_clock_ntp_delay_seconds",
+                          "gauge",
+                          "Round-trip delay of the NTP sample last used.",
+                          ce.delay_ns / 1e9);
+  return len;
+}
+
+/// @brief Report the per-phase latency statistics of acquisitions (counts,
+///        percentiles and max, in milliseconds); "stats reset" clears them
+int stats_command(const char *command, const Socket &socket) noexcept {
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  const char *arg = command + 5;
+  while (*arg == ' ')
+    ++arg;
+  if (!std::strncmp(arg, "reset", 5)) {
+    g_latency_stats.reset();
+    socket_sprintf(socket, sbuf, "done;error:0;info:statistics cleared");
+    return 0;
+  } else if (*arg) {
+    socket_sprintf(socket, sbuf,
+                   "done;error:1;status:invalid stats argument (use reset)");
+    return 1;
+  }
+  // leave room for the status and time fields added to the reply
+  char stats[MAX_SOCKET_BUFFER_SIZE - 64];
+  g_latency_stats.format(stats, sizeof(stats));
+  socket_sprintf(socket, sbuf, "done;error:0;%s", stats);
+  return 0;
+}
+
+/// @brief Report where the task pool spends its time, per task type (tasks
+///        run, stolen, and total/max wait, run and CPU times, in
+///        milliseconds); "tasks reset" clears the accounts
+int tasks_command(const char *command, const Socket &socket) noexcept {
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  const char *arg = command + 5;
+  while (*arg == ' ')
+    ++arg;
+  if (!std::strncmp(arg, "reset", 5)) {
+    g_task_pool.reset_stats();
+    socket_sprintf(socket, sbuf, "done;error:0;info:task accounts cleared");
+    return 0;
+  } else if (*arg) {
+    socket_sprintf(socket, sbuf,
+                   "done;error:1;status:invalid tasks argument (use reset)");
+    return 1;
+  }
+  char stats[MAX_SOCKET_BUFFER_SIZE - 64];
+  g_task_pool.format(stats, sizeof(stats));
+  socket_sprintf(socket, sbuf, "done;error:0;threads:%d;pending:%d;%s",
+                 g_task_pool.size(), g_task_pool.pending(), stats);
+  return 0;
+}
+
+/// @brief Plan the readout of a series: "plan --cadence [SEC] [--exposure
+///        [SEC]] [--width [PIX]] [--height [PIX]] [--nimages [INT]]
+///        [--max-bin [INT]]" replies with the readout configuration with the
+///        lowest read noise that meets the cadence (see plan_readout), and
+///        its predicted data rate and disk usage (in MB). Nothing is changed
+///        in the daemon's parameters; use setparam/image to apply the plan
+int plan_command(const char *command, const Socket &socket,
+                 const AndorParameters &params) noexcept {
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  PlanRequest request;
+  CommandError error;
+  if (resolve_plan_parameters(command, request, &error)) {
+    char ebuf[256];
+    error.format(ebuf, sizeof(ebuf));
+    socket_sprintf(socket, sbuf, "done;error:1;status:%s", ebuf);
     return 1;
+  }
 
-  // copy the input string so that we can tokenize it
-  char string[MAX_SOCKET_BUFFER_SIZE];
-  std::memcpy(string, command, MAX_SOCKET_BUFFER_SIZE);
+  // the camera is set up for every candidate, hence not while a job uses it
+  // (nor do we wait for the job to finish)
+  ReadoutPlan plan;
+  int status;
+  {
+    std::unique_lock<std::mutex> lock(g_camera_mtx, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      socket_sprintf(socket, sbuf,
+                     "done;error:3;status:busy, camera in use by job %lu",
+                     obs_queue.running());
+      return 3;
+    }
+    status = g_sdk.call([&] { return plan_readout(request, params, plan); });
+  }
+  if (status > 1) {
+    socket_sprintf(socket, sbuf,
+                   "done;error:%d;status:failed to query readout timings",
+                   status);
+    return status;
+  }
+  constexpr double MB = 1024e0 * 1024e0;
+  socket_sprintf(
+      socket, sbuf,
+      "done;error:%d;status:%s;hsspeed:%d;hsspeedmhz:%.3f;preampgain:%d;"
+      "preampgainx:%.1f;bin:%d;hstart:%d;hend:%d;vstart:%d;vend:%d;"
+      "exposure:%.4f;readout:%.4f;mincycle:%.4f;kineticcycletime:%.4f;"
+      "datarate:%.3f;series:%.1f;free:%.1f",
+      status, status ? "cadence not reachable (fastest readout)" : "planned",
+      plan.hsspeed, plan.hsspeed_mhz, plan.preampgain,
+      plan.preampgain_factor, plan.bin, plan.hstart, plan.hend, plan.vstart,
+      plan.vend, plan.exposure, plan.readout, plan.cycle,
+      status ? plan.cycle : request.cadence, plan.data_rate / MB,
+      plan.series_bytes / MB,
+      plan.free_bytes < 0 ? -1e0 : plan.free_bytes / MB);
+  return status;
+}
 
-  int ival;
-  float fval;
+/// @brief Set the tracing mode: "trace request" writes one Chrome trace file
+///        per acquisition request, "trace night" appends all requests to one
+///        file per night and "trace off" stops tracing (writing any pending
+///        events). Files are written in the FITS directory. With no
+///        argument, just report the current mode
+int trace_command(const char *command, const Socket &socket,
+                  const AndorParameters &params) noexcept {
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  const char *arg = command + 5;
+  while (*arg == ' ')
+    ++arg;
+  if (*arg) {
+    TraceMode mode;
+    if (!std::strncmp(arg, "off", 3))
+      mode = TraceMode::Off;
+    else if (!std::strncmp(arg, "request", 7))
+      mode = TraceMode::PerRequest;
+    else if (!std::strncmp(arg, "night", 5))
+      mode = TraceMode::PerNight;
+    else {
+      socket_sprintf(socket, sbuf,
+                     "done;error:1;status:invalid trace mode (use "
+                     "off/request/night)");
+      return 1;
+    }
+    // events recorded so far go to a file named after the previous mode
+    g_tracer.flush(params.save_dir_);
+    if (g_tracer.set_mode(mode)) {
+      socket_sprintf(socket, sbuf,
+                     "done;error:2;status:failed to allocate trace buffers");
+      return 2;
+    }
+  }
+  socket_sprintf(socket, sbuf, "done;error:0;trace:%s;tracedropped:%lu",
+                 TraceMode2str(g_tracer.mode()),
+                 (unsigned long)g_tracer.dropped());
+  return 0;
+}
 
-  char *token = std::strtok(string, " "); // this is the command (aka setparam)
-  token = std::strtok(nullptr, " ");
-  char *start, *end;
-  // split remaining substring to tokens and process one at a time
-  while (token) {
+/// @brief Report the latest telemetry sample and a summary of the history
+///        over the last MINUTES (default 60; up to 24 hours), e.g.
+///        "telemetry 120"
+int telemetry_command(const char *command, const Socket &socket) noexcept {
+  constexpr int MAX_MINUTES =
+      TELEMETRY_HISTORY_SIZE * TELEMETRY_HISTORY_BUCKET_SEC / 60;
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  const char *arg = command + 9;
+  while (*arg == ' ')
+    ++arg;
+  int minutes = 60;
+  if (*arg) {
+    char *end;
+    long m = std::strtol(arg, &end, 10);
+    if (end == arg || *end || m < 1 || m > MAX_MINUTES) {
+      socket_sprintf(socket, sbuf,
+                     "done;error:1;status:invalid telemetry argument (use "
+                     "minutes, up to %d)",
+                     MAX_MINUTES);
+      return 1;
+    }
+    minutes = static_cast<int>(m);
+  }
 
-    if (!std::strncmp(token, "acqmode=", 8)) {
-      ival = std::strtol(token + 8, &end, 10);
-      if (end == token) {
-        return 10;
-      }
-      params.acquisition_mode_ = static_cast<AcquisitionMode>(ival);
-      printf("[DEBUG][%s] Changing Acquisition Mode to : %d!\n",
-             date_str(now_str), ival);
-
-    } else if (!std::strncmp(token, "kineticcycletime=", 17)) {
-      fval = std::strtod(token + 17, &end);
-      if (end == token) {
-        return 10;
-      }
-      params.kinetics_cycle_time_ = fval;
-      printf("[DEBUG][%s] Changing Kinetic Cycle Time to : %.3fsec!\n",
-             date_str(now_str), fval);
-    } else if (!std::strncmp(token, "observername=", 13)) {
-      std::strcpy(params.observer_name_, token + 13);
-      params.observer_name_[31] = '\0';
-    } else if (!std::strncmp(token, "hsspeed=", 8)) {
-      ival = std::strtod(token + 8, &end);
-      if (end == token) {
-        return 10;
-      }
-      // let's ask the cammera to match the index to a current MHz value
-      {
-        int num_speeds;
-        float speed;
-        if (GetNumberHSSpeeds(0, 0, &num_speeds) != DRV_SUCCESS) {
-          fprintf(stderr,
-                  "[WRNNG][%s] Failed to get number of available horizontal "
-                  "speeds for camera! (command: [%s])\n",
-                  date_str(now_str), token);
-          return 2;
-        }
-        if ((ival < 0 || ival >= num_speeds) ||
-            (GetHSSpeed(0, 0, ival, &speed) != DRV_SUCCESS)) {
-          fprintf(stderr,
-                  "[WRNNG][%s] Index is out of limits for horizontal speed ! "
-                  "(command: [%s])\n",
-                  date_str(now_str), token);
-          return 2;
-        }
-        printf("[DEBUG][%s] Changing horizontal shift speed to : %.3fMHz!\n",
-               date_str(now_str), speed);
-      }
-      params.hsspeed = ival;
-    } else if (!std::strncmp(token, "preampgain=", 11)) {
-      ival = std::strtod(token + 11, &end);
-      if ((end == token) || (ival < 0 || ival >= 3)) {
-        fprintf(stderr,
-                "[WRNNG][%s] Index is out of limits for pre-amp gain! "
-                "(command: [%s])\n",
-                date_str(now_str), token);
-        return 11;
-      }
-      {
-        float fac;
-        if (GetPreAmpGain(ival, &fac) != DRV_SUCCESS) {
-          fprintf(stderr,
-                  "[ERROR][%s] Failed retrieving Pre-Amp Gain; wierd ..."
-                  "(traceback: %s)\n",
-                  date_str(now_str), __func__);
-          return 1;
-        }
-        printf("[DEBUG][%s] Changing Pre-Amp Gain factor to : %.1fx\n",
-               date_str(now_str), fac);
+  // summarize the history; this copies at most a day's worth of entries
+  std::vector<TelemetryBucket> history;
+  g_telemetry.history(history,
+                      (minutes * 60 + TELEMETRY_HISTORY_BUCKET_SEC - 1) /
+                          TELEMETRY_HISTORY_BUCKET_SEC);
+  TelemetryBucket sum;
+  double temp_sum = 0;
+  for (const auto &b : history) {
+    if (b.temp_samples) {
+      sum.temp_min = sum.temp_samples ? std::min(sum.temp_min, b.temp_min)
+                                      : b.temp_min;
+      sum.temp_max = sum.temp_samples ? std::max(sum.temp_max, b.temp_max)
+                                      : b.temp_max;
+      temp_sum += static_cast<double>(b.temp_mean) * b.temp_samples;
+      sum.temp_samples += b.temp_samples;
+    }
+    sum.samples += b.samples;
+    sum.cooler_on += b.cooler_on;
+    sum.acquiring += b.acquiring;
+  }
+
+  // leave room for the time field added to the reply
+  char reply[MAX_SOCKET_BUFFER_SIZE - 64];
+  TelemetrySnapshot tel = g_telemetry.snapshot();
+  int n = std::snprintf(reply, sizeof(reply),
+                        "done;error:0;sampling:%d;samples:%lu;temp:%+.1f;"
+                        "cooler:%d;minutes:%d;hsamples:%d",
+                        g_telemetry.running(), (unsigned long)tel.samples,
+                        tel.temp, tel.cooler_on, minutes, sum.samples);
+  if (sum.temp_samples)
+    n += std::snprintf(reply + n, sizeof(reply) - n,
+                       ";tmin:%+.1f;tmax:%+.1f;tmean:%+.2f", sum.temp_min,
+                       sum.temp_max, temp_sum / sum.temp_samples);
+  if (sum.samples)
+    std::snprintf(reply + n, sizeof(reply) - n,
+                  ";cooleron:%.2f;acquiring:%.2f",
+                  static_cast<double>(sum.cooler_on) / sum.samples,
+                  static_cast<double>(sum.acquiring) / sum.samples);
+  socket_sprintf(socket, sbuf, "%s", reply);
+  return 0;
+}
+
+/// @brief Set the (runtime) severity level of the logger, e.g.
+///        "loglevel warning"; with no argument, just report the current level
+int loglevel_command(const char *command, const Socket &socket) noexcept {
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  const char *arg = command + 8;
+  while (*arg == ' ')
+    ++arg;
+  if (*arg) {
+    LogLevel level;
+    if (str2LogLevel(arg, level)) {
+      socket_sprintf(socket, sbuf,
+                     "done;error:1;status:invalid log level (use "
+                     "debug/warning/error/fatal)");
+      return 1;
+    }
+    g_logger.set_level(level);
+  }
+  socket_sprintf(socket, sbuf, "done;error:0;loglevel:%s;logdropped:%lu",
+                 LogLevel2str(g_logger.level()), g_logger.dropped());
+  return 0;
+}
+
+/// @brief Check that the camera is initialized and can be used; if not,
+///        reply to the client that the command is rejected
+bool camera_usable(const Socket &socket) noexcept {
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  CameraState state = g_camera_state.load();
+  if (state == CameraState::Cooling || state == CameraState::Ready)
+    return true;
+  socket_sprintf(socket, sbuf,
+                 "done;error:1;state:%s;status:Camera not initialized; "
+                 "command rejected",
+                 CameraState2str(state));
+  return false;
+}
+
+/// Manipulate the observation queue via a command of type:
+/// "queue add [IMAGE_COMMAND]"          append a job, e.g.
+///                                      "queue add image --nimages 5 ..."
+/// "queue insert [POS] [IMAGE_COMMAND]" insert a job at (zero-based) POS
+/// "queue cancel [ID]"                  remove a pending job
+/// "queue move [ID] [POS]"              move a pending job to POS
+/// "queue clear"                        remove all pending jobs
+/// "queue pause"                        do not start any more jobs
+/// "queue resume"                       resume starting jobs
+/// "queue list"                         report running and pending jobs
+/// Jobs may be queued while the camera is still initialising; they start as
+/// soon as the camera is usable.
+int queue_command(const char *command, const Socket &socket,
+                  const AndorParameters &params) noexcept {
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  const char *cmd = command + 5;
+  while (*cmd == ' ')
+    ++cmd;
+
+  char *end;
+  uint64_t id;
+  int status = 0;
+
+  if (!std::strncmp(cmd, "add ", 4) || !std::strncmp(cmd, "insert ", 7)) {
+    int position = -1;
+    const char *image_cmd = cmd + 4;
+    if (*cmd == 'i') {
+      position = std::strtol(cmd + 7, &end, 10);
+      if (end == cmd + 7 || position < 0) {
+        socket_sprintf(socket, sbuf,
+                       "done;error:1;status:Invalid queue position!");
+        return 1;
       }
-      params.preampgain = ival;
-    } else {
-      fprintf(stderr,
-              "[WRNNG][%s] Skipping token in paramter set command: [%s]\n",
-              date_str(now_str), token);
+      image_cmd = end;
+    }
+    while (*image_cmd == ' ')
+      ++image_cmd;
+    CommandError error;
+    if (status =
+            obs_queue.insert(image_cmd, params, socket, position, id, &error);
+        status) {
+      char ebuf[256] = "Invalid image command!";
+      if (error.error != ParseError::None)
+        error.format(ebuf, sizeof(ebuf));
+      socket_sprintf(socket, sbuf, "done;error:%d;status:%s", status,
+                     status == 1 ? ebuf : "Queue is full!");
+      return status;
+    }
+    socket_sprintf(socket, sbuf, "done;error:0;status:queued;id:%lu;pending:%d",
+                   id, obs_queue.pending());
+
+  } else if (!std::strncmp(cmd, "cancel", 6)) {
+    id = std::strtoul(cmd + 6, &end, 10);
+    if (end == cmd + 6 || (status = obs_queue.cancel(id))) {
+      socket_sprintf(socket, sbuf, "done;error:1;status:No such pending job!");
+      return 1;
     }
+    socket_sprintf(socket, sbuf, "done;error:0;status:cancelled;id:%lu", id);
+
+  } else if (!std::strncmp(cmd, "move", 4)) {
+    id = std::strtoul(cmd + 4, &end, 10);
+    const char *pos = end;
+    int position = std::strtol(pos, &end, 10);
+    if (end == pos || position < 0 || (status = obs_queue.move(id, position))) {
+      socket_sprintf(socket, sbuf, "done;error:1;status:Invalid move!");
+      return 1;
+    }
+    socket_sprintf(socket, sbuf, "done;error:0;status:moved;id:%lu;position:%d",
+                   id, position);
+
+  } else if (!std::strncmp(cmd, "clear", 5)) {
+    socket_sprintf(socket, sbuf, "done;error:0;status:cleared;removed:%d",
+                   obs_queue.clear());
+
+  } else if (!std::strncmp(cmd, "pause", 5)) {
+    obs_queue.pause();
+    socket_sprintf(socket, sbuf, "done;error:0;status:paused");
 
-    token = std::strtok(nullptr, " "); // resolve next token (if any)
+  } else if (!std::strncmp(cmd, "resume", 6)) {
+    if (!camera_usable(socket))
+      return 1;
+    obs_queue.resume();
+    socket_sprintf(socket, sbuf, "done;error:0;status:resumed");
+
+  } else if (!std::strncmp(cmd, "list", 4)) {
+    char lbuf[MAX_SOCKET_BUFFER_SIZE - 64];
+    obs_queue.list(lbuf, sizeof(lbuf));
+    socket_sprintf(socket, sbuf, "done;error:0;%s", lbuf);
+
+  } else {
+    socket_sprintf(socket, sbuf, "done;error:1;status:Invalid command!");
+    return 1;
   }
 
   return 0;
 }
 
+namespace {
+using ParamOption = CommandOption<AndorParameters>;
+
+/// @brief Options of the setparam command (as "name=value")
+constexpr ParamOption param_options[] = {
+    {"acqmode", OptionType::Int,
+     static_cast<double>(AcquisitionMode::SingleScan),
+     static_cast<double>(AcquisitionMode::RunTillAbort),
+     [](AndorParameters &params, const OptionValue &v) noexcept {
+       params.acquisition_mode_ = static_cast<AcquisitionMode>(v.i);
+       printf("[DEBUG][%s] Changing Acquisition Mode to : %ld!\n",
+              date_str(now_str), v.i);
+       return 0;
+     }},
+    {"kineticcycletime", OptionType::Float, 0,
+     std::numeric_limits<float>::max(),
+     [](AndorParameters &params, const OptionValue &v) noexcept {
+       params.kinetics_cycle_time_ = static_cast<float>(v.f);
+       printf("[DEBUG][%s] Changing Kinetic Cycle Time to : %.3fsec!\n",
+              date_str(now_str), v.f);
+       return 0;
+     }},
+    {"observername", OptionType::String, 0, MAX_OBSERVER_NAME - 1,
+     [](AndorParameters &params, const OptionValue &v) noexcept {
+       std::memset(params.observer_name_, '\0', MAX_OBSERVER_NAME);
+       v.s.copy(params.observer_name_, MAX_OBSERVER_NAME - 1);
+       return 0;
+     }},
+    {"hsspeed", OptionType::Int, 0, SETUP_CACHE_MAX_ENTRIES - 1,
+     [](AndorParameters &params, const OptionValue &v) noexcept {
+       // let's ask the cammera to match the index to a current MHz value
+       // (unless cached); queries, answered even while acquiring
+       int ival = static_cast<int>(v.i);
+       int num_speeds;
+       float speed;
+       if (g_setup_cache.num_hsspeeds(num_speeds) &&
+           g_sdk.call([&] { return GetNumberHSSpeeds(0, 0, &num_speeds); },
+                      SdkAccess::Query) != DRV_SUCCESS) {
+         fprintf(stderr,
+                 "[WRNNG][%s] Failed to get number of available horizontal "
+                 "speeds for camera! (traceback: %s)\n",
+                 date_str(now_str), __func__);
+         return 2;
+       }
+       if (ival >= num_speeds ||
+           (g_setup_cache.hsspeed(ival, speed) &&
+            g_sdk.call([&] { return GetHSSpeed(0, 0, ival, &speed); },
+                       SdkAccess::Query) != DRV_SUCCESS)) {
+         fprintf(stderr,
+                 "[WRNNG][%s] Index is out of limits for horizontal speed ! "
+                 "(index: %d)\n",
+                 date_str(now_str), ival);
+         return 2;
+       }
+       printf("[DEBUG][%s] Changing horizontal shift speed to : %.3fMHz!\n",
+              date_str(now_str), speed);
+       params.hsspeed = ival;
+       return 0;
+     }},
+    {"preampgain", OptionType::Int, 0, MAX_PREAMP_GAIN_INDEX,
+     [](AndorParameters &params, const OptionValue &v) noexcept {
+       int ival = static_cast<int>(v.i);
+       float fac;
+       if (g_setup_cache.preampgain(ival, fac) &&
+           g_sdk.call([&] { return GetPreAmpGain(ival, &fac); },
+                      SdkAccess::Query) != DRV_SUCCESS) {
+         fprintf(stderr,
+                 "[ERROR][%s] Failed retrieving Pre-Amp Gain; wierd ..."
+                 "(traceback: %s)\n",
+                 date_str(now_str), __func__);
+         return 1;
+       }
+       printf("[DEBUG][%s] Changing Pre-Amp Gain factor to : %.1fx\n",
+              date_str(now_str), fac);
+       params.preampgain = ival;
+       return 0;
+     }},
+    {"savedir", OptionType::String, 0, sizeof(AndorParameters::save_dir_) - 1,
+     [](AndorParameters &params, const OptionValue &v) noexcept {
+       char dir[sizeof(params.save_dir_)] = {'\0'};
+       v.s.copy(dir, sizeof(dir) - 1);
+       struct stat sb;
+       if (stat(dir, &sb) || !S_ISDIR(sb.st_mode)) {
+         fprintf(stderr,
+                 "[WRNNG][%s] Invalid directory to save FITS files to! "
+                 "(directory: [%s])\n",
+                 date_str(now_str), dir);
+         return 12;
+       }
+       std::strcpy(params.save_dir_, dir);
+       printf("[DEBUG][%s] Saving FITS files to : %s\n", date_str(now_str),
+              params.save_dir_);
+       return 0;
+     }}};
+
+constexpr OptionTable param_table("setparam", OptionSyntax::Assign,
+                                  param_options);
+static_assert(param_table.valid(), "No perfect hash for setparam options");
+} // namespace
+
+/// @brief Resolve a "setparam name=value [name=value ...]" command; options
+///        are applied in order, up to the first one in error
+/// @return 0 on success; 10 if an option could not be parsed; else the
+///         status of the option that was rejected (2: hsspeed, 1: preampgain,
+///         12: savedir)
+int set_param_value(const char *command, AndorParameters &params) noexcept {
+  CommandError error;
+  if (param_table.parse(command, params, &error) == ParseError::None)
+    return 0;
+  char ebuf[256];
+  error.format(ebuf, sizeof(ebuf));
+  fprintf(stderr, "[ERROR][%s] Invalid setparam command: %s (traceback: %s)\n",
+          date_str(now_str), ebuf, __func__);
+  return error.error == ParseError::Rejected ? error.status : 10;
+}
+
 int resolve_command(const char *command, const Socket &socket,
                     AndorParameters &params) noexcept {
   if (!(std::strncmp(command, "settemp", 7))) {
-    return set_temperature(command, socket);
+    if (!camera_usable(socket))
+      return 1;
+    int status = set_temperature(command, socket);
+    if (!status)
+      persist_state(params);
+    return status;
   } else if (!(std::strncmp(command, "shutdown", 8))) {
     return -100;
+  } else if (!(std::strncmp(command, "restart", 7))) {
+    // planned restart; keep the camera cold
+    return -200;
   } else if (!(std::strncmp(command, "status", 6))) {
     // report here and also send to client
     return print_status(socket);
+  } else if (!(std::strncmp(command, "stats", 5))) {
+    return stats_command(command, socket);
+  } else if (!(std::strncmp(command, "tasks", 5))) {
+    return tasks_command(command, socket);
+  } else if (!(std::strncmp(command, "trace", 5))) {
+    return trace_command(command, socket, params);
   } else if (!(std::strncmp(command, "setparam", 8))) {
-    return set_param_value(command, params);
+    if (!camera_usable(socket))
+      return 1;
+    int status = set_param_value(command, params);
+    if (!status)
+      persist_state(params);
+    return status;
+  } else if (!(std::strncmp(command, "plan", 4))) {
+    if (!camera_usable(socket))
+      return 1;
+    return plan_command(command, socket, params);
   } else if (!(std::strncmp(command, "image", 5))) {
+    if (!camera_usable(socket))
+      return 1;
     return get_image(command, socket, params);
+  } else if (!(std::strncmp(command, "queue", 5))) {
+    return queue_command(command, socket, params);
+  } else if (!(std::strncmp(command, "telemetry", 9))) {
+    return telemetry_command(command, socket);
+  } else if (!(std::strncmp(command, "loglevel", 8))) {
+    return loglevel_command(command, socket);
   } else if (!(std::strncmp(command, "abort", 5))) {
-    abort_exposure_set = true;
-    return 0;
+    return abort_acquisition(socket);
   } else {
     fprintf(stderr,
             "[ERROR][%s] Failed to resolve command: \"%s\"; doing nothing!\n",
@@ -278,15 +1116,19 @@ int chat(const Socket &socket, AndorParameters &params) {
           "[DEBUG][%s] Received shutdown command; initializing exit sequence\n",
           date_str(now_str));
       break;
+    } else if (answr == -200) {
+      printf("[DEBUG][%s] Received restart command; restarting daemon and "
+             "keeping camera cold\n",
+             date_str(now_str));
+      return -2;
     }
   }
 
   return -1;
 }
 
-int main() {
+int main([[maybe_unused]] int argc, char *argv[]) {
   int sock_status;
-  unsigned int error;
 
   // register signal for SEGFAULT
   struct sigaction sa;
@@ -300,6 +1142,8 @@ int main() {
   signal(SIGINT, kill_daemon);
   signal(SIGQUIT, kill_daemon);
   signal(SIGTERM, kill_daemon);
+  // queued jobs may report to clients that have since disconnected
+  signal(SIGPIPE, SIG_IGN);
 
   // ANDOR2K parameters controlling usage
   AndorParameters params;
@@ -311,45 +1155,152 @@ int main() {
     return 10;
   }
 
-  // select the camera
-  if (select_camera(params.camera_num_) < 0) {
-    fprintf(stderr, "[FATAL][%s] Failed to select camera...exiting\n",
-            date_str(now_str));
-    return 10;
+  // restore configuration and cooler state from the previous run, if any; a
+  // planned restart means the camera should still be cold
+  if (const char *fn = std::getenv("ANDOR2KD_STATE_FILE"); fn && *fn)
+    state_file = fn;
+  DaemonState dstate;
+  dstate.target_temp = INTITIALIZE_TO_TEMP;
+  bool warm_restart = false;
+  if (!load_daemon_state(params, dstate, state_file)) {
+    warm_restart = dstate.planned_restart &&
+                   (std::time(nullptr) - dstate.saved_at) <
+                       std::chrono::duration_cast<std::chrono::seconds>(
+                           WARM_RESTART_MAX_AGE)
+                           .count();
+    printf("[DEBUG][%s] Restored state from %s (target temperature %+dC, %s "
+           "restart)\n",
+           date_str(now_str), state_file, dstate.target_temp,
+           warm_restart ? "warm" : "cold");
+  }
+  state_params = params; // (no other thread yet)
+
+  // resolve our own executable now, in case we need to restart later
+  char self_exe[PATH_MAX] = {'\0'};
+  if (!realpath(argv[0], self_exe)) {
+    ssize_t sz = readlink("/proc/self/exe", self_exe, PATH_MAX - 1);
+    self_exe[sz > 0 ? sz : 0] = '\0';
   }
 
   // report daemon initialization
   printf("[DEBUG][%s] Initializing ANDOR2K daemon service\n",
          date_str(now_str));
 
-  // initialize CCD
-  printf("[DEBUG][%s] Initializing CCD ....", date_str(now_str));
-  error = Initialize(params.initialization_dir_);
-  if (error != DRV_SUCCESS) {
-    fprintf(stderr, "[FATAL][%s] Initialisation error...exiting\n",
+  // CPU affinity/scheduling of the acquisition and writer threads, locking
+  // of frame memory; must be set before any thread is started
+  g_thread_setup.configure_from_env();
+
+  // publish acquired frames to shared memory; failing to do so is not fatal,
+  // images will still be saved as FITS
+  if (g_frame_ring.open(FRAME_RING_SHM_NAME, FRAME_RING_NUM_SLOTS,
+                        sizeof(at_32) * MAX_PIXELS_IN_DIM * MAX_PIXELS_IN_DIM)) {
+    fprintf(stderr,
+            "[WRNNG][%s] Failed to create shared memory frame ring; frames "
+            "will not be published\n",
+            date_str(now_str));
+  } else if (g_thread_setup.config().lock_memory &&
+             !g_thread_setup.lock_memory(g_frame_ring.data(),
+                                         g_frame_ring.size())) {
+    printf("[DEBUG][%s] Locked %zu bytes of shared memory frame ring\n",
+           date_str(now_str), g_frame_ring.size());
+  }
+
+  // acquisition paths log via the asynchronous logger; if it fails to
+  // start, messages are written synchronously
+  if (g_logger.start()) {
+    fprintf(stderr,
+            "[WRNNG][%s] Failed to start asynchronous logger; logging "
+            "synchronously\n",
+            date_str(now_str));
+  }
+
+  // timed acquisition phases also go to the trace (when tracing is on)
+  g_latency_stats.set_tracer(&g_tracer);
+
+  // single timer thread for all periodic work (e.g. progress reports while
+  // acquiring); without it acquisitions only report when frames complete
+  if (g_timer_service.start()) {
+    fprintf(stderr,
+            "[WRNNG][%s] Failed to start timer service; no progress reports "
+            "while acquiring\n",
             date_str(now_str));
-    return 10;
   }
-  // allow initialization ... go to sleep for two seconds
-  std::this_thread::sleep_for(2000ms);
-  printf("... ok!\n");
 
-  // cool down if needed RUN
-  if (cool_to_temperature(INTITIALIZE_TO_TEMP)) {
-    fprintf(stderr, "[FATAL][%s] Failed to set target temperature...exiting\n",
+  // track the offset of the system clock from NTP servers (off the
+  // acquisition paths), to correct frame timestamps; without it, frames are
+  // stamped with the system clock as is
+  const char *ntp_servers = std::getenv("ANDOR2KD_NTP_SERVERS");
+  if (!ntp_servers || !*ntp_servers)
+    ntp_servers = DEFAULT_NTP_SERVERS;
+  if (std::strcmp(ntp_servers, "none") && g_clock_monitor.start(ntp_servers)) {
+    fprintf(stderr,
+            "[WRNNG][%s] Failed to start clock monitor; frame timestamps "
+            "will not be corrected\n",
+            date_str(now_str));
+  }
+
+  // metrics for monitoring (e.g. Prometheus), on localhost only; not fatal
+  MetricsServer metrics_server;
+  if (metrics_server.start(METRICS_PORT, collect_metrics)) {
+    fprintf(stderr,
+            "[WRNNG][%s] Failed to start metrics endpoint on localhost:%d\n",
+            date_str(now_str), METRICS_PORT);
+  }
+
+  // a single thread talks to the SDK (acquisitions run on it as a whole);
+  // without it, SDK calls are made from whichever thread needs them
+  if (g_sdk.start()) {
+    fprintf(stderr,
+            "[WRNNG][%s] Failed to start SDK owner thread; SDK calls will not "
+            "be serialized\n",
+            date_str(now_str));
+  }
+
+  // post-readout processing (writing FITS files, ...) runs on a pool of
+  // threads; without it, acquisitions write their frames themselves
+  int pool_threads = TASK_POOL_THREADS;
+  if (const char *str = std::getenv("ANDOR2KD_POOL_THREADS"); str && *str) {
+    char *end;
+    long n = std::strtol(str, &end, 10);
+    if (*end || n < 0 || n > TASK_POOL_MAX_THREADS) {
+      fprintf(stderr,
+              "[WRNNG][%s] Invalid ANDOR2KD_POOL_THREADS \"%s\"; using %d "
+              "threads\n",
+              date_str(now_str), str, pool_threads);
+    } else {
+      pool_threads = static_cast<int>(n);
+    }
+  }
+  if (pool_threads && g_task_pool.start(pool_threads)) {
+    fprintf(stderr,
+            "[WRNNG][%s] Failed to start task pool; frames will be written "
+            "by the acquisition thread\n",
+            date_str(now_str));
+  }
+
+  // start the observation queue; jobs are accepted right away, but will only
+  // start executing once the camera is initialized
+  if (obs_queue.start(acquire_image, true)) {
+    fprintf(stderr, "[FATAL][%s] Failed to start observation queue...exiting\n",
             date_str(now_str));
     return 10;
   }
 
+  std::thread init_thread;
+  int shutdown_received = 0;
   try {
     ServerSocket server_sock(SOCKET_PORT);
 
     printf("[DEBUG][%s] Listening on port %d\n", date_str(now_str),
            SOCKET_PORT);
+
+    // bring up the camera in the background; clients are served meanwhile
+    init_thread = std::thread(initialize_camera, params, dstate.target_temp,
+                              warm_restart);
+
     printf("[DEBUG][%s] Service is up and running ... waiting for input\n",
            date_str(now_str));
 
-    int shutdown_received = 0;
     while (shutdown_received >= 0) {
       // creating hearing child socket
       Socket child_socket = server_sock.accept(sock_status);
@@ -357,12 +1308,14 @@ int main() {
         fprintf(stderr,
                 "[FATAL][%s] Failed to create child socket ... exiting\n",
                 date_str(now_str));
-        return 1;
+        break;
       }
       printf("[DEBUG][%s] Waiting for instructions ...\n", date_str(now_str));
 
       // communicate with client
+      g_metrics.clients.fetch_add(1, std::memory_order_relaxed);
       shutdown_received = chat(child_socket, params);
+      g_metrics.clients.fetch_sub(1, std::memory_order_relaxed);
     }
 
   } catch (std::exception &e) {
@@ -370,8 +1323,37 @@ int main() {
     fprintf(stderr, "[FATAL][%s] ... exiting\n", date_str(now_str));
   }
 
-  // shutdown system
-  system_shutdown();
+  // persist state for next run; a restart keeps the camera cold
+  bool restart = (shutdown_received == -2);
+  if (g_camera_state != CameraState::Initialising &&
+      g_camera_state != CameraState::Error)
+    persist_state(params, restart);
+
+  // shutdown system; stopping the temperature controller first releases the
+  // initialization thread, if it is still waiting for the temperature
+  g_temp_controller.stop();
+  if (init_thread.joinable())
+    init_thread.join();
+  obs_queue.stop();
+  g_task_pool.stop();
+  metrics_server.stop();
+  g_timer_service.stop();
+  g_clock_monitor.stop();
+  g_frame_ring.close();
+  g_tracer.flush(params.save_dir_);
+  system_shutdown(restart);
+  g_sdk.stop();
+  g_logger.stop();
+
+  if (restart) {
+    printf("[DEBUG][%s] Restarting daemon (%s)\n", date_str(now_str),
+           self_exe);
+    fflush(stdout);
+    execv(self_exe, argv);
+    fprintf(stderr, "[FATAL][%s] Failed to restart daemon: %s\n",
+            date_str(now_str), std::strerror(errno));
+    return 1;
+  }
 
   return 0;
 }
@@ -0,0 +1,70 @@
+#include "frame_ring.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+// Attach to the frame ring published by the andor2k daemon and print a short
+// summary of each new frame, reading the pixels in place (no copy).
+// Compile with: g++ -std=c++17 -I../src read_frame_ring.cpp ../src/frame_ring.cpp
+//               ../src/andor_tools.cpp -lrt (or link against libhelmosandor2k)
+
+int main(int argc, char *argv[]) {
+  const char *name = (argc > 1) ? argv[1] : FRAME_RING_SHM_NAME;
+
+  FrameRingReader ring;
+  if (ring.open(name)) {
+    fprintf(stderr,
+            "[ERROR] Failed to open frame ring %s; is the daemon running?\n",
+            name);
+    return 1;
+  }
+
+  uint64_t last = ring.last_frame();
+  printf("Attached to %s; latest frame is %lu\n", name, last);
+
+  for (;;) {
+    uint64_t latest = ring.last_frame();
+    if (latest == last) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      continue;
+    }
+
+    FrameView view;
+    if (ring.peek(latest, view)) {
+      // being written to right now; try again
+      continue;
+    }
+
+    const long npix = (long)view.info.width * view.info.height;
+    int32_t minval = view.pixels[0], maxval = view.pixels[0];
+    double sum = 0e0;
+    for (long i = 0; i < npix; i++) {
+      minval = std::min(minval, view.pixels[i]);
+      maxval = std::max(maxval, view.pixels[i]);
+      sum += view.pixels[i];
+    }
+
+    if (!ring.still_valid(view)) {
+      printf("Frame %lu overwritten while reading; skipped\n", latest);
+      continue;
+    }
+
+    if (latest - last > 1 && last)
+      printf("Missed %lu frame(s)\n", latest - last - 1);
+    printf("Frame %lu: image %d/%d, %dx%d (bin %dx%d), exposure %.3fs, "
+           "min %d, max %d, mean %.2f, latency %.3f ms\n",
+           view.info.frame_nr, view.info.image_nr, view.info.num_images,
+           view.info.width, view.info.height, view.info.hbin, view.info.vbin,
+           view.info.exposure_sec, minval, maxval, sum / npix,
+           (std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count() -
+            view.info.acquired_ns) *
+               1e-6);
+    last = latest;
+  }
+
+  return 0;
+}
@@ -0,0 +1,1246 @@
+#include "andor_sim.hpp"
+#include "atmcdLXd.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+/// A simulated Andor SDK: implements (with the same signatures and return
+/// codes) the subset of atmcdLXd.h used by this project, so that the library
+/// and the daemon can be linked against it (configure --with-andor-sim) and
+/// run without a camera.
+/// There are no threads: the state of an acquisition is derived from the
+/// time elapsed since StartAcquisition, i.e. frame k ends at
+///   start + first + (k-1) * cycle
+/// where first/cycle come from the exposure, shutter and readout models, and
+/// the temperature from an exponential approach to the set point. Pixels are
+/// only rendered when an image is retrieved (from a star field computed once
+/// per acquisition, plus noise seeded by the image index), so that retrieving
+/// the same image twice gives the same data and the circular buffer costs no
+/// memory.
+
+namespace {
+using SimClock = std::chrono::steady_clock;
+
+/// @brief Geometry of the (binned) images, in physical pixels (0-offset)
+struct Geometry {
+  int x0, y0;     ///< first pixel
+  int hbin, vbin; ///< binning
+  int w, h;       ///< size of the binned image
+};
+
+struct SimCamera {
+  std::mutex mtx;
+  std::condition_variable cv;
+  AndorSimConfig cfg; ///< copy taken at Initialize
+  bool initialized{false};
+  std::mt19937_64 rng;
+
+  // settings
+  int acq_mode{1}, read_mode{4}, trigger_mode{0};
+  int hbin{1}, vbin{1}, hstart{1}, hend{1}, vstart{1}, vend{1};
+  int track_centre{1}, track_height{1};
+  float exposure{0.01f}, accum_cycle{0}, kinetic_cycle{0};
+  int num_accum{1}, num_kinetics{1};
+  int hs{0}, vs{0}, preamp{0};
+  int shutter_mode{0}, shutter_open_ms{0}, shutter_close_ms{0};
+  bool metadata{false};
+  int64_t setting_calls{0}; ///< calls changing settings, since Initialize
+
+  // cooling; temperature was temp0 at temp0_time
+  bool cooler{false};
+  int cooler_mode{0};
+  int setpoint{20};
+  float temp0{20};
+  SimClock::time_point temp0_time;
+
+  // current acquisition
+  bool running{false};
+  Geometry geo{};
+  std::shared_ptr<const std::vector<float>> rate; ///< ADU/sec per pixel
+  float frame_exposure{0};                        ///< per image
+  double cycle_sec{0};                            ///< camera time
+  SimClock::time_point first_end;
+  SimClock::duration cycle{};
+  int64_t planned{0}; ///< images in the acquisition; -1 for run till abort
+  int64_t completed{0}, waited{0}, retrieved{0}, lost_upto{0}, lost{0};
+  bool cancel{false};
+
+  // faults
+  int inj_no_new_data{0}, inj_error_ack{0}, inj_overrun{0};
+
+  // camera clock: the steady clock plus offset, or held at held_at (see
+  // andor_sim_hold)
+  bool held{false};
+  SimClock::time_point held_at;
+  SimClock::duration offset{};
+}; // SimCamera
+
+SimCamera &cam() noexcept {
+  static SimCamera c;
+  return c;
+}
+
+/// @brief Current camera time
+SimClock::time_point sim_now(const SimCamera &c) noexcept {
+  return c.held ? c.held_at : SimClock::now() + c.offset;
+}
+
+SimClock::duration scaled(const AndorSimConfig &cfg, double sec) noexcept {
+  return std::chrono::duration_cast<SimClock::duration>(
+      std::chrono::duration<double>(sec * cfg.time_scale));
+}
+
+/// @brief Consume an injected fault, or roll the dice with probability p
+bool fault(SimCamera &c, int &injected, double p) noexcept {
+  if (injected > 0) {
+    --injected;
+    return true;
+  }
+  return p > 0 && std::uniform_real_distribution<double>(0, 1)(c.rng) < p;
+}
+
+/// @brief DRV_SUCCESS if settings can be changed (initialized and idle);
+///        counts the call
+unsigned settable(SimCamera &c) noexcept {
+  ++c.setting_calls;
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  return c.running ? DRV_ACQUIRING : DRV_SUCCESS;
+}
+
+Geometry geometry(const SimCamera &c) noexcept {
+  const auto &cfg = c.cfg;
+  switch (c.read_mode) {
+  case 0: // full vertical binning
+    return Geometry{0, 0, 1, cfg.height, cfg.width, 1};
+  case 3: { // single track
+    int y0 = std::max(0, c.track_centre - 1 - c.track_height / 2);
+    return Geometry{0, y0, 1, c.track_height, cfg.width, 1};
+  }
+  default: // image
+    return Geometry{c.hstart - 1,
+                    c.vstart - 1,
+                    c.hbin,
+                    c.vbin,
+                    (c.hend - c.hstart + 1) / c.hbin,
+                    (c.vend - c.vstart + 1) / c.vbin};
+  }
+}
+
+int64_t buffer_images(const SimCamera &c, const Geometry &g) noexcept {
+  int64_t bytes = static_cast<int64_t>(g.w) * g.h * sizeof(at_32);
+  return std::max<int64_t>(1, c.cfg.buffer_bytes / bytes);
+}
+
+/// @brief Readout time (camera time): every row of the detector is shifted,
+///        only the (binned) pixels of the image are digitized
+double readout_time(const SimCamera &c, const Geometry &g) noexcept {
+  const auto &cfg = c.cfg;
+  return cfg.height * cfg.vs_speeds_us[c.vs] * 1e-6 +
+         static_cast<double>(g.w) * g.h / (cfg.hs_speeds_mhz[c.hs] * 1e6) +
+         cfg.readout_overhead;
+}
+
+/// @brief Time to acquire a single image (camera time); with the shutter on
+///        auto, it opens and closes for every image
+double frame_time(const SimCamera &c, const Geometry &g) noexcept {
+  double shutter =
+      c.shutter_mode ? 0 : (c.shutter_open_ms + c.shutter_close_ms) * 1e-3;
+  return c.exposure + shutter + readout_time(c, g);
+}
+
+/// @brief Exposure, accumulation cycle and kinetic cycle times (camera time)
+void timings(const SimCamera &c, const Geometry &g, double &exposure,
+             double &accumulate, double &kinetic) noexcept {
+  double frame = frame_time(c, g);
+  exposure = c.exposure;
+  accumulate = std::max<double>(c.accum_cycle, frame);
+  switch (c.acq_mode) {
+  case 1:
+    kinetic = frame;
+    break;
+  case 2:
+    kinetic = c.num_accum * accumulate;
+    break;
+  default:
+    kinetic = std::max<double>(c.kinetic_cycle, frame);
+  }
+}
+
+/// @brief First image still in the circular buffer
+int64_t oldest(const SimCamera &c) noexcept {
+  return std::max(c.completed - buffer_images(c, c.geo), c.lost_upto) + 1;
+}
+
+/// @brief Bring the acquisition up to time now: count the images completed
+///        since the last call and decide if the buffer overran meanwhile
+void update(SimCamera &c, SimClock::time_point now) noexcept {
+  if (!c.running || now < c.first_end)
+    return;
+  int64_t n = 1 + (now - c.first_end) / c.cycle;
+  if (c.planned >= 0)
+    n = std::min(n, c.planned);
+  if (n > c.completed) {
+    // on overrun, all images but the newest are lost
+    double p = 1e0 - std::pow(1e0 - c.cfg.p_overrun, n - c.completed);
+    if (fault(c, c.inj_overrun, c.cfg.p_overrun > 0 ? p : 0))
+      c.lost_upto = n - 1;
+    c.completed = n;
+  }
+  if (c.planned >= 0 && c.completed >= c.planned)
+    c.running = false;
+}
+
+SimClock::time_point next_end(const SimCamera &c) noexcept {
+  return c.first_end + c.completed * c.cycle;
+}
+
+/// @brief Temperature (Celsius) at time now; settled is set to the time
+///        (camera time) since the temperature came within 1 C of the target
+float temperature(const SimCamera &c, SimClock::time_point now,
+                  double *settled = nullptr) noexcept {
+  const auto &cfg = c.cfg;
+  double t = cfg.time_scale > 0
+                 ? std::chrono::duration<double>(now - c.temp0_time).count() /
+                       cfg.time_scale
+                 : 1e9;
+  double target = c.cooler ? c.setpoint : cfg.ambient_temp;
+  double tau = c.cooler ? cfg.cooling_tau : cfg.warming_tau;
+  double d0 = c.temp0 - target;
+  if (settled)
+    *settled = t - (std::abs(d0) > 1e0 ? tau * std::log(std::abs(d0)) : 0e0);
+  return static_cast<float>(target + d0 * std::exp(-t / tau));
+}
+
+/// @brief Cooler switched or set point changed: restart the curve from the
+///        current temperature
+void temperature_change(SimCamera &c) noexcept {
+  auto now = sim_now(c);
+  c.temp0 = temperature(c, now);
+  c.temp0_time = now;
+}
+
+/// @brief ADU/sec for each pixel of an image: sky (or dark current, with the
+///        shutter closed) plus a field of stars with gaussian PSFs. Stars are
+///        placed on the detector (same seed, same field), so sub-images and
+///        binned images show the same stars.
+std::shared_ptr<const std::vector<float>> star_field(const SimCamera &c,
+                                                     const Geometry &g) {
+  const auto &cfg = c.cfg;
+  const bool dark = (c.shutter_mode == 2);
+  const float bin = static_cast<float>(g.hbin) * g.vbin;
+  auto rate = std::make_shared<std::vector<float>>(
+      static_cast<std::size_t>(g.w) * g.h,
+      (cfg.dark_rate + (dark ? 0 : cfg.sky_rate)) * bin);
+  if (dark)
+    return rate;
+
+  std::mt19937_64 gen(cfg.seed);
+  std::uniform_real_distribution<double> u(0, 1);
+  const double s2 = 2e0 * cfg.psf_sigma * cfg.psf_sigma;
+  const int r = static_cast<int>(std::ceil(4 * cfg.psf_sigma));
+  for (int i = 0; i < cfg.num_stars; i++) {
+    double x = u(gen) * cfg.width;
+    double y = u(gen) * cfg.height;
+    // mostly faint stars
+    double flux = cfg.max_star_flux * std::pow(u(gen), 3);
+    for (int py = static_cast<int>(y) - r; py <= static_cast<int>(y) + r;
+         py++) {
+      int by = (py - g.y0) / g.vbin;
+      if (py < g.y0 || by >= g.h)
+        continue;
+      for (int px = static_cast<int>(x) - r; px <= static_cast<int>(x) + r;
+           px++) {
+        int bx = (px - g.x0) / g.hbin;
+        if (px < g.x0 || bx >= g.w)
+          continue;
+        double dx = px + .5 - x, dy = py + .5 - y;
+        (*rate)[static_cast<std::size_t>(by) * g.w + bx] +=
+            flux * std::exp(-(dx * dx + dy * dy) / s2) / (M_PI * s2);
+      }
+    }
+  }
+  return rate;
+}
+
+/// @brief Render image index of the acquisition: bias plus signal plus
+///        (gaussian approximations of) shot and read noise, with unit gain
+void render(at_32 *arr, const std::vector<float> &rate, float exposure,
+            const AndorSimConfig &cfg, int64_t index) noexcept {
+  uint64_t s = (cfg.seed + 1) * 0x9E3779B97F4A7C15ULL ^
+               static_cast<uint64_t>(index) * 0xBF58476D1CE4E5B9ULL;
+  const double rn2 = static_cast<double>(cfg.read_noise) * cfg.read_noise;
+  const double sqrt3 = std::sqrt(3e0);
+  for (std::size_t i = 0; i < rate.size(); i++) {
+    // xorshift64*; the sum of four 16-bit uniforms is close to gaussian
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    uint64_t x = s * 0x2545F4914F6CDD1DULL;
+    double g = ((x & 0xffff) + ((x >> 16) & 0xffff) + ((x >> 32) & 0xffff) +
+                (x >> 48)) /
+                   65536e0 -
+               2e0;
+    double signal = rate[i] * exposure;
+    double v = cfg.bias + signal + std::sqrt(signal + rn2) * g * sqrt3;
+    arr[i] = static_cast<at_32>(
+        std::min<double>(std::max(v, 0e0), cfg.saturation));
+  }
+}
+
+/// @brief Render images [first, last] into arr, with the camera unlocked
+unsigned render_images(std::unique_lock<std::mutex> &lock, at_32 *arr,
+                       int64_t first, int64_t last) noexcept {
+  auto &c = cam();
+  auto rate = c.rate;
+  float exposure = c.frame_exposure;
+  AndorSimConfig cfg = c.cfg;
+  lock.unlock();
+  for (int64_t i = first; i <= last; i++, arr += rate->size())
+    render(arr, *rate, exposure, cfg, i);
+  return DRV_SUCCESS;
+}
+
+bool env_number(const char *name, double &value) noexcept {
+  const char *str = std::getenv(name);
+  if (!str)
+    return true;
+  char *end;
+  double v = std::strtod(str, &end);
+  if (end == str || *end || v < 0) {
+    fprintf(stderr, "[WRNNG] Invalid value for %s: \"%s\"; ignored\n", name,
+            str);
+    return false;
+  }
+  value = v;
+  return true;
+}
+} // namespace
+
+AndorSimConfig &andor_sim_config() noexcept {
+  static AndorSimConfig cfg;
+  return cfg;
+}
+
+int andor_sim_config_env(AndorSimConfig &cfg) noexcept {
+  int error = 0;
+  double v = cfg.time_scale;
+  error += !env_number("ANDOR_SIM_TIME_SCALE", v);
+  cfg.time_scale = v;
+  v = cfg.buffer_bytes / (1024e0 * 1024e0);
+  error += !env_number("ANDOR_SIM_BUFFER_MB", v);
+  cfg.buffer_bytes = static_cast<int64_t>(v * 1024 * 1024);
+  v = cfg.num_stars;
+  error += !env_number("ANDOR_SIM_STARS", v);
+  cfg.num_stars = static_cast<int>(v);
+  v = static_cast<double>(cfg.seed);
+  error += !env_number("ANDOR_SIM_SEED", v);
+  cfg.seed = static_cast<uint64_t>(v);
+
+  // e.g. "error_ack:0.001,no_new_data:0.01,overrun:0.001"
+  const char *faults = std::getenv("ANDOR_SIM_FAULTS");
+  for (const char *str = faults; str && *str;) {
+    const char *colon = std::strchr(str, ':');
+    char *end = nullptr;
+    double p = colon ? std::strtod(colon + 1, &end) : -1;
+    if (!colon || end == colon + 1 || p < 0 || p > 1 ||
+        (*end && *end != ',')) {
+      ++error;
+      break;
+    }
+    std::size_t len = colon - str;
+    if (len == 9 && !std::strncmp(str, "error_ack", len))
+      cfg.p_error_ack = p;
+    else if (len == 11 && !std::strncmp(str, "no_new_data", len))
+      cfg.p_no_new_data = p;
+    else if (len == 7 && !std::strncmp(str, "overrun", len))
+      cfg.p_overrun = p;
+    else {
+      ++error;
+      break;
+    }
+    str = *end ? end + 1 : end;
+  }
+  if (error && faults)
+    fprintf(stderr, "[WRNNG] Failed to parse ANDOR_SIM_FAULTS=\"%s\"\n",
+            faults);
+  return error;
+}
+
+void andor_sim_inject(AndorSimFault f, int count) noexcept {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  switch (f) {
+  case AndorSimFault::NoNewData:
+    c.inj_no_new_data += count;
+    break;
+  case AndorSimFault::ErrorAck:
+    c.inj_error_ack += count;
+    break;
+  case AndorSimFault::Overrun:
+    c.inj_overrun += count;
+    break;
+  }
+}
+
+void andor_sim_hold() noexcept {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  c.held_at = sim_now(c);
+  c.held = true;
+}
+
+void andor_sim_step(double sec) noexcept {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.held)
+    return;
+  c.held_at += scaled(c.cfg, sec);
+  c.cv.notify_all();
+}
+
+void andor_sim_release() noexcept {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.held)
+    return;
+  c.offset = c.held_at - SimClock::now();
+  c.held = false;
+  c.cv.notify_all();
+}
+
+int64_t andor_sim_images_lost() noexcept {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  update(c, sim_now(c));
+  return c.lost + std::max<int64_t>(0, oldest(c) - 1 - c.retrieved);
+}
+
+int64_t andor_sim_setting_calls() noexcept {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  return c.setting_calls;
+}
+
+// --- camera selection and information ---------------------------------------
+
+unsigned int GetAvailableCameras(at_32 *totalCameras) {
+  *totalCameras = 1;
+  return DRV_SUCCESS;
+}
+
+unsigned int GetCameraHandle(at_32 cameraIndex, at_32 *cameraHandle) {
+  if (cameraIndex)
+    return DRV_P1INVALID;
+  *cameraHandle = 100;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetCurrentCamera(at_32 cameraHandle) {
+  return cameraHandle == 100 ? DRV_SUCCESS : DRV_P1INVALID;
+}
+
+unsigned int Initialize(char *) {
+  auto &c = cam();
+  std::unique_lock<std::mutex> lock(c.mtx);
+  c.running = false;
+  c.initialized = false;
+  c.cv.notify_all();
+  AndorSimConfig cfg = andor_sim_config();
+  andor_sim_config_env(cfg);
+  if (cfg.width < 1 || cfg.height < 1 || cfg.hs_speeds_mhz.empty() ||
+      cfg.vs_speeds_us.empty() || cfg.preamp_gains.empty())
+    return DRV_INIERROR;
+  c.cfg = cfg;
+  c.rng.seed(cfg.seed);
+  c.acq_mode = 1;
+  c.read_mode = 4;
+  c.trigger_mode = 0;
+  c.hbin = c.vbin = c.hstart = c.vstart = 1;
+  c.hend = cfg.width;
+  c.vend = cfg.height;
+  c.track_centre = cfg.height / 2;
+  c.track_height = 1;
+  c.hs = c.vs = c.preamp = 0;
+  c.cooler = false;
+  c.setpoint = static_cast<int>(cfg.ambient_temp);
+  c.temp0 = cfg.ambient_temp;
+  c.temp0_time = sim_now(c);
+  c.completed = c.waited = c.retrieved = c.lost_upto = c.lost = 0;
+  c.setting_calls = 0;
+  c.inj_no_new_data = c.inj_error_ack = c.inj_overrun = 0;
+  fprintf(stderr, "[WRNNG] Using the simulated Andor SDK (%dx%d, time "
+                  "scale %.3g); no camera is controlled\n",
+          cfg.width, cfg.height, cfg.time_scale);
+  auto ready = SimClock::now() + scaled(cfg, cfg.init_time);
+  lock.unlock();
+  std::this_thread::sleep_until(ready);
+  lock.lock();
+  c.initialized = true;
+  return DRV_SUCCESS;
+}
+
+unsigned int ShutDown(void) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  c.running = false;
+  c.initialized = false;
+  c.cv.notify_all();
+  return DRV_SUCCESS;
+}
+
+unsigned int GetCameraSerialNumber(int *number) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *number = c.cfg.serial;
+  return DRV_SUCCESS;
+}
+
+unsigned int GetHeadModel(char *name) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  std::strcpy(name, c.cfg.head_model);
+  return DRV_SUCCESS;
+}
+
+unsigned int GetDetector(int *xpixels, int *ypixels) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *xpixels = c.cfg.width;
+  *ypixels = c.cfg.height;
+  return DRV_SUCCESS;
+}
+
+unsigned int GetCapabilities(AndorCapabilities *caps) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  at_u32 size = caps->ulSize;
+  std::memset(caps, 0, sizeof(AndorCapabilities));
+  caps->ulSize = size;
+  caps->ulAcqModes = 1 | 2 | 4 | 8;  // single, video, accumulate, kinetic
+  caps->ulReadModes = 1 | 2 | 16;    // full image, subimage, FVB
+  caps->ulTriggerModes = 1;          // internal
+  caps->ulCameraType = 13;           // iKon
+  return DRV_SUCCESS;
+}
+
+unsigned int IsInternalMechanicalShutter(int *InternalShutter) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *InternalShutter = 1;
+  return DRV_SUCCESS;
+}
+
+unsigned int GetStatus(int *status) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  update(c, sim_now(c));
+  *status = c.running ? DRV_ACQUIRING : DRV_IDLE;
+  return DRV_SUCCESS;
+}
+
+// --- cooling ------------------------------------------------------------------
+
+unsigned int CoolerON(void) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  temperature_change(c);
+  c.cooler = true;
+  return DRV_SUCCESS;
+}
+
+unsigned int CoolerOFF(void) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  temperature_change(c);
+  c.cooler = false;
+  return DRV_SUCCESS;
+}
+
+unsigned int IsCoolerOn(int *iCoolerStatus) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *iCoolerStatus = c.cooler;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetCoolerMode(int mode) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (mode != 0 && mode != 1)
+    return DRV_P1INVALID;
+  c.cooler_mode = mode;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetTemperature(int temperature) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (temperature < c.cfg.min_temp || temperature > c.cfg.max_temp)
+    return DRV_P1INVALID;
+  temperature_change(c);
+  c.setpoint = temperature;
+  return DRV_SUCCESS;
+}
+
+unsigned int GetTemperatureRange(int *mintemp, int *maxtemp) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *mintemp = c.cfg.min_temp;
+  *maxtemp = c.cfg.max_temp;
+  return DRV_SUCCESS;
+}
+
+unsigned int GetTemperatureF(float *temperature_c) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (fault(c, c.inj_error_ack, c.cfg.p_error_ack))
+    return DRV_ERROR_ACK;
+  auto now = sim_now(c);
+  update(c, now);
+  double settled;
+  *temperature_c = temperature(c, now, &settled);
+  if (c.running)
+    return DRV_ACQUIRING;
+  if (!c.cooler)
+    return DRV_TEMP_OFF;
+  if (std::abs(*temperature_c - c.setpoint) > 1e0)
+    return DRV_TEMP_NOT_REACHED;
+  return settled < c.cfg.stabilization_time ? DRV_TEMP_NOT_STABILIZED
+                                            : DRV_TEMP_STABILIZED;
+}
+
+unsigned int GetTemperature(int *temperature_c) {
+  float t;
+  unsigned int status = GetTemperatureF(&t);
+  if (status != DRV_NOT_INITIALIZED && status != DRV_ERROR_ACK)
+    *temperature_c = static_cast<int>(std::lround(t));
+  return status;
+}
+
+// --- readout speeds and gains -------------------------------------------------
+
+unsigned int GetNumberADChannels(int *channels) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *channels = 1;
+  return DRV_SUCCESS;
+}
+
+unsigned int GetNumberAmp(int *amp) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *amp = 1;
+  return DRV_SUCCESS;
+}
+
+unsigned int GetAmpDesc(int index, char *name, int length) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (index)
+    return DRV_P1INVALID;
+  if (length < 21)
+    return DRV_P3INVALID;
+  std::strcpy(name, "Conventional");
+  return DRV_SUCCESS;
+}
+
+unsigned int GetNumberHSSpeeds(int channel, int typ, int *speeds) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (channel)
+    return DRV_P1INVALID;
+  if (typ != 0 && typ != 1)
+    return DRV_P2INVALID;
+  *speeds = static_cast<int>(c.cfg.hs_speeds_mhz.size());
+  return DRV_SUCCESS;
+}
+
+unsigned int GetHSSpeed(int channel, int typ, int index, float *speed) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (channel)
+    return DRV_P1INVALID;
+  if (typ != 0 && typ != 1)
+    return DRV_P2INVALID;
+  if (index < 0 || index >= static_cast<int>(c.cfg.hs_speeds_mhz.size()))
+    return DRV_P3INVALID;
+  *speed = c.cfg.hs_speeds_mhz[index];
+  return DRV_SUCCESS;
+}
+
+unsigned int SetHSSpeed(int typ, int index) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (typ != 0 && typ != 1)
+    return DRV_P1INVALID;
+  if (index < 0 || index >= static_cast<int>(c.cfg.hs_speeds_mhz.size()))
+    return DRV_P2INVALID;
+  c.hs = index;
+  return DRV_SUCCESS;
+}
+
+unsigned int GetNumberVSSpeeds(int *speeds) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *speeds = static_cast<int>(c.cfg.vs_speeds_us.size());
+  return DRV_SUCCESS;
+}
+
+unsigned int GetVSSpeed(int index, float *speed) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (index < 0 || index >= static_cast<int>(c.cfg.vs_speeds_us.size()))
+    return DRV_P1INVALID;
+  *speed = c.cfg.vs_speeds_us[index];
+  return DRV_SUCCESS;
+}
+
+unsigned int GetFastestRecommendedVSSpeed(int *index, float *speed) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *index = std::min(c.cfg.fastest_recommended_vs,
+                    static_cast<int>(c.cfg.vs_speeds_us.size()) - 1);
+  *speed = c.cfg.vs_speeds_us[*index];
+  return DRV_SUCCESS;
+}
+
+unsigned int SetVSSpeed(int index) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (index < 0 || index >= static_cast<int>(c.cfg.vs_speeds_us.size()))
+    return DRV_P1INVALID;
+  c.vs = index;
+  return DRV_SUCCESS;
+}
+
+unsigned int GetNumberPreAmpGains(int *noGains) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *noGains = static_cast<int>(c.cfg.preamp_gains.size());
+  return DRV_SUCCESS;
+}
+
+unsigned int GetPreAmpGain(int index, float *gain) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (index < 0 || index >= static_cast<int>(c.cfg.preamp_gains.size()))
+    return DRV_P1INVALID;
+  *gain = c.cfg.preamp_gains[index];
+  return DRV_SUCCESS;
+}
+
+unsigned int IsPreAmpGainAvailable(int channel, int amplifier, int index,
+                                   int pa, int *status) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (channel)
+    return DRV_P1INVALID;
+  if (amplifier)
+    return DRV_P2INVALID;
+  if (index < 0 || index >= static_cast<int>(c.cfg.hs_speeds_mhz.size()))
+    return DRV_P3INVALID;
+  if (pa < 0 || pa >= static_cast<int>(c.cfg.preamp_gains.size()))
+    return DRV_P4INVALID;
+  *status = 1;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetPreAmpGain(int index) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (index < 0 || index >= static_cast<int>(c.cfg.preamp_gains.size()))
+    return DRV_P1INVALID;
+  c.preamp = index;
+  return DRV_SUCCESS;
+}
+
+// --- acquisition setup --------------------------------------------------------
+
+unsigned int SetAcquisitionMode(int mode) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (mode < 1 || mode > 5)
+    return DRV_P1INVALID;
+  c.acq_mode = mode;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetReadMode(int mode) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  // multi-track and random-track are not simulated
+  if (mode != 0 && mode != 3 && mode != 4)
+    return DRV_P1INVALID;
+  c.read_mode = mode;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetTriggerMode(int mode) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  // only the internal trigger is simulated
+  if (mode)
+    return DRV_P1INVALID;
+  c.trigger_mode = mode;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetImage(int hbin, int vbin, int hstart, int hend, int vstart,
+                      int vend) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (hstart < 1 || hstart > c.cfg.width)
+    return DRV_P3INVALID;
+  if (hend < hstart || hend > c.cfg.width)
+    return DRV_P4INVALID;
+  if (vstart < 1 || vstart > c.cfg.height)
+    return DRV_P5INVALID;
+  if (vend < vstart || vend > c.cfg.height)
+    return DRV_P6INVALID;
+  if (hbin < 1 || hbin > hend - hstart + 1)
+    return DRV_P1INVALID;
+  if (vbin < 1 || vbin > vend - vstart + 1)
+    return DRV_P2INVALID;
+  c.hbin = hbin;
+  c.vbin = vbin;
+  c.hstart = hstart;
+  c.hend = hend;
+  c.vstart = vstart;
+  c.vend = vend;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetSingleTrack(int centre, int height) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (centre < 1 || centre > c.cfg.height)
+    return DRV_P1INVALID;
+  if (height < 1 || centre - 1 - height / 2 < 0 ||
+      centre - 1 - height / 2 + height > c.cfg.height)
+    return DRV_P2INVALID;
+  c.track_centre = centre;
+  c.track_height = height;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetExposureTime(float time) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (time < 0)
+    return DRV_P1INVALID;
+  c.exposure = time;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetAccumulationCycleTime(float time) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (time < 0)
+    return DRV_P1INVALID;
+  c.accum_cycle = time;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetKineticCycleTime(float time) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (time < 0)
+    return DRV_P1INVALID;
+  c.kinetic_cycle = time;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetNumberAccumulations(int number) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (number < 1)
+    return DRV_P1INVALID;
+  c.num_accum = number;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetNumberKinetics(int number) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (number < 1)
+    return DRV_P1INVALID;
+  c.num_kinetics = number;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetShutter(int typ, int mode, int closingtime, int openingtime) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (typ != 0 && typ != 1)
+    return DRV_P1INVALID;
+  if (mode < 0 || mode > 2)
+    return DRV_P2INVALID;
+  if (closingtime < 0)
+    return DRV_P3INVALID;
+  if (openingtime < 0)
+    return DRV_P4INVALID;
+  c.shutter_mode = mode;
+  c.shutter_close_ms = closingtime;
+  c.shutter_open_ms = openingtime;
+  return DRV_SUCCESS;
+}
+
+unsigned int SetMetaData(int state) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (unsigned error = settable(c); error != DRV_SUCCESS)
+    return error;
+  if (state != 0 && state != 1)
+    return DRV_P1INVALID;
+  c.metadata = state;
+  return DRV_SUCCESS;
+}
+
+unsigned int GetAcquisitionTimings(float *exposure, float *accumulate,
+                                   float *kinetic) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  double e, a, k;
+  timings(c, geometry(c), e, a, k);
+  *exposure = static_cast<float>(e);
+  *accumulate = static_cast<float>(a);
+  *kinetic = static_cast<float>(k);
+  return DRV_SUCCESS;
+}
+
+unsigned int GetReadOutTime(float *ReadOutTime) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *ReadOutTime = static_cast<float>(readout_time(c, geometry(c)));
+  return DRV_SUCCESS;
+}
+
+unsigned int GetSizeOfCircularBuffer(at_32 *index) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  *index = static_cast<at_32>(buffer_images(c, geometry(c)));
+  return DRV_SUCCESS;
+}
+
+// --- acquisition --------------------------------------------------------------
+
+unsigned int StartAcquisition(void) {
+  auto &c = cam();
+  std::unique_lock<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  auto now = sim_now(c);
+  update(c, now);
+  if (c.running)
+    return DRV_ACQUIRING;
+  if (fault(c, c.inj_error_ack, c.cfg.p_error_ack))
+    return DRV_ERROR_ACK;
+  Geometry g = geometry(c);
+  if (g.w < 1 || g.h < 1)
+    return DRV_BINNING_ERROR;
+  try {
+    c.rate = star_field(c, g);
+  } catch (std::exception &) {
+    return DRV_ERROR_PAGELOCK;
+  }
+  c.geo = g;
+
+  double exposure, accumulate, kinetic;
+  timings(c, g, exposure, accumulate, kinetic);
+  c.frame_exposure = c.exposure * (c.acq_mode == 2 ? c.num_accum : 1);
+  c.cycle_sec = kinetic;
+  c.planned = c.acq_mode == 5   ? -1
+              : c.acq_mode == 3 ? c.num_kinetics
+              : c.acq_mode == 4 ? c.num_kinetics
+                                : 1;
+  // (rendering the star field is not camera time)
+  auto latency = scaled(c.cfg, c.cfg.start_latency);
+  auto start = sim_now(c) + latency;
+  c.first_end = start + scaled(c.cfg, c.acq_mode == 2 ? kinetic : frame_time(c, g));
+  c.cycle = std::max<SimClock::duration>(scaled(c.cfg, kinetic),
+                                         std::chrono::nanoseconds(1));
+  c.completed = c.waited = c.retrieved = c.lost_upto = c.lost = 0;
+  c.cancel = false;
+  c.running = true;
+  // (with the clock held, the latency passes with the steps)
+  bool held = c.held;
+  lock.unlock();
+  if (!held)
+    std::this_thread::sleep_for(latency);
+  return DRV_SUCCESS;
+}
+
+unsigned int AbortAcquisition(void) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  update(c, sim_now(c));
+  if (!c.running)
+    return DRV_IDLE;
+  c.running = false;
+  c.cv.notify_all();
+  return DRV_SUCCESS;
+}
+
+unsigned int WaitForAcquisitionTimeOut(int timeout_ms) {
+  auto &c = cam();
+  // (the timeout is in wall-clock time, whatever the time scale)
+  auto deadline = SimClock::now() + std::chrono::milliseconds(timeout_ms);
+  std::unique_lock<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (fault(c, c.inj_no_new_data, c.cfg.p_no_new_data))
+    return DRV_NO_NEW_DATA;
+  for (;;) {
+    if (c.cancel) {
+      c.cancel = false;
+      return DRV_NO_NEW_DATA;
+    }
+    update(c, sim_now(c));
+    // one event per image
+    if (c.completed > c.waited) {
+      ++c.waited;
+      return DRV_SUCCESS;
+    }
+    if (!c.running || SimClock::now() >= deadline)
+      return DRV_NO_NEW_DATA;
+    // (a held clock is stepped by andor_sim_step, which notifies)
+    c.cv.wait_until(lock, c.held ? deadline
+                                 : std::min(next_end(c) - c.offset, deadline));
+  }
+}
+
+unsigned int WaitForAcquisition(void) {
+  // (a timeout the wait never reaches)
+  return WaitForAcquisitionTimeOut(std::numeric_limits<int>::max());
+}
+
+unsigned int CancelWait(void) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  c.cancel = true;
+  c.cv.notify_all();
+  return DRV_SUCCESS;
+}
+
+unsigned int GetTotalNumberImagesAcquired(at_32 *index) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  update(c, sim_now(c));
+  *index = static_cast<at_32>(c.completed);
+  return DRV_SUCCESS;
+}
+
+unsigned int GetNumberNewImages(at_32 *first, at_32 *last) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (fault(c, c.inj_no_new_data, c.cfg.p_no_new_data))
+    return DRV_NO_NEW_DATA;
+  update(c, sim_now(c));
+  // images overwritten in the buffer count as retrieved
+  if (int64_t lost = oldest(c) - 1 - c.retrieved; lost > 0) {
+    c.lost += lost;
+    c.retrieved += lost;
+  }
+  if (c.retrieved >= c.completed)
+    return DRV_NO_NEW_DATA;
+  *first = static_cast<at_32>(c.retrieved + 1);
+  *last = static_cast<at_32>(c.completed);
+  return DRV_SUCCESS;
+}
+
+unsigned int GetImages(at_32 first, at_32 last, at_32 *arr, at_u32 size,
+                       at_32 *validfirst, at_32 *validlast) {
+  auto &c = cam();
+  std::unique_lock<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (fault(c, c.inj_error_ack, c.cfg.p_error_ack))
+    return DRV_ERROR_ACK;
+  if (fault(c, c.inj_no_new_data, c.cfg.p_no_new_data))
+    return DRV_NO_NEW_DATA;
+  if (!arr)
+    return DRV_P3INVALID;
+  update(c, sim_now(c));
+  if (first < 1 || last < first)
+    return DRV_GENERAL_ERRORS;
+  if (last > c.completed)
+    return DRV_NO_NEW_DATA;
+  // overwritten in the circular buffer
+  if (first < oldest(c)) {
+    if (validfirst && validlast) {
+      *validfirst = static_cast<at_32>(oldest(c));
+      *validlast = static_cast<at_32>(c.completed);
+    }
+    return DRV_GENERAL_ERRORS;
+  }
+  if (static_cast<int64_t>(size) !=
+      (last - first + 1) * static_cast<int64_t>(c.rate->size()))
+    return DRV_P4INVALID;
+  if (validfirst && validlast) {
+    *validfirst = first;
+    *validlast = last;
+  }
+  c.retrieved = std::max<int64_t>(c.retrieved, last);
+  return render_images(lock, arr, first, last);
+}
+
+unsigned int GetMostRecentImage(at_32 *arr, at_u32 size) {
+  auto &c = cam();
+  std::unique_lock<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (fault(c, c.inj_error_ack, c.cfg.p_error_ack))
+    return DRV_ERROR_ACK;
+  if (fault(c, c.inj_no_new_data, c.cfg.p_no_new_data))
+    return DRV_NO_NEW_DATA;
+  if (!arr)
+    return DRV_P1INVALID;
+  update(c, sim_now(c));
+  if (!c.completed)
+    return DRV_NO_NEW_DATA;
+  if (static_cast<int64_t>(size) != static_cast<int64_t>(c.rate->size()))
+    return DRV_P2INVALID;
+  return render_images(lock, arr, c.completed, c.completed);
+}
+
+unsigned int GetAcquiredData(at_32 *arr, at_u32 size) {
+  auto &c = cam();
+  std::unique_lock<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (fault(c, c.inj_error_ack, c.cfg.p_error_ack))
+    return DRV_ERROR_ACK;
+  if (!arr)
+    return DRV_P1INVALID;
+  update(c, sim_now(c));
+  if (c.running)
+    return DRV_ACQUIRING;
+  if (!c.completed)
+    return DRV_NO_NEW_DATA;
+  // the whole series for kinetics, else the last image
+  int64_t n = (c.acq_mode == 3 || c.acq_mode == 4) ? c.completed : 1;
+  if (static_cast<int64_t>(size) != n * static_cast<int64_t>(c.rate->size()))
+    return DRV_P2INVALID;
+  return render_images(lock, arr, c.completed - n + 1, c.completed);
+}
+
+unsigned int GetRelativeImageTimes(at_u32 first, at_u32 last, at_u64 *arr,
+                                   at_u32 size) {
+  auto &c = cam();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  if (!c.initialized)
+    return DRV_NOT_INITIALIZED;
+  if (!c.metadata)
+    return DRV_NOT_AVAILABLE;
+  update(c, sim_now(c));
+  if (first < 1 || static_cast<int64_t>(first) > c.completed)
+    return DRV_P1INVALID;
+  if (last < first || static_cast<int64_t>(last) > c.completed)
+    return DRV_P2INVALID;
+  if (!arr)
+    return DRV_P3INVALID;
+  if (size < last - first + 1)
+    return DRV_P4INVALID;
+  // nanoseconds since the start of the first image (camera time)
+  for (at_u32 i = first; i <= last; i++)
+    *arr++ = static_cast<at_u64>((i - 1) * c.cycle_sec * 1e9);
+  return DRV_SUCCESS;
+}
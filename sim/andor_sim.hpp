@@ -0,0 +1,107 @@
+#ifndef __ANDOR2K_ANDOR_SIM_HPP__
+#define __ANDOR2K_ANDOR_SIM_HPP__
+
+#include <cstdint>
+#include <vector>
+
+/// @brief Parameters of the simulated camera (libandorsim). Defaults model
+///        an iKon-L 936 (2048x2048, 16-bit, conventional amplifier).
+/// All durations are in seconds of "camera time"; time_scale maps them to
+/// wall-clock time, e.g. 0.01 runs a 10 sec exposure in 100 millisec. Values
+/// reported back through the SDK (GetAcquisitionTimings, GetReadOutTime,
+/// GetRelativeImageTimes) are always in camera time. Tests may hold the
+/// camera clock and step it instead (see andor_sim_hold).
+/// Changes take effect at the next call to Initialize, which also applies
+/// any ANDOR_SIM_* environment variables on top (see andor_sim_config_env).
+struct AndorSimConfig {
+  int width{2048};
+  int height{2048};
+  int serial{12345};
+  char head_model[32]{"DZ936_BV"};
+
+  /// @brief Horizontal (pixel) readout rates, in MHz
+  std::vector<float> hs_speeds_mhz{5.0f, 3.0f, 1.0f, 0.05f};
+  /// @brief Vertical (row) shift times, in microseconds
+  std::vector<float> vs_speeds_us{4.25f, 8.25f, 16.25f, 32.25f, 64.25f};
+  int fastest_recommended_vs{1};
+  std::vector<float> preamp_gains{1.0f, 2.0f, 4.0f};
+  float readout_overhead{0.002f}; ///< fixed cost of each readout
+  float start_latency{0.25f};     ///< cost of StartAcquisition
+  float init_time{2.0f};          ///< cost of Initialize
+  /// @brief Memory of the circular buffer; its size in images depends on
+  ///        the (binned) image size, as with the real driver
+  int64_t buffer_bytes{64LL * 1024 * 1024};
+
+  float ambient_temp{20.0f};
+  int min_temp{-100};
+  int max_temp{30};
+  float cooling_tau{150.0f}; ///< time constant when cooling to a set point
+  float warming_tau{300.0f}; ///< time constant when warming (cooler off)
+  float stabilization_time{30.0f}; ///< within 1 C this long to stabilize
+
+  int num_stars{200};
+  float max_star_flux{2.0e5f}; ///< ADU/sec, brightest star
+  float psf_sigma{2.0f};       ///< in (unbinned) pixels
+  float sky_rate{20.0f};       ///< ADU/sec/pixel
+  float dark_rate{0.01f};      ///< ADU/sec/pixel
+  float bias{300.0f};          ///< ADU
+  float read_noise{8.0f};      ///< ADU
+  int saturation{65535};
+  uint64_t seed{42};
+
+  double time_scale{1.0};
+
+  /// @brief Probability that a call returns DRV_ERROR_ACK (calls that talk
+  ///        to the camera: StartAcquisition, GetTemperature, image
+  ///        retrieval)
+  double p_error_ack{0};
+  /// @brief Probability that a call waiting for/polling data returns
+  ///        DRV_NO_NEW_DATA
+  double p_no_new_data{0};
+  /// @brief Probability, per frame, that the circular buffer overruns, i.e.
+  ///        all images not yet retrieved are lost
+  double p_overrun{0};
+}; // AndorSimConfig
+
+enum class AndorSimFault : int_fast8_t {
+  NoNewData, ///< next data call returns DRV_NO_NEW_DATA
+  ErrorAck,  ///< next call talking to the camera returns DRV_ERROR_ACK
+  Overrun    ///< next frame overruns the circular buffer
+};           // AndorSimFault
+
+/// @brief The configuration of the simulated camera
+AndorSimConfig &andor_sim_config() noexcept;
+
+/// @brief Apply the environment variables ANDOR_SIM_TIME_SCALE,
+///        ANDOR_SIM_BUFFER_MB, ANDOR_SIM_STARS, ANDOR_SIM_SEED and
+///        ANDOR_SIM_FAULTS (e.g. "error_ack:0.001,no_new_data:0.01,
+///        overrun:0.001") to cfg. Called by Initialize, so that binaries
+///        linked against the simulator can be configured without any code.
+/// @return 0 on success; anything else denotes an invalid variable (the
+///         rest are still applied)
+int andor_sim_config_env(AndorSimConfig &cfg) noexcept;
+
+/// @brief Make the next count calls (or frames, for Overrun) fail with the
+///        given fault
+void andor_sim_inject(AndorSimFault fault, int count = 1) noexcept;
+
+/// @brief Stop the camera clock: until andor_sim_release, camera time only
+///        advances with andor_sim_step, so that frames end exactly where a
+///        test wants them, whatever the scheduling of its threads
+void andor_sim_hold() noexcept;
+
+/// @brief Advance the held camera clock by sec seconds (of camera time)
+void andor_sim_step(double sec) noexcept;
+
+/// @brief Let the camera clock run again, from where it was held
+void andor_sim_release() noexcept;
+
+/// @brief Number of images lost to circular buffer overruns, since the last
+///        StartAcquisition
+int64_t andor_sim_images_lost() noexcept;
+
+/// @brief Number of calls to the functions setting up acquisitions (Set*,
+///        except for cooling and camera selection), since Initialize
+int64_t andor_sim_setting_calls() noexcept;
+
+#endif
@@ -1,14 +1,19 @@
+#include "acquisition_state.hpp"
 #include "andor2k.hpp"
 #include "andor2kd.hpp"
 #include "cpp_socket.hpp"
+#include "thread_setup.hpp"
+#include "trace_recorder.hpp"
 #include <condition_variable>
 #include <cstring>
 #include <mutex>
 
 extern std::mutex g_mtx_abort;
-extern int abort_set;
+extern AcquisitionState g_acq_state;
 extern int abort_socket_fd;
 extern std::condition_variable cv;
+extern TraceRecorder g_tracer;
+extern ThreadSetup g_thread_setup;
 
 /// This function will try to open a new listening socket on port port_no; if
 /// successeful, the (global) variable abort_socket_fd will be set to the new
@@ -24,7 +29,7 @@ extern std::condition_variable cv;
 /// variable.
 /// The newly created socket will wait for any incoming connection; if a message
 /// is received, it will be interpreted as an abort signal, hence:
-/// 1. the global variable abort_set will be set to 1, and
+/// 1. abort is requested on the (global) acquisition state g_acq_state, and
 /// 2. the CancelWait() funcation will be called (to cancel any call to
 /// WaitForAcquisition() in any other running thread)
 /// @param[in] port_no Port number to listen to for incoming connections
@@ -35,7 +40,10 @@ void abort_listener(int port_no) noexcept {
   char dbuf[64]; // for reporting datetime
 #endif
   int sock_status;
-  abort_set = 0;
+
+  g_thread_setup.setup_this_thread("andor-abort", ThreadRole::Service);
+  g_tracer.name_thread("abort listener");
+  TraceSpan span(g_tracer, "abort listener");
 
   // do not lock yet!
   std::unique_lock<std::mutex> lk(g_mtx_abort, std::defer_lock);
@@ -104,7 +112,8 @@ void abort_listener(int port_no) noexcept {
     printf("[DEBUG][%s] abort signal caught from client at localhost:%d!\n",
            date_str(dbuf), port_no);
 #endif
-    abort_set = 1;
+    g_tracer.instant("abort requested");
+    g_acq_state.request_abort();
     unsigned int error = CancelWait();
 #ifdef DEBUG
     printf("[DEBUG][%s] CancelWait() called, returned %d (success?%d)\n",
@@ -2,15 +2,18 @@
 #include "andor2k.hpp"
 #include "andor2kd.hpp"
 #include "cpp_socket.hpp"
+#include "latency_stats.hpp"
+#include "timer_service.hpp"
+#include "trace_recorder.hpp"
+#include <algorithm>
 #include <chrono>
 #include <cstring>
-#include <mutex>
-#include <thread>
 
 using std_time_point = std::chrono::system_clock::time_point;
 
-extern std::mutex g_mtx;
-extern int abort_set;
+extern TimerService g_timer_service;
+extern LatencyStats g_latency_stats;
+extern TraceRecorder g_tracer;
 
 int exp2tick_every(long iexp) noexcept {
   long min_tick = static_cast<long>(0.5e0 * 1e3); //  500 millisec
@@ -38,9 +41,10 @@ int exp2tick_every(long iexp) noexcept {
 }
 
 /// A class to handle reporting while an ANDOR2K image acquisition takes place.
-/// The only purpose of this class, is to call the report function (in a
-/// different thatn the one waiting on the acquisition) and report the progress
-/// status of the exposure.
+/// The only purpose of this class, is to report the progress status of the
+/// exposure; progress reports are fired by the timer service (see start), and
+/// the thread waiting on the acquisition calls finish as soon as the exposure
+/// is over.
 /// @param[in] s A pointer to an (already opened) socket; the report function
 ///              will regurarly send reports to this scoket (but will receive no
 ///              incoming messages)
@@ -63,86 +67,67 @@ AcquisitionReporter::AcquisitionReporter(const andor2k::Socket *s,
       mbuf, "info:Acquiring image ...;status:Acquiring;image 1/1;time:");
 }
 
-/// This function will constantly report to the instance's socket its current
-/// state, untill it can get a hold of the g_mtx (global) mutex. Reporting is
-/// performed in an every_ms millisecond interval.
-void AcquisitionReporter::report() noexcept {
-  int it = 0;
-#ifdef DEBUG
-  char dbuf[64];
-#endif
-
-  // get a lock instance but do not try to lock yet!
-  std::unique_lock<std::mutex> lk(g_mtx, std::defer_lock);
-
-  // if we are getting a bias image (aka exposure time is 0), wrap up and exit
-  // (aka) just send one message to client, that we are done
-  if (!exposure_ms) {
-#ifdef DEBUG
-    printf("[DEBUG][%s] image is bias! not using locks (%s)!\n", date_str(dbuf),
-           __func__);
-#endif
-    date_str(mbuf + len_const_prt);
-    std::sprintf(mbuf + std::strlen(mbuf),
-                 "done;progperc:%d;sprogperc:%d;elapsedt:%.2f;selapsedt:%.2f",
-                 100, 100, 0e0, 0e0);
-    return;
-  }
-
-  long from_series_start = 0;
-  int image_done = 0, series_done = 0;
-
-  // report while we can't get a hold of the lock
-  while (!lk.try_lock()) {
-    // time now
-    auto t_now = std::chrono::high_resolution_clock::now();
-
-    // time since started this exposure
-    from_series_start = std::chrono::duration_cast<std::chrono::milliseconds>(
-                            t_now - series_start)
-                            .count();
-
-    // percentage of exposure finished
-    image_done = (from_series_start * 100 / exposure_ms);
-
-    // percentage of series finished
-    series_done = image_done; //(from_acquisition_start * 100 / total_ms);
-
-    // prepare message to be sent (add datetime and information)
-    date_str(mbuf + len_const_prt);
-    std::sprintf(mbuf + std::strlen(mbuf),
-                 ";progperc:%d;sprogperc:%d;elapsedt:%.2f;selapsedt:%.2f",
-                 image_done, series_done, from_series_start / 1e3,
-                 from_series_start / 1e3);
-
-    // send message to client via the socket
-    socket->send(mbuf);
+int AcquisitionReporter::start() noexcept {
+  // if we are getting a bias image (aka exposure time is 0), there is no
+  // progress to report; only the final report will be sent
+  if (!exposure_ms)
+    return 0;
+  timer_id = g_timer_service.schedule_every(
+      std::chrono::milliseconds(every_ms), [this] { tick(); },
+      TimerService::clock::now());
+  return timer_id ? 0 : 1;
+}
 
-    // sleep a bit ...
-    std::this_thread::sleep_for(std::chrono::milliseconds(every_ms));
-    ++it;
+void AcquisitionReporter::stop() noexcept {
+  if (timer_id) {
+    g_timer_service.cancel(timer_id);
+    timer_id = 0;
   }
+}
 
-  // we got a lock! that means that the (current) exposure/acquisition is
-  // over
-  lk.unlock();
-
-  // prepare last message to be sent (add datetime and indormation). we are
-  // going to pretend that the acquisition is done 100% except if the (global)
-  // variable abort_set is non-zero, in which case probably the acquisition
-  // was aborted
-  if (!abort_set) {
-    image_done = 100;
-  } else {
-    image_done = (from_series_start * 100 / exposure_ms);
-  }
-  series_done = image_done;
+void AcquisitionReporter::send_progress(int image_done,
+                                        long from_series_start) noexcept {
+  // prepare message to be sent (add datetime and information)
   date_str(mbuf + len_const_prt);
   std::sprintf(mbuf + std::strlen(mbuf),
                ";progperc:%d;sprogperc:%d;elapsedt:%.2f;selapsedt:%.2f",
-               image_done, series_done, from_series_start / 1e3,
+               image_done, image_done, from_series_start / 1e3,
                from_series_start / 1e3);
 
-  // all done
-  return;
+  // send message to client via the socket
+  auto report_timer = g_latency_stats.timer(LatencyPhase::Report);
+  socket->send(mbuf);
+}
+
+/// Report the current state to the instance's socket. This is called by the
+/// (daemon-wide) timer service every every_ms milliseconds, from the moment
+/// start is called until the exposure is over.
+void AcquisitionReporter::tick() noexcept {
+  g_tracer.name_thread("timer service");
+  TraceSpan span(g_tracer, "reporter tick");
+
+  // time since started this exposure
+  long from_series_start =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::high_resolution_clock::now() - series_start)
+          .count();
+
+  // percentage of exposure finished; the estimate may run past the actual
+  // exposure while the image is read out
+  int image_done = std::min(from_series_start * 100 / exposure_ms, 99L);
+  send_progress(image_done, from_series_start);
+}
+
+/// Stop the periodic reports and send the last one. We are going to pretend
+/// that the acquisition is done 100% except if the acquisition was aborted.
+void AcquisitionReporter::finish(bool aborted) noexcept {
+  stop();
+  long from_series_start =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::high_resolution_clock::now() - series_start)
+          .count();
+  int image_done = 100;
+  if (aborted && exposure_ms)
+    image_done = std::min(from_series_start * 100 / exposure_ms, 100L);
+  send_progress(image_done, from_series_start);
 }
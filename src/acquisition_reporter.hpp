@@ -1,6 +1,7 @@
 #include "andor2kd.hpp"
 #include "cpp_socket.hpp"
 #include <chrono>
+#include <cstdint>
 #include <cstring>
 
 class AcquisitionReporter {
@@ -8,17 +9,32 @@ public:
   AcquisitionReporter(
       const andor2k::Socket *s, long exp_msec,
       const std::chrono::system_clock::time_point &s_start) noexcept;
+  AcquisitionReporter(const AcquisitionReporter &) = delete;
+  AcquisitionReporter &operator=(const AcquisitionReporter &) = delete;
+  ~AcquisitionReporter() noexcept { stop(); }
 
-  // constantly report untill we can get a lock of the mutex
-  void report() noexcept;
+  // schedule progress reports (every every_ms) on the timer service
+  int start() noexcept;
+
+  // cancel progress reports; on return, no report is in progress
+  void stop() noexcept;
+
+  // report progress (called by the timer service)
+  void tick() noexcept;
+
+  // stop reporting and send the final report; call as soon as the exposure
+  // is over
+  void finish(bool aborted) noexcept;
 
 private:
   const andor2k::Socket *socket; // socket to send message to
   long exposure_ms;              // exposure
   std::chrono::system_clock::time_point series_start; // start of series
-  long every_ms; // sleeps for every_ms milliseconds, then reports
+  long every_ms;                     // report every every_ms milliseconds
+  uint64_t timer_id{0};              // id of timer in the timer service
   char mbuf[MAX_SOCKET_BUFFER_SIZE]; // char buffer (for message)
   int len_const_prt; // length of the constant part of the message
 
   void clear_buf() noexcept { std::memset(mbuf, 0, MAX_SOCKET_BUFFER_SIZE); }
+  void send_progress(int image_done, long from_series_start) noexcept;
 };
@@ -2,21 +2,21 @@
 #include "andor2k.hpp"
 #include "andor2kd.hpp"
 #include "cpp_socket.hpp"
+#include "latency_stats.hpp"
+#include "timer_service.hpp"
+#include "trace_recorder.hpp"
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <mutex>
-#include <thread>
 
 using andor2k::Socket;
 using std_time_point = std::chrono::system_clock::time_point;
 using namespace std::chrono;
 
-// lock for the whole acquisition/series
-extern std::mutex g_mtx;
-
-// current image in series; this is set by the main thread (only safe to read
-// not write!). Note that image indexing starts at 1
-extern int cur_img_in_series;
+extern TimerService g_timer_service;
+extern LatencyStats g_latency_stats;
+extern TraceRecorder g_tracer;
 
 // using experimental data, it looks that the time needed to 'get' an image
 // in an rta follows a simple regression pattern. But, the pattern is a little
@@ -37,14 +37,14 @@ long estimated_series_time(long exposure_millisec, int num_images) noexcept {
 }
 
 /// A class to handle reporting while an ANDOR2K image acquisition takes place.
-/// The only purpose of this class, is to call the report function (in a
-/// different thatn the one waiting on the acquisition) and report the progress
-/// status of the exposure.
+/// The only purpose of this class, is to report the progress status of the
+/// exposures; progress reports are fired by the timer service (see start), and
+/// the thread acquiring the images calls frame_done as soon as each image is
+/// acquired, so that image boundaries are reported without delay.
 /// This version is reponsible for reporting while a series of acquisitions
 /// takes place, e.g. when using RunTillAbort or Kinematic mode.
-/// @param[in] s A pointer to an (already opened) socket; the report function
-///              will regurarly send reports to this scoket (but will receive no
-///              incoming messages)
+/// @param[in] s A pointer to an (already opened) socket; reports are sent to
+///              this socket (but no incoming messages are received)
 /// @param[in] exp_msec The exposure time of the image in milliseconds of the
 ///              image; note that this should be the actual exposure time, which
 ///              could be different than the one specified by the user. See the
@@ -56,141 +56,105 @@ AcquisitionSeriesReporter::AcquisitionSeriesReporter(
     const Socket *s, long exp_msec, int n_images,
     const std_time_point &s_start) noexcept
     : socket(s), exposure_millisec(exp_msec), series_start_t(s_start),
-      num_images(n_images), every_millisec(200) {
+      cur_img_start_t(s_start), num_images(n_images), cur_img(1),
+      every_millisec(200),
+      total_millisec(estimated_series_time(exp_msec, n_images)) {
   // write constant part of message so that we don't have to write it every
   // time
   clear_buf();
   len_const_prt = std::sprintf(mbuf, "info:Acquiring image series...;time:");
 }
 
-/// Dead simple ration class to help with adjust_timing function
-struct Ratio {
-  long nom, denom;
-  constexpr long operator*(long l) noexcept { return l * nom / denom; }
-};
-
-/// find the largest ratio of every_ms that we can subtract from
-/// from_image_start so that it is not negative
-inline long adjust_timing(long from_image_start, long every_ms) noexcept {
-  static Ratio fractions[] = { {3, 4}, {1, 2}, {1, 3}, {1, 5} };
-  for (int i = 0; i < (int)(sizeof(fractions)/sizeof(fractions[0])); i++) {
-    if (from_image_start - fractions[i] * every_ms > 0) {
-      return fractions[i] * every_ms;
-    }
-  }
-  return 0L;
+int AcquisitionSeriesReporter::start() noexcept {
+  std::lock_guard<std::mutex> lock(mtx);
+  timer_id = g_timer_service.schedule_every(
+      std::chrono::milliseconds(every_millisec), [this] { tick(); },
+      TimerService::clock::now());
+  return timer_id ? 0 : 1;
 }
 
-/// This function will constantly report to the instance's socket its current
-/// state, untill it can get a hold of the g_mtx (global) mutex. Reporting is
-/// performed in an every_ms millisecond interval.
-/// Note that (in cotrast to AcquisitionReporter::report) this function should
-/// report the whole time while (a diffrent thread) acquires a whole series
-/// of images.
-/// @note The andor2k API starts counting images in a series from index 1 (not
-/// 0) e.g. for GetImages()
-/// @note The current image index is set by the thread/function actually taking
-/// the exposures. This function will not ever set this variable
-/// (cur_img_in_series), it will only read it.
-void AcquisitionSeriesReporter::report() noexcept {
-
-  // time when function started
-  // auto series_start_t = high_resolution_clock::now();
-
-  // estimate the time for the whole series to end
-  long total_millisec = estimated_series_time(exposure_millisec, num_images);
-
-  // current image (note that the indexing of images starts from 1)
-  int cur_img = 1;
-  auto cur_img_start_t = series_start_t;
-
-  // get a lock instance but do not try to lock yet; we should only be able
-  // to get a hold of the lock after the series has ended (by that time, the
-  // main thread should unlock the g_mtx)
-  std::unique_lock<std::mutex> lk(g_mtx, std::defer_lock);
-
-  long from_cimage_start = 0, from_acquisition_start = 0;
-  int image_done = 0, series_done = 0;
-  while (!lk.try_lock()) {
-    // time now
-    auto t_now = high_resolution_clock::now();
-
-    // time since started this exposure
-    from_cimage_start =
-        duration_cast<std::chrono::milliseconds>(t_now - cur_img_start_t)
-            .count();
-
-    // time since start of exposure series
-    from_acquisition_start =
-        duration_cast<std::chrono::milliseconds>(t_now - series_start_t)
-            .count();
-
-    // what's the current image nr?
-    if (cur_img != cur_img_in_series) { // previous image done! report that
-// adjust start times; this exposure started sometime while we were
-// sleeping...
-#ifdef NEW_PART
-      long adjust_ms = adjust_timing(from_cimage_start, every_millisec);
-      auto from_cimage_start_p = from_cimage_start - adjust_ms;
-      auto from_acquisition_start_p = from_acquisition_start - adjust_ms;
-      cur_img_start_t =
-          high_resolution_clock::now() - duration(milliseconds(adjust_ms));
-#else
-      // new start if current image
-      cur_img_start_t = high_resolution_clock::now() -
-                        duration(milliseconds(every_millisec / 2));
-      auto from_cimage_start_p = from_cimage_start;
-      auto from_acquisition_start_p = from_acquisition_start;
-#endif
-
-      // report that we finished previous image
-      series_done = (from_acquisition_start_p * 100 / total_millisec);
-      date_str(mbuf + len_const_prt);
-      std::sprintf(
-          mbuf + std::strlen(mbuf),
-          ";status:Acquired image "
-          "%d/%d;progperc:%d;sprogperc:%d;elapsedt:%.1f;selapsedt:%.1f;",
-          cur_img, num_images, 100, series_done, from_cimage_start_p / 1e3,
-          from_acquisition_start_p / 1e3);
-
-      // send message to client via the socket
-      socket->send(mbuf);
-      cur_img = cur_img_in_series;
-    }
-
-    // percentage of current exposure finished
-    image_done = (from_cimage_start * 100 /
-                  estimated_time_per_image(exposure_millisec, cur_img));
-
-    // percentage of series finished
-    series_done = (from_acquisition_start * 100 / total_millisec);
-
-    // prepare message to be sent (add datetime and indormation)
-    date_str(mbuf + len_const_prt);
-    std::sprintf(mbuf + std::strlen(mbuf),
-                 ";status:Acquiring image "
-                 "%d/%d;progperc:%d;sprogperc:%d;elapsedt:%.1f;selapsedt:%.1f;",
-                 cur_img, num_images, image_done, series_done,
-                 from_cimage_start / 1e3, from_acquisition_start / 1e3);
-    // send message to client via the buffer
-    socket->send(mbuf);
-
-    // sleep a bit ...
-    std::this_thread::sleep_for(std::chrono::milliseconds(every_millisec));
+void AcquisitionSeriesReporter::stop() noexcept {
+  uint64_t id;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    id = timer_id;
+    timer_id = 0;
   }
+  // do not hold mtx here; a tick waiting on it would never return
+  if (id)
+    g_timer_service.cancel(id);
+}
+
+/// Format and send a message; must be called with mtx locked
+void AcquisitionSeriesReporter::send(const char *status, int image_done,
+                                     std_time_point t_now) noexcept {
+  // time since started this exposure and since start of exposure series
+  long from_cimage_start =
+      duration_cast<milliseconds>(t_now - cur_img_start_t).count();
+  long from_acquisition_start =
+      duration_cast<milliseconds>(t_now - series_start_t).count();
 
-  // we got a lock! that means that the exposure series is over
-  lk.unlock();
+  // percentage of series finished
+  int series_done = static_cast<int>(
+      std::min(from_acquisition_start * 100 / total_millisec, 100L));
 
-  // prepare last message to be sent (add datetime and information)
+  // prepare message to be sent (add datetime and indormation)
   date_str(mbuf + len_const_prt);
   std::sprintf(mbuf + std::strlen(mbuf),
-               ";status:Acquired %d/%d "
-               "images;progperc:%d;sprogperc:%d;elapsedt:%.1f;selapsedt:%.1f",
-               cur_img, num_images, 100, series_done, from_cimage_start / 1e3,
+               ";status:%s;progperc:%d;sprogperc:%d;elapsedt:%.1f;selapsedt:%."
+               "1f;",
+               status, image_done, series_done, from_cimage_start / 1e3,
                from_acquisition_start / 1e3);
 
-  // all done
-  return;
+  // send message to client via the socket
+  auto report_timer = g_latency_stats.timer(LatencyPhase::Report);
+  socket->send(mbuf);
+}
+
+/// Report the progress of the current image/series to the instance's socket.
+/// This is called by the (daemon-wide) timer service every every_ms
+/// milliseconds.
+/// @note The andor2k API starts counting images in a series from index 1 (not
+/// 0) e.g. for GetImages()
+void AcquisitionSeriesReporter::tick() noexcept {
+  g_tracer.name_thread("timer service");
+  TraceSpan span(g_tracer, "reporter tick");
+  std::lock_guard<std::mutex> lock(mtx);
+  if (cur_img > num_images)
+    return;
+
+  auto t_now = high_resolution_clock::now();
+  long from_cimage_start =
+      duration_cast<milliseconds>(t_now - cur_img_start_t).count();
+
+  // percentage of current exposure finished (the estimate may be a little
+  // off; never report the image as done before it actually is)
+  int image_done = static_cast<int>(std::min(
+      from_cimage_start * 100 /
+          estimated_time_per_image(exposure_millisec, cur_img - 1),
+      99L));
+
+  char status[64];
+  std::sprintf(status, "Acquiring image %d/%d", cur_img, num_images);
+  send(status, image_done, t_now);
+}
 
-} // report
+/// Report that image img_nr is acquired, and start timing the next one
+void AcquisitionSeriesReporter::frame_done(int img_nr) noexcept {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto t_now = high_resolution_clock::now();
+  char status[64];
+  std::sprintf(status, "Acquired image %d/%d", img_nr, num_images);
+  send(status, 100, t_now);
+  cur_img = img_nr + 1;
+  cur_img_start_t = t_now;
+}
+
+/// Stop the periodic reports and report that the series is over
+void AcquisitionSeriesReporter::finish(int images_acquired) noexcept {
+  stop();
+  std::lock_guard<std::mutex> lock(mtx);
+  char status[64];
+  std::sprintf(status, "Acquired %d/%d images", images_acquired, num_images);
+  send(status, 100, high_resolution_clock::now());
+}
@@ -1,23 +1,51 @@
 #include "andor2kd.hpp"
 #include "cpp_socket.hpp"
 #include <chrono>
+#include <cstdint>
 #include <cstring>
+#include <mutex>
 
 class AcquisitionSeriesReporter {
 public:
   AcquisitionSeriesReporter(
       const andor2k::Socket *s, long exp_msec, int n_images,
       const std::chrono::system_clock::time_point &s_start) noexcept;
-  void report() noexcept;
+  AcquisitionSeriesReporter(const AcquisitionSeriesReporter &) = delete;
+  AcquisitionSeriesReporter &
+  operator=(const AcquisitionSeriesReporter &) = delete;
+  ~AcquisitionSeriesReporter() noexcept { stop(); }
+
+  // schedule progress reports on the timer service
+  int start() noexcept;
+
+  // cancel progress reports; on return, no report is in progress
+  void stop() noexcept;
+
+  // report progress (called by the timer service)
+  void tick() noexcept;
+
+  // report that image img_nr (starting from 1) is acquired; call as soon as
+  // the frame is done
+  void frame_done(int img_nr) noexcept;
+
+  // stop reporting and send the final report for the series
+  void finish(int images_acquired) noexcept;
 
 private:
   const andor2k::Socket *socket;
   long exposure_millisec;
   std::chrono::system_clock::time_point series_start_t; // start of series
+  std::chrono::system_clock::time_point cur_img_start_t; // start of image
   int num_images;
+  int cur_img; // current image in series (starting from 1)
   long every_millisec;
+  long total_millisec; // estimated duration of the series
+  uint64_t timer_id{0};
   int len_const_prt;
+  std::mutex mtx; // protects all of the above, between ticks and frame_done
   char mbuf[MAX_SOCKET_BUFFER_SIZE];
 
   void clear_buf() noexcept { std::memset(mbuf, 0, MAX_SOCKET_BUFFER_SIZE); }
+  void send(const char *status, int image_done,
+            std::chrono::system_clock::time_point t_now) noexcept;
 }; // AcquisitionSeriesReporter
@@ -0,0 +1,132 @@
+#include "acquisition_state.hpp"
+#include <thread>
+
+const char *AcquisitionPhase2str(AcquisitionPhase p) noexcept {
+  switch (p) {
+  case AcquisitionPhase::Idle:
+    return "idle";
+  case AcquisitionPhase::Exposing:
+    return "exposing";
+  case AcquisitionPhase::Reading:
+    return "reading";
+  case AcquisitionPhase::Done:
+    return "done";
+  case AcquisitionPhase::Aborted:
+    return "aborted";
+  case AcquisitionPhase::Failed:
+    return "failed";
+  }
+  return "unknown";
+}
+
+namespace {
+int64_t now_ns() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+} // namespace
+
+/// Make the sequence number odd (aka "update in progress"); if another
+/// writer is already updating, spin until it is done
+void AcquisitionState::write_begin() noexcept {
+  uint64_t seq = m_seq.load(std::memory_order_relaxed);
+  for (;;) {
+    if (!(seq & 1) &&
+        m_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire,
+                                    std::memory_order_relaxed))
+      break;
+    std::this_thread::yield();
+    seq = m_seq.load(std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void AcquisitionState::write_end() noexcept {
+  m_seq.fetch_add(1, std::memory_order_seq_cst);
+  notify();
+}
+
+/// Wake up waiting readers, if any. Taking the mutex (even momentarily)
+/// makes sure that a reader that has checked the sequence number but not
+/// yet started waiting, does not miss the notification.
+void AcquisitionState::notify() noexcept {
+  if (m_waiters.load(std::memory_order_seq_cst)) {
+    { std::lock_guard<std::mutex> lock(m_mtx); }
+    m_cv.notify_all();
+  }
+}
+
+void AcquisitionState::begin(int num_images) noexcept {
+  write_begin();
+  m_num_images.store(num_images, std::memory_order_relaxed);
+  m_cur_image.store(1, std::memory_order_relaxed);
+  m_images_done.store(0, std::memory_order_relaxed);
+  m_start_ns.store(now_ns(), std::memory_order_relaxed);
+  m_frame_ns.store(0, std::memory_order_relaxed);
+  m_abort.store(false, std::memory_order_relaxed);
+  m_phase.store(static_cast<int_fast8_t>(AcquisitionPhase::Exposing),
+                std::memory_order_relaxed);
+  write_end();
+}
+
+void AcquisitionState::set_phase(AcquisitionPhase phase) noexcept {
+  write_begin();
+  m_phase.store(static_cast<int_fast8_t>(phase), std::memory_order_relaxed);
+  write_end();
+}
+
+void AcquisitionState::frame_done(int img_nr) noexcept {
+  write_begin();
+  m_images_done.store(img_nr, std::memory_order_relaxed);
+  m_cur_image.store(img_nr + 1, std::memory_order_relaxed);
+  m_frame_ns.store(now_ns(), std::memory_order_relaxed);
+  m_phase.store(static_cast<int_fast8_t>(AcquisitionPhase::Reading),
+                std::memory_order_relaxed);
+  write_end();
+}
+
+void AcquisitionState::request_abort() noexcept {
+  write_begin();
+  m_abort.store(true, std::memory_order_release);
+  write_end();
+}
+
+AcquisitionSnapshot AcquisitionState::snapshot() const noexcept {
+  AcquisitionSnapshot s;
+  uint64_t seq2;
+  do {
+    s.seq = m_seq.load(std::memory_order_acquire);
+    if (s.seq & 1) { // writer in progress
+      std::this_thread::yield();
+      seq2 = s.seq + 1;
+      continue;
+    }
+    s.cur_image = m_cur_image.load(std::memory_order_relaxed);
+    s.images_done = m_images_done.load(std::memory_order_relaxed);
+    s.num_images = m_num_images.load(std::memory_order_relaxed);
+    s.start_ns = m_start_ns.load(std::memory_order_relaxed);
+    s.frame_ns = m_frame_ns.load(std::memory_order_relaxed);
+    s.abort_requested = m_abort.load(std::memory_order_relaxed);
+    s.phase = static_cast<AcquisitionPhase>(
+        m_phase.load(std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    seq2 = m_seq.load(std::memory_order_relaxed);
+  } while (seq2 != s.seq);
+  return s;
+}
+
+AcquisitionSnapshot
+AcquisitionState::wait(uint64_t seq,
+                       std::chrono::milliseconds timeout) const noexcept {
+  m_waiters.fetch_add(1, std::memory_order_seq_cst);
+  {
+    std::unique_lock<std::mutex> lock(m_mtx);
+    m_cv.wait_for(lock, timeout, [&] {
+      uint64_t cur = m_seq.load(std::memory_order_seq_cst);
+      return !(cur & 1) && cur != seq;
+    });
+  }
+  m_waiters.fetch_sub(1, std::memory_order_relaxed);
+  return snapshot();
+}
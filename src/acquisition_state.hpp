@@ -0,0 +1,105 @@
+#ifndef __ANDOR2K_ACQUISITION_STATE_HPP__
+#define __ANDOR2K_ACQUISITION_STATE_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+enum class AcquisitionPhase : int_fast8_t {
+  Idle,      ///< no acquisition since the daemon started
+  Exposing,  ///< waiting for the current frame
+  Reading,   ///< frame done; retrieving/saving it
+  Done,      ///< last acquisition finished successfully
+  Aborted,   ///< last acquisition was aborted (e.g. by the client)
+  Failed     ///< last acquisition failed
+}; // AcquisitionPhase
+
+const char *AcquisitionPhase2str(AcquisitionPhase p) noexcept;
+
+/// @brief True if an acquisition is in progress in the given phase
+inline bool acquisition_active(AcquisitionPhase p) noexcept {
+  return p == AcquisitionPhase::Exposing || p == AcquisitionPhase::Reading;
+}
+
+/// @brief A consistent view of the acquisition state at some instant
+struct AcquisitionSnapshot {
+  uint64_t seq{0};       ///< incremented (by 2) on every update
+  int cur_image{0};      ///< image being acquired, starting from 1
+  int images_done{0};    ///< number of images acquired so far
+  int num_images{0};     ///< number of images in the acquisition
+  int64_t start_ns{0};   ///< start of acquisition, nanoseconds since epoch
+  int64_t frame_ns{0};   ///< completion of last frame, nanoseconds since epoch
+  bool abort_requested{false};
+  AcquisitionPhase phase{AcquisitionPhase::Idle};
+}; // AcquisitionSnapshot
+
+/// @brief State of the current (or last) acquisition, shared between the
+///        thread acquiring images and anyone interested in its progress.
+/// The state is published via a seqlock: writers never take a mutex (they
+/// only briefly spin against each other, which only happens if an abort is
+/// requested while a frame completes), while readers get a consistent
+/// snapshot by retrying if an update happened meanwhile. Readers may also
+/// block until the next update (aka a frame boundary, a phase transition or
+/// an abort request) via wait; writers only touch the condition variable when
+/// someone is actually waiting.
+/// All functions but request_abort are meant to be called by the thread
+/// performing the acquisition.
+class AcquisitionState {
+public:
+  AcquisitionState() noexcept = default;
+  AcquisitionState(const AcquisitionState &) = delete;
+  AcquisitionState &operator=(const AcquisitionState &) = delete;
+
+  /// @brief Start a new acquisition of num_images images; clears any
+  ///        previous abort request
+  void begin(int num_images) noexcept;
+
+  /// @brief Change the phase of the acquisition (e.g. start exposing the
+  ///        next frame, or mark the acquisition as done/failed)
+  void set_phase(AcquisitionPhase phase) noexcept;
+
+  /// @brief Frame img_nr (starting from 1) is done; phase changes to Reading
+  void frame_done(int img_nr) noexcept;
+
+  /// @brief Request that the current acquisition be aborted; callable from
+  ///        any thread. Note that this only marks the request; it is up to
+  ///        the caller to interrupt the SDK (e.g. via CancelWait)
+  void request_abort() noexcept;
+
+  bool abort_requested() const noexcept {
+    return m_abort.load(std::memory_order_acquire);
+  }
+
+  /// @brief Get a consistent snapshot of the state
+  AcquisitionSnapshot snapshot() const noexcept;
+
+  /// @brief Block until the state is updated past seq (i.e. the snapshot's
+  ///        seq differs from the one given), or until timeout
+  /// @return The latest snapshot (which may be unchanged on timeout)
+  AcquisitionSnapshot wait(uint64_t seq,
+                           std::chrono::milliseconds timeout) const noexcept;
+
+private:
+  std::atomic<uint64_t> m_seq{0};
+  std::atomic<int> m_cur_image{0};
+  std::atomic<int> m_images_done{0};
+  std::atomic<int> m_num_images{0};
+  std::atomic<int64_t> m_start_ns{0};
+  std::atomic<int64_t> m_frame_ns{0};
+  std::atomic<int_fast8_t> m_phase{
+      static_cast<int_fast8_t>(AcquisitionPhase::Idle)};
+  std::atomic<bool> m_abort{false};
+
+  // only used to block readers in wait
+  mutable std::atomic<int> m_waiters{0};
+  mutable std::mutex m_mtx;
+  mutable std::condition_variable m_cv;
+
+  void write_begin() noexcept;
+  void write_end() noexcept;
+  void notify() noexcept;
+}; // AcquisitionState
+
+#endif
@@ -1,21 +1,95 @@
 #include "andor2k.hpp"
+#include "acquisition_state.hpp"
+#include "async_logger.hpp"
+#include "clock_monitor.hpp"
+#include "frame_ring.hpp"
+#include "latency_stats.hpp"
+#include "metrics.hpp"
+#include "sdk_owner.hpp"
+#include "setup_cache.hpp"
+#include "task_pool.hpp"
+#include "telemetry.hpp"
+#include "temperature_controller.hpp"
+#include "thread_setup.hpp"
+#include "timer_service.hpp"
+#include "trace_recorder.hpp"
+#include <atomic>
 #include <condition_variable>
 #include <cstring>
 #include <mutex>
 
 int sig_abort_set = 0;
 int sig_interrupt_set = 0;
-int abort_exposure_set = 0;
-int stop_reporting_thread = 0;
-int acquisition_thread_finished = 0;
-int cur_img_in_series = 0;
 
-std::mutex g_mtx;
 std::mutex g_mtx_abort;
-int abort_set;
 int abort_socket_fd;
 std::condition_variable cv;
 
+// state/progress of the current (or last) acquisition
+AcquisitionState g_acq_state;
+
+// held by whoever is using the camera for an acquisition (e.g. the
+// observation queue worker)
+std::mutex g_camera_mtx;
+
+// lifecycle of the camera (see CameraState); set by the daemon
+std::atomic<CameraState> g_camera_state{CameraState::Initialising};
+
+// background temperature control
+TemperatureController g_temp_controller;
+
+// asynchronous logger, used on the acquisition (hot) paths
+AsyncLogger g_logger;
+
+// per-phase latency histograms of acquisitions (see the "stats" command)
+LatencyStats g_latency_stats;
+
+// counters exported via the metrics endpoint
+DaemonMetrics g_metrics;
+
+// timelines of acquisitions, in Chrome trace format (see the "trace" command)
+TraceRecorder g_tracer;
+
+// daemon-wide timer thread (e.g. for progress reports while acquiring)
+TimerService g_timer_service;
+
+// shared-memory ring where acquired frames are published for local consumers
+FrameRingWriter g_frame_ring;
+
+// offset of the system clock from NTP servers, to correct frame timestamps
+ClockMonitor g_clock_monitor;
+
+// the only thread talking to the SDK (see SdkOwner)
+SdkOwner g_sdk;
+
+// latest temperature/cooler/driver status, and their history (see the
+// "status" and "telemetry" commands)
+TelemetrySampler g_telemetry;
+
+// names, CPU affinity and scheduling of the daemon's threads, locking of
+// frame memory (see ThreadSetup)
+ThreadSetup g_thread_setup;
+
+// camera invariants and the settings last applied to it (see SetupCache)
+SetupCache g_setup_cache;
+
+// threads for post-readout processing, e.g. writing FITS files (see TaskPool)
+TaskPool g_task_pool;
+
+const char *CameraState2str(CameraState s) noexcept {
+  switch (s) {
+  case CameraState::Initialising:
+    return "initialising";
+  case CameraState::Cooling:
+    return "cooling";
+  case CameraState::Ready:
+    return "ready";
+  case CameraState::Error:
+    return "error";
+  }
+  return "unknown";
+}
+
 void AndorParameters::set_defaults() noexcept {
   camera_num_ = 0;
   exposure_ = 0.1;
@@ -39,12 +113,17 @@ void AndorParameters::set_defaults() noexcept {
   shutter_opening_time_ = 50;
   cooler_mode_ = 0;
   ar_hdr_tries_ = 0;
+  temp_tolerance_ = -1;
+  start_at_ns_ = 0;
 }
 
 char *get_status_string(char *buffer) noexcept {
   int status;
   GetStatus(&status);
+  return get_status_string(status, buffer);
+}
 
+char *get_status_string(int status, char *buffer) noexcept {
   std::memset(buffer, 0, MAX_STATUS_STRING_SIZE);
 
   switch (status) {
@@ -124,6 +203,9 @@ char *get_start_acquisition_status_string(unsigned int error,
   case DRV_SUCCESS:
     std::strcpy(buffer, "Acquisition started");
     break;
+  case SCHEDULED_START_ABORTED:
+    std::strcpy(buffer, "Aborted while waiting for the start time");
+    break;
   case DRV_NOT_INITIALIZED:
     std::strcpy(buffer, "System not initialized");
     break;
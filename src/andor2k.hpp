@@ -30,6 +30,9 @@ constexpr int MAX_FILTER_NAME_CHARS = 16;
 
 constexpr const int MAX_OBSERVER_NAME = 32;
 
+/// @brief Max index of the pre-amp gain (e.g. setparam, state file)
+constexpr int MAX_PREAMP_GAIN_INDEX = 2;
+
 /// @brief Minimum temperature to reach before shut down
 constexpr int SHUTDOWN_TEMPERATURE = 5;
 
@@ -46,10 +49,18 @@ constexpr int MAX_PIXELS_IN_DIM = 2048;
 
 constexpr int SOCKET_PORT = 8080;
 
+/// @brief Port of the (localhost-only) HTTP metrics endpoint; SOCKET_PORT+1
+///        is used for abort requests
+constexpr int METRICS_PORT = SOCKET_PORT + 2;
+
 constexpr int ABORT_EXIT_STATUS = std::numeric_limits<int>::max();
 
 constexpr int INTERRUPT_EXIT_STATUS = std::numeric_limits<int>::max();
 
+/// @brief Status returned in place of an SDK one, when an acquisition is
+///        aborted while waiting for its scheduled start (see "image --at")
+constexpr unsigned SCHEDULED_START_ABORTED = 1;
+
 enum class ReadOutMode : int_fast8_t {
   FullVerticalBinning = 0,
   MultiTrack = 1,
@@ -74,6 +85,16 @@ enum class ShutterMode : int_fast8_t {
   OpenForAnySeries
 }; // ShutterMode
 
+/// @brief Lifecycle of the camera, as tracked by the daemon
+enum class CameraState : int_fast8_t {
+  Initialising, ///< camera selection/initialization in progress
+  Cooling,      ///< initialized and usable, cooling to target temperature
+  Ready,        ///< initialized and target temperature stabilized
+  Error         ///< initialization failed
+}; // CameraState
+
+const char *CameraState2str(CameraState s) noexcept;
+
 struct AndorParameters {
   void set_defaults() noexcept;
 
@@ -130,6 +151,16 @@ struct AndorParameters {
    */
   int ar_hdr_tries_ = 0;
 
+  /* if >= 0, acquisitions will wait until the CCD temperature is within
+   * ±temp_tolerance_ Celsius of the target temperature before starting
+   */
+  float temp_tolerance_ = -1;
+
+  /* if > 0, the acquisition starts at this UTC time (nanoseconds since the
+   * epoch) rather than right away; applies to a single image command
+   */
+  int64_t start_at_ns_ = 0;
+
 }; // AndorParameters
 
 inline int ReadOutMode2int(ReadOutMode rom) noexcept {
@@ -150,6 +181,8 @@ int setup_read_out_mode(const AndorParameters *) noexcept;
 
 int setup_acquisition_mode(const AndorParameters *) noexcept;
 
+int setup_shutter(const AndorParameters *params) noexcept;
+
 int resolve_cmd_parameters(int argc, char *argv[],
                            AndorParameters &params) noexcept;
 
@@ -161,13 +194,18 @@ int cool_to_temperature(
 
 int select_camera(int camera_index = 0) noexcept;
 
-int system_shutdown() noexcept;
+int system_shutdown(bool keep_cold = false) noexcept;
 
 int print_status(const andor2k::Socket &socket) noexcept;
 
 int get_next_fits_filename(const AndorParameters *params,
                            char *fits_fn) noexcept;
 
+/// @brief The FITS filename following fits_fn in a series (INDEX + 1); no
+///        directory scan, so that files still being written are not reused
+int get_following_fits_filename(const AndorParameters *params,
+                                const char *fits_fn, char *next_fn) noexcept;
+
 int setup_acquisition(const AndorParameters *params, FitsHeaders *fheaders,
                       int &width, int &height, float &vsspeed,
                       float &hsspeed_mhz, at_32 *&img_mem) noexcept;
@@ -176,6 +214,13 @@ int get_acquisition(const AndorParameters *params, FitsHeaders *fheaders,
                     int xnumpixels, int ynumpixels, at_32 *img_buffer,
                     const andor2k::Socket &socket) noexcept;
 
+/// @brief Wait, on the calling thread, for most of a scheduled start (see
+///        "image --at"), so that the SDK owner is only handed the last
+///        SCHEDULED_START_HANDOVER_NS of it (with get_acquisition)
+/// @return 0, or SCHEDULED_START_ABORTED if aborted while waiting
+unsigned wait_scheduled_start(const AndorParameters *params,
+                              const andor2k::Socket &socket) noexcept;
+
 int set_fastest_recomended_vh_speeds(float &vspeed, int hsspeed_index,
                                      float &hsspeed_mhz) noexcept;
 
@@ -188,7 +233,16 @@ int save_as_fits(const AndorParameters *params, FitsHeaders *fheaders,
                  const andor2k::Socket &socket, char *fits_filename,
                  char *socket_buffer) noexcept;
 
+/// @brief Write a frame (data, then headers) to a new FITS file and close
+///        it; may be called from any thread (see SeriesWriter)
+/// @return 0 on success; anything else denotes an error (data not written)
+int write_fits_frame(const char *fits_filename, FitsHeaders &fheaders,
+                     int xpixels, int ypixels,
+                     const at_32 *img_buffer) noexcept;
+
 char *get_status_string(char *buf) noexcept;
+/// @brief Describe a status as returned by GetStatus (no SDK call)
+char *get_status_string(int status, char *buf) noexcept;
 char *get_start_acquisition_status_string(unsigned int error,
                                           char *buffer) noexcept;
 char *get_get_acquired_data_status_string(unsigned int error,
@@ -4,8 +4,10 @@
 #include "andor2k.hpp"
 #include "cpp_socket.hpp"
 
-int resolve_image_parameters(const char *command,
-                             AndorParameters &params) noexcept;
+struct CommandError;
+
+int resolve_image_parameters(const char *command, AndorParameters &params,
+                             CommandError *error = nullptr) noexcept;
 int socket_sprintf(const andor2k::Socket &socket, char *buffer, const char *fmt,
                    ...) noexcept;
 void abort_listener(int port_no) noexcept;
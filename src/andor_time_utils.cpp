@@ -4,6 +4,8 @@
 #include <chrono>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
+#include <limits>
 
 using namespace std::chrono;
 
@@ -71,13 +73,185 @@ std::chrono::nanoseconds start_time_correction(float exposure, float vsspeed,
 
 std::tm strfdt_work(const std_time_point &t,
                     long &fractional_seconds) noexcept {
-  std::chrono::milliseconds ms =
-      std::chrono::duration_cast<std::chrono::milliseconds>(
-          t.time_since_epoch());
-  // std::chrono::seconds s =
-  // std::chrono::duration_cast<std::chrono::seconds>(ms);
-  std::time_t tt = std::chrono::system_clock::to_time_t(t);
-  std::tm tm = *std::gmtime(&tt); // GMT (UTC)
-  fractional_seconds = ms.count() % 1000;
+  long long ms = duration_cast<milliseconds>(t.time_since_epoch()).count();
+  long long sec = ms / 1000;
+  fractional_seconds = static_cast<long>(ms % 1000);
+  if (fractional_seconds < 0) { // floor, for time points before the epoch
+    fractional_seconds += 1000;
+    --sec;
+  }
+  std::time_t tt = static_cast<std::time_t>(sec);
+  std::tm tm;
+  gmtime_r(&tt, &tm); // GMT (UTC)
   return tm;
-}
\ No newline at end of file
+}
+
+namespace {
+/// write v as exactly two decimal digits
+inline char *put2(char *p, unsigned v) noexcept {
+  p[0] = static_cast<char>('0' + v / 10);
+  p[1] = static_cast<char>('0' + v % 10);
+  return p + 2;
+}
+
+/// write y as (at least) four decimal digits; years outside [0, 9999] are
+/// clamped, which never happens for dates we care about
+inline char *put4(char *p, long y) noexcept {
+  unsigned v = y < 0 ? 0U : (y > 9999 ? 9999U : static_cast<unsigned>(y));
+  p = put2(p, v / 100);
+  return put2(p, v % 100);
+}
+
+/// "YYYY-MM-DDxHH:MM:SS" (19 chars, not null-terminated) for a civil date
+/// and a time of day (in seconds), using sep between date and time
+void put_ymdhms(char *p, long y, unsigned m, unsigned d, long sod,
+                char sep) noexcept {
+  p = put4(p, y);
+  *p++ = '-';
+  p = put2(p, m);
+  *p++ = '-';
+  p = put2(p, d);
+  *p++ = sep;
+  p = put2(p, static_cast<unsigned>(sod / 3600));
+  *p++ = ':';
+  p = put2(p, static_cast<unsigned>((sod % 3600) / 60));
+  *p++ = ':';
+  put2(p, static_cast<unsigned>(sod % 60));
+}
+
+/// per-thread cache of the last second formatted
+struct SecondCache {
+  long long sec = std::numeric_limits<long long>::min();
+  char str[20] = {'\0'};
+};
+} // namespace
+
+char *format_utc(const std_time_point &t, DateTimeFormat f,
+                 char *buf) noexcept {
+  thread_local SecondCache cache;
+
+  // split into (floored) seconds since epoch and milliseconds
+  long long ms = duration_cast<milliseconds>(t.time_since_epoch()).count();
+  long long sec = ms / 1000;
+  long long msec = ms % 1000;
+  if (msec < 0) {
+    msec += 1000;
+    --sec;
+  }
+
+  // new second; format "YYYY-MM-DDTHH:MM:SS" once
+  if (sec != cache.sec) {
+    long long days = sec / 86400;
+    long long sod = sec % 86400;
+    if (sod < 0) {
+      sod += 86400;
+      --days;
+    }
+    long y;
+    unsigned m, d;
+    civil_from_days(static_cast<long>(days), y, m, d);
+    put_ymdhms(cache.str, y, m, d, static_cast<long>(sod), 'T');
+    cache.sec = sec;
+  }
+
+  // pick the part of the cached string we need
+  const char *src = cache.str;
+  int len = 19;
+  switch (f) {
+  case DateTimeFormat::YMD:
+    len = 10;
+    break;
+  case DateTimeFormat::HMS:
+  case DateTimeFormat::HMfS:
+    src += 11;
+    len = 8;
+    break;
+  default:
+    break;
+  }
+  std::memcpy(buf, src, len);
+
+  // sub-second digits
+  if (f == DateTimeFormat::YMDHMfS || f == DateTimeFormat::HMfS) {
+    unsigned v = static_cast<unsigned>(msec);
+    buf[len++] = '.';
+    buf[len++] = static_cast<char>('0' + v / 100);
+    buf[len++] = static_cast<char>('0' + (v / 10) % 10);
+    buf[len++] = static_cast<char>('0' + v % 10);
+  }
+  buf[len] = '\0';
+  return buf;
+}
+
+char *format_local(std::time_t t, char *buf) noexcept {
+  thread_local SecondCache cache;
+  if (static_cast<long long>(t) != cache.sec) {
+    std::tm tm;
+    localtime_r(&t, &tm);
+    put_ymdhms(cache.str, tm.tm_year + 1900L,
+               static_cast<unsigned>(tm.tm_mon + 1),
+               static_cast<unsigned>(tm.tm_mday),
+               tm.tm_hour * 3600L + tm.tm_min * 60L + tm.tm_sec, ' ');
+    cache.sec = t;
+  }
+  std::memcpy(buf, cache.str, 20);
+  return buf;
+}
+
+namespace {
+/// parse exactly n decimal digits
+const char *getn(const char *p, int n, long &v) noexcept {
+  v = 0;
+  for (int i = 0; i < n; i++, p++) {
+    if (*p < '0' || *p > '9')
+      return nullptr;
+    v = v * 10 + (*p - '0');
+  }
+  return p;
+}
+} // namespace
+
+int parse_utc(const char *str, int64_t &utc_ns) noexcept {
+  long y, mo, d, h, mi, s;
+  const char *p = str;
+  if (!(p = getn(p, 4, y)) || *p++ != '-' || !(p = getn(p, 2, mo)) ||
+      *p++ != '-' || !(p = getn(p, 2, d)) || (*p != 'T' && *p != ' ') ||
+      !(p = getn(p + 1, 2, h)) || *p++ != ':' || !(p = getn(p, 2, mi)) ||
+      *p++ != ':' || !(p = getn(p, 2, s)))
+    return 1;
+  if (mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59 || s > 60)
+    return 1;
+
+  // fractional seconds
+  long ns = 0;
+  if (*p == '.') {
+    int digits = 0;
+    for (++p; *p >= '0' && *p <= '9'; p++, digits++) {
+      if (digits == 9)
+        return 1;
+      ns = ns * 10 + (*p - '0');
+    }
+    if (!digits)
+      return 1;
+    for (; digits < 9; digits++)
+      ns *= 10;
+  }
+  if (*p == 'Z')
+    ++p;
+  if (*p)
+    return 1;
+
+  // the day must exist in the month (e.g. no February 30)
+  long y2;
+  unsigned m2, d2;
+  long days = days_from_civil(y, static_cast<unsigned>(mo),
+                              static_cast<unsigned>(d));
+  civil_from_days(days, y2, m2, d2);
+  if (d2 != static_cast<unsigned>(d))
+    return 1;
+
+  utc_ns = (static_cast<int64_t>(days) * 86400 + h * 3600 + mi * 60 + s) *
+               1000000000ll +
+           ns;
+  return 0;
+}
@@ -3,8 +3,10 @@
 
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <thread>
 
 using std_time_point = std::chrono::system_clock::time_point;
@@ -20,6 +22,9 @@ std::chrono::nanoseconds start_time_correction(float exposure, float vsspeed,
                                                float hsspeed, int img_rows,
                                                int img_cols) noexcept;
 
+/// @brief Broken-down UTC time and milliseconds of time point t (uses
+///        gmtime_r, hence thread-safe; see format_utc for a faster way to
+///        get a formatted string)
 std::tm strfdt_work(const std_time_point &t, long &fractional_seconds) noexcept;
 
 /*std_time_point timeval_to_timepoint(timeval tv) noexcept {
@@ -28,71 +33,71 @@ std::tm strfdt_work(const std_time_point &t, long &fractional_seconds) noexcept;
                                   microseconds{tv.tv_usec}};
 }*/
 
-template <DateTimeFormat F>
-char *strfdt(const std_time_point &t, char *buf) noexcept {
-  long fsec;
-  auto tm = strfdt_work(t, fsec);
-  if (std::strftime(buf, 64, "%F", &tm) > 0) {
-    return buf;
-  }
-  return nullptr;
+/// @brief Convert a count of days since 1970-01-01 to a (proleptic Gregorian)
+///        civil date; see H. Hinnant, "chrono-Compatible Low-Level Date
+///        Algorithms". Pure integer arithmetic, hence thread-safe.
+/// @param[in] z Days since 1970-01-01 (may be negative)
+/// @param[out] y Year
+/// @param[out] m Month in range [1, 12]
+/// @param[out] d Day of month in range [1, 31]
+constexpr void civil_from_days(long z, long &y, unsigned &m,
+                               unsigned &d) noexcept {
+  z += 719468;
+  const long era = (z >= 0 ? z : z - 146096) / 146097;
+  const unsigned doe = static_cast<unsigned>(z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = static_cast<long>(yoe) + era * 400 + (m <= 2);
 }
 
-template <>
-inline char *strfdt<DateTimeFormat::YMD>(const std_time_point &t,
-                                         char *buf) noexcept {
-  long fsec;
-  auto tm = strfdt_work(t, fsec);
-  if (std::strftime(buf, 64, "%F", &tm) > 0) {
-    return buf;
-  }
-  return nullptr;
+/// @brief Convert a (proleptic Gregorian) civil date to a count of days since
+///        1970-01-01; the inverse of civil_from_days
+/// @param[in] y Year
+/// @param[in] m Month in range [1, 12]
+/// @param[in] d Day of month in range [1, 31]
+constexpr long days_from_civil(long y, unsigned m, unsigned d) noexcept {
+  y -= m <= 2;
+  const long era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<long>(doe) - 719468;
 }
 
-template <>
-inline char *strfdt<DateTimeFormat::YMDHMS>(const std_time_point &t,
-                                            char *buf) noexcept {
-  long fsec;
-  auto tm = strfdt_work(t, fsec);
-  if (std::strftime(buf, 64, "%FT%T", &tm) > 0) {
-    return buf;
-  }
-  return nullptr;
-}
+/// @brief Parse a UTC date/time "YYYY-MM-DDTHH:MM:SS[.fffffffff][Z]" (a space
+///        is accepted in place of the 'T'; up to 9 fractional digits)
+/// @param[out] utc_ns Nanoseconds since the epoch
+/// @return 0 on success; anything else denotes an error (invalid string)
+int parse_utc(const char *str, int64_t &utc_ns) noexcept;
 
-template <>
-inline char *strfdt<DateTimeFormat::YMDHMfS>(const std_time_point &t,
-                                             char *buf) noexcept {
-  long fsec;
-  auto tm = strfdt_work(t, fsec);
-  if (int btw = std::strftime(buf, 64, "%FT%T.", &tm); btw > 0) {
-    sprintf(buf + btw, "%03ld", fsec);
-    return buf;
-  }
-  return nullptr;
-}
+/// @brief Format a (UTC) time point according to DateTimeFormat F, i.e.
+///        YMD: "YYYY-MM-DD", YMDHMS: "YYYY-MM-DDTHH:MM:SS",
+///        YMDHMfS: "YYYY-MM-DDTHH:MM:SS.sss", HMS: "HH:MM:SS" and
+///        HMfS: "HH:MM:SS.sss"
+/// The date/time part is cached (per thread) for the last second formatted,
+/// so that consecutive calls within the same second only copy the cached
+/// prefix and render the milliseconds. Thread-safe.
+/// @param[in] t The time point to format
+/// @param[in] f The format
+/// @param[out] buf A buffer of at least 24 chars; on return it holds the
+///            (null-terminated) formatted string
+/// @return Always buf
+char *format_utc(const std_time_point &t, DateTimeFormat f,
+                 char *buf) noexcept;
 
-template <>
-inline char *strfdt<DateTimeFormat::HMfS>(const std_time_point &t,
-                                          char *buf) noexcept {
-  long fsec;
-  auto tm = strfdt_work(t, fsec);
-  if (int btw = std::strftime(buf, 64, "%T.", &tm); btw > 0) {
-    sprintf(buf + btw, "%03ld", fsec);
-    return buf;
-  }
-  return nullptr;
-}
+/// @brief Format t (seconds since epoch) as local time "YYYY-MM-DD HH:MM:SS"
+///        (aka "%F %T"); cached per thread for the last second formatted.
+///        Thread-safe.
+/// @param[out] buf A buffer of at least 20 chars
+/// @return Always buf
+char *format_local(std::time_t t, char *buf) noexcept;
 
-template <>
-inline char *strfdt<DateTimeFormat::HMS>(const std_time_point &t,
-                                         char *buf) noexcept {
-  long fsec;
-  auto tm = strfdt_work(t, fsec);
-  if (std::strftime(buf, 64, "%T.", &tm) > 0) {
-    return buf;
-  }
-  return nullptr;
+template <DateTimeFormat F>
+char *strfdt(const std_time_point &t, char *buf) noexcept {
+  return format_utc(t, F, buf);
 }
 
 #endif
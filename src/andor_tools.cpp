@@ -1,19 +1,32 @@
+#include "acquisition_state.hpp"
 #include "andor2k.hpp"
+#include "andor_time_utils.hpp"
 #include "atmcdLXd.h"
 #include "cpp_socket.hpp"
+#include "sdk_owner.hpp"
+#include "telemetry.hpp"
+#include "temperature_controller.hpp"
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <ctime>
 
+extern TemperatureController g_temp_controller;
+extern std::atomic<CameraState> g_camera_state;
+extern AcquisitionState g_acq_state;
+extern TelemetrySampler g_telemetry;
+extern SdkOwner g_sdk;
+
 /// @brief Fill input buffer buf with current local datetime "%Y-%m-%d %H:%M:%S"
+/// Thread-safe, and cheap for repeated calls within the same second (see
+/// format_local).
 /// @param[in] The input buffer to store the datetime string; must be of size
 ///            >= 32.
 /// @return A c-string holding current local datetime; this is actually the
 ///         input string buf.
 const char *date_str(char *buf) noexcept {
-  std::time_t now = std::time(nullptr);
-  std::tm *now_loct = std::localtime(&now);
-  std::strftime(buf, 32, "%F %T", now_loct);
-  return buf;
+  return format_local(std::time(nullptr), buf);
 }
 
 int print_status(const andor2k::Socket &sock) noexcept {
@@ -22,20 +35,71 @@ int print_status(const andor2k::Socket &sock) noexcept {
   char sockbuf[MAX_SOCKET_BUFFER_SIZE];
   int cbytes;
 
-  // get and report status
+  // report the camera's lifecycle state (e.g. still initialising)
+  CameraState cstate = g_camera_state.load();
   printf("[DEBUG][%s] Status report for ANDOR2K:\n", date_str(buf));
-  printf("[DEBUG][%s] %s\n", buf, get_status_string(descr));
+  printf("[DEBUG][%s] Camera state: %s\n", buf, CameraState2str(cstate));
+  cbytes = sprintf(sockbuf, "state:%s;", CameraState2str(cstate));
+
+  // do not touch the SDK before (or while) the camera is initialized
+  if (cstate == CameraState::Cooling || cstate == CameraState::Ready) {
+    if (g_telemetry.running()) {
+      // report the latest sample; the SDK is not touched (it may be busy
+      // with an acquisition)
+      auto tel = g_telemetry.snapshot();
+      printf("[DEBUG][%s] %s\n", buf,
+             get_status_string(tel.driver_status, descr));
+      cbytes += sprintf(sockbuf + cbytes, "status:%s;", descr);
+      auto now = std::chrono::system_clock::now().time_since_epoch();
+      double age =
+          (std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() -
+           tel.temp_ns) /
+          1e9;
+      printf("[DEBUG][%s] Temp: %+.1fC: %s (cooler %s; read %.1f sec ago)\n",
+             buf, tel.temp, get_get_temperature_string(tel.temp_status, descr),
+             tel.cooler_on ? "on" : "off", tel.valid() ? age : -1.);
+      cbytes += sprintf(
+          sockbuf + cbytes, "temp:%+4d (%s);cooler:%d;tempage:%.1f;",
+          static_cast<int>(std::lround(tel.temp)), descr, tel.cooler_on,
+          tel.valid() ? age : -1.);
+    } else {
+      // get and report status (between frames of an acquisition in
+      // progress)
+      int dstatus, ctemp;
+      unsigned int error = g_sdk.call(
+          [&] {
+            GetStatus(&dstatus);
+            return GetTemperature(&ctemp);
+          },
+          SdkAccess::Query);
+      printf("[DEBUG][%s] %s\n", buf, get_status_string(dstatus, descr));
+      cbytes += sprintf(sockbuf + cbytes, "status:%s;", descr);
 
-  cbytes = sprintf(sockbuf, "status:%s;", descr);
+      // report temperature
+      date_str(buf);
+      printf("[DEBUG][%s] Temp: %+4dC: %s\n", buf, ctemp,
+             get_get_temperature_string(error, descr));
+      cbytes += sprintf(sockbuf + cbytes, "temp:%+4d (%s);", ctemp, descr);
+    }
+
+    // report temperature control
+    auto treading = g_temp_controller.reading();
+    printf("[DEBUG][%s] Temperature control: %s (target: %+4dC)\n", buf,
+           TempControlState2str(treading.state), treading.target);
+    cbytes += sprintf(sockbuf + cbytes, "target:%+4d;tstate:%s;",
+                      treading.target, TempControlState2str(treading.state));
+  } else {
+    cbytes += sprintf(sockbuf + cbytes, "status:Camera not initialized;");
+  }
 
-  // get and report temperature
-  unsigned int error;
-  int ctemp;
-  date_str(buf);
-  error = GetTemperature(&ctemp);
-  printf("[DEBUG][%s] Temp: %+4dC: %s\n", buf, ctemp,
-         get_get_temperature_string(error, descr));
-  cbytes += sprintf(sockbuf + cbytes, "temp:%+4d (%s);", ctemp, descr);
+  // report the current (or last) acquisition; this never blocks the thread
+  // performing the acquisition
+  auto acq = g_acq_state.snapshot();
+  printf("[DEBUG][%s] Acquisition: %s (image %d/%d)\n", buf,
+         AcquisitionPhase2str(acq.phase), acq.cur_image, acq.num_images);
+  cbytes += sprintf(sockbuf + cbytes, "acq:%s;acqimage:%d/%d;acqdone:%d;",
+                    AcquisitionPhase2str(acq.phase), acq.cur_image,
+                    acq.num_images, acq.images_done);
 
   // report end of status
   printf("[DEBUG][%s] End of status report for ANDOR2K:\n", date_str(buf));
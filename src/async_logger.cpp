@@ -0,0 +1,242 @@
+#include "async_logger.hpp"
+#include "andor_time_utils.hpp"
+#include "thread_setup.hpp"
+#include <cctype>
+
+extern ThreadSetup g_thread_setup;
+
+static_assert((LOG_RING_SLOTS & (LOG_RING_SLOTS - 1)) == 0,
+              "LOG_RING_SLOTS must be a power of 2");
+
+const char *LogLevel2str(LogLevel l) noexcept {
+  switch (l) {
+  case LogLevel::Debug:
+    return "DEBUG";
+  case LogLevel::Warning:
+    return "WRNNG";
+  case LogLevel::Error:
+    return "ERROR";
+  case LogLevel::Fatal:
+    return "FATAL";
+  }
+  return "UNKWN";
+}
+
+int str2LogLevel(const char *str, LogLevel &l) noexcept {
+  if (!std::strncmp(str, "debug", 5))
+    l = LogLevel::Debug;
+  else if (!std::strncmp(str, "warning", 7))
+    l = LogLevel::Warning;
+  else if (!std::strncmp(str, "error", 5))
+    l = LogLevel::Error;
+  else if (!std::strncmp(str, "fatal", 5))
+    l = LogLevel::Fatal;
+  else
+    return 1;
+  return 0;
+}
+
+/// Format a single printf conversion spec (as found in the format string,
+/// e.g. "%-8.3lf") for argument nr. Length modifiers in the spec are dropped
+/// and replaced by ones matching the recorded type of the argument.
+static int format_arg(char *buf, int buf_sz, const char *spec, int spec_len,
+                      const LogRecord &rec, int nr) noexcept {
+  char conv = spec[spec_len - 1];
+  char nspec[32];
+  int n = 0;
+  for (int i = 0; i < spec_len - 1 && n < 24; i++)
+    if (!std::strchr("hljztL", spec[i]))
+      nspec[n++] = spec[i];
+
+  if (nr >= rec.nargs)
+    return std::snprintf(buf, buf_sz, "<missing>");
+
+  const LogRecord::Arg &arg = rec.args[nr];
+  switch (rec.types[nr]) {
+  case LogRecord::Int:
+  case LogRecord::UInt:
+    if (conv == 'c') {
+      nspec[n++] = 'c';
+      nspec[n] = '\0';
+      return std::snprintf(buf, buf_sz, nspec, static_cast<int>(arg.i));
+    } else if (std::strchr("fFeEgGaA", conv)) {
+      nspec[n++] = conv;
+      nspec[n] = '\0';
+      return std::snprintf(buf, buf_sz, nspec,
+                           rec.types[nr] == LogRecord::Int
+                               ? static_cast<double>(arg.i)
+                               : static_cast<double>(arg.u));
+    }
+    nspec[n++] = 'l';
+    nspec[n++] = 'l';
+    nspec[n++] = std::strchr("diuxXo", conv) ? conv : 'd';
+    nspec[n] = '\0';
+    return rec.types[nr] == LogRecord::Int
+               ? std::snprintf(buf, buf_sz, nspec, arg.i)
+               : std::snprintf(buf, buf_sz, nspec, arg.u);
+  case LogRecord::Double:
+    nspec[n++] = std::strchr("fFeEgGaA", conv) ? conv : 'g';
+    nspec[n] = '\0';
+    return std::snprintf(buf, buf_sz, nspec, arg.d);
+  case LogRecord::Str:
+    nspec[n++] = 's';
+    nspec[n] = '\0';
+    return std::snprintf(buf, buf_sz, nspec, rec.strings + arg.str);
+  case LogRecord::Ptr:
+    nspec[n++] = 'p';
+    nspec[n] = '\0';
+    return std::snprintf(buf, buf_sz, nspec, arg.p);
+  }
+  return 0;
+}
+
+int LogRecord::format(char *buf, int buf_sz) const noexcept {
+  // prefix: "[LEVEL][YYYY-MM-DD HH:MM:SS] "
+  char tbuf[32];
+  format_local(static_cast<std::time_t>(time_ns / 1000000000LL), tbuf);
+  int len = std::snprintf(buf, buf_sz, "[%s][%s] ", LogLevel2str(level), tbuf);
+
+  // walk the format string; copy plain text, format conversions one by one
+  int nr = 0;
+  const char *c = fmt;
+  while (*c && len < buf_sz - 2) {
+    if (*c != '%') {
+      buf[len++] = *c++;
+      continue;
+    }
+    if (c[1] == '%') {
+      buf[len++] = '%';
+      c += 2;
+      continue;
+    }
+    // find the conversion char
+    const char *e = c + 1;
+    while (*e && !std::isalpha(static_cast<unsigned char>(*e)))
+      ++e;
+    while (*e && std::strchr("hljztL", *e))
+      ++e;
+    if (!*e)
+      break;
+    int w = format_arg(buf + len, buf_sz - 1 - len, c, e - c + 1, *this, nr++);
+    if (w > 0)
+      len += std::min(w, buf_sz - 2 - len);
+    c = e + 1;
+  }
+  buf[len++] = '\n';
+  buf[len] = '\0';
+  return len;
+}
+
+AsyncLogger::AsyncLogger() noexcept
+    : m_slots(new (std::nothrow) Slot[LOG_RING_SLOTS]) {
+  if (m_slots)
+    for (uint64_t i = 0; i < static_cast<uint64_t>(LOG_RING_SLOTS); i++)
+      m_slots[i].seq.store(i, std::memory_order_relaxed);
+}
+
+int AsyncLogger::start(FILE *out, FILE *err) noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  if (!m_slots || m_worker.joinable())
+    return 1;
+  m_stop = false;
+  m_out = out;
+  m_err = err;
+  try {
+    m_worker = std::thread(&AsyncLogger::work, this);
+  } catch (std::exception &) {
+    return 1;
+  }
+  m_running.store(true, std::memory_order_release);
+  return 0;
+}
+
+void AsyncLogger::stop() noexcept {
+  // from now on, callers write their own messages; the logger thread writes
+  // whatever is left in the ring before exiting
+  m_running.store(false, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  if (m_worker.joinable()) {
+    if (m_worker.get_id() == std::this_thread::get_id())
+      m_worker.detach();
+    else
+      m_worker.join();
+  }
+}
+
+/// Claim the next free slot (multi-producer); returns nullptr if the ring is
+/// full
+LogRecord *AsyncLogger::acquire(uint64_t &pos) noexcept {
+  constexpr uint64_t mask = LOG_RING_SLOTS - 1;
+  pos = m_enqueue.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot &slot = m_slots[pos & mask];
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+    if (diff == 0) {
+      if (m_enqueue.compare_exchange_weak(pos, pos + 1,
+                                          std::memory_order_relaxed))
+        return &slot.rec;
+    } else if (diff < 0) {
+      return nullptr; // the consumer has not freed this slot yet
+    } else {
+      pos = m_enqueue.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void AsyncLogger::commit(uint64_t pos) noexcept {
+  m_slots[pos & (LOG_RING_SLOTS - 1)].seq.store(pos + 1,
+                                                std::memory_order_release);
+  // only wake the logger thread if it is actually asleep
+  if (m_sleeping.load(std::memory_order_relaxed))
+    m_cv.notify_one();
+}
+
+void AsyncLogger::write(const LogRecord &rec) noexcept {
+  char line[1024];
+  int len = rec.format(line, sizeof(line));
+  std::fwrite(line, 1, len, rec.level == LogLevel::Debug ? m_out : m_err);
+}
+
+/// Write all messages available in the ring; returns the number written
+int AsyncLogger::drain() noexcept {
+  constexpr uint64_t mask = LOG_RING_SLOTS - 1;
+  int count = 0;
+  for (;;) {
+    Slot &slot = m_slots[m_dequeue & mask];
+    if (slot.seq.load(std::memory_order_acquire) != m_dequeue + 1)
+      break;
+    write(slot.rec);
+    slot.seq.store(m_dequeue + LOG_RING_SLOTS, std::memory_order_release);
+    ++m_dequeue;
+    ++count;
+  }
+  if (count) {
+    std::fflush(m_out);
+    std::fflush(m_err);
+  }
+  return count;
+}
+
+void AsyncLogger::work() noexcept {
+  g_thread_setup.setup_this_thread("andor-logger", ThreadRole::Writer);
+  std::unique_lock<std::mutex> lock(m_mtx);
+  while (!m_stop) {
+    lock.unlock();
+    int count = drain();
+    lock.lock();
+    if (!count && !m_stop) {
+      // producers do not take the mutex, so a notification may be missed;
+      // hence the (short) timeout
+      m_sleeping.store(true, std::memory_order_relaxed);
+      m_cv.wait_for(lock, std::chrono::milliseconds(20));
+      m_sleeping.store(false, std::memory_order_relaxed);
+    }
+  }
+  lock.unlock();
+  drain();
+}
@@ -0,0 +1,219 @@
+#ifndef __ANDOR2K_ASYNC_LOGGER_HPP__
+#define __ANDOR2K_ASYNC_LOGGER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+/// @brief Severity of a log message; messages below the logger's level are
+///        discarded (see AsyncLogger::set_level)
+enum class LogLevel : int_fast8_t { Debug, Warning, Error, Fatal };
+
+/// @brief The tag printed for each level, e.g. "DEBUG" or "WRNNG"
+const char *LogLevel2str(LogLevel l) noexcept;
+
+/// @brief Resolve a level from its name, e.g. "debug", "warning", ...
+/// @return 0 on success; 1 if the name is not a valid level
+int str2LogLevel(const char *str, LogLevel &l) noexcept;
+
+/// @brief Max number of arguments of a log message
+constexpr int LOG_MAX_ARGS = 10;
+
+/// @brief Space for (a copy of) all string arguments of a log message; longer
+///        strings are truncated
+constexpr int LOG_STR_ARENA = 192;
+
+/// @brief Number of slots in the logger's ring (must be a power of 2)
+constexpr int LOG_RING_SLOTS = 4096;
+
+/// @brief A log message, as recorded by the producer: the format string
+///        (which must be a string literal; it serves as the format id) plus
+///        the arguments in binary form. Formatting happens later, on the
+///        logger thread.
+struct LogRecord {
+  enum ArgType : uint8_t { Int, UInt, Double, Str, Ptr };
+  union Arg {
+    long long i;
+    unsigned long long u;
+    double d;
+    const void *p;
+    uint16_t str; ///< offset of string in strings
+  };
+  int64_t time_ns;   ///< time of the call, nanoseconds since epoch
+  const char *fmt;   ///< printf-like format, without trailing newline
+  LogLevel level;
+  uint8_t nargs;
+  uint16_t str_len;  ///< bytes used in strings
+  uint8_t types[LOG_MAX_ARGS];
+  Arg args[LOG_MAX_ARGS];
+  char strings[LOG_STR_ARENA];
+
+  template <typename T> void add(const T &arg) noexcept;
+
+  /// @brief Format the record as a log line, e.g.
+  ///        "[DEBUG][2022-03-14 21:07:11] Image written in FITS file ...\n"
+  /// @return Number of chars written to buf (excluding the null terminator)
+  int format(char *buf, int buf_sz) const noexcept;
+}; // LogRecord
+
+/// @brief An asynchronous logger.
+/// Producers (e.g. the thread acquiring frames) record a format string and
+/// the binary arguments in a bounded, lock-free (multi-producer,
+/// single-consumer) ring; a background thread formats the messages and writes
+/// them to stdout (Debug) or stderr (all other levels). Producers never block
+/// and never perform I/O: if the ring is full the message is dropped and
+/// counted (see dropped).
+/// If the logger thread is not running (e.g. in programs other than the
+/// daemon), messages are formatted and written by the caller.
+class AsyncLogger {
+public:
+  AsyncLogger() noexcept;
+  AsyncLogger(const AsyncLogger &) = delete;
+  AsyncLogger &operator=(const AsyncLogger &) = delete;
+  ~AsyncLogger() noexcept { stop(); }
+
+  /// @brief Start the logger thread
+  /// @param[in] out Where Debug messages are written
+  /// @param[in] err Where all other messages are written
+  /// @return 0 on success; anything else denotes an error
+  int start(FILE *out = stdout, FILE *err = stderr) noexcept;
+
+  /// @brief Write all pending messages and stop the logger thread
+  void stop() noexcept;
+
+  void set_level(LogLevel l) noexcept {
+    m_level.store(l, std::memory_order_relaxed);
+  }
+  LogLevel level() const noexcept {
+    return m_level.load(std::memory_order_relaxed);
+  }
+
+  /// @brief Number of messages dropped because the ring was full
+  uint64_t dropped() const noexcept {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+
+  /// @brief Log a message; fmt must be a string literal (it is not copied)
+  ///        with printf-like conversions (length modifiers are ignored, the
+  ///        arguments' types are recorded instead)
+  template <typename... Args>
+  void log(LogLevel l, const char *fmt, const Args &...args) noexcept {
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many log arguments");
+    if (l < level())
+      return;
+    if (!m_running.load(std::memory_order_acquire)) {
+      LogRecord rec;
+      fill(rec, l, fmt, args...);
+      write(rec);
+      return;
+    }
+    uint64_t pos;
+    LogRecord *rec = acquire(pos);
+    if (!rec) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    fill(*rec, l, fmt, args...);
+    commit(pos);
+  }
+
+  template <typename... Args>
+  void debug(const char *fmt, const Args &...args) noexcept {
+    log(LogLevel::Debug, fmt, args...);
+  }
+  template <typename... Args>
+  void warning(const char *fmt, const Args &...args) noexcept {
+    log(LogLevel::Warning, fmt, args...);
+  }
+  template <typename... Args>
+  void error(const char *fmt, const Args &...args) noexcept {
+    log(LogLevel::Error, fmt, args...);
+  }
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> seq;
+    LogRecord rec;
+  };
+  std::unique_ptr<Slot[]> m_slots;
+  alignas(64) std::atomic<uint64_t> m_enqueue{0};
+  alignas(64) uint64_t m_dequeue{0}; ///< only touched by the logger thread
+  std::atomic<uint64_t> m_dropped{0};
+  std::atomic<LogLevel> m_level{LogLevel::Debug};
+  std::atomic<bool> m_running{false};
+  std::atomic<bool> m_sleeping{false};
+  bool m_stop = false;
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::thread m_worker;
+  FILE *m_out = stdout;
+  FILE *m_err = stderr;
+
+  template <typename... Args>
+  static void fill(LogRecord &rec, LogLevel l, const char *fmt,
+                   const Args &...args) noexcept {
+    rec.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+    rec.fmt = fmt;
+    rec.level = l;
+    rec.nargs = 0;
+    rec.str_len = 0;
+    (rec.add(args), ...);
+  }
+
+  LogRecord *acquire(uint64_t &pos) noexcept;
+  void commit(uint64_t pos) noexcept;
+  int drain() noexcept;
+  void write(const LogRecord &rec) noexcept;
+  void work() noexcept;
+}; // AsyncLogger
+
+template <typename T> void LogRecord::add(const T &arg) noexcept {
+  using U = std::decay_t<T>;
+  if constexpr (std::is_same_v<U, char *> || std::is_same_v<U, const char *>) {
+    // copy the string; it may well be gone by the time we format it
+    const char *str = arg; // (arrays decay here)
+    int avail = LOG_STR_ARENA - str_len;
+    int len = 0;
+    if (str && avail > 0) {
+      len = static_cast<int>(strnlen(str, avail - 1));
+      std::memcpy(strings + str_len, str, len);
+    }
+    types[nargs] = Str;
+    args[nargs].str = str_len;
+    if (avail > 0) {
+      strings[str_len + len] = '\0';
+      str_len += len + 1;
+    } else {
+      // arena full; point to the terminator of the last string
+      args[nargs].str = LOG_STR_ARENA - 1;
+    }
+  } else if constexpr (std::is_floating_point_v<U>) {
+    types[nargs] = Double;
+    args[nargs].d = static_cast<double>(arg);
+  } else if constexpr (std::is_enum_v<U>) {
+    types[nargs] = Int;
+    args[nargs].i = static_cast<long long>(arg);
+  } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+    types[nargs] = Int;
+    args[nargs].i = arg;
+  } else if constexpr (std::is_integral_v<U>) {
+    types[nargs] = UInt;
+    args[nargs].u = arg;
+  } else {
+    static_assert(std::is_pointer_v<U>, "Unsupported log argument type");
+    types[nargs] = Ptr;
+    args[nargs].p = static_cast<const void *>(arg);
+  }
+  ++nargs;
+}
+
+#endif
@@ -0,0 +1,211 @@
+#include "clock_monitor.hpp"
+#include "andor2k.hpp"
+#include "thread_setup.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern ThreadSetup g_thread_setup;
+
+namespace {
+/// Weight of a new offset measurement, and of the residual on the drift
+constexpr double CLOCK_OFFSET_GAIN = 0.5;
+constexpr double CLOCK_DRIFT_GAIN = 0.1;
+/// Drift of any sane clock is within ±500 ppm (as for NTP)
+constexpr double CLOCK_MAX_DRIFT_PPM = 500;
+/// Time to wait for a reply
+constexpr int CLOCK_QUERY_TIMEOUT_MS = 1000;
+
+double seconds(std::chrono::steady_clock::duration d) noexcept {
+  return std::chrono::duration<double>(d).count();
+}
+} // namespace
+
+int ClockMonitor::start(const char *servers,
+                        std::chrono::milliseconds poll_interval,
+                        std::chrono::milliseconds publish_interval) noexcept {
+  char buf[32];
+  std::lock_guard<std::mutex> lock(m_mtx);
+  if (m_worker.joinable() || m_stop || !servers)
+    return 1;
+
+  // split the list; names are resolved by the worker
+  m_servers.clear();
+  for (const char *s = servers; *s;) {
+    std::size_t len = std::strcspn(s, ", ");
+    if (len && len < sizeof(Server::name)) {
+      Server server;
+      std::memcpy(server.name, s, len);
+      server.name[len] = '\0';
+      m_servers.push_back(server);
+    }
+    s += len;
+    s += std::strspn(s, ", ");
+  }
+  if (m_servers.empty())
+    return 1;
+
+  m_poll_interval = poll_interval;
+  m_publish_interval = publish_interval;
+  try {
+    m_worker = std::thread(&ClockMonitor::work, this);
+  } catch (std::exception &) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to start clock monitor (traceback: %s)\n",
+            date_str(buf), __func__);
+    return 1;
+  }
+  return 0;
+}
+
+void ClockMonitor::stop() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  if (m_worker.joinable())
+    m_worker.join();
+}
+
+ClockMonitor::Estimate ClockMonitor::estimate() const noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_estimate;
+}
+
+void ClockMonitor::work() noexcept {
+  g_thread_setup.setup_this_thread("andor-clock", ThreadRole::Service);
+  using Clock = std::chrono::steady_clock;
+  auto next_poll = Clock::now();
+  std::unique_lock<std::mutex> lock(m_mtx);
+  while (!m_stop) {
+    if (Clock::now() >= next_poll) {
+      // the servers are only touched by this thread
+      lock.unlock();
+      poll();
+      lock.lock();
+      next_poll = Clock::now() + m_poll_interval;
+    }
+    publish();
+    auto wake = std::min(next_poll, Clock::now() + m_publish_interval);
+    m_cv.wait_until(lock, wake, [this] { return m_stop; });
+  }
+}
+
+/// Query every server once; keep, per server, the sample with the smallest
+/// delay out of the last CLOCK_FILTER_SAMPLES, and use the best of these to
+/// update the estimates (if it has not been used already). The filter lags
+/// behind a step of the clock, so steps are detected on the samples of this
+/// poll instead.
+void ClockMonitor::poll() noexcept {
+  char buf[32];
+  Sample best, latest;
+  int reached = 0;
+  for (auto &server : m_servers) {
+    if (!server.resolved) {
+      server.resolved = !ntp_resolve(server.name, server.addr);
+      if (!server.resolved)
+        continue;
+    }
+    Sample sample;
+    if (ntp_query(server.addr, sample.ntp, CLOCK_QUERY_TIMEOUT_MS) ||
+        sample.ntp.delay_ns < 0)
+      continue;
+    sample.when = std::chrono::steady_clock::now();
+    server.samples[server.next] = sample;
+    server.next = (server.next + 1) % CLOCK_FILTER_SAMPLES;
+    server.num_samples = std::min(server.num_samples + 1, CLOCK_FILTER_SAMPLES);
+
+    const Sample *filtered = std::min_element(
+        server.samples, server.samples + server.num_samples,
+        [](const Sample &a, const Sample &b) {
+          return a.ntp.delay_ns < b.ntp.delay_ns;
+        });
+    if (!reached || filtered->ntp.delay_ns < best.ntp.delay_ns)
+      best = *filtered;
+    if (!reached || sample.ntp.delay_ns < latest.ntp.delay_ns)
+      latest = sample;
+    ++reached;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtx);
+  bool was_reached = m_estimate.servers_reached > 0;
+  m_estimate.servers_reached = reached;
+  if (!reached) {
+    // log once, when losing all servers
+    if (was_reached)
+      fprintf(stderr,
+              "[WRNNG][%s] No NTP server reachable; keeping the last clock "
+              "correction (traceback: %s)\n",
+              date_str(buf), __func__);
+    return;
+  }
+  ++m_estimate.polls;
+  // a step, unless the delay (bounding the error) can explain the residual
+  if (m_have_estimate && latest.ntp.delay_ns < CLOCK_STEP_NS &&
+      std::abs(latest.ntp.offset_ns - predict(latest.when)) > CLOCK_STEP_NS)
+    update(latest);
+  else if (!m_have_estimate || best.when > m_estimate_time)
+    update(best);
+}
+
+/// Must be called with m_mtx locked
+double ClockMonitor::predict(
+    std::chrono::steady_clock::time_point t) const noexcept {
+  return m_estimate.offset_ns +
+         m_estimate.drift_ppm * 1e3 * seconds(t - m_estimate_time);
+}
+
+/// Must be called with m_mtx locked. An alpha-beta filter: the offset is
+/// predicted with the drift, and the residual of the measurement corrects
+/// both.
+void ClockMonitor::update(const Sample &sample) noexcept {
+  char buf[32];
+  int64_t measured = sample.ntp.offset_ns;
+  m_estimate.delay_ns = sample.ntp.delay_ns;
+
+  if (!m_have_estimate) {
+    m_estimate.offset_ns = measured;
+    m_estimate.drift_ppm = 0;
+    m_estimate_time = sample.when;
+    m_have_estimate = true;
+    return;
+  }
+
+  double dt = seconds(sample.when - m_estimate_time);
+  double predicted = predict(sample.when);
+  double residual = measured - predicted;
+  if (std::abs(residual) > CLOCK_STEP_NS) {
+    // the system clock (or the server) stepped; start over, discarding the
+    // samples taken before the step
+    fprintf(stderr,
+            "[WRNNG][%s] Clock offset stepped by %+.3f sec (traceback: %s)\n",
+            date_str(buf), residual / 1e9, __func__);
+    ++m_estimate.steps;
+    m_estimate.offset_ns = measured;
+    m_estimate.drift_ppm = 0;
+    for (auto &server : m_servers) {
+      server.num_samples = 0;
+      server.next = 0;
+    }
+  } else {
+    m_estimate.offset_ns =
+        static_cast<int64_t>(predicted + CLOCK_OFFSET_GAIN * residual);
+    if (dt > 0)
+      m_estimate.drift_ppm = std::clamp(
+          m_estimate.drift_ppm + CLOCK_DRIFT_GAIN * residual / dt / 1e3,
+          -CLOCK_MAX_DRIFT_PPM, CLOCK_MAX_DRIFT_PPM);
+  }
+  m_estimate_time = sample.when;
+}
+
+/// Must be called with m_mtx locked
+void ClockMonitor::publish() noexcept {
+  if (!m_have_estimate)
+    return;
+  m_correction_ns.store(
+      static_cast<int64_t>(predict(std::chrono::steady_clock::now())),
+      std::memory_order_relaxed);
+}
@@ -0,0 +1,172 @@
+#ifndef __ANDOR2K_CLOCK_MONITOR_HPP__
+#define __ANDOR2K_CLOCK_MONITOR_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <netinet/in.h>
+#include <thread>
+#include <vector>
+
+/// @brief Default NTP servers sampled by the daemon; a comma-separated list
+///        of [host][:port], overridden by the ANDOR2KD_NTP_SERVERS environment
+///        variable ("none" disables monitoring)
+constexpr char DEFAULT_NTP_SERVERS[] = "0.pool.ntp.org,1.pool.ntp.org";
+
+/// @brief Port of NTP servers
+constexpr int NTP_PORT = 123;
+
+/// @brief Seconds from the NTP epoch (1900) to the Unix epoch (1970)
+constexpr uint64_t NTP_TIMESTAMP_DELTA = 2208988800ull;
+
+/// @brief Convert the fractional part of an NTP timestamp (units of 2^-32
+///        sec) to nanoseconds
+constexpr int64_t ntp_fraction_to_ns(uint32_t fraction) noexcept {
+  return static_cast<int64_t>(
+      (static_cast<uint64_t>(fraction) * 1000000000ull) >> 32);
+}
+
+/// @brief Convert nanoseconds (less than 1 sec) to the fractional part of an
+///        NTP timestamp
+constexpr uint32_t ns_to_ntp_fraction(int64_t ns) noexcept {
+  return static_cast<uint32_t>((static_cast<uint64_t>(ns) << 32) /
+                               1000000000ull);
+}
+
+/// @brief Convert an NTP timestamp (seconds and fraction since 1900) to
+///        nanoseconds since the Unix epoch
+constexpr int64_t ntp_to_unix_ns(uint32_t seconds, uint32_t fraction) noexcept {
+  return (static_cast<int64_t>(seconds) -
+          static_cast<int64_t>(NTP_TIMESTAMP_DELTA)) *
+             1000000000ll +
+         ntp_fraction_to_ns(fraction);
+}
+
+/// @brief Convert nanoseconds since the Unix epoch to an NTP timestamp
+constexpr void unix_ns_to_ntp(int64_t ns, uint32_t &seconds,
+                              uint32_t &fraction) noexcept {
+  seconds = static_cast<uint32_t>(ns / 1000000000ll + NTP_TIMESTAMP_DELTA);
+  fraction = ns_to_ntp_fraction(ns % 1000000000ll);
+}
+
+/// @brief Result of one client/server exchange; offset is server time minus
+///        local (system) time, delay the round trip less the server's
+///        processing time
+struct NtpSample {
+  int64_t offset_ns{0};
+  int64_t delay_ns{0};
+}; // NtpSample
+
+/// @brief Resolve [host][:port] (port defaults to NTP_PORT) to an IPv4
+///        address; this may block (DNS), so keep it off acquisition paths
+/// @return 0 on success; anything else denotes an error
+int ntp_resolve(const char *server, sockaddr_in &addr) noexcept;
+
+/// @brief One (SNTP) exchange with a server
+/// @param[in] timeout_ms Time to wait for the reply
+/// @return 0 on success; anything else denotes an error (no or invalid reply)
+int ntp_query(const sockaddr_in &addr, NtpSample &sample,
+              int timeout_ms = 1000) noexcept;
+
+/// @brief Background clock-offset monitor.
+/// A dedicated thread periodically queries one or more NTP servers. Per
+/// server, the sample with the smallest round-trip delay out of the last
+/// CLOCK_FILTER_SAMPLES is kept (samples delayed by network queues have the
+/// largest errors); the server with the smallest such delay is then used to
+/// update a smoothed offset and a drift (frequency) estimate. Large jumps of
+/// the offset are taken as a step of the system clock and reset the
+/// estimates.
+/// Between polls the thread keeps publishing the offset extrapolated with
+/// the drift, so that reading the correction is a single atomic load and
+/// never touches the network (see correction_ns).
+class ClockMonitor {
+public:
+  /// @brief Samples kept per server, for round-trip delay filtering
+  static constexpr int CLOCK_FILTER_SAMPLES = 8;
+  /// @brief Offset changes larger than this are a step, not drift
+  static constexpr int64_t CLOCK_STEP_NS = 128000000;
+
+  ClockMonitor() noexcept = default;
+  ClockMonitor(const ClockMonitor &) = delete;
+  ClockMonitor &operator=(const ClockMonitor &) = delete;
+  ~ClockMonitor() noexcept { stop(); }
+
+  /// @brief Start monitoring
+  /// @param[in] servers Comma-separated list of [host][:port]
+  /// @param[in] poll_interval Interval between queries of the servers
+  /// @param[in] publish_interval Interval between updates of the published
+  ///            (extrapolated) correction
+  /// @return 0 on success; anything else denotes an error (e.g. an empty
+  ///         list of servers); servers that fail to resolve are retried at
+  ///         every poll
+  int start(const char *servers,
+            std::chrono::milliseconds poll_interval = std::chrono::seconds(64),
+            std::chrono::milliseconds publish_interval =
+                std::chrono::seconds(1)) noexcept;
+
+  /// @brief Stop the monitor thread; the last correction remains available
+  void stop() noexcept;
+
+  /// @brief Correction to add to the system clock, in nanoseconds; 0 until
+  ///        the first successful exchange. Lock-free and thread-safe.
+  int64_t correction_ns() const noexcept {
+    int64_t c = m_correction_ns.load(std::memory_order_relaxed);
+    return c == NO_CORRECTION ? 0 : c;
+  }
+
+  /// @brief Whether at least one server has been reached
+  bool synchronized() const noexcept {
+    return m_correction_ns.load(std::memory_order_relaxed) != NO_CORRECTION;
+  }
+
+  /// @brief Snapshot of the estimates
+  struct Estimate {
+    int64_t offset_ns{0};    ///< smoothed offset, at the last poll
+    double drift_ppm{0};     ///< drift of the system clock (ppm)
+    int64_t delay_ns{0};     ///< round trip of the sample used
+    uint64_t polls{0};       ///< polls with at least one reply
+    uint64_t steps{0};       ///< steps of the clock detected
+    int servers_reached{0};  ///< servers that replied at the last poll
+  }; // Estimate
+  Estimate estimate() const noexcept;
+
+private:
+  static constexpr int64_t NO_CORRECTION =
+      std::numeric_limits<int64_t>::min();
+
+  struct Sample {
+    NtpSample ntp;
+    std::chrono::steady_clock::time_point when;
+  }; // Sample
+
+  struct Server {
+    char name[128];
+    sockaddr_in addr;
+    bool resolved{false};
+    Sample samples[CLOCK_FILTER_SAMPLES];
+    int num_samples{0};
+    int next{0};
+  }; // Server
+
+  mutable std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::thread m_worker;
+  std::vector<Server> m_servers;
+  std::chrono::milliseconds m_poll_interval{0}, m_publish_interval{0};
+  std::atomic<int64_t> m_correction_ns{NO_CORRECTION};
+  Estimate m_estimate;
+  std::chrono::steady_clock::time_point m_estimate_time;
+  bool m_have_estimate = false;
+  bool m_stop = false;
+
+  void work() noexcept;
+  void poll() noexcept;
+  double predict(std::chrono::steady_clock::time_point t) const noexcept;
+  void update(const Sample &sample) noexcept;
+  void publish() noexcept;
+}; // ClockMonitor
+
+#endif
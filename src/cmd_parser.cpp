@@ -10,7 +10,7 @@ int resolve_cmd_parameters(int argc, char *argv[],
   while (i < argc) {
 
     /* BINNING ACCUMULATION (AKA IMAGES) -------------------------------------*/
-    if (!std::strncmp(argv[i], "--nimages", 9)) {
+    if (!std::strcmp(argv[i], "--nimages")) {
       if (argc <= i + 1) {
         fprintf(stderr,
                 "[ERROR] Must provide a numeric argument to \"--nimages\"\n");
@@ -33,7 +33,7 @@ int resolve_cmd_parameters(int argc, char *argv[],
 
       /* BINNING OPTIONS
        * -------------------------------------------------------*/
-    } else if (!std::strncmp(argv[i], "--bin", 5)) {
+    } else if (!std::strcmp(argv[i], "--bin")) {
       if (argc <= i + 1) {
         fprintf(stderr,
                 "[ERROR] Must provide a numeric argument to \"--bin\"\n");
@@ -49,7 +49,7 @@ int resolve_cmd_parameters(int argc, char *argv[],
         return 1;
       }
       i += 2;
-    } else if (!std::strncmp(argv[i], "--hbin", 6)) {
+    } else if (!std::strcmp(argv[i], "--hbin")) {
       if (argc <= i + 1) {
         fprintf(stderr,
                 "[ERROR] Must provide a numeric argument to \"--hbin\"\n");
@@ -64,7 +64,7 @@ int resolve_cmd_parameters(int argc, char *argv[],
         return 1;
       }
       i += 2;
-    } else if (!std::strncmp(argv[i], "--vbin", 6)) {
+    } else if (!std::strcmp(argv[i], "--vbin")) {
       if (argc <= i + 1) {
         fprintf(stderr,
                 "[ERROR] Must provide a numeric argument to \"--vbin\"\n");
@@ -82,7 +82,7 @@ int resolve_cmd_parameters(int argc, char *argv[],
 
       /* IMAGE DIMENSIONS OPTIONS
        * ----------------------------------------------*/
-    } else if (!std::strncmp(argv[i], "--hstart", 8)) {
+    } else if (!std::strcmp(argv[i], "--hstart")) {
       if (argc <= i + 1) {
         fprintf(stderr,
                 "[ERROR] Must provide a numeric argument to \"--hstart\"\n");
@@ -97,7 +97,7 @@ int resolve_cmd_parameters(int argc, char *argv[],
         return 1;
       }
       i += 2;
-    } else if (!std::strncmp(argv[i], "--hend", 6)) {
+    } else if (!std::strcmp(argv[i], "--hend")) {
       if (argc <= i + 1) {
         fprintf(stderr,
                 "[ERROR] Must provide a numeric argument to \"--hend\"\n");
@@ -112,7 +112,7 @@ int resolve_cmd_parameters(int argc, char *argv[],
         return 1;
       }
       i += 2;
-    } else if (!std::strncmp(argv[i], "--vstart", 8)) {
+    } else if (!std::strcmp(argv[i], "--vstart")) {
       if (argc <= i + 1) {
         fprintf(stderr,
                 "[ERROR] Must provide a numeric argument to \"--vstart\"\n");
@@ -127,7 +127,7 @@ int resolve_cmd_parameters(int argc, char *argv[],
         return 1;
       }
       i += 2;
-    } else if (!std::strncmp(argv[i], "--vend", 6)) {
+    } else if (!std::strcmp(argv[i], "--vend")) {
       if (argc <= i + 1) {
         fprintf(stderr,
                 "[ERROR] Must provide a numeric argument to \"--vend\"\n");
@@ -145,7 +145,7 @@ int resolve_cmd_parameters(int argc, char *argv[],
 
       /* IMAGE FILENAME
        * --------------------------------------------------------*/
-    } else if (!std::strncmp(argv[i], "--filename", 10)) {
+    } else if (!std::strcmp(argv[i], "--filename")) {
       if (argc <= i + 1) {
         fprintf(stderr,
                 "[ERROR] Must provide a string argument to \"--filename\"\n");
@@ -159,7 +159,7 @@ int resolve_cmd_parameters(int argc, char *argv[],
                   std::strlen(argv[i + 1]));
       i += 2;
 
-    } else if (!std::strncmp(argv[i], "--type", 6)) {
+    } else if (!std::strcmp(argv[i], "--type")) {
       if (argc <= i + 1) {
         fprintf(stderr,
                 "[ERROR] Must provide a string argument to \"--type\"\n");
@@ -171,7 +171,7 @@ int resolve_cmd_parameters(int argc, char *argv[],
       }
       std::memcpy(params.type_, argv[i + 1], std::strlen(argv[i + 1]));
       i += 2;
-    } else if (!std::strncmp(argv[i], "--exposure", 10)) {
+    } else if (!std::strcmp(argv[i], "--exposure")) {
       if (argc <= i + 1) {
         fprintf(stderr,
                 "[ERROR] Must provide a float argument to \"--exposure\"\n");
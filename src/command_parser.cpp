@@ -0,0 +1,143 @@
+#include "command_parser.hpp"
+#include "andor2k.hpp"
+#include "andor_time_utils.hpp"
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+
+const char *ParseError2str(ParseError e) noexcept {
+  switch (e) {
+  case ParseError::None:
+    return "none";
+  case ParseError::WrongCommand:
+    return "wrong command";
+  case ParseError::MissingValue:
+    return "missing value";
+  case ParseError::NotANumber:
+    return "not a number";
+  case ParseError::OutOfRange:
+    return "out of range";
+  case ParseError::TooLong:
+    return "too long";
+  case ParseError::InvalidTime:
+    return "invalid time";
+  case ParseError::PastTime:
+    return "time passed";
+  case ParseError::Rejected:
+    return "rejected";
+  }
+  return "unknown";
+}
+
+int CommandError::format(char *buf, std::size_t buf_sz) const noexcept {
+  // (part of) the value, with ';' replaced
+  char val[64];
+  std::size_t len = value.size() < sizeof(val) ? value.size() : sizeof(val) - 1;
+  for (std::size_t i = 0; i < len; i++)
+    val[i] = value[i] == ';' ? '?' : value[i];
+  val[len] = '\0';
+  const int olen = static_cast<int>(option.size());
+  const char *oname = option.data();
+
+  switch (error) {
+  case ParseError::None:
+    return std::snprintf(buf, buf_sz, "ok");
+  case ParseError::WrongCommand:
+    return std::snprintf(buf, buf_sz, "not a \"%.*s\" command: \"%s\"", olen,
+                         oname, val);
+  case ParseError::MissingValue:
+    return std::snprintf(buf, buf_sz, "%.*s: missing value (offset %zu)",
+                         olen, oname, offset);
+  case ParseError::NotANumber:
+    return std::snprintf(buf, buf_sz,
+                         "%.*s: value \"%s\" is not a number (offset %zu)",
+                         olen, oname, val, offset);
+  case ParseError::OutOfRange:
+    return std::snprintf(
+        buf, buf_sz, "%.*s: value \"%s\" out of range [%.15g, %.15g] (offset "
+        "%zu)",
+        olen, oname, val, min, max, offset);
+  case ParseError::TooLong:
+    return std::snprintf(
+        buf, buf_sz, "%.*s: value longer than %.0f characters (offset %zu)",
+        olen, oname, max, offset);
+  case ParseError::InvalidTime:
+    return std::snprintf(
+        buf, buf_sz,
+        "%.*s: value \"%s\" is not a UTC date/time, e.g. "
+        "2022-03-11T21:04:05.5 (offset %zu)",
+        olen, oname, val, offset);
+  case ParseError::PastTime:
+    return std::snprintf(buf, buf_sz,
+                         "%.*s: time \"%s\" has already passed (offset %zu)",
+                         olen, oname, val, offset);
+  case ParseError::Rejected:
+    return std::snprintf(
+        buf, buf_sz, "%.*s: value \"%s\" rejected, status %d (offset %zu)",
+        olen, oname, val, status, offset);
+  }
+  return std::snprintf(buf, buf_sz, "unknown error");
+}
+
+/// Numbers must take up the whole value; a leading '+' is accepted (as by
+/// strtol/strtod), leading whitespace is not.
+ParseError parse_option_value(OptionType type, double min, double max,
+                              std::string_view value,
+                              OptionValue &result) noexcept {
+  const char *first = value.data();
+  const char *last = first + value.size();
+  if (type == OptionType::Int || type == OptionType::Float) {
+    if (first != last && *first == '+' && last - first > 1 && first[1] != '-')
+      ++first;
+  }
+
+  switch (type) {
+  case OptionType::Int: {
+    auto [ptr, ec] = std::from_chars(first, last, result.i, 10);
+    if (ec == std::errc::result_out_of_range)
+      return ParseError::OutOfRange;
+    if (ec != std::errc() || ptr != last)
+      return ParseError::NotANumber;
+    return (result.i >= min && result.i <= max) ? ParseError::None
+                                                 : ParseError::OutOfRange;
+  }
+  case OptionType::Float: {
+    auto [ptr, ec] = std::from_chars(first, last, result.f);
+    if (ec == std::errc::result_out_of_range)
+      return ParseError::OutOfRange;
+    if (ec != std::errc() || ptr != last)
+      return ParseError::NotANumber;
+    // (NaN is never in range)
+    return (result.f >= min && result.f <= max) ? ParseError::None
+                                                 : ParseError::OutOfRange;
+  }
+  case OptionType::String:
+    result.s = value;
+    return value.size() <= max ? ParseError::None : ParseError::TooLong;
+  case OptionType::Utc: {
+    // parse_utc wants a nul-terminated string
+    char str[48];
+    if (value.size() >= sizeof(str))
+      return ParseError::InvalidTime;
+    value.copy(str, value.size());
+    str[value.size()] = '\0';
+    if (parse_utc(str, result.ns))
+      return ParseError::InvalidTime;
+    auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+    return result.ns > now_ns ? ParseError::None : ParseError::PastTime;
+  }
+  }
+  return ParseError::NotANumber;
+}
+
+void skipped_token(std::string_view command,
+                   std::string_view token) noexcept {
+  char buf[32];
+  fprintf(stderr,
+          "[WRNNG][%s] Ignoring input parameter \"%.*s\" of \"%.*s\" command "
+          "(traceback: %s)\n",
+          date_str(buf), static_cast<int>(token.size()), token.data(),
+          static_cast<int>(command.size()), command.data(), __func__);
+}
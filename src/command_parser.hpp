@@ -0,0 +1,264 @@
+#ifndef __ANDOR2K_COMMAND_PARSER_HPP__
+#define __ANDOR2K_COMMAND_PARSER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/// @brief Why a command could not be parsed
+enum class ParseError : int_fast8_t {
+  None,
+  WrongCommand, ///< command does not start with the expected keyword
+  MissingValue, ///< option given without a value
+  NotANumber,   ///< value is not (entirely) a number
+  OutOfRange,   ///< numeric value out of the option's range
+  TooLong,      ///< string value longer than the option allows
+  InvalidTime,  ///< value is not a UTC date/time
+  PastTime,     ///< UTC date/time has already passed
+  Rejected      ///< value refused when applied (see CommandOption::apply)
+}; // ParseError
+
+const char *ParseError2str(ParseError e) noexcept;
+
+/// @brief Exactly what went wrong while parsing a command: the error, the
+///        option and value (views into the command) and where the offending
+///        token starts
+struct CommandError {
+  ParseError error{ParseError::None};
+  std::string_view option;
+  std::string_view value;
+  std::size_t offset{0}; ///< of the offending token, in the command
+  double min{0}, max{0}; ///< range (OutOfRange) or max length (TooLong)
+  int status{0};         ///< returned by CommandOption::apply (Rejected)
+
+  /// @brief Describe the error, e.g. "--bin: value "0" out of range [1,
+  ///        2048] (offset 12)"; ';' in values is written as '?', so that the
+  ///        description can be part of a reply to a client
+  /// @return Number of chars written (as snprintf)
+  int format(char *buf, std::size_t buf_sz) const noexcept;
+}; // CommandError
+
+/// @brief Splits a command into whitespace-separated tokens, in place
+class CommandTokenizer {
+public:
+  constexpr explicit CommandTokenizer(std::string_view command) noexcept
+      : m_command(command) {}
+
+  /// @brief Get the next token
+  /// @return false if there are no more tokens
+  constexpr bool next(std::string_view &token) noexcept {
+    while (m_pos < m_command.size() && is_space(m_command[m_pos]))
+      ++m_pos;
+    if (m_pos == m_command.size())
+      return false;
+    std::size_t start = m_pos;
+    while (m_pos < m_command.size() && !is_space(m_command[m_pos]))
+      ++m_pos;
+    token = m_command.substr(start, m_pos - start);
+    return true;
+  }
+
+  /// @brief Offset of a token (as returned by next) in the command
+  std::size_t offset(std::string_view token) const noexcept {
+    return static_cast<std::size_t>(token.data() - m_command.data());
+  }
+
+private:
+  std::string_view m_command;
+  std::size_t m_pos{0};
+
+  static constexpr bool is_space(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' ||
+           c == '\f';
+  }
+}; // CommandTokenizer
+
+/// @brief FNV-1a hash of a keyword, salted with seed
+constexpr uint32_t keyword_hash(std::string_view key, uint32_t seed) noexcept {
+  uint32_t h = 2166136261u ^ seed;
+  for (char c : key) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/// @brief A perfect hash of N keywords, built at compile time: the seed of
+///        keyword_hash is searched for, so that no two keywords share a
+///        slot. A lookup is then one hash and one (exact) comparison.
+template <std::size_t N> class KeywordMap {
+public:
+  /// @brief Slots of the table: a power of 2, at least 4 * N
+  static constexpr std::size_t SLOTS = [] {
+    std::size_t s = 4;
+    while (s < 4 * N)
+      s *= 2;
+    return s;
+  }();
+
+  template <typename F> constexpr explicit KeywordMap(F key_of) noexcept {
+    for (std::size_t i = 0; i < N; i++)
+      m_keys[i] = key_of(i);
+    for (m_seed = 0; m_seed < MAX_SEED; m_seed++) {
+      for (auto &s : m_slots)
+        s = -1;
+      std::size_t i = 0;
+      for (; i < N; i++) {
+        auto &s = m_slots[keyword_hash(m_keys[i], m_seed) & (SLOTS - 1)];
+        if (s >= 0)
+          break;
+        s = static_cast<int_fast16_t>(i);
+      }
+      if (i == N)
+        return;
+    }
+  }
+
+  /// @brief false if no perfect hash was found (or keywords are repeated)
+  constexpr bool valid() const noexcept { return m_seed < MAX_SEED; }
+
+  /// @return Index of key (as given to the constructor), or -1
+  constexpr int find(std::string_view key) const noexcept {
+    int i = m_slots[keyword_hash(key, m_seed) & (SLOTS - 1)];
+    return (i >= 0 && m_keys[i] == key) ? i : -1;
+  }
+
+private:
+  static constexpr uint32_t MAX_SEED = 1u << 12;
+  std::string_view m_keys[N]{};
+  int_fast16_t m_slots[SLOTS]{};
+  uint32_t m_seed{0};
+}; // KeywordMap
+
+/// @brief Type of an option's value
+enum class OptionType : int_fast8_t {
+  Int,    ///< integral number, in [min, max]
+  Float,  ///< real number, in [min, max]
+  String, ///< at most max chars
+  Utc     ///< future UTC date/time, see parse_utc
+};
+
+/// @brief The value of an option, as parsed (and validated) for its type
+struct OptionValue {
+  long i{0};
+  double f{0};
+  int64_t ns{0}; ///< Utc (nanoseconds since epoch)
+  std::string_view s; ///< String; not nul-terminated
+};
+
+/// @brief Syntax of the options of a command
+enum class OptionSyntax : int_fast8_t {
+  Separate, ///< "--name value"
+  Assign    ///< "name=value"
+};
+
+/// @brief One (row of a table of) option(s), applied to a T
+template <typename T> struct CommandOption {
+  std::string_view name;
+  OptionType type{OptionType::Int};
+  double min{0}, max{0}; ///< valid range; for String, max is the max length
+  /// @brief Store the (validated) value to target
+  /// @return 0 on success; else the value is rejected (ParseError::Rejected)
+  int (*apply)(T &target, const OptionValue &value) noexcept {nullptr};
+};
+
+/// @brief A command's options, looked up by a KeywordMap. Tokens that are
+///        not options are logged and skipped; parsing stops at the first
+///        error. Nothing is allocated, or copied (but for Utc values).
+template <typename T, std::size_t N> class OptionTable {
+public:
+  constexpr OptionTable(std::string_view command, OptionSyntax syntax,
+                        const CommandOption<T> (&options)[N]) noexcept
+      : m_command(command), m_syntax(syntax), m_options(),
+        m_map([&](std::size_t i) { return options[i].name; }) {
+    for (std::size_t i = 0; i < N; i++)
+      m_options[i] = options[i];
+  }
+
+  constexpr bool valid() const noexcept { return m_map.valid(); }
+
+  /// @return The option named name, or nullptr
+  constexpr const CommandOption<T> *
+  find(std::string_view name) const noexcept {
+    int i = m_map.find(name);
+    return i < 0 ? nullptr : &m_options[i];
+  }
+
+  /// @brief Parse a command and apply its options to target, in order
+  /// @param[in] command The command, starting with the table's keyword
+  /// @param[out] error If not nullptr, set to what went wrong (if anything)
+  /// @return The error (ParseError::None on success)
+  ParseError parse(std::string_view command, T &target,
+                   CommandError *error = nullptr) const noexcept;
+
+private:
+  std::string_view m_command;
+  OptionSyntax m_syntax;
+  CommandOption<T> m_options[N];
+  KeywordMap<N> m_map;
+}; // OptionTable
+
+/// @brief Parse value as of type (and range of) option
+/// @return ParseError::None, or what is wrong with value
+ParseError parse_option_value(OptionType type, double min, double max,
+                              std::string_view value,
+                              OptionValue &result) noexcept;
+
+/// @brief Log a token skipped while parsing a command
+void skipped_token(std::string_view command, std::string_view token) noexcept;
+
+template <typename T, std::size_t N>
+ParseError OptionTable<T, N>::parse(std::string_view command, T &target,
+                                    CommandError *error) const noexcept {
+  CommandError e;
+  CommandTokenizer tokens(command);
+  std::string_view token, value;
+  OptionValue v;
+  if (!tokens.next(token) || token != m_command) {
+    e.error = ParseError::WrongCommand;
+    e.option = m_command;
+    e.value = token;
+  }
+  while (e.error == ParseError::None && tokens.next(token)) {
+    std::string_view name = token;
+    if (m_syntax == OptionSyntax::Assign) {
+      std::size_t eq = token.find('=');
+      name = token.substr(0, eq);
+      value = eq == std::string_view::npos ? std::string_view{}
+                                           : token.substr(eq + 1);
+    }
+    const CommandOption<T> *option = find(name);
+    if (!option) {
+      skipped_token(m_command, token);
+      continue;
+    }
+    e.option = option->name;
+    e.offset = tokens.offset(token);
+    if (m_syntax == OptionSyntax::Separate) {
+      if (!tokens.next(value)) {
+        e.error = ParseError::MissingValue;
+        break;
+      }
+      e.offset = tokens.offset(value);
+    } else if (value.empty()) {
+      e.error = ParseError::MissingValue;
+      break;
+    } else {
+      e.offset = tokens.offset(value);
+    }
+    e.value = value;
+    e.min = option->min;
+    e.max = option->max;
+    if (e.error = parse_option_value(option->type, option->min, option->max,
+                                     value, v);
+        e.error != ParseError::None)
+      break;
+    if (e.status = option->apply(target, v); e.status)
+      e.error = ParseError::Rejected;
+  }
+  if (error)
+    *error = (e.error == ParseError::None) ? CommandError{} : e;
+  return e.error;
+}
+
+#endif
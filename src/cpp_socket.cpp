@@ -73,6 +73,23 @@ andor2k::Socket::~Socket() noexcept {
   close(m_sockid);
 }
 
+std::unique_ptr<andor2k::Socket> andor2k::Socket::duplicate() const noexcept {
+  int fd = dup(m_sockid);
+  if (fd < 0)
+    return nullptr;
+#ifdef SOCKET_LOGGER
+  return std::unique_ptr<Socket>(new Socket(fd, m_address, m_logger));
+#else
+  return std::unique_ptr<Socket>(new Socket(fd, m_address));
+#endif
+}
+
+void andor2k::Socket::set_tag(const char *tag) noexcept {
+  m_tag[0] = '\0';
+  if (tag)
+    std::strncat(m_tag, tag, sizeof(m_tag) - 1);
+}
+
 void andor2k::Socket::set_sock_addr(int port, const char *ip) noexcept {
   // m_address.sin_addr.s_addr = ip? (inet_addr(ip)) : (htonl(INADDR_ANY));
   if (ip && !(std::strcmp("localhost", ip))) {
@@ -90,7 +107,20 @@ int andor2k::Socket::send(const char *msg, int flag) const noexcept {
 #ifdef SOCKET_LOGGER
   m_logger->print_msg(m_sockid, " Sending msg via Socket", 10);
 #endif
-  return ::send(m_sockid, msg, std::strlen(msg), flag);
+  std::size_t len = std::strlen(msg);
+  if (!m_tag[0])
+    return ::send(m_sockid, msg, len, flag);
+  // message and tag in one call, so that they are not split by messages
+  // sent (to the same connection) from other threads
+  char sep[] = ";";
+  iovec iov[3] = {{const_cast<char *>(msg), len},
+                  {sep, (len && msg[len - 1] == ';') ? 0u : 1u},
+                  {const_cast<char *>(m_tag), std::strlen(m_tag)}};
+  msghdr mh;
+  std::memset(&mh, 0, sizeof(mh));
+  mh.msg_iov = iov;
+  mh.msg_iovlen = 3;
+  return ::sendmsg(m_sockid, &mh, flag);
 }
 
 int andor2k::Socket::recv(char *buffer, std::size_t buf_sz,
@@ -101,8 +131,8 @@ int andor2k::Socket::recv(char *buffer, std::size_t buf_sz,
   return ::recv(m_sockid, buffer, buf_sz, flag);
 }
 
-int andor2k::Socket::bind(int port) noexcept {
-  set_sock_addr(port);
+int andor2k::Socket::bind(int port, const char *ip) noexcept {
+  set_sock_addr(port, ip);
 #ifdef SOCKET_LOGGER
   m_logger->print_msg(m_sockid, " Binding Socket to port", 10);
 #endif
@@ -198,7 +228,8 @@ andor2k::ServerSocket::ServerSocket(int port
                                     ,
                                     andor2k::SocketLogger *logger
 #endif
-                                    )
+                                    ,
+                                    const char *ip)
     : m_socket(
 #ifdef SOCKET_LOGGER
           logger
@@ -211,12 +242,17 @@ andor2k::ServerSocket::ServerSocket(int port
     status = -10;
   }
 
+  // allow re-binding right after a restart, while connections closed by
+  // the previous instance are still in TIME_WAIT
+  if (status >= 0)
+    m_socket.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+
   // assign port
-  m_socket.set_sock_addr(port);
+  m_socket.set_sock_addr(port, ip);
 
   // bind the socket
   if (status >= 0) {
-    if ((status = m_socket.bind(port)) < 0) {
+    if ((status = m_socket.bind(port, ip)) < 0) {
       // perror("[ERROR] Failed to bind socket!");
       status = -30;
     }
@@ -5,6 +5,7 @@
 #include <cerrno>
 #include <fcntl.h>
 #include <iostream>
+#include <memory>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
@@ -38,6 +39,7 @@ class Socket {
 private:
   int m_sockid;          ///< the socket's file descriptor
   sockaddr_in m_address; ///< the (socket's) address
+  char m_tag[32] = {'\0'}; ///< appended to every message sent (see set_tag)
 #ifdef SOCKET_LOGGER
   SocketLogger *m_logger;
 #endif
@@ -79,6 +81,22 @@ public:
   /// @brief Get the instances socket id, aka the socket file descriptor
   int sockid() const noexcept { return m_sockid; }
 
+  /// @brief Create a new Socket sharing this instance's connection
+  /// The file descriptor is duplicated (see dup), so that the two instances
+  /// can be used and closed independently. This is handy when a connection
+  /// must be replied to from another thread, after the original Socket has
+  /// gone out of scope.
+  /// @return A new Socket, or nullptr if the descriptor could not be
+  ///         duplicated
+  std::unique_ptr<Socket> duplicate() const noexcept;
+
+  /// @brief Tag every message sent from now on, e.g. with "job:12", so that
+  ///        the client can tell messages of asynchronous work (sent via a
+  ///        duplicate of its connection) from direct replies. The tag is
+  ///        appended to each message as a last field, i.e. ";[TAG]". An
+  ///        empty tag (or nullptr) removes it.
+  void set_tag(const char *tag) noexcept;
+
   /// @brief Assign the socket's address, aka will do the following
   /// * set sin_family to AF_INET
   /// * set sin_port to port (actually htons(port))
@@ -121,6 +139,8 @@ public:
   ///       nonblocking I/O mode. In nonblocking mode it would fail with the
   ///       error EAGAIN or EWOULDBLOCK in this case.
   ///       The size of the message is computed using a call to strlen().
+  ///       If the socket is tagged (see set_tag), the tag is sent along with
+  ///       the message, in a single call.
   /// @see https://linux.die.net/man/2/send
   int send(const char *msg, int flag = 0) const noexcept;
 
@@ -152,6 +172,8 @@ public:
   /// to the instance's address and then bind the socket.
   /// Traditionally, this operation is called "assigning a name to a socket".
   /// @param[in] port The port number.
+  /// @param[in] ip The address to bind to (see set_sock_addr); any address
+  ///            if nullptr
   /// @return On success, zero is returned. On error, -1 is returned, and
   ///         errno is set appropriately.
   /// @note The function will first call setSockaddr(port) to set the instance
@@ -159,7 +181,7 @@ public:
   ///       It is normally necessary to assign a local address using bind()
   ///       before a SOCK_STREAM socket may receive connections.
   /// @see https://linux.die.net/man/2/bind
-  int bind(int port) noexcept;
+  int bind(int port, const char *ip = nullptr) noexcept;
 
   /// @brief Listen for connections on a socket (for server sockets).
   /// listen() marks the socket referred to by sockfd as a passive socket, that
@@ -266,12 +288,15 @@ public:
   ///          throw. If it does not fail, the socket is ready to create new
   ///          sockets via accepting connections.
   /// @param[in] port The port to connect to.
+  /// @param[in] ip The address to listen on, e.g. "localhost"; any address
+  ///            if nullptr
   ServerSocket(int port
 #ifdef SOCKET_LOGGER
                ,
                SocketLogger *logger
 #endif
-  );
+               ,
+               const char *ip = nullptr);
 
   /// @brief send data
   int send(const char *msg, int flag = 0) const noexcept {
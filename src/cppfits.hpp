@@ -176,6 +176,9 @@ public:
       case FitsHeader::ValueType::tdouble:
         status = this->update_key<double>(hdr.key, &hdr.dval, hdr.comment);
         break;
+      case FitsHeader::ValueType::tlong:
+        status = this->update_key<long>(hdr.key, &hdr.lval, hdr.comment);
+        break;
       default:
         status = -100;
       }
@@ -0,0 +1,131 @@
+#include "daemon_state.hpp"
+#include "setup_cache.hpp"
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+// The state file is plain text, one "key=value" pair per line, e.g.
+// target_temp=-50
+// planned_restart=1
+// ...
+// Unknown keys are ignored, so that older daemons can read files written by
+// newer ones.
+
+int save_daemon_state(const AndorParameters &params, const DaemonState &state,
+                      const char *fn) noexcept {
+  char buf[32];
+  char tmp_fn[MAX_FITS_FILE_SIZE];
+  std::snprintf(tmp_fn, sizeof(tmp_fn), "%s.tmp", fn);
+
+  FILE *fout = std::fopen(tmp_fn, "w");
+  if (!fout) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to open state file %s: %s (traceback: %s)\n",
+            date_str(buf), tmp_fn, std::strerror(errno), __func__);
+    return 1;
+  }
+
+  std::fprintf(fout, "target_temp=%d\n", state.target_temp);
+  std::fprintf(fout, "planned_restart=%d\n", state.planned_restart);
+  std::fprintf(fout, "saved_at=%ld\n", state.saved_at);
+  std::fprintf(fout, "acqmode=%d\n",
+               AcquisitionMode2int(params.acquisition_mode_));
+  std::fprintf(fout, "kineticcycletime=%.6f\n", params.kinetics_cycle_time_);
+  std::fprintf(fout, "hsspeed=%d\n", params.hsspeed);
+  std::fprintf(fout, "preampgain=%d\n", params.preampgain);
+  std::fprintf(fout, "observername=%s\n", params.observer_name_);
+
+  int error = std::ferror(fout);
+  if (std::fclose(fout) || error || std::rename(tmp_fn, fn)) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to write state file %s (traceback: %s)\n",
+            date_str(buf), fn, __func__);
+    std::remove(tmp_fn);
+    return 1;
+  }
+  return 0;
+}
+
+namespace {
+/// @brief Parse val as an integer in [min, max]
+/// @return 0 on success, 1 if val is not such an integer
+int parse_int(const char *val, long min, long max, long &i) noexcept {
+  char *end;
+  errno = 0;
+  i = std::strtol(val, &end, 10);
+  return (end == val || *end || errno || i < min || i > max);
+}
+
+/// @brief Parse val as a (finite) float in [min, max]
+/// @return 0 on success, 1 if val is not such a number
+int parse_float(const char *val, double min, double max, double &f) noexcept {
+  char *end;
+  errno = 0;
+  f = std::strtod(val, &end);
+  return (end == val || *end || errno || !std::isfinite(f) || f < min ||
+          f > max);
+}
+} // namespace
+
+int load_daemon_state(AndorParameters &params, DaemonState &state,
+                      const char *fn) noexcept {
+  FILE *fin = std::fopen(fn, "r");
+  if (!fin)
+    return 1;
+
+  char buf[32];
+  long i;
+  double f;
+
+  char line[256];
+  while (std::fgets(line, sizeof(line), fin)) {
+    line[std::strcspn(line, "\r\n")] = '\0';
+    char *val = std::strchr(line, '=');
+    if (!val)
+      continue;
+    *val++ = '\0';
+
+    int invalid = 0;
+    if (!std::strcmp(line, "target_temp")) {
+      if (!(invalid = parse_int(val, ANDOR_MIN_TEMP, ANDOR_MAX_TEMP, i)))
+        state.target_temp = i;
+    } else if (!std::strcmp(line, "planned_restart")) {
+      if (!(invalid = parse_int(val, 0, 1, i)))
+        state.planned_restart = i;
+    } else if (!std::strcmp(line, "saved_at")) {
+      if (!(invalid = parse_int(val, 0, std::numeric_limits<long>::max(), i)))
+        state.saved_at = i;
+    } else if (!std::strcmp(line, "acqmode")) {
+      if (!(invalid = parse_int(
+                val, AcquisitionMode2int(AcquisitionMode::SingleScan),
+                AcquisitionMode2int(AcquisitionMode::RunTillAbort), i)))
+        params.acquisition_mode_ = static_cast<AcquisitionMode>(i);
+    } else if (!std::strcmp(line, "kineticcycletime")) {
+      if (!(invalid = parse_float(val, 0, std::numeric_limits<float>::max(),
+                                  f)))
+        params.kinetics_cycle_time_ = static_cast<float>(f);
+    } else if (!std::strcmp(line, "hsspeed")) {
+      if (!(invalid = parse_int(val, 0, SETUP_CACHE_MAX_ENTRIES - 1, i)))
+        params.hsspeed = i;
+    } else if (!std::strcmp(line, "preampgain")) {
+      if (!(invalid = parse_int(val, 0, MAX_PREAMP_GAIN_INDEX, i)))
+        params.preampgain = i;
+    } else if (!std::strcmp(line, "observername")) {
+      if (!(invalid = (std::strlen(val) > MAX_OBSERVER_NAME - 1))) {
+        std::memset(params.observer_name_, '\0', MAX_OBSERVER_NAME);
+        std::strcpy(params.observer_name_, val);
+      }
+    }
+    if (invalid)
+      fprintf(stderr,
+              "[WRNNG][%s] Ignoring invalid value \"%s\" of %s in state file "
+              "%s (traceback: %s)\n",
+              date_str(buf), val, line, fn, __func__);
+  }
+
+  std::fclose(fin);
+  return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef __ANDOR2K_DAEMON_STATE_HPP__
+#define __ANDOR2K_DAEMON_STATE_HPP__
+
+#include "andor2k.hpp"
+#include <chrono>
+
+/// @brief File where the daemon persists its configuration and cooler state,
+///        so that it can be restored on (warm) restart
+constexpr char DAEMON_STATE_FILE[] = "/home/andor2k/.andor2kd.state";
+
+/// @brief A planned restart is only honoured if the daemon comes back within
+///        this time; else the camera is treated as if it were cold-started
+constexpr std::chrono::minutes WARM_RESTART_MAX_AGE{10};
+
+/// @brief On start, if the CCD is already within this many degrees Celsius of
+///        the target temperature, the cool-down wait is skipped
+constexpr float COLD_CAMERA_TOLERANCE = 1e0;
+
+/// @brief State of the daemon, as persisted between runs
+struct DaemonState {
+  int target_temp{0};     ///< last target temperature (Celsius)
+  int planned_restart{0}; ///< was the daemon stopped for a (warm) restart
+  long saved_at{0};       ///< seconds since epoch, when the state was saved
+}; // DaemonState
+
+/// @brief Save daemon state and (the persistent part of) parameters
+/// The file is written to a temporary and then renamed, so that a crash
+/// never leaves a half-written state file behind.
+/// @return Anything other than 0 denotes an error
+int save_daemon_state(const AndorParameters &params, const DaemonState &state,
+                      const char *fn = DAEMON_STATE_FILE) noexcept;
+
+/// @brief Load daemon state and (the persistent part of) parameters, as
+///        previously saved via save_daemon_state
+/// Values are checked against the same limits as setparam (and settemp);
+/// invalid ones are ignored, with a warning, leaving the current value.
+/// @return 0 on success, 1 if there is no state file, anything else denotes
+///         an error
+int load_daemon_state(AndorParameters &params, DaemonState &state,
+                      const char *fn = DAEMON_STATE_FILE) noexcept;
+
+#endif
@@ -1,4 +1,7 @@
 #include "andor2k.hpp"
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <filesystem>
@@ -51,6 +54,50 @@ int get_next_fits_filename(const AndorParameters *params,
   return 0;
 }
 
+/// @brief Formulate the FITS filename following fits_fn in a series
+/// The INDEX of fits_fn (see get_next_fits_filename) is incremented, e.g.
+/// [GENERIC_FN][YYYYMMDD]6.fits becomes [GENERIC_FN][YYYYMMDD]7.fits (the
+/// date is kept, even past midnight). Frames of a series are written in the
+/// background (see SeriesWriter), so the save dir may not yet hold the file
+/// of the previous frame; numbering from it avoids a collision (and a scan
+/// of the save dir per frame).
+/// @param[in] fits_fn A filename as formulated by get_next_fits_filename
+///            (for the same params)
+/// @param[out] next_fn The following filename; may be the same as fits_fn
+/// @return An integer; if other than 0, then the function failed.
+int get_following_fits_filename(const AndorParameters *params,
+                                const char *fits_fn, char *next_fn) noexcept {
+  const char *ext = ".fits";
+  std::size_t sz = std::strlen(fits_fn);
+  std::size_t esz = std::strlen(ext);
+  if (sz <= esz || std::strcmp(fits_fn + sz - esz, ext))
+    return 1;
+
+  /* skip path, generic filename and date, to get to the index */
+  const char *base = std::strrchr(fits_fn, '/');
+  base = base ? base + 1 : fits_fn;
+  std::size_t gsz = std::strlen(params->image_filename_);
+  if (std::strncmp(base, params->image_filename_, gsz))
+    return 1;
+  const char *start = base + gsz + 8;
+  const char *end = fits_fn + sz - esz;
+  if (start >= end)
+    return 1;
+  char *iend;
+  long index = std::strtol(start, &iend, 10);
+  if (iend != end || index < 1 || index == LONG_MAX)
+    return 1;
+
+  char filename[MAX_FITS_FILE_SIZE];
+  int prefix = static_cast<int>(start - fits_fn);
+  int len = std::snprintf(filename, sizeof(filename), "%.*s%ld%s", prefix,
+                          fits_fn, index + 1, ext);
+  if (len < 0 || len >= MAX_FITS_FILE_SIZE)
+    return 1;
+  std::strcpy(next_fn, filename);
+  return 0;
+}
+
 /// @brief Formulate the next to-be-saved FITS filename to avoid collisions
 /// Basically, we are saving FITS files, using the convention:
 /// [GENERIC_FN][YYYYMMDD][INDEX].fits
@@ -90,11 +90,8 @@ FitsHeader create_fits_header(const char *key, long val,
 int FitsHeaders::merge(const std::vector<FitsHeader> &hvec,
                        bool stop_if_error) noexcept {
 
-  if (mvec.capacity() < mvec.size() + hvec.size()) {
-    std::vector<FitsHeader> newv;
-    newv.reserve(mvec.size() + hvec.size());
-    newv.swap(mvec);
-  }
+  /* note: reserve keeps the headers already in mvec */
+  mvec.reserve(mvec.size() + hvec.size());
 
   int errors = 0;
   int adds = 0;
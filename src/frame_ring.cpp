@@ -0,0 +1,250 @@
+#include "frame_ring.hpp"
+#include "andor2k.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+inline FrameSlotHeader *slot_at(unsigned char *base, uint32_t idx,
+                                std::size_t slot_bytes) noexcept {
+  return reinterpret_cast<FrameSlotHeader *>(
+      base + sizeof(FrameRingHeader) +
+      idx * frame_ring_slot_stride(slot_bytes));
+}
+inline const FrameSlotHeader *slot_at(const unsigned char *base, uint32_t idx,
+                                      std::size_t slot_bytes) noexcept {
+  return reinterpret_cast<const FrameSlotHeader *>(
+      base + sizeof(FrameRingHeader) +
+      idx * frame_ring_slot_stride(slot_bytes));
+}
+} // namespace
+
+/// @brief Create the shared-memory segment and initialize its header
+/// If a segment of the same name already exists (e.g. from a previous run of
+/// the daemon), it is unlinked first, so that readers still holding the old
+/// mapping are not affected by the new layout.
+/// @param[in] name Name of the POSIX shared-memory object (e.g.
+///            FRAME_RING_SHM_NAME)
+/// @param[in] num_slots Number of most recent frames to keep
+/// @param[in] slot_bytes Max bytes of pixel data per frame
+/// @return Anything other than 0 denotes an error
+int FrameRingWriter::open(const char *name, int num_slots,
+                          std::size_t slot_bytes) noexcept {
+  char buf[32];
+  close();
+
+  if (num_slots < 2 || std::strlen(name) >= sizeof(m_name)) {
+    fprintf(stderr,
+            "[ERROR][%s] Invalid frame ring parameters (traceback: %s)\n",
+            date_str(buf), __func__);
+    return 1;
+  }
+
+  shm_unlink(name);
+  int fd = shm_open(name, O_CREAT | O_RDWR | O_EXCL, 0644);
+  if (fd < 0) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to create shared memory object %s: %s "
+            "(traceback: %s)\n",
+            date_str(buf), name, std::strerror(errno), __func__);
+    return 1;
+  }
+
+  std::size_t size = frame_ring_size(num_slots, slot_bytes);
+  if (ftruncate(fd, size)) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to size shared memory object %s to %zu bytes: "
+            "%s (traceback: %s)\n",
+            date_str(buf), name, size, std::strerror(errno), __func__);
+    ::close(fd);
+    shm_unlink(name);
+    return 1;
+  }
+
+  void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to map shared memory object %s: %s "
+            "(traceback: %s)\n",
+            date_str(buf), name, std::strerror(errno), __func__);
+    shm_unlink(name);
+    return 1;
+  }
+
+  m_base = static_cast<unsigned char *>(mem);
+  m_size = size;
+  std::strcpy(m_name, name);
+  m_next_frame = 1;
+
+  // construct the header and the slot headers in place; the magic number is
+  // written last, so that readers never see a half-initialized ring
+  auto *hdr = new (m_base) FrameRingHeader;
+  hdr->version = FRAME_RING_VERSION;
+  hdr->num_slots = num_slots;
+  hdr->pad_ = 0;
+  hdr->slot_bytes = slot_bytes;
+  hdr->last_frame.store(0, std::memory_order_relaxed);
+  for (int i = 0; i < num_slots; i++) {
+    auto *slot = new (slot_at(m_base, i, slot_bytes)) FrameSlotHeader;
+    slot->seq.store(0, std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  hdr->magic = FRAME_RING_MAGIC;
+
+  printf("[DEBUG][%s] Publishing frames to shared memory %s (%d slots, %zu "
+         "bytes)\n",
+         date_str(buf), name, num_slots, size);
+  return 0;
+}
+
+void FrameRingWriter::close() noexcept {
+  if (m_base) {
+    munmap(m_base, m_size);
+    shm_unlink(m_name);
+  }
+  m_base = nullptr;
+  m_size = 0;
+}
+
+/// The slot to write to is (frame_nr - 1) % num_slots, i.e. the one holding
+/// the oldest frame. The slot's seqlock is made odd before any byte is
+/// touched and even (advanced by two) after the copy is done.
+uint64_t FrameRingWriter::publish(const int32_t *pixels,
+                                  const FrameInfo &info) noexcept {
+  if (!m_base)
+    return 0;
+
+  auto *hdr = reinterpret_cast<FrameRingHeader *>(m_base);
+  std::size_t bytes = static_cast<std::size_t>(info.width) * info.height *
+                      sizeof(int32_t);
+  if (info.width < 1 || info.height < 1 || bytes > hdr->slot_bytes)
+    return 0;
+
+  uint64_t frame_nr = m_next_frame++;
+  auto *slot =
+      slot_at(m_base, (frame_nr - 1) % hdr->num_slots, hdr->slot_bytes);
+
+  uint64_t seq = slot->seq.load(std::memory_order_relaxed);
+  slot->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot->info = info;
+  slot->info.frame_nr = frame_nr;
+  std::memcpy(reinterpret_cast<unsigned char *>(slot) +
+                  sizeof(FrameSlotHeader),
+              pixels, bytes);
+
+  slot->seq.store(seq + 2, std::memory_order_release);
+  hdr->last_frame.store(frame_nr, std::memory_order_release);
+  return frame_nr;
+}
+
+int FrameRingReader::open(const char *name) noexcept {
+  close();
+
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return 1;
+
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < (off_t)sizeof(FrameRingHeader)) {
+    ::close(fd);
+    return 1;
+  }
+
+  void *mem = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED)
+    return 1;
+
+  m_base = static_cast<const unsigned char *>(mem);
+  m_size = st.st_size;
+
+  // validate layout
+  if (header()->magic != FRAME_RING_MAGIC ||
+      header()->version != FRAME_RING_VERSION ||
+      frame_ring_size(header()->num_slots, header()->slot_bytes) > m_size) {
+    close();
+    return 2;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  return 0;
+}
+
+void FrameRingReader::close() noexcept {
+  if (m_base)
+    munmap(const_cast<unsigned char *>(m_base), m_size);
+  m_base = nullptr;
+  m_size = 0;
+}
+
+uint64_t FrameRingReader::last_frame() const noexcept {
+  return m_base ? header()->last_frame.load(std::memory_order_acquire) : 0;
+}
+
+uint64_t FrameRingReader::slot_bytes() const noexcept {
+  return m_base ? header()->slot_bytes : 0;
+}
+
+int FrameRingReader::peek(uint64_t frame_nr, FrameView &view) const noexcept {
+  if (!m_base || !frame_nr)
+    return 1;
+
+  const auto *hdr = header();
+  const auto *slot =
+      slot_at(m_base, (frame_nr - 1) % hdr->num_slots, hdr->slot_bytes);
+
+  uint64_t seq = slot->seq.load(std::memory_order_acquire);
+  if (seq & 1)
+    return 2;
+
+  view.info = slot->info;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot->seq.load(std::memory_order_relaxed) != seq)
+    return 2;
+  if (view.info.frame_nr != frame_nr)
+    return 1;
+
+  view.slot = slot;
+  view.seq = seq;
+  view.pixels = reinterpret_cast<const int32_t *>(
+      reinterpret_cast<const unsigned char *>(slot) + sizeof(FrameSlotHeader));
+  return 0;
+}
+
+bool FrameRingReader::still_valid(const FrameView &view) const noexcept {
+  if (!view.slot)
+    return false;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return view.slot->seq.load(std::memory_order_relaxed) == view.seq;
+}
+
+int FrameRingReader::read_latest(FrameInfo &info, int32_t *pixels,
+                                 std::size_t max_pixels,
+                                 int max_tries) const noexcept {
+  for (int i = 0; i < max_tries; i++) {
+    FrameView view;
+    int status = peek(last_frame(), view);
+    if (status == 1)
+      return 1;
+    if (status)
+      continue;
+    std::size_t npix =
+        static_cast<std::size_t>(view.info.width) * view.info.height;
+    if (npix > max_pixels)
+      return 3;
+    std::memcpy(pixels, view.pixels, npix * sizeof(int32_t));
+    if (still_valid(view)) {
+      info = view.info;
+      return 0;
+    }
+  }
+  return 2;
+}
@@ -0,0 +1,155 @@
+#ifndef __ANDOR2K_FRAME_RING_HPP__
+#define __ANDOR2K_FRAME_RING_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Name of the POSIX shared-memory object the daemon publishes frames
+///        to (see shm_open)
+constexpr char FRAME_RING_SHM_NAME[] = "/andor2k_frames";
+
+/// @brief Default number of slots (aka most recent frames kept) in the ring
+constexpr int FRAME_RING_NUM_SLOTS = 4;
+
+/// @brief Magic number marking an initialized frame ring ("A2KR")
+constexpr uint32_t FRAME_RING_MAGIC = 0x524b3241;
+
+/// @brief Layout version of the frame ring; bump on any layout change
+constexpr uint32_t FRAME_RING_VERSION = 1;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Frame ring needs lock-free 64-bit atomics in shared memory");
+
+/// @brief Description of a frame, as published in each slot of the ring
+struct FrameInfo {
+  uint64_t frame_nr{0};          ///< sequence number, starting from 1
+  int32_t width{0}, height{0};   ///< pixels in x and y (after binning)
+  int32_t hbin{1}, vbin{1};      ///< horizontal and vertical binning
+  int32_t image_nr{1};           ///< index of image in series (from 1)
+  int32_t num_images{1};         ///< number of images in series
+  float exposure_sec{0};         ///< actual exposure time in seconds
+  int64_t exposure_start_ns{0};  ///< UTC, nanoseconds since epoch
+  int64_t acquired_ns{0};        ///< UTC, nanoseconds since epoch
+};
+
+/// @brief Header of each slot in the ring; the pixel data (int32_t) follow
+/// the header. The seq member is the slot's seqlock: it is odd while the
+/// writer updates the slot and even otherwise.
+struct alignas(64) FrameSlotHeader {
+  std::atomic<uint64_t> seq;
+  FrameInfo info;
+};
+
+/// @brief Header of the whole shared-memory segment
+struct alignas(64) FrameRingHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_slots;
+  uint32_t pad_;
+  uint64_t slot_bytes;               ///< max bytes of pixel data per slot
+  std::atomic<uint64_t> last_frame;  ///< frame_nr of latest published frame
+};
+
+/// @brief Size of a slot (header plus pixel data), rounded to cache lines
+inline std::size_t frame_ring_slot_stride(std::size_t slot_bytes) noexcept {
+  std::size_t sz = sizeof(FrameSlotHeader) + slot_bytes;
+  return (sz + 63) & ~static_cast<std::size_t>(63);
+}
+
+/// @brief Total size of the shared-memory segment
+inline std::size_t frame_ring_size(int num_slots,
+                                   std::size_t slot_bytes) noexcept {
+  return sizeof(FrameRingHeader) +
+         num_slots * frame_ring_slot_stride(slot_bytes);
+}
+
+/// @brief The writer (daemon) side of the frame ring.
+/// Frames are published round-robin; the writer never waits for readers.
+class FrameRingWriter {
+public:
+  FrameRingWriter() noexcept = default;
+  FrameRingWriter(const FrameRingWriter &) = delete;
+  FrameRingWriter &operator=(const FrameRingWriter &) = delete;
+  ~FrameRingWriter() noexcept { close(); }
+
+  /// @brief Create (or re-create) and map the shared-memory segment
+  /// @return Anything other than 0 denotes an error
+  int open(const char *name, int num_slots, std::size_t slot_bytes) noexcept;
+
+  /// @brief Unmap and unlink the shared-memory segment
+  void close() noexcept;
+
+  bool is_open() const noexcept { return m_base != nullptr; }
+
+  /// @brief The mapped segment (nullptr if not open) and its size in bytes
+  const void *data() const noexcept { return m_base; }
+  std::size_t size() const noexcept { return m_size; }
+
+  /// @brief Copy a frame into the next slot of the ring. The frame_nr member
+  ///        of info is ignored and assigned by the ring.
+  /// @return The frame number assigned, or 0 if nothing was published (ring
+  ///         not open or frame too large)
+  uint64_t publish(const int32_t *pixels, const FrameInfo &info) noexcept;
+
+private:
+  char m_name[64] = {'\0'};
+  unsigned char *m_base = nullptr;
+  std::size_t m_size = 0;
+  uint64_t m_next_frame = 1;
+}; // FrameRingWriter
+
+/// @brief A zero-copy view of a frame inside the ring. The view is only valid
+///        as long as FrameRingReader::still_valid returns true for it.
+struct FrameView {
+  FrameInfo info;
+  const int32_t *pixels = nullptr;
+  const FrameSlotHeader *slot = nullptr;
+  uint64_t seq = 0;
+};
+
+/// @brief The reader (consumer) side of the frame ring.
+/// Readers never block the writer; if a slot is overwritten while being read
+/// the read is reported as failed (or retried, see read_latest).
+class FrameRingReader {
+public:
+  FrameRingReader() noexcept = default;
+  FrameRingReader(const FrameRingReader &) = delete;
+  FrameRingReader &operator=(const FrameRingReader &) = delete;
+  ~FrameRingReader() noexcept { close(); }
+
+  /// @brief Map an existing shared-memory segment (read-only)
+  /// @return Anything other than 0 denotes an error
+  int open(const char *name = FRAME_RING_SHM_NAME) noexcept;
+
+  void close() noexcept;
+
+  /// @brief frame_nr of the latest published frame (0 if none yet)
+  uint64_t last_frame() const noexcept;
+
+  /// @brief Get a zero-copy view of frame frame_nr
+  /// @return 0 on success, 1 if the frame is not (or no longer) in the ring,
+  ///         2 if the slot is being written to right now
+  int peek(uint64_t frame_nr, FrameView &view) const noexcept;
+
+  /// @brief Check that the slot of a view has not been overwritten since
+  ///        peek; call after you are done processing the pixels
+  bool still_valid(const FrameView &view) const noexcept;
+
+  /// @brief Copy the latest frame to pixels (of capacity max_pixels)
+  /// @return 0 on success, anything else denotes an error
+  int read_latest(FrameInfo &info, int32_t *pixels, std::size_t max_pixels,
+                  int max_tries = 10) const noexcept;
+
+  uint64_t slot_bytes() const noexcept;
+
+private:
+  const unsigned char *m_base = nullptr;
+  std::size_t m_size = 0;
+
+  const FrameRingHeader *header() const noexcept {
+    return reinterpret_cast<const FrameRingHeader *>(m_base);
+  }
+}; // FrameRingReader
+
+#endif
@@ -0,0 +1,192 @@
+#include "frame_times.hpp"
+#include "andor2k.hpp"
+#include "andor_time_utils.hpp"
+#include "atmcdLXd.h"
+#include <cstdio>
+#include <cstring>
+#include <fitsio.h>
+
+namespace {
+/// write v as exactly n decimal digits
+char *putn(char *p, long v, int n) noexcept {
+  for (int i = n - 1; i >= 0; i--, v /= 10)
+    p[i] = static_cast<char>('0' + v % 10);
+  return p + n;
+}
+} // namespace
+
+char *format_frame_time(int64_t utc_ns, bool with_date, char *buf) noexcept {
+  // floor, for times before the epoch
+  int64_t sec = utc_ns / 1000000000ll;
+  int64_t ns = utc_ns % 1000000000ll;
+  if (ns < 0) {
+    ns += 1000000000ll;
+    --sec;
+  }
+  long days = static_cast<long>(sec / 86400);
+  long sod = static_cast<long>(sec % 86400);
+  if (sod < 0) {
+    sod += 86400;
+    --days;
+  }
+
+  char *p = buf;
+  if (with_date) {
+    long y;
+    unsigned m, d;
+    civil_from_days(days, y, m, d);
+    p = putn(p, y, 4);
+    *p++ = '-';
+    p = putn(p, m, 2);
+    *p++ = '-';
+    p = putn(p, d, 2);
+    *p++ = 'T';
+  }
+  p = putn(p, sod / 3600, 2);
+  *p++ = ':';
+  p = putn(p, sod % 3600 / 60, 2);
+  *p++ = ':';
+  p = putn(p, sod % 60, 2);
+  *p++ = '.';
+  p = putn(p, static_cast<long>(ns / 1000), 6);
+  *p = '\0';
+  return buf;
+}
+
+int frame_times_filename(const char *fits_filename, char *buf) noexcept {
+  constexpr char ext[] = ".fits";
+  constexpr char times_ext[] = ".times.fits";
+  std::size_t len = std::strlen(fits_filename);
+  std::size_t ext_len = std::strlen(ext);
+  if (len >= ext_len && !std::strcmp(fits_filename + len - ext_len, ext))
+    len -= ext_len;
+  if (len + sizeof(times_ext) > MAX_FITS_FILE_SIZE)
+    return 1;
+  std::memcpy(buf, fits_filename, len);
+  std::memcpy(buf + len, times_ext, sizeof(times_ext));
+  return 0;
+}
+
+int FrameTimes::begin(int num_images, float exposure,
+                      long timecorr_ns) noexcept {
+  m_frames.clear();
+  m_exposure = exposure;
+  m_timecorr_ns = timecorr_ns;
+  m_sdk_times = true;
+  m_sdk_anchored = false;
+  try {
+    m_frames.reserve(num_images > 0 ? num_images : 1);
+  } catch (std::exception &) {
+    return 1;
+  }
+  return 0;
+}
+
+void FrameTimes::resolve(FrameTime &ft, int image_nr) noexcept {
+  ft.image_nr = image_nr;
+  int64_t exposure_ns = static_cast<int64_t>(m_exposure * 1e9);
+  int64_t readout_ns = m_timecorr_ns - exposure_ns;
+  ft.end_utc_ns = ft.wait_utc_ns - (readout_ns > 0 ? readout_ns : 0);
+  ft.start_utc_ns = ft.end_utc_ns - exposure_ns;
+
+  // the SDK's frame spacing (camera clock) beats our wake-up times; give up
+  // on it at the first failure (e.g. no metadata)
+  if (!m_sdk_times || image_nr < 1)
+    return;
+  at_u64 rel_ns;
+  if (GetRelativeImageTimes(image_nr, image_nr, &rel_ns, 1) != DRV_SUCCESS) {
+    m_sdk_times = false;
+    return;
+  }
+  ft.sdk_rel_ns = static_cast<int64_t>(rel_ns);
+  if (!m_sdk_anchored) {
+    m_sdk_epoch_ns = ft.start_utc_ns - ft.sdk_rel_ns;
+    m_sdk_anchored = true;
+  }
+  ft.start_utc_ns = m_sdk_epoch_ns + ft.sdk_rel_ns;
+  ft.end_utc_ns = ft.start_utc_ns + exposure_ns;
+}
+
+int FrameTimes::apply_headers(const FrameTime &ft,
+                              FitsHeaders &headers) const noexcept {
+  char tbuf[32];
+  int error = 0;
+  error += headers.update("DATE-OBS",
+                          format_frame_time(ft.start_utc_ns, true, tbuf),
+                          "UTC date/time of exposure start") < 0;
+  error += headers.update("UT-START",
+                          format_frame_time(ft.start_utc_ns, false, tbuf),
+                          "UTC time of exposure start") < 0;
+  error += headers.update("UT-END",
+                          format_frame_time(ft.end_utc_ns, false, tbuf),
+                          "UTC time of exposure end") < 0;
+  error += headers.update("MJD-OBS", unix_ns_to_mjd(ft.start_utc_ns),
+                          "MJD of exposure start") < 0;
+  return error;
+}
+
+int FrameTimes::write_table(const char *filename) const noexcept {
+  char buf[32];
+  constexpr int COLUMNS = 6;
+  char *ttype[COLUMNS] = {(char *)"FRAME",     (char *)"START_UTC",
+                          (char *)"END_UTC",   (char *)"WAIT_UTC",
+                          (char *)"WAIT_MONO", (char *)"SDK_REL"};
+  char *tform[COLUMNS] = {(char *)"1J", (char *)"1K", (char *)"1K",
+                          (char *)"1K", (char *)"1K", (char *)"1K"};
+  char *tunit[COLUMNS] = {(char *)"",   (char *)"ns", (char *)"ns",
+                          (char *)"ns", (char *)"ns", (char *)"ns"};
+
+  // one column at a time
+  long long nrows = m_frames.size();
+  std::vector<int> frame_nr;
+  std::vector<long long> times;
+  try {
+    frame_nr.reserve(nrows);
+    times.reserve(nrows);
+  } catch (std::exception &) {
+    return 1;
+  }
+  for (const auto &ft : m_frames)
+    frame_nr.push_back(ft.image_nr);
+  int64_t FrameTime::*columns[] = {
+      &FrameTime::start_utc_ns, &FrameTime::end_utc_ns,
+      &FrameTime::wait_utc_ns, &FrameTime::wait_mono_ns,
+      &FrameTime::sdk_rel_ns};
+
+  fitsfile *fptr;
+  int status = 0;
+  if (fits_create_file(&fptr, filename, &status)) {
+    fits_report_error(stderr, status);
+    return status;
+  }
+  // an empty primary array is prepended by cfitsio
+  fits_create_tbl(fptr, BINARY_TBL, nrows, COLUMNS, ttype, tform, tunit,
+                  FRAME_TIMES_EXTNAME, &status);
+  if (nrows)
+    fits_write_col(fptr, TINT, 1, 1, 1, nrows, frame_nr.data(), &status);
+  for (int col = 0; col < COLUMNS - 1 && nrows; col++) {
+    times.clear();
+    for (const auto &ft : m_frames)
+      times.push_back(ft.*columns[col]);
+    fits_write_col(fptr, TLONGLONG, col + 2, 1, 1, nrows, times.data(),
+                   &status);
+  }
+  char timesys[] = "UTC";
+  float exposure = m_exposure;
+  long timecorr = m_timecorr_ns;
+  fits_update_key(fptr, TSTRING, "TIMESYS", timesys,
+                  "Time system of the *_UTC columns", &status);
+  fits_update_key(fptr, TFLOAT, "EXPTIME", &exposure,
+                  "Actual exposure time (sec)", &status);
+  fits_update_key(fptr, TLONG, "TIMECORR", &timecorr,
+                  "Exposure plus readout time (nanosec)", &status);
+  if (status) {
+    fits_report_error(stderr, status);
+    fprintf(stderr,
+            "[ERROR][%s] Failed writing frame times to %s (traceback: %s)\n",
+            date_str(buf), filename, __func__);
+  }
+  int close_status = 0;
+  fits_close_file(fptr, &close_status);
+  return status ? status : close_status;
+}
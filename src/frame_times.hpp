@@ -0,0 +1,120 @@
+#ifndef __ANDOR2K_FRAME_TIMES_HPP__
+#define __ANDOR2K_FRAME_TIMES_HPP__
+
+#include "clock_monitor.hpp"
+#include "fits_header.hpp"
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+/// @brief Name of the binary table extension holding the frame times
+constexpr char FRAME_TIMES_EXTNAME[] = "FRAMETIMES";
+
+/// @brief Timestamps of one frame; all times are nanoseconds, UTC times are
+///        since the Unix epoch and corrected by the tracked clock offset
+struct FrameTime {
+  int64_t wait_utc_ns{0};  ///< CLOCK_REALTIME at WaitForAcquisition return
+  int64_t wait_mono_ns{0}; ///< CLOCK_MONOTONIC, at the same instant
+  int64_t sdk_rel_ns{-1};  ///< start, relative to the first frame of the
+                           ///< series, per the SDK; -1 if not available
+  int64_t start_utc_ns{0}; ///< start of exposure
+  int64_t end_utc_ns{0};   ///< end of exposure
+  int image_nr{0};         ///< index of the frame in the series (from 1)
+}; // FrameTime
+
+/// @brief Format a UTC time (nanoseconds since the epoch) with microseconds,
+///        as "YYYY-MM-DDTHH:MM:SS.ffffff" or, if with_date is false,
+///        "HH:MM:SS.ffffff". Thread-safe.
+/// @param[out] buf A buffer of at least 27 chars
+/// @return Always buf
+char *format_frame_time(int64_t utc_ns, bool with_date, char *buf) noexcept;
+
+/// @brief Modified Julian Date of a UTC time (nanoseconds since the epoch)
+constexpr double unix_ns_to_mjd(int64_t utc_ns) noexcept {
+  return 40587e0 + static_cast<double>(utc_ns) / 86400e9;
+}
+
+/// @brief Name of the file holding the frame times table of a series, from
+///        the FITS file of its first frame (".fits" becomes ".times.fits")
+/// @param[out] buf A buffer of at least MAX_FITS_FILE_SIZE chars
+/// @return 0 on success; anything else denotes an error (name too long)
+int frame_times_filename(const char *fits_filename, char *buf) noexcept;
+
+/// @brief Timestamps of the frames of one series.
+/// Storage for all frames is reserved up front (begin), so that capturing a
+/// frame time right as WaitForAcquisition returns is two clock reads, an
+/// atomic load and a store; anything slower (querying the SDK, deriving the
+/// exposure start/end) is left to resolve, once the frame is read out.
+/// The exposure of a frame is taken to end a readout time (TIMECORR less the
+/// exposure) before WaitForAcquisition returns. If the SDK reports start
+/// times relative to the first frame (metadata enabled), these are used for
+/// the spacing of the frames, anchored at the first frame resolved.
+class FrameTimes {
+public:
+  /// @param[in] monitor Clock offset to correct UTC times with, if any
+  explicit FrameTimes(const ClockMonitor *monitor = nullptr) noexcept
+      : m_monitor(monitor) {}
+
+  /// @brief Start a series; must be called before StartAcquisition
+  /// @param[in] num_images Number of frames in the series
+  /// @param[in] exposure Actual exposure time in seconds
+  /// @param[in] timecorr_ns Exposure plus readout time (see TIMECORR)
+  /// @return 0 on success; anything else denotes an error (allocation)
+  int begin(int num_images, float exposure, long timecorr_ns) noexcept;
+
+  /// @brief Record the time of a frame; call right after WaitForAcquisition
+  ///        returns. Never allocates.
+  /// @return The frame's record, or nullptr if all frames have been captured
+  FrameTime *capture() noexcept {
+    if (m_frames.size() == m_frames.capacity())
+      return nullptr;
+    timespec mono, real;
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+    FrameTime &ft = m_frames.emplace_back();
+    ft.wait_mono_ns = mono.tv_sec * 1000000000ll + mono.tv_nsec;
+    ft.wait_utc_ns = real.tv_sec * 1000000000ll + real.tv_nsec;
+    if (m_monitor)
+      ft.wait_utc_ns += m_monitor->correction_ns();
+    return &ft;
+  }
+
+  /// @brief Frame-loop jitter at the last captured frame: the change in the
+  ///        interval between consecutive frames (absolute, in nanoseconds)
+  /// @return -1 if fewer than three frames have been captured
+  int64_t last_jitter_ns() const noexcept {
+    std::size_t n = m_frames.size();
+    if (n < 3)
+      return -1;
+    int64_t dt = (m_frames[n - 1].wait_mono_ns - m_frames[n - 2].wait_mono_ns) -
+                 (m_frames[n - 2].wait_mono_ns - m_frames[n - 3].wait_mono_ns);
+    return dt < 0 ? -dt : dt;
+  }
+
+  /// @brief Derive the start/end of exposure of a captured frame
+  /// @param[in] image_nr Index of the frame in the series (from 1), as known
+  ///            to the SDK
+  void resolve(FrameTime &ft, int image_nr) noexcept;
+
+  /// @brief Set DATE-OBS, UT-START, UT-END and MJD-OBS for a resolved frame
+  /// @return 0 on success; anything else denotes an error
+  int apply_headers(const FrameTime &ft, FitsHeaders &headers) const noexcept;
+
+  /// @brief Write the times of all captured frames as a FITS binary table
+  ///        (extension FRAME_TIMES_EXTNAME) to a new file
+  /// @return 0 on success; anything else denotes an error (cfitsio status)
+  int write_table(const char *filename) const noexcept;
+
+  const std::vector<FrameTime> &frames() const noexcept { return m_frames; }
+
+private:
+  const ClockMonitor *m_monitor;
+  std::vector<FrameTime> m_frames;
+  float m_exposure{0};
+  long m_timecorr_ns{0};
+  int64_t m_sdk_epoch_ns{0}; ///< start of the first frame, for sdk_rel_ns
+  bool m_sdk_times{false};   ///< query the SDK for relative times
+  bool m_sdk_anchored{false};
+}; // FrameTimes
+
+#endif
@@ -1,15 +1,27 @@
+#include "acquisition_state.hpp"
 #include "andor2k.hpp"
 #include "andor2kd.hpp"
 #include "andor_time_utils.hpp"
+#include "async_logger.hpp"
 #include "atmcdLXd.h"
+#include "clock_monitor.hpp"
 #include "fits_header.hpp"
+#include "frame_ring.hpp"
 #include "get_exposure.hpp"
+#include "latency_stats.hpp"
+#include "metrics.hpp"
+#include "scheduled_start.hpp"
+#include "sdk_owner.hpp"
+#include "series_writer.hpp"
+#include "task_pool.hpp"
+#include "timer_service.hpp"
+#include "trace_recorder.hpp"
 #include <algorithm>
 #include <chrono>
 #include <cppfits.hpp>
 #include <cstdio>
 #include <cstring>
-#include <thread>
+#include <mutex>
 
 using andor2k::Socket;
 using namespace std::chrono_literals;
@@ -17,9 +29,16 @@ using std_time_point = std::chrono::system_clock::time_point;
 
 extern int sig_interrupt_set;
 extern int sig_abort_set;
-extern int abort_exposure_set;
-extern int stop_reporting_thread;
-extern int acquisition_thread_finished;
+extern FrameRingWriter g_frame_ring;
+extern AcquisitionState g_acq_state;
+extern TimerService g_timer_service;
+extern AsyncLogger g_logger;
+extern LatencyStats g_latency_stats;
+extern DaemonMetrics g_metrics;
+extern TraceRecorder g_tracer;
+extern ClockMonitor g_clock_monitor;
+extern TaskPool g_task_pool;
+extern SdkOwner g_sdk;
 
 int get_kinetic_scan(const AndorParameters *params, FitsHeaders *fheaders,
                      int xpixels, int ypixels, at_32 *img_buffer,
@@ -38,6 +57,155 @@ int find_start_time_cor(const FitsHeaders *fheaders,
   return 1;
 }
 
+/// Up to SCHEDULED_START_HANDOVER_NS before the scheduled start, the wait
+/// runs on the calling thread; the acquisition is published as started
+/// first, so that it can be aborted meanwhile (the abort is then reported
+/// by get_acquisition, which finds it when start_acquisition is called).
+unsigned wait_scheduled_start(const AndorParameters *params,
+                              const Socket &socket) noexcept {
+  if (params->start_at_ns_ <= 0)
+    return 0;
+
+  char buf[32], tbuf[32];
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  format_frame_time(params->start_at_ns_, true, tbuf);
+  socket_sprintf(socket, sbuf,
+                 "info:waiting for scheduled start;status:scheduled;at:%s;"
+                 "time:%s;",
+                 tbuf, date_str(buf));
+
+  g_acq_state.begin(params->num_images_);
+  ScheduledStart scheduled(&g_clock_monitor);
+  int wstatus = scheduled.wait_until(
+      params->start_at_ns_ - SCHEDULED_START_HANDOVER_NS, [] {
+        return g_acq_state.abort_requested() || sig_abort_set ||
+               sig_interrupt_set;
+      });
+  return wstatus == 1 ? SCHEDULED_START_ABORTED : 0;
+}
+
+/// @brief Call StartAcquisition; if the parameters ask for a scheduled start
+///        (params->start_at_ns_, see "image --at"), wait for that UTC time
+///        first (see ScheduledStart), spinning on an isolated CPU if the
+///        system has one. Most of the wait is normally spent before, off the
+///        SDK owner (see wait_scheduled_start).
+/// For scheduled starts, the requested time, the achieved error (time of the
+/// call minus the requested one) and the duration of the call are added to
+/// the headers, as STARTREQ, STARTERR and STARTDUR.
+/// @return The status of StartAcquisition, or SCHEDULED_START_ABORTED if an
+///         abort was requested while waiting
+unsigned start_acquisition(const AndorParameters *params,
+                           FitsHeaders *fheaders) noexcept {
+  if (params->start_at_ns_ <= 0) {
+    auto start_timer = g_latency_stats.timer(LatencyPhase::StartAcquisition);
+    return StartAcquisition();
+  }
+
+  char tbuf[32];
+  format_frame_time(params->start_at_ns_, true, tbuf);
+
+  ScheduledStart scheduled(&g_clock_monitor, first_isolated_cpu());
+  int wstatus = scheduled.wait_until(params->start_at_ns_, [] {
+    return g_acq_state.abort_requested() || sig_abort_set || sig_interrupt_set;
+  });
+  if (wstatus == 1)
+    return SCHEDULED_START_ABORTED;
+
+  auto start_timer = g_latency_stats.timer(LatencyPhase::StartAcquisition);
+  int64_t called_ns = scheduled.now_utc_ns();
+  unsigned error = StartAcquisition();
+  int64_t returned_ns = scheduled.now_utc_ns();
+  start_timer.stop();
+  int cpu = scheduled.pinned_cpu();
+  scheduled.unpin();
+
+  double start_error = (called_ns - params->start_at_ns_) * 1e-3;
+  double start_duration = (returned_ns - called_ns) * 1e-3;
+  if (wstatus == 2)
+    g_logger.warning("Scheduled start %s had passed when the acquisition was "
+                     "ready; started %.1f microsec late (traceback: %s)",
+                     tbuf, start_error, __func__);
+  else
+    g_logger.debug("Scheduled start %s: called StartAcquisition %+.1f "
+                   "microsec off, on CPU %d; the call took %.1f microsec",
+                   tbuf, start_error, cpu, start_duration);
+
+  fheaders->update("STARTREQ", tbuf, "Requested UTC start of acquisition");
+  fheaders->update("STARTERR", start_error,
+                   "Start error, achieved minus requested (microsec)");
+  fheaders->update("STARTDUR", start_duration,
+                   "Duration of the StartAcquisition call (microsec)");
+  return error;
+}
+
+/// @brief Wait for the next frame, as WaitForAcquisition does, but in slices
+///        of SDK_YIELD_INTERVAL; before each slice, the queries queued on
+///        the SDK owner (e.g. for status or temperature) are served (see
+///        SdkOwner::yield), so that they are answered while a series runs.
+/// @return DRV_SUCCESS once a frame is done; DRV_NO_NEW_DATA if the wait
+///         was cancelled (e.g. aborted) or the acquisition has stopped;
+///         else the error of WaitForAcquisitionTimeOut
+unsigned wait_for_acquisition() noexcept {
+  for (;;) {
+    g_sdk.yield();
+    unsigned status = WaitForAcquisitionTimeOut(
+        static_cast<int>(SDK_YIELD_INTERVAL.count()));
+    if (status != DRV_NO_NEW_DATA || g_acq_state.abort_requested() ||
+        sig_abort_set || sig_interrupt_set)
+      return status;
+    // a time out, unless the acquisition has stopped meanwhile (then pick
+    // up the event of its last frame, if any)
+    int driver_status;
+    if (GetStatus(&driver_status) != DRV_SUCCESS ||
+        driver_status != DRV_ACQUIRING)
+      return WaitForAcquisitionTimeOut(0);
+  }
+}
+
+/// @brief Publish a just-acquired frame to the shared-memory frame ring
+/// This is a no-op if the ring has not been opened (e.g. outside the daemon).
+/// Frame times are taken from frame_time if given; else the exposure start
+/// time is estimated as now minus the TIMECORR correction (aka exposure plus
+/// readout time) found in the headers. Times are corrected by the offset of
+/// the system clock tracked by g_clock_monitor.
+/// @param[in] image_nr Index of the frame in the series (starting from 1)
+/// @param[in] exposure Actual exposure time in seconds
+/// @param[in] frame_time Resolved times of the frame (see FrameTimes), if any
+/// @return The frame number assigned by the ring, or 0 if not published
+uint64_t publish_frame(const AndorParameters *params,
+                       const FitsHeaders *fheaders, int xpixels, int ypixels,
+                       const at_32 *img_buffer, int image_nr, float exposure,
+                       const FrameTime *frame_time) noexcept {
+  static_assert(sizeof(at_32) == sizeof(int32_t));
+  if (!g_frame_ring.is_open())
+    return 0;
+
+  FrameInfo info;
+  info.width = xpixels;
+  info.height = ypixels;
+  info.hbin = params->image_hbin_;
+  info.vbin = params->image_vbin_;
+  info.image_nr = image_nr;
+  info.num_images = params->num_images_;
+  info.exposure_sec = exposure;
+  if (frame_time) {
+    info.acquired_ns = frame_time->wait_utc_ns;
+    info.exposure_start_ns = frame_time->start_utc_ns;
+    return g_frame_ring.publish(reinterpret_cast<const int32_t *>(img_buffer),
+                                info);
+  }
+  info.acquired_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count() +
+                     g_clock_monitor.correction_ns();
+  long correction_ns;
+  find_start_time_cor(fheaders, correction_ns);
+  info.exposure_start_ns = info.acquired_ns - correction_ns;
+
+  return g_frame_ring.publish(reinterpret_cast<const int32_t *>(img_buffer),
+                              info);
+}
+
 int exposure2tick_every(long iexp) noexcept {
   long min_tick = static_cast<long>(0.5e0 * 1e3);
   long max_tick = static_cast<long>(5 * 1e3);
@@ -63,50 +231,65 @@ int exposure2tick_every(long iexp) noexcept {
   }
 }
 
-class ThreadReporter {
+/// Progress reports for a kinetic series. Reports are fired by the timer
+/// service every every_ms milliseconds (see start); the thread acquiring the
+/// images calls frame_done as soon as each image is acquired, which reports
+/// the image as done and starts timing the next one.
+class KineticReporter {
 public:
-  ThreadReporter(const Socket *s, long exp_msec, long tot_ms, int img_nr,
-                 int num_img, const std_time_point &s_start) noexcept
-      : socket(s), image_nr(img_nr), num_images(num_img), exposure_ms(exp_msec),
-        total_ms(tot_ms), series_start(s_start) {
+  KineticReporter(const Socket *s, long exp_msec, long tot_ms, int num_img,
+                  const std_time_point &s_start) noexcept
+      : socket(s), image_nr(1), num_images(num_img), exposure_ms(exp_msec),
+        total_ms(tot_ms), series_start(s_start), image_start(s_start) {
     every_ms = exposure2tick_every(exp_msec);
     clear_buf();
-    len_const_prt = std::sprintf(
-        mbuf, "info:acquiring image ...;status:acquiring;image:%03d/%03d;time:",
-        image_nr, num_images);
+    set_const_part();
   };
+  KineticReporter(const KineticReporter &) = delete;
+  KineticReporter &operator=(const KineticReporter &) = delete;
+  ~KineticReporter() noexcept { stop(); }
+
+  int start() noexcept {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (every_ms <= 0)
+      return 0;
+    timer_id = g_timer_service.schedule_every(
+        std::chrono::milliseconds(every_ms), [this] { tick(); },
+        TimerService::clock::now());
+    return timer_id ? 0 : 1;
+  }
 
-  void report() noexcept {
-    int it = 0;
-    auto t_start = std::chrono::high_resolution_clock::now();
-    while (!stop_reporting_thread && !acquisition_thread_finished) {
-      auto t_now = std::chrono::high_resolution_clock::now();
-      long from_thread_start =
-          std::chrono::duration_cast<std::chrono::milliseconds>(t_now - t_start)
-              .count();
-      long from_acquisition_start =
-          std::chrono::duration_cast<std::chrono::milliseconds>(t_now -
-                                                                series_start)
-              .count();
-      int image_done = (from_thread_start * 100 / exposure_ms);
-      int series_done = (from_acquisition_start * 100 / total_ms);
-
-      date_str(mbuf + len_const_prt);
-      std::sprintf(mbuf + std::strlen(mbuf),
-                   ";progperc:%d;sprogperc:%d;elapsedt:%.2f;selapsedt:%.2f",
-                   image_done, series_done, from_thread_start / 1e3,
-                   from_acquisition_start / 1e3);
-      socket->send(mbuf);
-
-      if (stop_reporting_thread || acquisition_thread_finished)
-        break;
-      std::this_thread::sleep_for(std::chrono::milliseconds(every_ms));
-      ++it;
+  void stop() noexcept {
+    uint64_t id;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      id = timer_id;
+      timer_id = 0;
     }
+    if (id)
+      g_timer_service.cancel(id);
+  }
+
+  void tick() noexcept {
+    g_tracer.name_thread("timer service");
+    TraceSpan span(g_tracer, "reporter tick");
+    std::lock_guard<std::mutex> lock(mtx);
+    if (image_nr > num_images)
+      return;
+    send(std::chrono::high_resolution_clock::now(), false);
+  }
+
+  void frame_done(int img_nr) noexcept {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto t_now = std::chrono::high_resolution_clock::now();
+    send(t_now, true);
+    image_nr = img_nr + 1;
+    image_start = t_now;
+    set_const_part();
   }
 
 private:
-  long every_ms;        // sleeps for every_ms milliseconds, then reports
+  long every_ms;        // report every every_ms milliseconds
   const Socket *socket; // socket to send message to
   int image_nr,
       num_images; // current image number, total number of images is sequence
@@ -115,28 +298,50 @@ private:
   long exposure_ms;            // exposure
   long total_ms;               //
   std_time_point series_start; // start of series
+  std_time_point image_start;  // start of current image
+  uint64_t timer_id{0};        // id of timer in the timer service
+  std::mutex mtx;              // protects all of the above
 
   void clear_buf() noexcept { std::memset(mbuf, 0, MAX_SOCKET_BUFFER_SIZE); }
-};
 
-void wait_for_acquisition(int &status) noexcept {
-  acquisition_thread_finished = false;
-  status = WaitForAcquisition();
-  if (status != DRV_SUCCESS) {
-    /*fprintf(stderr,
-            "[ERROR][%s] Something happened while waiting for a new "
-            "acquisition! Aborting (traceback: %s)\n",
-            date_str(buf), __func__);*/
-    AbortAcquisition();
-    status = 1;
+  void set_const_part() noexcept {
+    len_const_prt = std::sprintf(
+        mbuf, "info:acquiring image ...;status:acquiring;image:%03d/%03d;time:",
+        image_nr, num_images);
   }
-  stop_reporting_thread = true;
-  acquisition_thread_finished = true;
-  status = 0;
-  return;
-}
 
-auto report_lambda = [](ThreadReporter reporter) { reporter.report(); };
+  // must be called with mtx locked
+  void send(std_time_point t_now, bool image_acquired) noexcept {
+    long from_image_start =
+        std::chrono::duration_cast<std::chrono::milliseconds>(t_now -
+                                                              image_start)
+            .count();
+    long from_acquisition_start =
+        std::chrono::duration_cast<std::chrono::milliseconds>(t_now -
+                                                              series_start)
+            .count();
+    long image_done = 100, series_done = 100;
+    if (!image_acquired && exposure_ms > 0)
+      image_done = std::min(from_image_start * 100 / exposure_ms, 99L);
+    if (total_ms > 0)
+      series_done = std::min(from_acquisition_start * 100 / total_ms, 100L);
+
+    // the constant part is only valid while the image is being acquired
+    int len = len_const_prt;
+    if (image_acquired)
+      len = std::sprintf(mbuf,
+                         "info:acquired image;status:acquired;image:%03d/"
+                         "%03d;time:",
+                         image_nr, num_images);
+    date_str(mbuf + len);
+    std::sprintf(mbuf + std::strlen(mbuf),
+                 ";progperc:%ld;sprogperc:%ld;elapsedt:%.2f;selapsedt:%.2f",
+                 image_done, series_done, from_image_start / 1e3,
+                 from_acquisition_start / 1e3);
+    auto report_timer = g_latency_stats.timer(LatencyPhase::Report);
+    socket->send(mbuf);
+  }
+};
 
 /// @brief Setup and get an acquisition (single or multiple scans)
 /// The function will:
@@ -157,14 +362,21 @@ int get_acquisition(const AndorParameters *params, FitsHeaders *fheaders,
                     int xnumpixels, int ynumpixels, at_32 *img_buffer,
                     const Socket &socket) noexcept {
 
-  char buf[32] = {'\0'}; // buffer for datetime string
-
 #ifdef DEBUG
-  printf("[DEBUG][%s] get_acquisition called, with dimensions %dx%d, to be "
-         "stored at %p (traceback: %s)\n",
-         date_str(buf), xnumpixels, ynumpixels, (void *)img_buffer, __func__);
+  g_logger.debug("get_acquisition called, with dimensions %dx%d, to be "
+                 "stored at %p (traceback: %s)",
+                 xnumpixels, ynumpixels, (void *)img_buffer, __func__);
 #endif
 
+  g_tracer.name_thread("acquisition");
+  TraceSpan span(g_tracer, "get_acquisition");
+
+  // publish the start of the acquisition, unless already published while
+  // waiting for a scheduled start (see wait_scheduled_start); this also
+  // clears any previous abort request
+  if (!acquisition_active(g_acq_state.snapshot().phase))
+    g_acq_state.begin(params->num_images_);
+
   // depending on acquisition mode, acquire the exposure(s)
   int acq_status = 0;
   switch (params->acquisition_mode_) {
@@ -181,19 +393,26 @@ int get_acquisition(const AndorParameters *params, FitsHeaders *fheaders,
                                   img_buffer, socket);
     break;
   default:
-    fprintf(stderr,
-            "[ERROR][%s] Invalid Acquisition Mode; don't know what to do! "
-            "(traceback: %s)\n",
-            date_str(buf), __func__);
+    g_logger.error("Invalid Acquisition Mode; don't know what to do! "
+                   "(traceback: %s)",
+                   __func__);
     acq_status = 10;
   }
 
   // check for errors
   if (acq_status) {
-    fprintf(stderr, "[ERROR][%s] Failed acquiring image(s)! (traceback: %s)\n",
-            date_str(buf), __func__);
+    g_logger.error("Failed acquiring image(s)! (traceback: %s)", __func__);
   }
 
+  // publish the end of the acquisition
+  if (!acq_status)
+    g_acq_state.set_phase(AcquisitionPhase::Done);
+  else if (g_acq_state.abort_requested() || acq_status == ABORT_EXIT_STATUS ||
+           acq_status == INTERRUPT_EXIT_STATUS)
+    g_acq_state.set_phase(AcquisitionPhase::Aborted);
+  else
+    g_acq_state.set_phase(AcquisitionPhase::Failed);
+
   return acq_status;
 }
 
@@ -216,94 +435,116 @@ int get_kinetic_scan(const AndorParameters *params, FitsHeaders *fheaders,
                      int xpixels, int ypixels, at_32 *img_buffer,
                      const Socket &socket) noexcept {
 
-  char buf[32] = {'\0'};                  // buffer for datetime string
-  char fits_filename[MAX_FITS_FILE_SIZE]; // FITS to save aqcuired data to
-  char sbuf[MAX_SOCKET_BUFFER_SIZE];      // buffer for socket communication
+  char fits_filename[MAX_FITS_FILE_SIZE];  // FITS to save aqcuired data to
+  char times_filename[MAX_FITS_FILE_SIZE]; // FITS to save frame times to
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];       // buffer for socket communication
 
   long millisec_per_image, total_millisec;
   if (coarse_exposure_time(params, millisec_per_image, total_millisec)) {
-    fprintf(stderr,
-            "[ERROR][%s] Failed to compute coarse timings for acquisition! "
-            "(traceback %s)\n",
-            date_str(buf), __func__);
+    g_logger.error("Failed to compute coarse timings for acquisition! "
+                   "(traceback %s)",
+                   __func__);
     millisec_per_image = static_cast<long>(params->exposure_ * 1e3);
     total_millisec = params->num_images_ * millisec_per_image;
   }
 
-  printf("---> KS: Computed image time: %ld and series time: %ld <--\n",
-         millisec_per_image, total_millisec);
+  g_logger.debug("---> KS: Computed image time: %ld and series time: %ld <--",
+                 millisec_per_image, total_millisec);
+
+  // storage for the timestamps of all frames in the series
+  long timecorr_ns;
+  find_start_time_cor(fheaders, timecorr_ns);
+  FrameTimes frame_times(&g_clock_monitor);
+  frame_times.begin(params->num_images_, params->exposure_, timecorr_ns);
+  times_filename[0] = '\0';
+  fits_filename[0] = '\0';
 
-  // start acquisition(s)
-  printf("[DEBUG][%s] Starting %d image acquisitions ...\n", date_str(buf),
-         params->num_images_);
+  // frames are written to FITS by the task pool, while we read out the next
+  SeriesWriter writer(g_task_pool);
+
+  // start acquisition(s), at the scheduled time if any
+  g_logger.debug("Starting %d image acquisitions ...", params->num_images_);
+  if (unsigned error = start_acquisition(params, fheaders);
+      error != DRV_SUCCESS) {
+    AbortAcquisition();
+    if (error == SCHEDULED_START_ABORTED)
+      return ABORT_EXIT_STATUS;
+    // failed to start acquisition .... report error and send it to client
+    char acq_str[MAX_STATUS_STRING_SIZE];
+    char buf[32];
+    g_logger.error("Failed to start acquisition; error is: %s (traceback: %s)",
+                   get_start_acquisition_status_string(error, acq_str),
+                   __func__);
+    socket_sprintf(socket, sbuf,
+                   "done;error:%u;info:start acquisition error (%s);time:%s;",
+                   error, acq_str, date_str(buf));
+    return 1;
+  }
   auto series_start = std::chrono::system_clock::now();
-  StartAcquisition();
+
+  // report status (via the timer service) for the whole series
+  KineticReporter reporter(&socket, millisec_per_image, total_millisec,
+                           params->num_images_, series_start);
+  reporter.start();
 
   at_32 lAcquired = 0;
   while (lAcquired < params->num_images_) { // loop untill we have all images
 
-    // start reporting thread for this image
-    int cur_image = lAcquired + 1;
-    stop_reporting_thread = false;
-    std::thread rthread(report_lambda,
-                        ThreadReporter(&socket, millisec_per_image,
-                                       total_millisec, cur_image,
-                                       params->num_images_, series_start));
-    printf("--> new thread created, %d/%d ... <---\n", cur_image,
-           params->num_images_);
-
-    // do we have a signal to quit ?
-    if (sig_abort_set || sig_interrupt_set) {
-      stop_reporting_thread = true;
-      rthread.join();
-      return sig_abort_set ? ABORT_EXIT_STATUS : INTERRUPT_EXIT_STATUS;
+    // do we have a signal (or an abort request) to quit ?
+    if (sig_abort_set || sig_interrupt_set || g_acq_state.abort_requested()) {
+      AbortAcquisition();
+      reporter.stop();
+      return (sig_abort_set || !sig_interrupt_set) ? ABORT_EXIT_STATUS
+                                                   : INTERRUPT_EXIT_STATUS;
     }
+    if (lAcquired)
+      g_acq_state.set_phase(AcquisitionPhase::Exposing);
 
     // wait until acquisition finished
-    if (WaitForAcquisition() != DRV_SUCCESS) {
-      fprintf(stderr,
-              "[ERROR][%s] Something happened while waiting for a new "
-              "acquisition! Aborting (traceback: %s)\n",
-              date_str(buf), __func__);
+    auto exposure_timer = g_latency_stats.timer(LatencyPhase::Exposure);
+    int status = wait_for_acquisition();
+    FrameTime *frame_time = frame_times.capture();
+    exposure_timer.stop();
+    if (status != DRV_SUCCESS) {
+      g_logger.error("Something happened while waiting for a new "
+                     "acquisition! Aborting (traceback: %s)",
+                     __func__);
       AbortAcquisition();
-      stop_reporting_thread = true;
-      rthread.join();
+      reporter.stop();
       return 10;
     }
 
-    // acquisition finished; stop reporting via the thread
-    stop_reporting_thread = true;
-    rthread.join();
-    printf("--> thread joined <---\n");
+    // acquisition finished; publish/report the frame boundary right away
+    g_acq_state.frame_done(lAcquired + 1);
+    g_metrics.frame_acquired(lAcquired == 0);
+    reporter.frame_done(lAcquired + 1);
+    if (int64_t jitter = frame_times.last_jitter_ns(); jitter >= 0)
+      g_latency_stats.record(LatencyPhase::Jitter, jitter);
 
     // total number of images acquired since the current acquisition started
     GetTotalNumberImagesAcquired(&lAcquired);
 
     // update the data array with the most recently acquired image
-    if (unsigned int err = GetMostRecentImage(img_buffer, xpixels * ypixels);
-        err != DRV_SUCCESS) {
-      fprintf(stderr,
-              "[ERROR][%s] Failed retrieving acquisition from cammera buffer! "
-              "(traceback: %s)\n",
-              date_str(buf), __func__);
+    auto readout_timer = g_latency_stats.timer(LatencyPhase::Readout);
+    unsigned int err = GetMostRecentImage(img_buffer, xpixels * ypixels);
+    readout_timer.stop();
+    if (err != DRV_SUCCESS) {
+      g_logger.error("Failed retrieving acquisition from cammera buffer! "
+                     "(traceback: %s)",
+                     __func__);
       switch (err) {
       case DRV_ERROR_ACK:
-        fprintf(stderr,
-                "[ERROR][%s] Unable to communicate with card (traceback: %s)\n",
-                date_str(buf), __func__);
+        g_logger.error("Unable to communicate with card (traceback: %s)",
+                       __func__);
         break;
       case DRV_P1INVALID:
-        fprintf(stderr, "[ERROR][%s] Invalid pointer (traceback: %s)\n",
-                date_str(buf), __func__);
+        g_logger.error("Invalid pointer (traceback: %s)", __func__);
         break;
       case DRV_P2INVALID:
-        fprintf(stderr, "[ERROR][%s] Array size is incorrect (traceback: %s)\n",
-                date_str(buf), __func__);
+        g_logger.error("Array size is incorrect (traceback: %s)", __func__);
         break;
       case DRV_NO_NEW_DATA:
-        fprintf(stderr,
-                "[ERROR][%s] There is no new data yet (traceback: %s)\n",
-                date_str(buf), __func__);
+        g_logger.error("There is no new data yet (traceback: %s)", __func__);
         break;
       }
       AbortAcquisition();
@@ -311,43 +552,58 @@ int get_kinetic_scan(const AndorParameters *params, FitsHeaders *fheaders,
       return 10;
     }
 
-    // save to FITS format
-    if (get_next_fits_filename(params, fits_filename)) {
-      fprintf(stderr,
-              "[ERROR][%s] Failed getting FITS filename! No FITS image saved "
-              "(traceback: %s)\n",
-              date_str(buf), __func__);
+    // time-stamp the frame (DATE-OBS, UT-START, ...)
+    if (frame_time) {
+      frame_times.resolve(*frame_time, lAcquired);
+      frame_times.apply_headers(*frame_time, *fheaders);
+    }
+
+    // make the frame available to local consumers
+    publish_frame(params, fheaders, xpixels, ypixels, img_buffer, lAcquired,
+                  params->exposure_, frame_time);
+
+    // save to FITS format (on the task pool); frames after the first are
+    // numbered from the previous one (which may still be written)
+    auto filename_timer = g_latency_stats.timer(LatencyPhase::Filename);
+    int fn_status =
+        fits_filename[0]
+            ? get_following_fits_filename(params, fits_filename,
+                                              fits_filename)
+            : get_next_fits_filename(params, fits_filename);
+    filename_timer.stop();
+    if (fn_status) {
+      g_logger.error("Failed getting FITS filename! No FITS image saved "
+                     "(traceback: %s)",
+                     __func__);
       AbortAcquisition();
       return 1;
     }
+    if (!times_filename[0] &&
+        frame_times_filename(fits_filename, times_filename))
+      times_filename[0] = '\0';
 
-    FitsImage<int32_t> fits(fits_filename, xpixels, ypixels);
-    if (fits.write<at_32>(img_buffer)) {
-      fprintf(stderr,
-              "[ERROR][%s] Failed writting data to FITS file (traceback: "
-              "%s)!\n",
-              date_str(buf), __func__);
+    if (writer.write(fits_filename, *fheaders, xpixels, ypixels,
+                     img_buffer)) {
       AbortAcquisition();
       return 2;
-    } else {
-      printf("[DEBUG][%s] Image written in FITS file %s\n", date_str(buf),
-             fits_filename);
-    }
-
-    if (fits.apply_headers(*fheaders, false) < 0) {
-      fprintf(stderr,
-              "[WRNNG][%s] Some headers not applied in FITS file! Should "
-              "inspect file (traceback: %s)\n",
-              date_str(buf), __func__);
     }
-    fits.close();
   } // colected/saved all exposures!
+  reporter.stop();
+
+  // one table with the times of all frames, next to the first frame; then
+  // wait for the frames still being written
+  if (times_filename[0])
+    writer.write_table(frame_times, times_filename);
+  if (writer.finish()) {
+    AbortAcquisition();
+    return 2;
+  }
 
-  printf("[DEBUG][%s] Finished acquiring/saving %d images for sequence\n",
-         date_str(buf), (int)lAcquired);
+  g_logger.debug("Finished acquiring/saving %d images for sequence",
+                 (int)lAcquired);
   socket_sprintf(socket, sbuf,
                  "done;error:0;info:images acquired and saved %ld", lAcquired);
-  printf("--> sending [%s] <--\n", sbuf);
+  g_logger.debug("--> sending [%s] <--", sbuf);
 
   AbortAcquisition();
   return 0;
@@ -1,5 +1,7 @@
 #include "andor2k.hpp"
 #include "andor2kd.hpp"
+#include "frame_times.hpp"
+#include <cstdint>
 
 int get_single_scan(const AndorParameters *params, FitsHeaders *fheaders,
                     int xpixels, int ypixels, at_32 *img_buffer,
@@ -7,3 +9,13 @@ int get_single_scan(const AndorParameters *params, FitsHeaders *fheaders,
 int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
                  int xpixels, int ypixels, at_32 *img_buffer,
                  const andor2k::Socket &socket) noexcept;
+unsigned start_acquisition(const AndorParameters *params,
+                           FitsHeaders *fheaders) noexcept;
+unsigned wait_for_acquisition() noexcept;
+int find_start_time_cor(const FitsHeaders *fheaders,
+                        long &correction_ns) noexcept;
+uint64_t publish_frame(const AndorParameters *params,
+                       const FitsHeaders *fheaders, int xpixels, int ypixels,
+                       const at_32 *img_buffer, int image_nr,
+                       float exposure,
+                       const FrameTime *frame_time = nullptr) noexcept;
@@ -1,6 +1,6 @@
 #include "andor2k.hpp"
 #include "andor_time_utils.hpp"
-#include <cmath>
+#include "clock_monitor.hpp"
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -15,9 +15,6 @@
 // see
 // https://lettier.github.io/posts/2016-04-26-lets-make-a-ntp-client-in-c.html
 
-#define NTP_TIMESTAMP_DELTA 2208988800ull
-constexpr int ntp_port = 123;
-
 // (li   & 11 000 000) >> 6
 #define LI(packet) (uint8_t)((packet.li_vn_mode & 0xC0) >> 6)
 // (vn   & 00 111 000) >> 3
@@ -58,140 +55,106 @@ struct ntp_packet {
 
 static_assert(sizeof(ntp_packet) == 48);
 
-static_assert(sizeof(double) == sizeof(uint64_t));
-union ntp_word_10 {
-  uint64_t u64t;
-  double asd;
-};
-
-/*double uint2double(uint32_t u32high, uint32_t u32low) noexcept {
-  // make the u32 bit ints to a single u64 int
-  uint64_t u64_int = static_cast<uint64_t>(u32high) << 32 | u32low;
-  // take all the bits as a 64 bit unsigned integer, stick it in a floating
-  // point variable with at least 64 bits of mantissa (usually double) and do a
-  // floating point divide by 2^32
-  ntp_word_10 w10{u64_int};
-  // return *(double *)(&u64_int) / static_cast<double>((uint64_t)0x100000000);
-  return w10.asd / static_cast<double>((uint64_t)0x100000000);
-}*/
-
-double uint2double(uint32_t u32high, uint32_t u32low) noexcept {
-  double d = static_cast<double>(u32high);
-  double dlow = static_cast<double>(u32low);
-  while (dlow > 1)
-    dlow /= 10e0;
-  return d + dlow;
-}
-
-inline int fsec2millisec(uint32_t fsec) noexcept {
-  double dlow = static_cast<double>(fsec);
-  while (dlow > 1)
-    dlow /= 10e0;
-  return static_cast<int>(std::round(dlow * 1e3));
+static int64_t system_now_ns() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
 }
 
-int get_ntp_time(const char *ntp_server, std_time_point &ntpt) noexcept {
-  // Socket file descriptor and the n return result from writing/reading from
-  // the socket. We are using base c sockets here, cause we want UDP
-  int sockfd, n;
-  char buf[32]; // for reporting log datetime
-
-  // Create and zero out the packet. All 48 bytes worth.
-  ntp_packet packet = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-  std::memset(&packet, 0, sizeof(ntp_packet));
-
-  // Set the first byte's bits to 00,011,011 for li = 0, vn = 3, and mode = 3.
-  // The rest will be left set to zero.
-  *((char *)&packet + 0) =
-      0x1b; // Represents 27 in base 10 or 00011011 in base 2.
-
-  // Create a UDP socket, convert the host-name to an IP address, set the port
-  // number, connect to the server, send the packet, and then read in the
-  // return packet.
-  struct sockaddr_in serv_addr; // Server address data structure.
-  struct hostent *server;       // Server data structure.
+int ntp_resolve(const char *server, sockaddr_in &addr) noexcept {
+  char host[128];
+  int port = NTP_PORT;
+  std::snprintf(host, sizeof(host), "%s", server);
+  if (char *colon = std::strchr(host, ':'); colon) {
+    *colon = '\0';
+    port = std::atoi(colon + 1);
+  }
 
-  sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP); // Create a UDP socket.
-  if (sockfd < 0) {
-    fprintf(stderr,
-            "[ERROR][%s] Failed to open connection to NTP host %s:%d "
-            "(traceback: %s)\n",
-            date_str(buf), ntp_server, ntp_port, __func__);
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  addrinfo *res = nullptr;
+  if (getaddrinfo(host, nullptr, &hints, &res) || !res)
     return 1;
-  }
+  std::memcpy(&addr, res->ai_addr, sizeof(sockaddr_in));
+  addr.sin_port = htons(port);
+  freeaddrinfo(res);
+  return 0;
+}
 
-  server = gethostbyname(ntp_server); // Convert URL to IP.
-  if (server == NULL) {
-    fprintf(stderr, "[ERROR][%s] No such NTP host %s:%d (traceback: %s)\n",
-            date_str(buf), ntp_server, ntp_port, __func__);
+/// The client's transmit time is sent and echoed back as the originate
+/// time, so that stale or spoofed replies are rejected. With t1 the
+/// client's transmit, t2 the server's receive, t3 the server's transmit and
+/// t4 the client's receive time, the offset is ((t2-t1) + (t3-t4))/2 and
+/// the delay (t4-t1) - (t3-t2).
+int ntp_query(const sockaddr_in &addr, NtpSample &sample,
+              int timeout_ms) noexcept {
+  int sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sockfd < 0)
+    return 1;
+  timeval tv{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+  if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) ||
+      connect(sockfd, (const sockaddr *)&addr, sizeof(addr))) {
+    close(sockfd);
     return 1;
   }
 
-  // Zero out the server address structure.
-  bzero((char *)&serv_addr, sizeof(serv_addr));
-  serv_addr.sin_family = AF_INET;
-
-  // Copy the server's IP address to the server address structure.
-  bcopy((char *)server->h_addr, (char *)&serv_addr.sin_addr.s_addr,
-        server->h_length);
-
-  // Convert the port number integer to network big-endian style and save it
-  // to the server address structure.
-  serv_addr.sin_port = htons(ntp_port);
-
-  // Call up the server using its IP address and port number.
-  if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
-    fprintf(stderr,
-            "[ERROR][%s] Failed to connect to NTP host %s:%d (traceback: %s)\n",
-            date_str(buf), ntp_server, ntp_port, __func__);
-    return 1;
+  // li = 0, vn = 3, and mode = 3 (client)
+  ntp_packet packet;
+  std::memset(&packet, 0, sizeof(ntp_packet));
+  packet.li_vn_mode = 0x1b;
+  uint32_t tx_s, tx_f;
+  int64_t t1 = system_now_ns();
+  unix_ns_to_ntp(t1, tx_s, tx_f);
+  packet.txTm_s = htonl(tx_s);
+  packet.txTm_f = htonl(tx_f);
+
+  if (write(sockfd, (char *)&packet, sizeof(ntp_packet)) !=
+      sizeof(ntp_packet)) {
+    close(sockfd);
+    return 2;
   }
+  ssize_t n = read(sockfd, (char *)&packet, sizeof(ntp_packet));
+  int64_t t4 = system_now_ns();
+  close(sockfd);
+
+  // a server (mode 4) reply to our request; stratum 0 is a "kiss-o'-death"
+  if (n != sizeof(ntp_packet) || (MODE(packet) != 4 && MODE(packet) != 5) ||
+      !packet.stratum || LI(packet) == 3 || ntohl(packet.origTm_s) != tx_s ||
+      ntohl(packet.origTm_f) != tx_f)
+    return 3;
+
+  int64_t t2 = ntp_to_unix_ns(ntohl(packet.rxTm_s), ntohl(packet.rxTm_f));
+  int64_t t3 = ntp_to_unix_ns(ntohl(packet.txTm_s), ntohl(packet.txTm_f));
+  sample.offset_ns = ((t2 - t1) + (t3 - t4)) / 2;
+  sample.delay_ns = (t4 - t1) - (t3 - t2);
+  return 0;
+}
 
-  // Send it the NTP packet it wants. If n == -1, it failed.
-  n = write(sockfd, (char *)&packet, sizeof(ntp_packet));
-  if (n < 0) {
-    fprintf(stderr,
-            "[ERROR][%s] Failed to send request to NTP host %s:%d (traceback: "
-            "%s)\n",
-            date_str(buf), ntp_server, ntp_port, __func__);
+int get_ntp_time(const char *ntp_server, std_time_point &ntpt) noexcept {
+  char buf[32]; // for reporting log datetime
+
+  sockaddr_in serv_addr;
+  if (ntp_resolve(ntp_server, serv_addr)) {
+    fprintf(stderr, "[ERROR][%s] No such NTP host %s (traceback: %s)\n",
+            date_str(buf), ntp_server, __func__);
     return 1;
   }
 
-  // Wait and receive the packet back from the server. If n == -1, it failed.
-  n = read(sockfd, (char *)&packet, sizeof(ntp_packet));
-  if (n < 0) {
+  NtpSample sample;
+  if (ntp_query(serv_addr, sample)) {
     fprintf(stderr,
-            "[ERROR][%s] Failed getting response from NTP host %s:%d "
+            "[ERROR][%s] Failed getting response from NTP host %s "
             "(traceback: %s)\n",
-            date_str(buf), ntp_server, ntp_port, __func__);
+            date_str(buf), ntp_server, __func__);
     return 1;
   }
 
-  // These two fields contain the time-stamp seconds as the packet left the NTP
-  // server. The number of seconds correspond to the seconds passed since 1900.
-  // ntohl() converts the bit/byte order from the network's to host's
-  // "endianness".
-  packet.txTm_s = ntohl(packet.txTm_s); // Time-stamp seconds.
-  packet.txTm_f = ntohl(packet.txTm_f); // Time-stamp fraction of a second.
-
-  // Extract the 32 bits that represent the time-stamp seconds (since NTP
-  // epoch) from when the packet left the server.
-  // Subtract 70 years worth of seconds from the seconds since 1900.
-  // This leaves the seconds since the UNIX epoch of 1970.
-  // (1900)-------------(1970)*****************(Time Packet Left the Server)
-  time_t txTm = (time_t)(packet.txTm_s - NTP_TIMESTAMP_DELTA);
-
-  ntpt = std::chrono::system_clock::from_time_t(txTm);
-  ntpt += std::chrono::milliseconds(fsec2millisec(packet.txTm_f));
-
-  // uint64_t t64 = ui32_to_ui64(packet.txTm_s, packet.txTm_f);
-  // double td = ui64_to_double(t64);
-  // double td = uint2double(packet.txTm_s, packet.txTm_f);
-
-  // printf(">> Integral seconds  : %u\n", packet.txTm_s);
-  // printf(">> Fractional seconds: %u\n", packet.txTm_f);
-  // printf(">> Seconds (double)  : %f\n", td);
-  // printf(">> Integer millisec, : %d\n", fsec2millisec(packet.txTm_f));
-
+  // server time is local time plus the offset; the fraction of the
+  // timestamps is in units of 2^-32 sec (see ntp_fraction_to_ns)
+  ntpt = std::chrono::system_clock::now() +
+         std::chrono::duration_cast<std::chrono::system_clock::duration>(
+             std::chrono::nanoseconds(sample.offset_ns));
   return 0;
 }
@@ -1,8 +1,15 @@
 #include "acquisition_series_reporter.hpp"
+#include "acquisition_state.hpp"
 #include "andor2k.hpp"
 #include "andor_time_utils.hpp"
+#include "async_logger.hpp"
 #include "atmcdLXd.h"
 #include "fits_header.hpp"
+#include "get_exposure.hpp"
+#include "latency_stats.hpp"
+#include "metrics.hpp"
+#include "series_writer.hpp"
+#include "task_pool.hpp"
 #include <chrono>
 #include <condition_variable>
 #include <cppfits.hpp>
@@ -14,14 +21,15 @@
 
 using andor2k::Socket;
 
-extern std::mutex g_mtx;
 extern std::mutex g_mtx_abort;
-extern int abort_set;
 extern int abort_socket_fd;
-extern int cur_img_in_series;
+extern AcquisitionState g_acq_state;
 extern std::condition_variable cv;
-
-auto rta_lambda = [](AcquisitionSeriesReporter reporter) { reporter.report(); };
+extern AsyncLogger g_logger;
+extern LatencyStats g_latency_stats;
+extern DaemonMetrics g_metrics;
+extern ClockMonitor g_clock_monitor;
+extern TaskPool g_task_pool;
 
 /// @brief Get/Save a Run Till Abort acquisition to FITS format
 /// The function will perform the following:
@@ -43,8 +51,9 @@ int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
                  const Socket &socket) noexcept {
 
   char buf[32] = {'\0'};                  // buffer for datetime string
-  char fits_filename[MAX_FITS_FILE_SIZE]; // FITS to save aqcuired data to
-  char sockbuf[MAX_SOCKET_BUFFER_SIZE];   // buffer for socket communication
+  char fits_filename[MAX_FITS_FILE_SIZE];  // FITS to save aqcuired data to
+  char times_filename[MAX_FITS_FILE_SIZE]; // FITS to save frame times to
+  char sockbuf[MAX_SOCKET_BUFFER_SIZE];    // buffer for socket communication
 
   // first off, let's create an abort signal listener thread/socket. spawn off
   // the thread and wait till we are notified that we have the socket's fd
@@ -57,24 +66,30 @@ int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
   // ok, we are listening on port SOCKET_PORT+1 for abort, with the open socket
   // having an fd=abort_socket_fd
 
-  printf("[DEBUG][%s] Starting RTA %d image acquisitions ... with dimensions: "
-         "%dx%d "
-         "stored at %p\n",
-         date_str(buf), params->num_images_, xpixels, ypixels,
-         (void *)img_buffer);
+  g_logger.debug("Starting RTA %d image acquisitions ... with dimensions: "
+                 "%dx%d stored at %p",
+                 params->num_images_, xpixels, ypixels, (void *)img_buffer);
 
   // lets get the actual exposure time, so that we know exaclty
   float exposure, accumulate, kinetic;
   GetAcquisitionTimings(&exposure, &accumulate, &kinetic);
 
-  // start acquisition; start timing after the call to StartAcquisition, cause
-  // this call will take some time ~250 millisec
-  if (unsigned error = StartAcquisition(); error != DRV_SUCCESS) {
+  // storage for the timestamps of all frames in the series
+  long timecorr_ns;
+  find_start_time_cor(fheaders, timecorr_ns);
+  FrameTimes frame_times(&g_clock_monitor);
+  frame_times.begin(params->num_images_, exposure, timecorr_ns);
+  times_filename[0] = '\0';
+
+  // start acquisition (at the scheduled time, if any); start timing after the
+  // call to StartAcquisition, cause this call will take some time ~250
+  // millisec
+  if (unsigned error = start_acquisition(params, fheaders);
+      error != DRV_SUCCESS) {
     // failed to start acquisition .... report error and send it to client
     char acq_str[MAX_STATUS_STRING_SIZE];
-    fprintf(stderr,
-            "[ERROR][%s] Failed to start acquisition; error descrition %s:\n",
-            date_str(buf), get_start_acquisition_status_string(error, acq_str));
+    g_logger.error("Failed to start acquisition; error descrition %s:",
+                   get_start_acquisition_status_string(error, acq_str));
 
     socket_sprintf(
         socket, sockbuf,
@@ -92,50 +107,67 @@ int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
   // start time for the whole series
   auto series_start = std::chrono::system_clock::now();
 
-  // IMPORTANT!!
-  // get the global lock -- only release it when we are done with the
-  // acquisition
-  g_mtx.lock();
+  // frames are written to FITS by the task pool, while we read out the next
+  SeriesWriter writer(g_task_pool, &socket);
 
-  // spawn off a new thread to report status while we are waiting for the
-  // acquisition to end
-  std::thread report_t(
-      rta_lambda, AcquisitionSeriesReporter(
-                      &socket, (long)(exposure * 1000), params->num_images_,
-                      std::chrono::high_resolution_clock::now()));
+  // report status (via the timer service) while we are waiting for the
+  // acquisitions to end
+  AcquisitionSeriesReporter reporter(&socket, (long)(exposure * 1000),
+                                     params->num_images_,
+                                     std::chrono::high_resolution_clock::now());
+  reporter.start();
 
   // loop untill we have all images
+  int cur_img_in_series = 0;
   for (int curimg = 0; curimg < params->num_images_; curimg++) {
     cur_img_in_series = curimg + 1;
 
+    // an abort requested while we were saving the previous image finds no
+    // WaitForAcquisition to cancel; check for it here
+    if (g_acq_state.abort_requested()) {
+      AbortAcquisition();
+      reporter.stop();
+      shutdown(abort_socket_fd, 2);
+      abort_t.join();
+      // no reply before the frames queued are written
+      writer.finish();
+      socket_sprintf(socket, sockbuf,
+                     "done;status:unfinished %d/%d (abort called by "
+                     "user);error:1;time:%s;",
+                     curimg, params->num_images_, date_str(buf));
+      return 1;
+    }
+    if (curimg)
+      g_acq_state.set_phase(AcquisitionPhase::Exposing);
+
 #ifdef DEBUG
-    printf("[DEBUG][%s] Performing acquisition for image %d/%d ...\n",
-           date_str(buf), cur_img_in_series, params->num_images_);
-    auto wfa_ci = std::chrono::system_clock::now();
+    g_logger.debug("Performing acquisition for image %d/%d ...",
+                   cur_img_in_series, params->num_images_);
 #endif
 
     // wait until current image acquisition is finished
-    int status = WaitForAcquisition();
+    auto exposure_timer = g_latency_stats.timer(LatencyPhase::Exposure);
+    int status = wait_for_acquisition();
+    FrameTime *frame_time = frame_times.capture();
+    [[maybe_unused]] int64_t wfa_ns = exposure_timer.stop();
     if (status != DRV_SUCCESS) {
-      fprintf(stderr,
-              "[ERROR][%s] Something happened while waiting for a new "
-              "acquisition! Aborting (traceback: %s)\n",
-              date_str(buf), __func__);
+      g_logger.error("Something happened while waiting for a new "
+                     "acquisition! Aborting (traceback: %s)",
+                     __func__);
       AbortAcquisition();
 
-      // allow reporter to end and join with main, and
+      // stop reporting, and
       // kill abort listening socket and join corresponding thread
-      g_mtx.unlock();
+      reporter.stop();
       shutdown(abort_socket_fd, 2);
-      report_t.join();
       abort_t.join();
+      writer.finish();
 
       // report the error (maybe an abort requested by client)
-      if (abort_set) {
-        fprintf(stderr,
-                "[ERROR][%s] Abort requested by client while waiting for a new "
-                "acquisition! Aborting (traceback: %s)\n",
-                date_str(buf), __func__);
+      if (g_acq_state.abort_requested()) {
+        g_logger.error("Abort requested by client while waiting for a new "
+                       "acquisition! Aborting (traceback: %s)",
+                       __func__);
         socket_sprintf(socket, sockbuf,
                        "done;status:unfinished %d/%d (abort called by "
                        "user);error:%d;time:%s;",
@@ -151,19 +183,24 @@ int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
       return 1;
     } // WaitForAcquisition()
 
+    // publish/report the frame boundary right away
+    g_acq_state.frame_done(cur_img_in_series);
+    g_metrics.frame_acquired(curimg == 0);
+    reporter.frame_done(cur_img_in_series);
+    if (int64_t jitter = frame_times.last_jitter_ns(); jitter >= 0)
+      g_latency_stats.record(LatencyPhase::Jitter, jitter);
+
 #ifdef DEBUG
-    printf(">> WaitForAcquisition took %ld millisec (image %d/%d)\n",
-           std::chrono::duration_cast<std::chrono::milliseconds>(
-               std::chrono::system_clock::now() - wfa_ci)
-               .count(),
-           cur_img_in_series, params->num_images_);
+    g_logger.debug(">> WaitForAcquisition took %ld millisec (image %d/%d)",
+                   (long)(wfa_ns / 1000000), cur_img_in_series,
+                   params->num_images_);
 #endif
 
 #ifdef DEBUG
-    printf("[DEBUG][%s] Exposure ended for image %d/%d ...\n", date_str(buf),
-           cur_img_in_series, params->num_images_);
-    auto gi_ci = std::chrono::system_clock::now();
+    g_logger.debug("Exposure ended for image %d/%d ...",
+                   cur_img_in_series, params->num_images_);
 #endif
+    auto readout_timer = g_latency_stats.timer(LatencyPhase::Readout);
 
     // wait untill a new image is available
     int vfirst = 0, vlast = 0;
@@ -172,20 +209,20 @@ int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
     auto tt = std::chrono::system_clock::now();
 #endif
     while (GetNumberNewImages(&vfirst, &vlast) == DRV_NO_NEW_DATA) {
-      printf(">> No new data yet; waitin for new available image ...\n");
+      g_logger.debug(">> No new data yet; waitin for new available image ...");
       std::this_thread::sleep_for(std::chrono::milliseconds(1));
 #ifdef DEBUG
       if (std::chrono::duration_cast<std::chrono::seconds>(
               std::chrono::system_clock::now() - tt)
               .count() > 10) {
-        printf(">> Exiting wated for 10 secs and still no new image!\n");
+        g_logger.debug(">> Exiting wated for 10 secs and still no new image!");
         AbortAcquisition();
-        // allow reporter to end and join with main, and
+        // stop reporting, and
         // kill abort listening socket and join corresponding thread
-        g_mtx.unlock();
+        reporter.stop();
         shutdown(abort_socket_fd, 2);
-        report_t.join();
         abort_t.join();
+        writer.finish();
         socket_sprintf(socket, sockbuf,
                        "done;status:failed/error %d/%d while waiting "
                        "acquisition;error:%d;time:%s;",
@@ -197,9 +234,9 @@ int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
     }
 
 #ifdef DEBUG
-    printf(">> GetNumberNewImages(&vfirst, &vlast) returned vfirst=%d and "
-           "vlast=%d\n",
-           vfirst, vlast);
+    g_logger.debug(">> GetNumberNewImages(&vfirst, &vlast) returned "
+                   "vfirst=%d and vlast=%d",
+                   vfirst, vlast);
 #endif
 
     // get current image from circular buffer; copy to img_buffer
@@ -207,27 +244,25 @@ int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
                       xpixels * ypixels, &vfirst, &vlast);
 
 #ifdef DEBUG
-    printf(">> GetImages for image %d returned sizes: validfirst:%d, "
-           "validlast:%d\n",
-           cur_img_in_series, vfirst, vlast);
+    g_logger.debug(">> GetImages for image %d returned sizes: validfirst:%d, "
+                   "validlast:%d",
+                   cur_img_in_series, vfirst, vlast);
 #endif
 
     // did we get the data successefully ?
     if (error != DRV_SUCCESS) {
       char errorbuf[MAX_STATUS_STRING_SIZE];
-      fprintf(stderr,
-              "[ERROR][%s] Failed retrieving acquisition from cammera buffer! "
-              "Error: %s"
-              "(traceback: %s)\n",
-              date_str(buf), get_get_images_string(error, errorbuf), __func__);
+      g_logger.error("Failed retrieving acquisition from cammera buffer! "
+                     "Error: %s(traceback: %s)",
+                     get_get_images_string(error, errorbuf), __func__);
       AbortAcquisition();
 
-      // allow reporter to end and join with main, and
+      // stop reporting, and
       // kill abort listening socket and join corresponding thread
-      g_mtx.unlock();
+      reporter.stop();
       shutdown(abort_socket_fd, 2);
-      report_t.join();
       abort_t.join();
+      writer.finish();
 
       socket_sprintf(socket, sockbuf,
                      "done;status:failed/error image %d/%d while retrieving "
@@ -237,33 +272,74 @@ int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
       return 1;
     }
 
+    [[maybe_unused]] int64_t gi_ns = readout_timer.stop();
+
+    // time-stamp the frame (DATE-OBS, UT-START, ...)
+    if (frame_time) {
+      frame_times.resolve(*frame_time, cur_img_in_series);
+      frame_times.apply_headers(*frame_time, *fheaders);
+    }
+
+    // make the frame available to local consumers
+    publish_frame(params, fheaders, xpixels, ypixels, img_buffer,
+                  cur_img_in_series, exposure, frame_time);
+
 #ifdef DEBUG
-    printf(">> GetImage took %ld millisec (image %d/%d)\n",
-           std::chrono::duration_cast<std::chrono::milliseconds>(
-               std::chrono::system_clock::now() - gi_ci)
-               .count(),
-           cur_img_in_series, params->num_images_);
-    auto saf_ci = std::chrono::system_clock::now();
+    g_logger.debug(">> GetImage took %ld millisec (image %d/%d)",
+                   (long)(gi_ns / 1000000), cur_img_in_series,
+                   params->num_images_);
+    auto saf_ci = std::chrono::steady_clock::now();
 #endif
 
 #ifdef DEBUG
-    printf("[DEBUG][%s] Image acquired and saved to buffer for %d/%d\n",
-           date_str(buf), cur_img_in_series, params->num_images_);
+    g_logger.debug("Image acquired and saved to buffer for %d/%d",
+                   cur_img_in_series, params->num_images_);
 #endif
 
-    // save image to FITS format
-    if (save_as_fits(params, fheaders, xpixels, ypixels, img_buffer, socket,
-                     fits_filename, sockbuf)) {
+    // formulate a valid FITS filename to save the data to; frames after the
+    // first are numbered from the previous one (which may still be written)
+    auto filename_timer = g_latency_stats.timer(LatencyPhase::Filename);
+    int fn_status =
+        curimg ? get_following_fits_filename(params, fits_filename,
+                                              fits_filename)
+               : get_next_fits_filename(params, fits_filename);
+    filename_timer.stop();
+    if (fn_status) {
+      g_logger.error("Failed getting FITS filename! No FITS image saved "
+                     "(traceback: %s)",
+                     __func__);
       AbortAcquisition();
-      // allow reporter to end and join with main, and
+      // stop reporting, and
       // kill abort listening socket and join corresponding thread
-      g_mtx.unlock();
+      reporter.stop();
       shutdown(abort_socket_fd, 2);
-      report_t.join();
       abort_t.join();
+      writer.finish();
+      socket_sprintf(socket, sockbuf,
+                     "done;status:error saving FITS file;error:%d", 1);
       return 1;
     }
 
+    // save image to FITS format (on the task pool); a failure to write this
+    // or an earlier frame stops the series
+    if (writer.write(fits_filename, *fheaders, xpixels, ypixels,
+                     img_buffer)) {
+      AbortAcquisition();
+      // stop reporting, and
+      // kill abort listening socket and join corresponding thread
+      reporter.stop();
+      shutdown(abort_socket_fd, 2);
+      abort_t.join();
+      writer.finish();
+      socket_sprintf(socket, sockbuf,
+                     "done;error:1;status:error while saving to FITS;error:%d",
+                     15);
+      return 1;
+    }
+    if (!times_filename[0] &&
+        frame_times_filename(fits_filename, times_filename))
+      times_filename[0] = '\0';
+
     /* get a FITS filename according to conventions
     if (get_next_fits_filename(params, fits_filename)) {
       fprintf(stderr,
@@ -271,11 +347,10 @@ int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
               "(traceback: %s)\n",
               date_str(buf), __func__);
       AbortAcquisition();
-      // allow reporter to end and join with main, and
+      // stop reporting, and
       // kill abort listening socket and join corresponding thread
-      g_mtx.unlock();
+      reporter.stop();
       shutdown(abort_socket_fd, 2);
-      report_t.join();
       abort_t.join();
       socket_sprintf(socket, sockbuf, "done;status:error saving FITS file
     (%d/%d);error:%d;time:%s;", cur_img_in_series, params->num_images_, 1,
@@ -290,11 +365,10 @@ int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
               "%s)!\n",
               date_str(buf), __func__);
       AbortAcquisition();
-      // allow reporter to end and join with main, and
+      // stop reporting, and
       // kill abort listening socket and join corresponding thread
-      g_mtx.unlock();
+      reporter.stop();
       shutdown(abort_socket_fd, 2);
-      report_t.join();
       abort_t.join();
       socket_sprintf(socket, sockbuf, "done;error:1;status:error while saving to
     FITS, image (%d/%d);error:%d;time:%s;", cur_img_in_series,
@@ -319,29 +393,40 @@ int get_rta_scan(const AndorParameters *params, FitsHeaders *fheaders,
     */
 
 #ifdef DEBUG
-    printf(">> SaveToFits took %ld millisec (image %d/%d)\n",
-           std::chrono::duration_cast<std::chrono::milliseconds>(
-               std::chrono::system_clock::now() - saf_ci)
-               .count(),
-           cur_img_in_series, params->num_images_);
+    g_logger.debug(">> SaveToFits took %ld millisec (image %d/%d)",
+                   std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - saf_ci)
+                       .count(),
+                   cur_img_in_series, params->num_images_);
 #endif
 
   } // colected/saved all exposures!
 
 #ifdef DEBUG
-  printf(">> Series took %ld millisec\n",
-         std::chrono::duration_cast<std::chrono::milliseconds>(
-             std::chrono::system_clock::now() - series_start)
-             .count());
+  g_logger.debug(">> Series took %ld millisec",
+                 std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::system_clock::now() - series_start)
+                     .count());
 #endif
 
-  // Series done! allow reporter to end and join with main, and kill abort
-  // listening socket and join corresponding thread
-  g_mtx.unlock();
+  // Series done! final progress report, and kill abort listening socket and
+  // join corresponding thread
+  reporter.finish(cur_img_in_series);
   shutdown(abort_socket_fd, 2);
-  report_t.join();
   abort_t.join();
 
+  // one table with the times of all frames, next to the first frame; then
+  // wait for the frames still being written
+  if (times_filename[0])
+    writer.write_table(frame_times, times_filename);
+  if (writer.finish()) {
+    socket_sprintf(socket, sockbuf,
+                   "done;error:1;status:error while saving to FITS;error:%d",
+                   15);
+    AbortAcquisition();
+    return 1;
+  }
+
   // auto ful_stop_at = std::chrono::high_resolution_clock::now();
   socket_sprintf(socket, sockbuf,
                  "done;error:0;info:exposure series ok;status:acquired and "
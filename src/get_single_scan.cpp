@@ -1,8 +1,13 @@
 #include "acquisition_reporter.hpp"
+#include "acquisition_state.hpp"
 #include "andor2k.hpp"
 #include "andor_time_utils.hpp"
+#include "async_logger.hpp"
 #include "atmcdLXd.h"
 #include "fits_header.hpp"
+#include "get_exposure.hpp"
+#include "latency_stats.hpp"
+#include "metrics.hpp"
 #include <chrono>
 #include <condition_variable>
 #include <cppfits.hpp>
@@ -14,13 +19,14 @@
 
 using andor2k::Socket;
 
-extern std::mutex g_mtx;
 extern std::mutex g_mtx_abort;
-extern int abort_set;
+extern AcquisitionState g_acq_state;
 extern int abort_socket_fd;
 extern std::condition_variable cv;
-
-auto rs_lambda = [](AcquisitionReporter reporter) { reporter.report(); };
+extern AsyncLogger g_logger;
+extern LatencyStats g_latency_stats;
+extern DaemonMetrics g_metrics;
+extern ClockMonitor g_clock_monitor;
 
 /// @brief Get/Save a single scan acquisitionto FITS format
 /// The function will perform the following:
@@ -32,9 +38,8 @@ auto rs_lambda = [](AcquisitionReporter reporter) { reporter.report(); };
 /// @param[in] ypixels Number of y-axis pixels, aka height
 /// @param[in] img_buffer An array of int32_t large enough to hold
 ///                    xpixels*ypixels elements
-/// @note remember to set the (extern) variables:
-/// extern int stop_reporting_thread;
-/// extern int acquisition_thread_finished;
+/// @note progress is published on the (extern) g_acq_state; the acquisition
+/// should have been started (AcquisitionState::begin) by the caller
 int get_single_scan(const AndorParameters *params, FitsHeaders *fheaders,
                     int xpixels, int ypixels, at_32 *img_buffer,
                     const Socket &socket) noexcept {
@@ -58,6 +63,12 @@ int get_single_scan(const AndorParameters *params, FitsHeaders *fheaders,
   float exposure, accumulate, kinetic;
   GetAcquisitionTimings(&exposure, &accumulate, &kinetic);
 
+  // storage for the frame's timestamps
+  long timecorr_ns;
+  find_start_time_cor(fheaders, timecorr_ns);
+  FrameTimes frame_times(&g_clock_monitor);
+  frame_times.begin(1, exposure, timecorr_ns);
+
   // long millisec_per_image, total_millisec;
   // if (coarse_exposure_time(params, millisec_per_image, total_millisec)) {
   //  fprintf(stderr,
@@ -68,20 +79,18 @@ int get_single_scan(const AndorParameters *params, FitsHeaders *fheaders,
   //  total_millisec = params->num_images_ * millisec_per_image;
   //}
 
-  printf("[DEBUG][%s] Starting image acquisition ... with dimensions: %dx%d "
-         "stored at %p\n",
-         date_str(buf), xpixels, ypixels, (void *)img_buffer);
+  g_logger.debug("Starting image acquisition ... with dimensions: %dx%d "
+                 "stored at %p",
+                 xpixels, ypixels, (void *)img_buffer);
 
-  // start acquisition ...
-  auto acq_start_t = std::chrono::high_resolution_clock::now();
-  if (unsigned error = StartAcquisition(); error != DRV_SUCCESS) {
+  // start acquisition (at the scheduled time, if any) ...
+  if (unsigned error = start_acquisition(params, fheaders);
+      error != DRV_SUCCESS) {
     // failed to start acquisition .... report error and send it to client
     char acq_str[MAX_STATUS_STRING_SIZE];
-    fprintf(stderr,
-            "[ERROR][%s] Failed to start acquisition; error is: %s (traceback: "
-            "%s)\n",
-            date_str(buf), get_start_acquisition_status_string(error, acq_str),
-            __func__);
+    g_logger.error("Failed to start acquisition; error is: %s (traceback: %s)",
+                   get_start_acquisition_status_string(error, acq_str),
+                   __func__);
     socket_sprintf(socket, sockbuf,
                    "done;error:1;info:start acquisition error (%s);time:%s;",
                    acq_str, buf);
@@ -92,41 +101,36 @@ int get_single_scan(const AndorParameters *params, FitsHeaders *fheaders,
     return 1;
   }
 
-  // IMPORTANT!!
-  // get the global lock -- only release it when we are done with the
-  // acquisition
-  g_mtx.lock();
-
-  // spawn off a new thread to report status while we are waiting for the
+  // report status (via the timer service) while we are waiting for the
   // acquisition to end
-  std::thread report_t(
-      rs_lambda,
-      AcquisitionReporter(&socket, (long)(exposure * 1e3), acq_start_t));
+  auto acq_start_t = std::chrono::high_resolution_clock::now();
+  AcquisitionReporter reporter(&socket, (long)(exposure * 1e3), acq_start_t);
+  reporter.start();
 
   // wait for the acquisition ... (note that the already active abort-
   // listening socket, may receive an abort request while waiting (in which
-  // case, abort_set should be positive)
-  int status = WaitForAcquisition();
+  // case, an abort is marked on g_acq_state)
+  auto exposure_timer = g_latency_stats.timer(LatencyPhase::Exposure);
+  int status = wait_for_acquisition();
+  FrameTime *frame_time = frame_times.capture();
+  exposure_timer.stop();
   if (status != DRV_SUCCESS) { // error while waiting for acquisition to end...
-    fprintf(stderr,
-            "[ERROR][%s] Something happened while waiting for a new "
-            "acquisition! Aborting (traceback: %s)\n",
-            date_str(buf), __func__);
+    g_logger.error("Something happened while waiting for a new acquisition! "
+                   "Aborting (traceback: %s)",
+                   __func__);
     AbortAcquisition();
 
-    // allow reporter to end and join with main, and
+    // final progress report, and
     // kill abort listening socket and join corresponding thread
-    g_mtx.unlock();
+    reporter.finish(g_acq_state.abort_requested());
     shutdown(abort_socket_fd, 2);
-    report_t.join();
     abort_t.join();
 
     // report the error (maybe an abort requested by client)
-    if (abort_set) {
-      fprintf(stderr,
-              "[ERROR][%s] Abort requested by client while waiting for a new "
-              "acquisition! Aborting (traceback: %s)\n",
-              date_str(buf), __func__);
+    if (g_acq_state.abort_requested()) {
+      g_logger.error("Abort requested by client while waiting for a new "
+                     "acquisition! Aborting (traceback: %s)",
+                     __func__);
       socket_sprintf(
           socket, sockbuf,
           "done;status:unfinished (abort called by user);error:%d;time%s;",
@@ -140,39 +144,30 @@ int get_single_scan(const AndorParameters *params, FitsHeaders *fheaders,
     return 1;
   }
 
-  // at this point, either we successefully waited or not, we should unlock
-  // ... but we have not joined yet ....
-  // by the way, shutdown the listening socket (on the abort thread)
-  g_mtx.unlock();
+  // exposure is over; report that right away and shutdown the listening
+  // socket (on the abort thread)
+  g_acq_state.frame_done(1);
+  g_metrics.frame_acquired(true);
+  reporter.finish(false);
   shutdown(abort_socket_fd, 2);
 
   // get the acquired data and set the timer for end of acquisition
+  auto readout_timer = g_latency_stats.timer(LatencyPhase::Readout);
   unsigned int error = GetAcquiredData(img_buffer, xpixels * ypixels);
+  readout_timer.stop();
   // auto acq_stop_t = std::chrono::high_resolution_clock::now();
 
-  // enough time should have passed. join reporting and listening threads now
-  report_t.join();
+  // enough time should have passed. join listening thread now
   abort_t.join();
 
-  /* start of exposure time point is now, minus the correction
-  auto dtnow = std::chrono::high_resolution_clock::now();
-  dtnow -= std::chrono::milliseconds(start_time_corr);
-  char tbuf[64];
-  strfdt<DateTimeFormat::YMD>(dtnow, tbuf);
-  fheaders->update("DATE", tbuf, "Date of exposure start");
-  strfdt<DateTimeFormat::HMfS>(dtnow, tbuf);
-  fheaders->update("DATE", tbuf, "UT time of exposure time"); */
-
   // check for errors while getting acquired data
   if (error != DRV_SUCCESS) {
     // report error
     char errbuf[MAX_STATUS_STRING_SIZE];
-    fprintf(stderr,
-            "[ERROR][%s] Failed to get acquired data! Aborting acquisition, "
-            "error: %s "
-            "(traceback: %s)\n",
-            date_str(buf), get_get_acquired_data_status_string(error, errbuf),
-            __func__);
+    g_logger.error("Failed to get acquired data! Aborting acquisition, "
+                   "error: %s (traceback: %s)",
+                   get_get_acquired_data_status_string(error, errbuf),
+                   __func__);
     // abort acquisition
     AbortAcquisition();
     // report to client that an error occured
@@ -183,6 +178,16 @@ int get_single_scan(const AndorParameters *params, FitsHeaders *fheaders,
     return 2;
   }
 
+  // time-stamp the frame (DATE-OBS, UT-START, ...)
+  if (frame_time) {
+    frame_times.resolve(*frame_time, 1);
+    frame_times.apply_headers(*frame_time, *fheaders);
+  }
+
+  // make the frame available to local consumers
+  publish_frame(params, fheaders, xpixels, ypixels, img_buffer, 1, exposure,
+                frame_time);
+
   // report to client that data is acquired
   socket_sprintf(
       socket, sockbuf,
@@ -0,0 +1,107 @@
+#include "latency_stats.hpp"
+#include <cmath>
+#include <cstdio>
+
+const char *LatencyPhase2str(LatencyPhase p) noexcept {
+  switch (p) {
+  case LatencyPhase::Setup:
+    return "setup";
+  case LatencyPhase::StartAcquisition:
+    return "start";
+  case LatencyPhase::Exposure:
+    return "exposure";
+  case LatencyPhase::Readout:
+    return "readout";
+  case LatencyPhase::Filename:
+    return "filename";
+  case LatencyPhase::FitsWrite:
+    return "fitswrite";
+  case LatencyPhase::Headers:
+    return "headers";
+  case LatencyPhase::Close:
+    return "close";
+  case LatencyPhase::Aristarchos:
+    return "aristarchos";
+  case LatencyPhase::Report:
+    return "report";
+  case LatencyPhase::Jitter:
+    return "jitter";
+  }
+  return "unknown";
+}
+
+void LatencyHistogram::reset() noexcept {
+  for (auto &b : m_buckets)
+    b.store(0, std::memory_order_relaxed);
+  m_max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const noexcept {
+  uint64_t total = 0;
+  for (const auto &b : m_buckets)
+    total += b.load(std::memory_order_relaxed);
+  return total;
+}
+
+uint64_t LatencyHistogram::bucket_upper(int idx) noexcept {
+  if (idx < SUB_BUCKETS)
+    return idx;
+  int shift = idx / SUB_BUCKETS - 1;
+  uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + idx % SUB_BUCKETS)
+                   << shift;
+  return lower + (1ULL << shift) - 1;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const noexcept {
+  uint64_t total = count();
+  if (!total)
+    return 0;
+
+  uint64_t rank = static_cast<uint64_t>(std::ceil(q / 1e2 * total));
+  if (rank < 1)
+    rank = 1;
+  if (rank > total)
+    rank = total;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++) {
+    seen += m_buckets[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      // never report more than the max recorded value
+      uint64_t v = bucket_upper(i);
+      uint64_t mx = max();
+      return (mx && v > mx) ? mx : v;
+    }
+  }
+  return max();
+}
+
+void LatencyStats::reset() noexcept {
+  for (auto &h : m_hist)
+    h.reset();
+}
+
+int LatencyStats::format(char *buf, int buf_sz) const noexcept {
+  int len = 0;
+  if (buf_sz > 0)
+    buf[0] = '\0';
+  for (int i = 0; i < NUM_LATENCY_PHASES; i++) {
+    const LatencyHistogram &h = m_hist[i];
+    int sz = buf_sz - len;
+    int w = std::snprintf(buf + len, sz > 0 ? sz : 0,
+                          "%s%s:n=%lu,p50=%.3f,p90=%.3f,p99=%.3f,max=%.3f",
+                          i ? ";" : "",
+                          LatencyPhase2str(static_cast<LatencyPhase>(i)),
+                          static_cast<unsigned long>(h.count()),
+                          h.percentile(50e0) / 1e6, h.percentile(90e0) / 1e6,
+                          h.percentile(99e0) / 1e6, h.max() / 1e6);
+    if (w < 0 || w >= sz) {
+      // does not fit; drop the partial entry
+      if (len < buf_sz)
+        buf[len] = '\0';
+      break;
+    }
+    len += w;
+  }
+  return len;
+}
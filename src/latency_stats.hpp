@@ -0,0 +1,182 @@
+#ifndef __ANDOR2K_LATENCY_STATS_HPP__
+#define __ANDOR2K_LATENCY_STATS_HPP__
+
+#include "trace_recorder.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/// @brief The phases of an acquisition we keep latency statistics for
+enum class LatencyPhase : int_fast8_t {
+  Setup,            ///< setup_acquisition (including Aristarchos headers)
+  StartAcquisition, ///< the StartAcquisition call
+  Exposure,         ///< waiting for a frame (WaitForAcquisition)
+  Readout,          ///< retrieving a frame (GetImages, GetAcquiredData, ...)
+  Filename,         ///< generating the FITS filename
+  FitsWrite,        ///< writing the image data to the FITS file
+  Headers,          ///< applying the headers to the FITS file
+  Close,            ///< closing (flushing) the FITS file
+  Aristarchos,      ///< fetching/decoding the Aristarchos headers
+  Report,           ///< sending a progress report to the client
+  Jitter            ///< not a phase: frame-loop jitter, i.e. the change in
+                    ///< the interval between consecutive frames of a series
+}; // LatencyPhase
+
+constexpr int NUM_LATENCY_PHASES = 11;
+
+/// @brief Short name of a phase, e.g. "setup", "exposure", ...
+const char *LatencyPhase2str(LatencyPhase p) noexcept;
+
+/// @brief A histogram of durations (in nanoseconds), with logarithmic buckets
+///        each split in SUB_BUCKETS linear sub-buckets (as in HDR
+///        histograms); any recorded value is reported with a relative error
+///        of less than 1/SUB_BUCKETS (about 3%).
+/// Recording is wait-free (a single relaxed atomic increment, plus a rare
+/// update of the max), so that it can be done from any thread on the
+/// acquisition paths. Durations longer than
+/// about 18 minutes (2^40 ns) are clamped.
+class LatencyHistogram {
+public:
+  static constexpr int SUB_BITS = 5;
+  static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+  static constexpr int MAX_BITS = 40;
+  static constexpr int NUM_BUCKETS =
+      (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+  LatencyHistogram() noexcept { reset(); }
+  LatencyHistogram(const LatencyHistogram &) = delete;
+  LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+  void record(int64_t ns) noexcept {
+    uint64_t v = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+    m_buckets[bucket(v)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (v > max &&
+           !m_max.compare_exchange_weak(max, v, std::memory_order_relaxed))
+      ;
+  }
+
+  /// @brief Clear the histogram. Samples recorded concurrently may or may not
+  ///        survive the reset.
+  void reset() noexcept;
+
+  /// @brief Number of samples recorded
+  uint64_t count() const noexcept;
+
+  uint64_t max() const noexcept {
+    return m_max.load(std::memory_order_relaxed);
+  }
+
+  /// @brief The value (in ns) below which q percent of the samples fall,
+  ///        e.g. percentile(99.) for the 99th percentile; 0 if empty
+  uint64_t percentile(double q) const noexcept;
+
+  /// @brief Index of the bucket holding value v
+  static int bucket(uint64_t v) noexcept {
+    if (v < static_cast<uint64_t>(SUB_BUCKETS))
+      return static_cast<int>(v);
+    int exp = 63 - __builtin_clzll(v);
+    if (exp >= MAX_BITS)
+      return NUM_BUCKETS - 1;
+    int sub =
+        static_cast<int>(v >> (exp - SUB_BITS)) & (SUB_BUCKETS - 1);
+    return (exp - SUB_BITS + 1) * SUB_BUCKETS + sub;
+  }
+
+  /// @brief The largest value that falls in bucket idx
+  static uint64_t bucket_upper(int idx) noexcept;
+
+private:
+  std::atomic<uint64_t> m_buckets[NUM_BUCKETS];
+  std::atomic<uint64_t> m_max;
+}; // LatencyHistogram
+
+class LatencyTimer;
+
+/// @brief Latency histograms, one per acquisition phase. Collected all the
+///        time (timing a phase costs two clock readings and an atomic
+///        increment) and reported to clients via the daemon's "stats"
+///        command.
+class LatencyStats {
+public:
+  LatencyStats() noexcept = default;
+  LatencyStats(const LatencyStats &) = delete;
+  LatencyStats &operator=(const LatencyStats &) = delete;
+
+  void record(LatencyPhase p, int64_t ns) noexcept {
+    m_hist[static_cast<int>(p)].record(ns);
+  }
+
+  /// @brief Time a phase, from now until the timer is stopped or destroyed
+  LatencyTimer timer(LatencyPhase p) noexcept;
+
+  /// @brief Also record every timed phase as a (complete) event in tracer,
+  ///        whenever tracing is on
+  void set_tracer(TraceRecorder *tracer) noexcept { m_tracer = tracer; }
+  TraceRecorder *tracer() const noexcept { return m_tracer; }
+
+  const LatencyHistogram &histogram(LatencyPhase p) const noexcept {
+    return m_hist[static_cast<int>(p)];
+  }
+
+  void reset() noexcept;
+
+  /// @brief Write the statistics as a ';'-separated list, one entry per phase
+  ///        of the form "<phase>:n=<count>,p50=<ms>,p90=<ms>,p99=<ms>,
+  ///        max=<ms>" (durations in milliseconds)
+  /// @return Number of chars written (excluding the null terminator); if the
+  ///         buffer is too small, the output is truncated at the last
+  ///         complete entry
+  int format(char *buf, int buf_sz) const noexcept;
+
+private:
+  LatencyHistogram m_hist[NUM_LATENCY_PHASES];
+  TraceRecorder *m_tracer = nullptr;
+}; // LatencyStats
+
+/// @brief Measure the duration of a phase and record it in a LatencyStats
+///        instance, either when stop is called or on destruction (so that
+///        failed/early-exit paths are accounted for as well)
+class LatencyTimer {
+public:
+  using clock = std::chrono::steady_clock;
+
+  LatencyTimer(LatencyStats &stats, LatencyPhase p) noexcept
+      : m_stats(&stats), m_phase(p), m_start(clock::now()) {}
+  LatencyTimer(LatencyTimer &&other) noexcept
+      : m_stats(other.m_stats), m_phase(other.m_phase),
+        m_start(other.m_start) {
+    other.m_stats = nullptr;
+  }
+  LatencyTimer(const LatencyTimer &) = delete;
+  LatencyTimer &operator=(const LatencyTimer &) = delete;
+  LatencyTimer &operator=(LatencyTimer &&) = delete;
+  ~LatencyTimer() noexcept { stop(); }
+
+  /// @brief Record the time elapsed since construction; further calls do
+  ///        nothing
+  /// @return The duration recorded in nanoseconds (0 if already stopped)
+  int64_t stop() noexcept {
+    if (!m_stats)
+      return 0;
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     clock::now() - m_start)
+                     .count();
+    m_stats->record(m_phase, ns);
+    if (TraceRecorder *tracer = m_stats->tracer())
+      tracer->complete(LatencyPhase2str(m_phase), m_start, ns);
+    m_stats = nullptr;
+    return ns;
+  }
+
+private:
+  LatencyStats *m_stats;
+  LatencyPhase m_phase;
+  clock::time_point m_start;
+}; // LatencyTimer
+
+inline LatencyTimer LatencyStats::timer(LatencyPhase p) noexcept {
+  return LatencyTimer(*this, p);
+}
+
+#endif
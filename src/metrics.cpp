@@ -0,0 +1,119 @@
+#include "metrics.hpp"
+#include "andor2k.hpp"
+#include "thread_setup.hpp"
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+extern ThreadSetup g_thread_setup;
+
+/// @brief Max size of the metrics (body of the HTTP response)
+constexpr int METRICS_BUFFER_SIZE = 8192;
+
+int prometheus_append(char *buf, int buf_sz, int len, const char *name,
+                      const char *type, const char *help, double value,
+                      const char *labels) noexcept {
+  int sz = buf_sz - len;
+  if (sz <= 0)
+    return len;
+  int w;
+  if (type)
+    w = std::snprintf(buf + len, sz,
+                      "# HELP %s %s\n# TYPE %s %s\n%s%s%s%s %.17g\n", name,
+                      help, name, type, name, labels ? "{" : "",
+                      labels ? labels : "", labels ? "}" : "", value);
+  else
+    w = std::snprintf(buf + len, sz, "%s%s%s%s %.17g\n", name,
+                      labels ? "{" : "", labels ? labels : "",
+                      labels ? "}" : "", value);
+  if (w < 0 || w >= sz) {
+    buf[len] = '\0';
+    return len;
+  }
+  return len + w;
+}
+
+int MetricsServer::start(int port, Collector collector) noexcept {
+  char buf[32];
+  if (m_worker.joinable() || !collector)
+    return 1;
+  try {
+    m_server = std::make_unique<andor2k::ServerSocket>(port, "localhost");
+    m_collector = std::move(collector);
+    m_stop = false;
+    m_worker = std::thread(&MetricsServer::work, this);
+  } catch (std::exception &e) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to start metrics server on localhost:%d "
+            "(traceback: %s)\n",
+            date_str(buf), port, __func__);
+    m_server.reset();
+    return 1;
+  }
+  return 0;
+}
+
+void MetricsServer::stop() noexcept {
+  m_stop = true;
+  // wakes up the server thread, blocked in accept
+  if (m_server)
+    ::shutdown(m_server->sockid(), SHUT_RDWR);
+  if (m_worker.joinable())
+    m_worker.join();
+  m_server.reset();
+}
+
+void MetricsServer::work() noexcept {
+  g_thread_setup.setup_this_thread("andor-metrics", ThreadRole::Service);
+  char request[1024];
+  char body[METRICS_BUFFER_SIZE];
+  char header[256];
+  int status;
+
+  while (!m_stop) {
+    andor2k::Socket client = m_server->accept(status);
+    if (status < 0) {
+      if (m_stop)
+        break;
+      continue;
+    }
+
+    // a client that never sends its request must not block the server
+    client.set_option(SOL_SOCKET, SO_RCVTIMEO, timeval{1, 0});
+
+    // read (at least) the request line
+    int len = 0;
+    while (len < (int)sizeof(request) - 1) {
+      int bytes = client.recv(request + len, sizeof(request) - 1 - len);
+      if (bytes <= 0)
+        break;
+      len += bytes;
+      request[len] = '\0';
+      if (std::strstr(request, "\r\n"))
+        break;
+    }
+    if (len <= 0)
+      continue;
+    request[len] = '\0';
+
+    const char *status_line;
+    if (!std::strncmp(request, "GET /metrics ", 13) ||
+        !std::strncmp(request, "GET / ", 6)) {
+      status_line = "200 OK";
+      m_collector(body, sizeof(body));
+    } else {
+      status_line = "404 Not Found";
+      std::strcpy(body, "not found; try /metrics\n");
+    }
+    std::snprintf(header, sizeof(header),
+                  "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4; "
+                  "charset=utf-8\r\nContent-Length: %zu\r\nConnection: "
+                  "close\r\n\r\n",
+                  status_line, std::strlen(body));
+    // the client may have gone away; do not get killed by SIGPIPE
+    if (client.send(header, MSG_NOSIGNAL) > 0)
+      client.send(body, MSG_NOSIGNAL);
+    m_served.fetch_add(1, std::memory_order_relaxed);
+  }
+}
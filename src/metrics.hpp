@@ -0,0 +1,98 @@
+#ifndef __ANDOR2K_METRICS_HPP__
+#define __ANDOR2K_METRICS_HPP__
+
+#include "cpp_socket.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+/// @brief Counters describing what the daemon has been doing; updated (with
+///        relaxed atomics) on the acquisition paths, read by the metrics
+///        endpoint. Nothing here ever touches the SDK.
+struct DaemonMetrics {
+  std::atomic<uint64_t> frames_acquired{0};
+  std::atomic<uint64_t> frames_written{0};
+  std::atomic<uint64_t> bytes_written{0}; ///< image data written to FITS
+  std::atomic<int64_t> last_frame_ns{0};  ///< steady clock, last frame
+  std::atomic<int64_t> frame_interval_ns{0}; ///< between the last 2 frames
+  std::atomic<int64_t> last_write_ns{0};  ///< duration of last FITS write
+  std::atomic<uint64_t> aristarchos_ok{0};
+  std::atomic<uint64_t> aristarchos_failed{0};
+  std::atomic<int> clients{0}; ///< clients currently connected
+
+  /// @brief A frame was acquired; first_in_series is set for the first
+  ///        frame of an acquisition (no cadence is computed from it)
+  void frame_acquired(bool first_in_series) noexcept {
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    int64_t last = last_frame_ns.exchange(now, std::memory_order_relaxed);
+    if (!first_in_series && last)
+      frame_interval_ns.store(now - last, std::memory_order_relaxed);
+    frames_acquired.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /// @brief A frame was written to a FITS file
+  /// @param[in] bytes Size of the image data written
+  /// @param[in] write_ns Time to write the file (data, headers and close)
+  void frame_written(uint64_t bytes, int64_t write_ns) noexcept {
+    frames_written.fetch_add(1, std::memory_order_relaxed);
+    bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+    last_write_ns.store(write_ns, std::memory_order_relaxed);
+  }
+}; // DaemonMetrics
+
+/// @brief Append a metric, in Prometheus text exposition format, e.g.
+///        "# HELP name help\n# TYPE name gauge\nname{labels} value\n"
+/// @param[in] type "counter" or "gauge"; if nullptr, the HELP and TYPE lines
+///            are omitted (e.g. for further samples of a labelled metric)
+/// @param[in] labels Labels, e.g. "state=\"cooling\"" or nullptr
+/// @return The new length of the string in buf; if it does not fit, the
+///         metric is not appended
+int prometheus_append(char *buf, int buf_sz, int len, const char *name,
+                      const char *type, const char *help, double value,
+                      const char *labels = nullptr) noexcept;
+
+/// @brief A minimal HTTP server answering "GET /metrics" with a body in
+///        Prometheus text format, produced by a user-supplied callback.
+/// One request is served at a time, on a dedicated thread; it is meant to be
+/// scraped every few seconds by a local agent, so it listens on localhost
+/// only.
+class MetricsServer {
+public:
+  /// @brief Fills in buf (of size buf_sz) with the metrics; returns the
+  ///        number of chars written
+  using Collector = std::function<int(char *buf, int buf_sz)>;
+
+  MetricsServer() noexcept = default;
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+  ~MetricsServer() noexcept { stop(); }
+
+  /// @brief Start listening on localhost:port
+  /// @return 0 on success; anything else denotes an error (e.g. the port is
+  ///         in use)
+  int start(int port, Collector collector) noexcept;
+
+  /// @brief Stop serving; returns once the server thread has exited
+  void stop() noexcept;
+
+  /// @brief Number of requests served
+  uint64_t served() const noexcept {
+    return m_served.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::thread m_worker;
+  std::unique_ptr<andor2k::ServerSocket> m_server;
+  std::atomic<bool> m_stop{false};
+  std::atomic<uint64_t> m_served{0};
+  Collector m_collector;
+
+  void work() noexcept;
+}; // MetricsServer
+
+#endif
@@ -0,0 +1,234 @@
+#include "obs_queue.hpp"
+#include "andor2kd.hpp"
+#include "thread_setup.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+extern std::mutex g_camera_mtx;
+extern ThreadSetup g_thread_setup;
+
+int ObservationQueue::start(ObsJobExecutor exec, bool paused) noexcept {
+  char buf[32];
+  std::lock_guard<std::mutex> lock(m_mtx);
+  if (m_worker.joinable())
+    return 1;
+  m_exec = exec;
+  m_stop = false;
+  m_paused = paused;
+  try {
+    m_worker = std::thread(&ObservationQueue::work, this);
+  } catch (std::exception &) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to start observation queue worker "
+            "(traceback: %s)\n",
+            date_str(buf), __func__);
+    return 1;
+  }
+  return 0;
+}
+
+void ObservationQueue::stop() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stop = true;
+    m_jobs.clear();
+  }
+  m_cv.notify_all();
+  if (m_worker.joinable()) {
+    // stop may be called at exit, from a signal handler running on the
+    // worker itself
+    if (m_worker.get_id() == std::this_thread::get_id())
+      m_worker.detach();
+    else
+      m_worker.join();
+  }
+}
+
+void ObservationQueue::pause() noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  m_paused = true;
+}
+
+void ObservationQueue::resume() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_paused = false;
+  }
+  m_cv.notify_all();
+}
+
+bool ObservationQueue::paused() const noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_paused;
+}
+
+std::deque<ObservationJob>::iterator
+ObservationQueue::find(uint64_t id) noexcept {
+  return std::find_if(m_jobs.begin(), m_jobs.end(),
+                      [=](const ObservationJob &j) { return j.id == id; });
+}
+
+int ObservationQueue::insert(const char *command,
+                             const AndorParameters &params,
+                             const andor2k::Socket &socket, int position,
+                             uint64_t &id, CommandError *error) noexcept {
+  return add(command, params, socket, position, false, id, error);
+}
+
+int ObservationQueue::insert_immediate(const char *command,
+                                       const AndorParameters &params,
+                                       const andor2k::Socket &socket,
+                                       uint64_t &id,
+                                       CommandError *error) noexcept {
+  return add(command, params, socket, 0, true, id, error);
+}
+
+int ObservationQueue::add(const char *command, const AndorParameters &params,
+                          const andor2k::Socket &socket, int position,
+                          bool immediate, uint64_t &id,
+                          CommandError *error) noexcept {
+  char buf[32];
+
+  // resolve the command now, on a copy of the current parameters; any error
+  // is reported back to the client at submission time rather than when the
+  // job gets to run
+  ObservationJob job;
+  std::strncpy(job.command, command, MAX_SOCKET_BUFFER_SIZE - 1);
+  job.params = params;
+  if (resolve_image_parameters(command, job.params, error)) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to resolve image parameters for queued job "
+            "(traceback: %s)\n",
+            date_str(buf), __func__);
+    return 1;
+  }
+  job.socket = socket.duplicate();
+  job.immediate = immediate;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_stop || (int)m_jobs.size() >= MAX_QUEUED_JOBS)
+      return 2;
+    id = job.id = m_next_id++;
+    // immediate jobs go right after the last immediate job still waiting
+    if (immediate) {
+      auto last = std::find_if(
+          m_jobs.rbegin(), m_jobs.rend(),
+          [](const ObservationJob &j) { return j.immediate; });
+      position = std::distance(last, m_jobs.rend());
+    }
+    if (position < 0 || position >= (int)m_jobs.size())
+      m_jobs.push_back(std::move(job));
+    else
+      m_jobs.insert(m_jobs.begin() + position, std::move(job));
+  }
+  m_cv.notify_one();
+
+  printf("[DEBUG][%s] Queued job %lu: \"%s\"\n", date_str(buf), id, command);
+  return 0;
+}
+
+int ObservationQueue::cancel(uint64_t id) noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  auto it = find(id);
+  if (it == m_jobs.end())
+    return 1;
+  m_jobs.erase(it);
+  return 0;
+}
+
+int ObservationQueue::move(uint64_t id, int position) noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  auto it = find(id);
+  if (it == m_jobs.end())
+    return 1;
+  ObservationJob job = std::move(*it);
+  job.immediate = false;
+  m_jobs.erase(it);
+  if (position < 0 || position >= (int)m_jobs.size())
+    m_jobs.push_back(std::move(job));
+  else
+    m_jobs.insert(m_jobs.begin() + position, std::move(job));
+  return 0;
+}
+
+int ObservationQueue::clear() noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  int num_jobs = m_jobs.size();
+  m_jobs.clear();
+  return num_jobs;
+}
+
+uint64_t ObservationQueue::running() const noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_running;
+}
+
+int ObservationQueue::pending() const noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_jobs.size();
+}
+
+int ObservationQueue::list(char *buf, std::size_t buf_sz) const noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  std::size_t sz =
+      std::snprintf(buf, buf_sz, "running:%lu;pending:%d;paused:%d", m_running,
+                    (int)m_jobs.size(), (int)m_paused);
+  for (const auto &job : m_jobs) {
+    if (sz >= buf_sz)
+      break;
+    sz += std::snprintf(buf + sz, buf_sz - sz, ";job:%lu:%s", job.id,
+                        job.command);
+  }
+  return m_jobs.size();
+}
+
+/// The worker pops the front job as soon as the previous one has finished,
+/// so that consecutive jobs run without waiting for any client round trip.
+void ObservationQueue::work() noexcept {
+  g_thread_setup.setup_this_thread("andor-queue", ThreadRole::Service);
+  char buf[32];
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+
+  for (;;) {
+    ObservationJob job;
+    {
+      std::unique_lock<std::mutex> lock(m_mtx);
+      m_running = 0;
+      m_cv.wait(lock,
+                [this] { return m_stop || (!m_paused && !m_jobs.empty()); });
+      if (m_stop)
+        return;
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+      m_running = job.id;
+    }
+
+    std::lock_guard<std::mutex> camera_lock(g_camera_mtx);
+    printf("[DEBUG][%s] Starting queued job %lu: \"%s\"\n", date_str(buf),
+           job.id, job.command);
+
+    int status = 1;
+    if (job.socket) {
+      // everything the job sends to the client is tagged with its id, so
+      // that it can be told apart from direct replies on the connection
+      char tag[32];
+      std::snprintf(tag, sizeof(tag), "job:%lu", job.id);
+      job.socket->set_tag(tag);
+      socket_sprintf(*job.socket, sbuf, "job;status:started");
+      status = m_exec(job.params, *job.socket);
+      socket_sprintf(*job.socket, sbuf, "job;status:finished;error:%d",
+                     status);
+    }
+
+    if (status)
+      fprintf(stderr,
+              "[ERROR][%s] Queued job %lu failed with status %d (traceback: "
+              "%s)\n",
+              date_str(buf), job.id, status, __func__);
+    else
+      printf("[DEBUG][%s] Queued job %lu done\n", date_str(buf), job.id);
+  }
+}
@@ -0,0 +1,135 @@
+#ifndef __ANDOR2K_OBSERVATION_QUEUE_HPP__
+#define __ANDOR2K_OBSERVATION_QUEUE_HPP__
+
+#include "andor2k.hpp"
+#include "command_parser.hpp"
+#include "cpp_socket.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/// @brief Max number of jobs (not counting the running one) in the queue
+constexpr int MAX_QUEUED_JOBS = 64;
+
+/// @brief Function executing an (already resolved) image job; it is passed
+///        the job's parameters and the socket of the client that submitted
+///        the job. Should return 0 on success.
+using ObsJobExecutor = int (*)(AndorParameters &,
+                               const andor2k::Socket &) noexcept;
+
+/// @brief An image command waiting in the observation queue.
+/// The command is parsed and validated (aka resolve_image_parameters) when
+/// the job is submitted, so that nothing but the SDK setup and the
+/// acquisition itself is left to do when the job starts.
+struct ObservationJob {
+  uint64_t id{0};
+  char command[MAX_SOCKET_BUFFER_SIZE] = {'\0'};
+  AndorParameters params;
+  std::unique_ptr<andor2k::Socket> socket; ///< where to report progress
+  bool immediate{false}; ///< submitted via insert_immediate (and not moved)
+};
+
+/// @brief A server-side queue of image jobs, executed back-to-back by a
+///        dedicated worker thread.
+/// The worker holds g_camera_mtx for the duration of each job, so that any
+/// other command using the camera is serialized with the queue. A plain
+/// "image" is itself run as a job, ahead of the queued ones (see
+/// insert_immediate), so that the thread serving clients never waits for an
+/// acquisition.
+class ObservationQueue {
+public:
+  ObservationQueue() noexcept = default;
+  ObservationQueue(const ObservationQueue &) = delete;
+  ObservationQueue &operator=(const ObservationQueue &) = delete;
+  ~ObservationQueue() noexcept { stop(); }
+
+  /// @brief Start the worker thread; jobs are run via exec
+  /// @param[in] paused If true, jobs are accepted but not executed until
+  ///            resume is called (e.g. while the camera is initialising)
+  int start(ObsJobExecutor exec, bool paused = false) noexcept;
+
+  /// @brief Drop all pending jobs, wait for the running one (if any) to
+  ///        finish and join the worker thread
+  void stop() noexcept;
+
+  /// @brief Stop starting new jobs; the running job (if any) is not affected
+  void pause() noexcept;
+
+  /// @brief Resume starting jobs
+  void resume() noexcept;
+
+  bool paused() const noexcept;
+
+  /// @brief Resolve an image command and add it to the queue
+  /// @param[in] command The image command, e.g. "image --nimages 5 ..."
+  /// @param[in] params Parameters to start from (e.g. as set by setparam);
+  ///            the command's options are resolved on a copy of these
+  /// @param[in] socket Socket of the client submitting the job; progress of
+  ///            the job is reported here (via a duplicate of the socket),
+  ///            each message tagged with "job:[ID]" (see Socket::set_tag)
+  /// @param[in] position Zero-based position in the pending jobs; a negative
+  ///            value or a position past the end appends the job
+  /// @param[out] id The id assigned to the new job
+  /// @param[out] error If not nullptr, set to why the command could not be
+  ///            resolved (if it could not be parsed)
+  /// @return 0 on success, 1 if the command could not be resolved, 2 if the
+  ///         queue is full or stopped
+  int insert(const char *command, const AndorParameters &params,
+             const andor2k::Socket &socket, int position, uint64_t &id,
+             CommandError *error = nullptr) noexcept;
+
+  /// @brief Resolve an image command and add it ahead of all pending jobs,
+  ///        but after the immediate jobs still waiting, so that these run in
+  ///        the order they were submitted
+  /// @return As insert
+  int insert_immediate(const char *command, const AndorParameters &params,
+                       const andor2k::Socket &socket, uint64_t &id,
+                       CommandError *error = nullptr) noexcept;
+
+  /// @brief Remove a pending job from the queue
+  /// @return 0 on success, 1 if no pending job with the given id exists
+  int cancel(uint64_t id) noexcept;
+
+  /// @brief Move a pending job to a new (zero-based) position; a moved job
+  ///        is no longer treated as immediate
+  /// @return 0 on success, 1 if no pending job with the given id exists
+  int move(uint64_t id, int position) noexcept;
+
+  /// @brief Remove all pending jobs
+  /// @return Number of jobs removed
+  int clear() noexcept;
+
+  /// @brief Write a description of the queue to buf, in the format used by
+  ///        the socket protocol, e.g.
+  ///        "running:12;pending:2;paused:0;job:13:image --nimages 2;..."
+  /// @return Number of pending jobs
+  int list(char *buf, std::size_t buf_sz) const noexcept;
+
+  /// @brief Id of the job currently executing, 0 if the queue is idle
+  uint64_t running() const noexcept;
+
+  /// @brief Number of pending jobs
+  int pending() const noexcept;
+
+private:
+  mutable std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::deque<ObservationJob> m_jobs;
+  std::thread m_worker;
+  ObsJobExecutor m_exec = nullptr;
+  uint64_t m_next_id = 1;
+  uint64_t m_running = 0;
+  bool m_stop = false;
+  bool m_paused = false;
+
+  void work() noexcept;
+  int add(const char *command, const AndorParameters &params,
+          const andor2k::Socket &socket, int position, bool immediate,
+          uint64_t &id, CommandError *error) noexcept;
+  std::deque<ObservationJob>::iterator find(uint64_t id) noexcept;
+}; // ObservationQueue
+
+#endif
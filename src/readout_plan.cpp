@@ -0,0 +1,232 @@
+#include "readout_plan.hpp"
+#include "atmcdLXd.h"
+#include "setup_cache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <sys/statvfs.h>
+
+extern SetupCache g_setup_cache;
+
+namespace {
+using PlanOption = CommandOption<PlanRequest>;
+constexpr double FLOAT_MAX_D = std::numeric_limits<float>::max();
+
+/// @brief Options of the plan command; see resolve_plan_parameters
+constexpr PlanOption plan_options[] = {
+    {"--cadence", OptionType::Float, 1e-6, FLOAT_MAX_D,
+     [](PlanRequest &r, const OptionValue &v) noexcept {
+       r.cadence = static_cast<float>(v.f);
+       return 0;
+     }},
+    {"--exposure", OptionType::Float, 0, FLOAT_MAX_D,
+     [](PlanRequest &r, const OptionValue &v) noexcept {
+       r.exposure = static_cast<float>(v.f);
+       return 0;
+     }},
+    {"--width", OptionType::Int, 1, MAX_PIXELS_IN_DIM,
+     [](PlanRequest &r, const OptionValue &v) noexcept {
+       r.width = static_cast<int>(v.i);
+       return 0;
+     }},
+    {"--height", OptionType::Int, 1, MAX_PIXELS_IN_DIM,
+     [](PlanRequest &r, const OptionValue &v) noexcept {
+       r.height = static_cast<int>(v.i);
+       return 0;
+     }},
+    {"--nimages", OptionType::Int, 1, std::numeric_limits<int>::max(),
+     [](PlanRequest &r, const OptionValue &v) noexcept {
+       r.nimages = static_cast<int>(v.i);
+       return 0;
+     }},
+    {"--max-bin", OptionType::Int, 1, PLAN_MAX_BIN,
+     [](PlanRequest &r, const OptionValue &v) noexcept {
+       r.max_bin = static_cast<int>(v.i);
+       return 0;
+     }}};
+
+constexpr OptionTable plan_table("plan", OptionSyntax::Separate,
+                                 plan_options);
+static_assert(plan_table.valid(), "No perfect hash for plan options");
+
+/// @brief Fill in the size of a frame (and series) and the data rate
+void plan_data(const PlanRequest &request, const AndorParameters &params,
+               ReadoutPlan &plan) noexcept {
+  constexpr int64_t block = 2880; // FITS block
+  int64_t width = (plan.hend - plan.hstart + 1) / plan.bin;
+  int64_t height = (plan.vend - plan.vstart + 1) / plan.bin;
+  plan.frame_bytes = width * height * static_cast<int64_t>(sizeof(at_32));
+  int64_t file_bytes = PLAN_FITS_HEADER_BYTES +
+                       (plan.frame_bytes + block - 1) / block * block;
+  plan.series_bytes = file_bytes * request.nimages;
+  float cadence = plan.cycle > request.cadence ? plan.cycle : request.cadence;
+  plan.data_rate = plan.frame_bytes / static_cast<double>(cadence);
+  struct statvfs st;
+  plan.free_bytes = -1;
+  if (!statvfs(params.save_dir_, &st))
+    plan.free_bytes = static_cast<int64_t>(st.f_bavail) * st.f_frsize;
+}
+} // namespace
+
+int resolve_plan_parameters(const char *command, PlanRequest &request,
+                            CommandError *error) noexcept {
+  char buf[32];
+  CommandError cerror;
+  if (plan_table.parse(command, request, &cerror) == ParseError::None &&
+      request.cadence <= 0) {
+    // (the only option that must be given)
+    cerror.error = ParseError::MissingValue;
+    cerror.option = "--cadence";
+    cerror.offset = std::strlen(command);
+  }
+  if (cerror.error == ParseError::None)
+    return 0;
+  char ebuf[256];
+  cerror.format(ebuf, sizeof(ebuf));
+  fprintf(stderr, "[ERROR][%s] Invalid plan command: %s (traceback: %s)\n",
+          date_str(buf), ebuf, __func__);
+  if (error)
+    *error = cerror;
+  return 1;
+}
+
+/// Candidates are ordered by read noise: a slower horizontal readout has
+/// less, as does a higher pre-amp gain (in electrons); binning is on-chip
+/// and adds none, but costs resolution, so smaller binning comes first. The
+/// pre-amp gain does not change the timings, so the highest one is always
+/// chosen. The timings of each candidate are not modelled on the host but
+/// asked of the SDK (GetAcquisitionTimings, GetReadOutTime), with the
+/// camera set up as for the series (read-out mode, field, speeds, exposure,
+/// acquisition mode with no kinetic cycle time, shutter). The speed and gain
+/// tables are read off the SetupCache, and settings go through it, so that
+/// the next acquisition sets only what differs from the last candidate.
+/// Must be called on the thread setting up acquisitions (see SdkOwner).
+int plan_readout(const PlanRequest &request, const AndorParameters &params,
+                 ReadoutPlan &plan) noexcept {
+  char buf[32];
+
+  // camera invariants (cached, else ask)
+  int xpixels, ypixels, num_hs, num_gains;
+  if ((g_setup_cache.detector(xpixels, ypixels) &&
+       GetDetector(&xpixels, &ypixels) != DRV_SUCCESS) ||
+      (g_setup_cache.num_hsspeeds(num_hs) &&
+       GetNumberHSSpeeds(0, 0, &num_hs) != DRV_SUCCESS) ||
+      (g_setup_cache.num_preampgains(num_gains) &&
+       GetNumberPreAmpGains(&num_gains) != DRV_SUCCESS) ||
+      num_hs < 1 || num_hs > SETUP_CACHE_MAX_ENTRIES || num_gains < 1) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to query camera capabilities (traceback: "
+            "%s)\n",
+            date_str(buf), __func__);
+    return 2;
+  }
+
+  // horizontal speeds, slowest first
+  int order[SETUP_CACHE_MAX_ENTRIES];
+  float mhz[SETUP_CACHE_MAX_ENTRIES];
+  for (int i = 0; i < num_hs; i++) {
+    if (g_setup_cache.hsspeed(i, mhz[i]) &&
+        GetHSSpeed(0, 0, i, &mhz[i]) != DRV_SUCCESS) {
+      fprintf(stderr,
+              "[ERROR][%s] Failed to query horizontal speed %d (traceback: "
+              "%s)\n",
+              date_str(buf), i, __func__);
+      return 2;
+    }
+    int j = i;
+    for (; j > 0 && mhz[order[j - 1]] > mhz[i]; j--)
+      order[j] = order[j - 1];
+    order[j] = i;
+  }
+
+  // highest pre-amp gain
+  plan.preampgain = -1;
+  for (int i = 0; i < num_gains; i++) {
+    float factor;
+    if (g_setup_cache.preampgain(i, factor) &&
+        GetPreAmpGain(i, &factor) != DRV_SUCCESS)
+      continue;
+    if (plan.preampgain < 0 || factor > plan.preampgain_factor) {
+      plan.preampgain = i;
+      plan.preampgain_factor = factor;
+    }
+  }
+  if (plan.preampgain < 0) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to query pre-amp gains (traceback: %s)\n",
+            date_str(buf), __func__);
+    return 2;
+  }
+
+  // the series, as it would be set up
+  AndorParameters p = params;
+  p.read_out_mode_ = ReadOutMode::Image;
+  if (p.acquisition_mode_ != AcquisitionMode::KineticSeries)
+    p.acquisition_mode_ = AcquisitionMode::RunTillAbort;
+  p.num_images_ = request.nimages;
+  p.exposure_ = request.exposure < 0 ? params.exposure_ : request.exposure;
+  p.kinetics_cycle_time_ = 0;
+  int width = (request.width && request.width < xpixels) ? request.width
+                                                         : xpixels;
+  int height = (request.height && request.height < ypixels) ? request.height
+                                                            : ypixels;
+  if (setup_shutter(&p))
+    return 2;
+
+  ReadoutPlan fastest;
+  fastest.cycle = -1;
+  for (int k = 0; k < num_hs; k++) {
+    const int hs = order[k];
+    for (int bin = 1; bin <= request.max_bin; bin++) {
+      // a centered field, a multiple of the binning
+      int w = width - width % bin, h = height - height % bin;
+      if (!w || !h)
+        break;
+      p.image_hbin_ = p.image_vbin_ = bin;
+      p.image_hstart_ = (xpixels - w) / 2 + 1;
+      p.image_hend_ = p.image_hstart_ + w - 1;
+      p.image_vstart_ = (ypixels - h) / 2 + 1;
+      p.image_vend_ = p.image_vstart_ + h - 1;
+
+      float vsspeed, hsspeed_mhz, exposure, accumulate, kinetic, readout;
+      if (setup_read_out_mode(&p) || setup_acquisition_mode(&p) ||
+          set_fastest_recomended_vh_speeds(vsspeed, hs, hsspeed_mhz) ||
+          GetAcquisitionTimings(&exposure, &accumulate, &kinetic) !=
+              DRV_SUCCESS ||
+          GetReadOutTime(&readout) != DRV_SUCCESS) {
+        fprintf(stderr,
+                "[ERROR][%s] Failed to set up readout with horizontal speed "
+                "%d and binning %d (traceback: %s)\n",
+                date_str(buf), hs, bin, __func__);
+        return 2;
+      }
+      printf("[DEBUG][%s] Plan: %.3fMHz, binning %d, %dx%d pixels: readout "
+             "%.4f sec, cycle %.4f sec\n",
+             date_str(buf), hsspeed_mhz, bin, w / bin, h / bin, readout,
+             kinetic);
+
+      ReadoutPlan candidate = plan;
+      candidate.hsspeed = hs;
+      candidate.hsspeed_mhz = hsspeed_mhz;
+      candidate.bin = bin;
+      candidate.hstart = p.image_hstart_;
+      candidate.hend = p.image_hend_;
+      candidate.vstart = p.image_vstart_;
+      candidate.vend = p.image_vend_;
+      candidate.exposure = exposure;
+      candidate.readout = readout;
+      candidate.cycle = kinetic;
+      if (kinetic <= request.cadence) {
+        plan = candidate;
+        plan_data(request, params, plan);
+        return 0;
+      }
+      if (fastest.cycle < 0 || kinetic < fastest.cycle)
+        fastest = candidate;
+    }
+  }
+
+  plan = fastest;
+  plan_data(request, params, plan);
+  return 1;
+}
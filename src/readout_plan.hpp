@@ -0,0 +1,58 @@
+#ifndef __ANDOR2K_READOUT_PLAN_HPP__
+#define __ANDOR2K_READOUT_PLAN_HPP__
+
+#include "andor2k.hpp"
+#include "command_parser.hpp"
+#include <cstdint>
+
+/// @brief Max binning factor tried by plan_readout
+constexpr int PLAN_MAX_BIN = 16;
+
+/// @brief FITS headers, as assumed for the disk usage of a planned series
+///        (2 blocks of 36 cards)
+constexpr int PLAN_FITS_HEADER_BYTES = 2 * 2880;
+
+/// @brief What a series is to achieve, as given to the "plan" command
+struct PlanRequest {
+  float cadence{0};   ///< seconds from frame to frame
+  float exposure{-1}; ///< seconds; negative: the current exposure
+  int width{0};       ///< (unbinned) field, centered; 0: whole detector
+  int height{0};
+  int nimages{1};     ///< frames in the series (for disk usage)
+  int max_bin{1};     ///< binning factors tried, 1 to max_bin
+}; // PlanRequest
+
+/// @brief A readout configuration and what it is predicted to achieve
+struct ReadoutPlan {
+  int hsspeed{0}; ///< index
+  float hsspeed_mhz{0};
+  int preampgain{0}; ///< index
+  float preampgain_factor{0};
+  int bin{1};
+  int hstart{1}, hend{1}, vstart{1}, vend{1};
+  float exposure{0};
+  float readout{0}; ///< seconds, per frame
+  float cycle{0};   ///< shortest kinetic cycle, seconds
+  int64_t frame_bytes{0};  ///< pixel data of a frame
+  int64_t series_bytes{0}; ///< FITS files of the series
+  double data_rate{0};     ///< bytes/sec, at the requested cadence
+  int64_t free_bytes{-1};  ///< free space in the FITS directory (-1: unknown)
+}; // ReadoutPlan
+
+/// @brief Resolve a plan command-string, i.e.
+///        "plan --cadence [FLOAT] [--exposure [FLOAT]] [--width [INT]]
+///        [--height [INT]] [--nimages [INT]] [--max-bin [INT]]"
+/// @param[out] error If not nullptr, set to exactly what went wrong (if the
+///            command could not be parsed)
+/// @return 0 on success; anything else denotes an error
+int resolve_plan_parameters(const char *command, PlanRequest &request,
+                            CommandError *error = nullptr) noexcept;
+
+/// @brief Find the readout configuration with the lowest read noise that
+///        meets the requested cadence.
+/// @return 0 if a configuration meets the cadence; 1 if none does (plan is
+///         then the fastest configuration); anything else denotes an error
+int plan_readout(const PlanRequest &request, const AndorParameters &params,
+                 ReadoutPlan &plan) noexcept;
+
+#endif
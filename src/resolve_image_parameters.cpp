@@ -1,53 +1,165 @@
 #include "andor2k.hpp"
 #include "andor2kd.hpp"
+#include "command_parser.hpp"
 #include <cstdio>
-#include <cstdlib>
 #include <cstring>
+#include <limits>
+
+namespace {
+using Option = CommandOption<AndorParameters>;
+using Value = OptionValue;
+constexpr double INT_MAX_D = std::numeric_limits<int>::max();
+constexpr double FLOAT_MAX_D = std::numeric_limits<float>::max();
+
+/// @brief Copy a (validated) string value to a nul-terminated buffer
+template <std::size_t S>
+int copy_to(char (&buf)[S], std::string_view value) noexcept {
+  std::memset(buf, '\0', S);
+  value.copy(buf, S - 1);
+  return 0;
+}
+
+/// @brief Options of the image command; see resolve_image_parameters
+constexpr Option image_options[] = {
+    {"--nimages", OptionType::Int, 1, INT_MAX_D,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.num_images_ = static_cast<int>(v.i);
+       if (p.num_images_ == 1)
+         p.acquisition_mode_ = AcquisitionMode::SingleScan;
+       else if (p.acquisition_mode_ == AcquisitionMode::SingleScan)
+         p.acquisition_mode_ = AcquisitionMode::RunTillAbort;
+       return 0;
+     }},
+    {"--bin", OptionType::Int, 1, MAX_PIXELS_IN_DIM,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.image_hbin_ = p.image_vbin_ = static_cast<int>(v.i);
+       return 0;
+     }},
+    {"--hbin", OptionType::Int, 1, MAX_PIXELS_IN_DIM,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.image_hbin_ = static_cast<int>(v.i);
+       return 0;
+     }},
+    {"--vbin", OptionType::Int, 1, MAX_PIXELS_IN_DIM,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.image_vbin_ = static_cast<int>(v.i);
+       return 0;
+     }},
+    {"--hstart", OptionType::Int, 1, MAX_PIXELS_IN_DIM - 1,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.image_hstart_ = static_cast<int>(v.i);
+       return 0;
+     }},
+    {"--hend", OptionType::Int, 2, MAX_PIXELS_IN_DIM,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.image_hend_ = static_cast<int>(v.i);
+       return 0;
+     }},
+    {"--vstart", OptionType::Int, 1, MAX_PIXELS_IN_DIM - 1,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.image_vstart_ = static_cast<int>(v.i);
+       return 0;
+     }},
+    {"--vend", OptionType::Int, 2, MAX_PIXELS_IN_DIM,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.image_vend_ = static_cast<int>(v.i);
+       return 0;
+     }},
+    {"--filename", OptionType::String, 0, MAX_FITS_FILENAME_SIZE - 1,
+     [](AndorParameters &p, const Value &v) noexcept {
+       return copy_to(p.image_filename_, v.s);
+     }},
+    {"--type", OptionType::String, 0, MAX_IMAGE_TYPE_CHARS - 1,
+     [](AndorParameters &p, const Value &v) noexcept {
+       return copy_to(p.type_, v.s);
+     }},
+    {"--object", OptionType::String, 0, MAX_OBJECT_NAME_CHARS - 1,
+     [](AndorParameters &p, const Value &v) noexcept {
+       return copy_to(p.object_name_, v.s);
+     }},
+    {"--filter", OptionType::String, 0, MAX_FILTER_NAME_CHARS - 1,
+     [](AndorParameters &p, const Value &v) noexcept {
+       return copy_to(p.filter_name_, v.s);
+     }},
+    {"--exposure", OptionType::Float, 0, FLOAT_MAX_D,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.exposure_ = static_cast<float>(v.f);
+       return 0;
+     }},
+    {"--ar-tries", OptionType::Int, 0, INT_MAX_D,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.ar_hdr_tries_ = static_cast<int>(v.i);
+       return 0;
+     }},
+    {"--stable-within", OptionType::Float, -FLOAT_MAX_D, FLOAT_MAX_D,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.temp_tolerance_ = static_cast<float>(v.f);
+       return 0;
+     }},
+    {"--at", OptionType::Utc, 0, 0,
+     [](AndorParameters &p, const Value &v) noexcept {
+       p.start_at_ns_ = v.ns;
+       return 0;
+     }}};
+
+constexpr OptionTable image_table("image", OptionSyntax::Separate,
+                                  image_options);
+static_assert(image_table.valid(), "No perfect hash for image options");
+} // namespace
+
 
 /// @brief Resolve an image command-string
 /// An image command-string always starts with the string "image" and then is
-/// followed by a list of options which can be:
+/// followed by a list of options (names must match exactly; values must be
+/// entirely numeric where a number is expected, and within range) which can
+/// be:
 /// * --nimages [INT]
 ///     if [INT] > 1 then the function will set the Acquisition Mode to Run Till
 ///     Abort. If [INT] == 1, then the function will set the Acquisition Mode to
 ///     Single Scan.
-/// * --[vh]bin [INT] vertical or horizontal binning
+/// * --[vh]bin [INT] vertical or horizontal binning, in range [1, 2048]
 /// * --bin [INT] Sets both vertical and horizontal binning
-/// * --[vh]start [INT] starting pixel (inclusive, aka starting from 1 not 0)
-/// * --[vh]end [INT] ending pixel (inclusive, aka in range [1, 2048])
+/// * --[vh]start [INT] starting pixel (inclusive, aka in range [1, 2048))
+/// * --[vh]end [INT] ending pixel (inclusive, aka in range [2, 2048])
 /// * --filename [STRING] generic filename for exposure(s); a date-string, an
 ///     index and the extension .fits will be added to the filename(s) when
-///     acquiring the exposures.
+///     acquiring the exposures. At most 127 characters
 /// * --type [STRING] can be any of "flat", "bias", "object"
 /// * --exposure [FLOAT] exposure time in seconds
 /// * --ar-tries [INT] number of tries to access Aristarchos headers (0 means
-///     do not try at all)
+///     do not try at all); not negative
 /// * --object [STRING] Name of object; this will be writeen (as is) in the
 ///     FITS file header
 /// * --filter [STRING] Name of filter; this will be writeen (as is) in the
 ///     FITS file header
+/// * --stable-within [FLOAT] wait until the CCD temperature is within
+///     ±[FLOAT] Celsius of the target temperature before starting the
+///     acquisition; a negative value means do not wait
+/// * --at [UTC] start the acquisition at the given UTC time, formatted as
+///     "YYYY-MM-DDTHH:MM:SS[.fffffffff][Z]"; the time must be in the future.
+///     Unlike the other options, this only applies to the command it is given
+///     with
 ///
 /// @param[in] command A c-string holding the command to resolve; the string
 ///                    should start with the "image" token and hold as many
 ///                    options as needed. Here are examples of valid commands:
 /// "image --bin 2"
 /// "image --vbin 2 --hbin 4 --filename foobar --type object --exposure 4.6"
+///                    Options not listed above are skipped (with a warning).
 /// @param[out] params The parameters instance where the resolved options (as
 ///                    extracted from the command) are going to be saved. E.g.
 ///                    given "image --bin 2" the params variables from vertical
 ///                    and horizontal binning are goinf to be set to 2
+/// @param[out] error If not nullptr, set to exactly what went wrong (if the
+///                    command could not be parsed)
 /// @return Anything other than 0 denotes an error
-int resolve_image_parameters(const char *command,
-                             AndorParameters &params) noexcept {
+int resolve_image_parameters(const char *command, AndorParameters &params,
+                             CommandError *error) noexcept {
 
 #ifdef DEBUG
   printf(">> Resolving command: [%s]\n", command);
 #endif
 
-  // first string should be "image"
-  if (std::strncmp(command, "image", 5))
-    return 1;
-
   if (params.read_out_mode_ != ReadOutMode::Image) {
     printf("-----> WTF at start readoutmode is different!\n");
     return 4;
@@ -56,304 +168,19 @@ int resolve_image_parameters(const char *command,
   // datetime string buffer
   char buf[32];
 
-  // copy the input string so that we can tokenize it
-  char string[MAX_SOCKET_BUFFER_SIZE];
-  std::memcpy(string, command, sizeof(char) * MAX_SOCKET_BUFFER_SIZE);
-
-  char *token = std::strtok(string, " "); // this is the command (aka image)
-  token = std::strtok(nullptr, " ");
-  char *end;
-  // split remaining substring to tokens and process one at a time
-  while (token) {
-
-    /* NUM IMAGES
-     *--------------------------------------------------------*/
-    if (!std::strncmp(token, "--nimages", 9)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a numeric argument to \"--nimages\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      params.num_images_ = std::strtol(token, &end, 10);
-      if (end == token || params.num_images_ < 1) {
-        fprintf(stderr,
-                "[ERROR][%s] Failed to convert parameter \"%s\" to (valid) "
-                "integral numeric value (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-      if (params.num_images_ == 1) {
-        params.acquisition_mode_ = AcquisitionMode::SingleScan;
-      } else if (params.num_images_ > 1 &&
-                 params.acquisition_mode_ == AcquisitionMode::SingleScan) {
-        params.acquisition_mode_ = AcquisitionMode::RunTillAbort;
-      }
-
-      /* BINNING OPTIONS
-       * -------------------------------------------------------*/
-    } else if (!std::strncmp(token, "--bin", 5)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a numeric argument to \"--bin\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      params.image_vbin_ = std::strtol(token, &end, 10);
-      params.image_hbin_ = params.image_vbin_;
-      if (end == token) {
-        fprintf(stderr,
-                "[ERROR][%s] Failed to convert parameter \"%s\" to integral "
-                "numeric value (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-    } else if (!std::strncmp(token, "--hbin", 6)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a numeric argument to \"--hbin\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      params.image_hbin_ = std::strtol(token, &end, 10);
-      if (end == token) {
-        fprintf(stderr,
-                "[ERROR][%s] Failed to convert parameter \"%s\" to integral "
-                "numeric value (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-    } else if (!std::strncmp(token, "--vbin", 6)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a numeric argument to \"--vbin\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      params.image_vbin_ = std::strtol(token, &end, 10);
-      if (end == token) {
-        fprintf(stderr,
-                "[ERROR][%s] Failed to convert parameter \"%s\" to integral "
-                "numeric value (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-
-      /* IMAGE DIMENSIONS OPTIONS
-       * ----------------------------------------------*/
-    } else if (!std::strncmp(token, "--hstart", 8)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a numeric argument to \"--hstart\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      params.image_hstart_ = std::strtol(token, &end, 10);
-      if (end == token) {
-        fprintf(stderr,
-                "[ERROR][%s] Failed to convert parameter \"%s\" to integral "
-                "numeric value (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-    } else if (!std::strncmp(token, "--hend", 6)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a numeric argument to \"--hend\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      params.image_hend_ = std::strtol(token, &end, 10);
-      if (end == token) {
-        fprintf(stderr,
-                "[ERROR][%s] Failed to convert parameter \"%s\" to integral "
-                "numeric value (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-    } else if (!std::strncmp(token, "--vstart", 8)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a numeric argument to \"--vstart\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      params.image_vstart_ = std::strtol(token, &end, 10);
-      if (end == token) {
-        fprintf(stderr,
-                "[ERROR][%s] Failed to convert parameter \"%s\" to integral "
-                "numeric value (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-    } else if (!std::strncmp(token, "--vend", 6)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a numeric argument to \"--vend\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      params.image_vend_ = std::strtol(token, &end, 10);
-      if (end == token) {
-        fprintf(stderr,
-                "[ERROR][%s] Failed to convert parameter \"%s\" to integral "
-                "numeric value (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-      if (params.read_out_mode_ != ReadOutMode::Image) {
-        printf("-----> WTF at end readoutmode is different! a if\n");
-        return 4;
-      }
-
-      /* IMAGE FILENAME
-       * --------------------------------------------------------*/
-    } else if (!std::strncmp(token, "--filename", 10)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a string argument to \"--filename\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      if (std::strlen(token) >= 128) {
-        fprintf(stderr,
-                "[ERROR][%s] Invalid argument for \"%s\" (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-      std::memset(params.image_filename_, '\0', MAX_FITS_FILENAME_SIZE);
-      std::strcpy(params.image_filename_, token);
-      if (params.read_out_mode_ != ReadOutMode::Image) {
-        printf("-----> WTF at end readoutmode is different! a it\n");
-        return 4;
-      }
+  // a scheduled start only applies to the command it is given with
+  params.start_at_ns_ = 0;
 
-      /* IMAGE TYPE
-       * --------------------------------------------------------*/
-    } else if (!std::strncmp(token, "--type", 6)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a string argument to \"--type\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      if (std::strlen(token) >= MAX_IMAGE_TYPE_CHARS) {
-        fprintf(stderr,
-                "[ERROR][%s] Invalid argument for \"%s\" (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-      std::memset(params.type_, '\0', MAX_IMAGE_TYPE_CHARS);
-      std::strcpy(params.type_, token);
-
-      if (params.read_out_mode_ != ReadOutMode::Image) {
-        printf("-----> WTF at end readoutmode is different! a ot\n");
-        return 4;
-      }
-      /* OBJECT TYPE
-       * --------------------------------------------------------*/
-    } else if (!std::strncmp(token, "--object", 8)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a string argument to \"--object\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      if (std::strlen(token) >= MAX_OBJECT_NAME_CHARS) {
-        fprintf(stderr,
-                "[ERROR][%s] Invalid argument for \"%s\" (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-      std::memset(params.object_name_, '\0', MAX_OBJECT_NAME_CHARS);
-      std::strcpy(params.object_name_, token);
-
-      if (params.read_out_mode_ != ReadOutMode::Image) {
-        printf("-----> WTF at end readoutmode is different! a fn\n");
-        return 4;
-      }
-
-      /* FILTER NAME
-       * --------------------------------------------------------*/
-    } else if (!std::strncmp(token, "--filter", 8)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a string argument to \"--filter\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      if (std::strlen(token) >= MAX_FILTER_NAME_CHARS) {
-        fprintf(stderr,
-                "[ERROR][%s] Invalid argument for \"%s\" (traceback: %s)\n",
-                date_str(buf), token, __func__);
-        return 1;
-      }
-      std::memset(params.filter_name_, '\0', MAX_FILTER_NAME_CHARS);
-      std::strcpy(params.filter_name_, token);
-
-      if (params.read_out_mode_ != ReadOutMode::Image) {
-        printf("-----> WTF at end readoutmode is different! a e\n");
-        return 4;
-      }
-      /* EXPOSURE
-       * --------------------------------------------------------*/
-    } else if (!std::strncmp(token, "--exposure", 10)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide a float argument to \"--exposure\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      params.exposure_ = std::strtod(token, &end);
-      if (end == token || !(params.exposure_ >= 0e0)) {
-        fprintf(
-            stderr,
-            "[ERROR][%s] Failed to convert parameter \"%s\" to a (valid) float "
-            "numeric value (traceback: %s)\n",
-            date_str(buf), token, __func__);
-        return 1;
-      }
-
-      /* ARISTARCHOS HEADERS
-       * --------------------------------------------------------*/
-    } else if (!std::strncmp(token, "--ar-tries", 10)) {
-      if (token = std::strtok(nullptr, " "); token == nullptr) {
-        fprintf(stderr,
-                "[ERROR][%s] Must provide an int argument to \"--ar-tries\" "
-                "(traceback: %s)\n",
-                date_str(buf), __func__);
-        return 1;
-      }
-      params.ar_hdr_tries_ = std::strtol(token, &end, 10);
-      if (end == token) {
-        fprintf(
-            stderr,
-            "[ERROR][%s] Failed to convert parameter \"%s\" to a (valid) int "
-            "numeric value (traceback: %s)\n",
-            date_str(buf), token, __func__);
-        return 1;
-      }
-
-    } else {
-      fprintf(stderr,
-              "[WRNNG][%s] Ignoring input parameter \"%s\" (traceback: %s)\n",
-              date_str(buf), token, __func__);
-    }
-
-    token = std::strtok(nullptr, " "); // resolve next token (if any)
+  CommandError cerror;
+  if (image_table.parse(command, params, &cerror) != ParseError::None) {
+    char ebuf[256];
+    cerror.format(ebuf, sizeof(ebuf));
+    fprintf(stderr,
+            "[ERROR][%s] Invalid image command: %s (traceback: %s)\n",
+            date_str(buf), ebuf, __func__);
+    if (error)
+      *error = cerror;
+    return 1;
   }
 
   // some final testing
@@ -389,10 +216,6 @@ int resolve_image_parameters(const char *command,
     status = 2;
   }
 
-  // TODO why the fuck do i need this here? i actually think i don't, its fixed
-  std::memset(params.save_dir_, 0, 128);
-  std::strcpy(params.save_dir_, "/home/andor2k/fits");
-
   if (params.read_out_mode_ != ReadOutMode::Image) {
     fprintf(stderr,
             "[ERROR][%s] ReadOutMode can only be \'Image\', for some reason it "
@@ -1,63 +1,84 @@
 #include "andor2k.hpp"
 #include "andor2kd.hpp"
 #include "andor_time_utils.hpp"
+#include "async_logger.hpp"
 #include "atmcdLXd.h"
 #include "fits_header.hpp"
+#include "latency_stats.hpp"
+#include "metrics.hpp"
 #include <chrono>
 #include <cppfits.hpp>
 #include <cstdio>
 #include <cstring>
 
+extern AsyncLogger g_logger;
+extern LatencyStats g_latency_stats;
+extern DaemonMetrics g_metrics;
+
 int save_as_fits(const AndorParameters *params, FitsHeaders *fheaders,
                  int xpixels, int ypixels, at_32 *img_buffer,
                  const andor2k::Socket &socket, char *fits_filename,
                  char *socket_buffer) noexcept {
 
-  char buf[32] = {'\0'}; // buffer for datetime string
-
   // formulate a valid FITS filename to save the data to
-  if (get_next_fits_filename(params, fits_filename)) {
-    fprintf(stderr,
-            "[ERROR][%s] Failed getting FITS filename! No FITS image saved "
-            "(traceback: %s)\n",
-            date_str(buf), __func__);
+  auto filename_timer = g_latency_stats.timer(LatencyPhase::Filename);
+  int status = get_next_fits_filename(params, fits_filename);
+  filename_timer.stop();
+  if (status) {
+    g_logger.error("Failed getting FITS filename! No FITS image saved "
+                   "(traceback: %s)",
+                   __func__);
     AbortAcquisition();
     socket_sprintf(socket, socket_buffer,
                    "done;status:error saving FITS file;error:%d", 1);
     return 1;
   }
 
-  printf("[DEBUG][%s] Image acquired; saving to FITS file \"%s\" ...\n",
-         date_str(buf), fits_filename);
+  g_logger.debug("Image acquired; saving to FITS file \"%s\" ...",
+                 fits_filename);
 
-  // Create a FITS file and save the image at it
-  FitsImage<int32_t> fits(fits_filename, xpixels, ypixels);
-  if (fits.write<at_32>(img_buffer)) {
-    fprintf(stderr,
-            "[ERROR][%s] Failed writting data to FITS file (traceback: %s)!\n",
-            date_str(buf), __func__);
+  if (write_fits_frame(fits_filename, *fheaders, xpixels, ypixels,
+                       img_buffer)) {
     socket_sprintf(socket, socket_buffer,
                    "done;error:1;status:error while saving to FITS;error:%d",
                    15);
     return 1;
-  } else {
-    printf("[DEBUG][%s] Image written in FITS file %s\n", date_str(buf),
-           fits_filename);
-    socket_sprintf(socket, socket_buffer,
-                   "info:image saved to FITS;status:FITS file created %s",
-                   fits_filename);
   }
+  socket_sprintf(socket, socket_buffer,
+                 "info:image saved to FITS;status:FITS file created %s",
+                 fits_filename);
+  return 0;
+}
+
+int write_fits_frame(const char *fits_filename, FitsHeaders &fheaders,
+                     int xpixels, int ypixels,
+                     const at_32 *img_buffer) noexcept {
+  // Create a FITS file and save the image at it
+  auto write_timer = g_latency_stats.timer(LatencyPhase::FitsWrite);
+  FitsImage<int32_t> fits(fits_filename, xpixels, ypixels);
+  int status = fits.write<at_32>(const_cast<at_32 *>(img_buffer));
+  int64_t write_ns = write_timer.stop();
+  if (status) {
+    g_logger.error("Failed writting data to FITS file (traceback: %s)!",
+                   __func__);
+    return 1;
+  }
+  g_logger.debug("Image written in FITS file %s", fits_filename);
 
   // apply headers to FITS file and close
-  if (fits.apply_headers(*fheaders, false) < 0) {
-    fprintf(stderr,
-            "[WRNNG][%s] Some headers not applied in FITS file! Should inspect "
-            "file (traceback: %s)\n",
-            date_str(buf), __func__);
+  auto headers_timer = g_latency_stats.timer(LatencyPhase::Headers);
+  if (fits.apply_headers(fheaders, false) < 0) {
+    g_logger.warning("Some headers not applied in FITS file! Should inspect "
+                     "file (traceback: %s)",
+                     __func__);
   }
+  write_ns += headers_timer.stop();
 
   // close the (newly-created) FITS file
+  auto close_timer = g_latency_stats.timer(LatencyPhase::Close);
   fits.close();
+  write_ns += close_timer.stop();
+  g_metrics.frame_written(sizeof(int32_t) * xpixels * ypixels, write_ns);
 
   return 0;
 }
@@ -0,0 +1,93 @@
+#include "scheduled_start.hpp"
+#include "andor2k.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+
+namespace {
+int64_t monotonic_ns() noexcept {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+/// hint to the CPU that we are spinning
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+} // namespace
+
+int first_isolated_cpu() noexcept {
+  FILE *fp = std::fopen("/sys/devices/system/cpu/isolated", "r");
+  if (!fp)
+    return -1;
+  // a list of ranges, e.g. "2-3,6"; empty if there are no isolated CPUs
+  int cpu;
+  if (std::fscanf(fp, "%d", &cpu) != 1)
+    cpu = -1;
+  std::fclose(fp);
+  return cpu;
+}
+
+int ScheduledStart::wait_until(int64_t target_utc_ns,
+                               bool (*aborted)()) noexcept {
+  if (now_utc_ns() >= target_utc_ns)
+    return 2;
+
+  // sleep, in slices, until shortly before the target
+  for (;;) {
+    if (aborted && aborted())
+      return 1;
+    int64_t left = target_utc_ns - now_utc_ns();
+    if (left <= SCHEDULED_START_SPIN_NS)
+      break;
+    int64_t wake =
+        monotonic_ns() +
+        std::min(left - SCHEDULED_START_SPIN_NS, SCHEDULED_START_POLL_NS);
+    timespec ts{static_cast<time_t>(wake / 1000000000ll),
+                static_cast<long>(wake % 1000000000ll)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) ==
+           EINTR)
+      ;
+  }
+
+  // spin, on a single CPU, for the last bit
+  pin();
+  while (now_utc_ns() < target_utc_ns)
+    cpu_relax();
+  return 0;
+}
+
+void ScheduledStart::pin() noexcept {
+  char buf[32];
+  if (m_cpu < 0 || m_pinned || m_cpu >= CPU_SETSIZE)
+    return;
+  if (sched_getaffinity(0, sizeof(m_saved_affinity), &m_saved_affinity)) {
+    fprintf(stderr,
+            "[WRNNG][%s] Failed to get CPU affinity; not pinning thread "
+            "(traceback: %s)\n",
+            date_str(buf), __func__);
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(m_cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set)) {
+    fprintf(stderr,
+            "[WRNNG][%s] Failed to pin thread to CPU %d (traceback: %s)\n",
+            date_str(buf), m_cpu, __func__);
+    return;
+  }
+  m_pinned = true;
+}
+
+void ScheduledStart::unpin() noexcept {
+  if (!m_pinned)
+    return;
+  sched_setaffinity(0, sizeof(m_saved_affinity), &m_saved_affinity);
+  m_pinned = false;
+}
@@ -0,0 +1,76 @@
+#ifndef __ANDOR2K_SCHEDULED_START_HPP__
+#define __ANDOR2K_SCHEDULED_START_HPP__
+
+#include "clock_monitor.hpp"
+#include <cstdint>
+#include <ctime>
+#include <sched.h>
+
+/// @brief Stop sleeping this long before a scheduled start, and spin on the
+///        clock instead (covers the wake-up latency of the scheduler)
+constexpr int64_t SCHEDULED_START_SPIN_NS = 2000000;
+
+/// @brief Longest single sleep while waiting for a scheduled start, so that
+///        abort requests are noticed
+constexpr int64_t SCHEDULED_START_POLL_NS = 50000000;
+
+/// @brief The wait for a scheduled start is left to the SDK owner (which
+///        then calls StartAcquisition) only this long before it; up to then
+///        it is spent on the thread requesting the acquisition
+constexpr int64_t SCHEDULED_START_HANDOVER_NS = 200000000;
+
+/// @brief First CPU isolated from the scheduler (isolcpus=), as listed in
+///        /sys/devices/system/cpu/isolated
+/// @return The CPU number, or -1 if there is none
+int first_isolated_cpu() noexcept;
+
+/// @brief Wait for an absolute UTC instant, with low jitter.
+/// Most of the wait is spent sleeping on CLOCK_MONOTONIC (immune to steps of
+/// the system clock; the distance to the target is recomputed after every
+/// slice, so steps and changes of the NTP correction are followed). The last
+/// SCHEDULED_START_SPIN_NS are spent spinning on the (corrected) system
+/// clock, pinned to a single CPU (preferably an isolated one), so that the
+/// caller acts within microseconds of the target. The CPU affinity of the
+/// thread is restored by unpin (or on destruction).
+class ScheduledStart {
+public:
+  /// @param[in] monitor Clock offset to correct the system clock with, if any
+  /// @param[in] cpu CPU to spin on; -1 to spin wherever the thread runs
+  explicit ScheduledStart(const ClockMonitor *monitor = nullptr,
+                          int cpu = -1) noexcept
+      : m_monitor(monitor), m_cpu(cpu) {}
+  ScheduledStart(const ScheduledStart &) = delete;
+  ScheduledStart &operator=(const ScheduledStart &) = delete;
+  ~ScheduledStart() noexcept { unpin(); }
+
+  /// @brief Block until target_utc_ns
+  /// @param[in] aborted Polled while sleeping; the wait is cut short as soon
+  ///            as it returns true
+  /// @return 0 on time; 1 if aborted; 2 if the target had already passed
+  ///         (returns at once)
+  int wait_until(int64_t target_utc_ns, bool (*aborted)()) noexcept;
+
+  /// @brief Restore the CPU affinity of the thread, if it was pinned
+  void unpin() noexcept;
+
+  /// @brief (Corrected) UTC time, nanoseconds since the epoch
+  int64_t now_utc_ns() const noexcept {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t ns = ts.tv_sec * 1000000000ll + ts.tv_nsec;
+    return m_monitor ? ns + m_monitor->correction_ns() : ns;
+  }
+
+  /// @brief CPU the thread was pinned to, or -1
+  int pinned_cpu() const noexcept { return m_pinned ? m_cpu : -1; }
+
+private:
+  const ClockMonitor *m_monitor;
+  int m_cpu;
+  bool m_pinned{false};
+  cpu_set_t m_saved_affinity;
+
+  void pin() noexcept;
+}; // ScheduledStart
+
+#endif
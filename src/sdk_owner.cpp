@@ -0,0 +1,110 @@
+#include "sdk_owner.hpp"
+#include "andor2k.hpp"
+#include "thread_setup.hpp"
+#include <cstdio>
+
+extern ThreadSetup g_thread_setup;
+
+// out of line; too large to inline (see -Winline)
+SdkOwner::SdkOwner() noexcept = default;
+
+int SdkOwner::start() noexcept {
+  char buf[32];
+  std::lock_guard<std::mutex> lock(m_mtx);
+  if (m_worker.joinable())
+    return 1;
+  m_stop = false;
+  try {
+    m_worker = std::thread(&SdkOwner::work, this);
+  } catch (std::exception &) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to start SDK owner thread (traceback: %s)\n",
+            date_str(buf), __func__);
+    return 1;
+  }
+  m_owner_id.store(m_worker.get_id(), std::memory_order_release);
+  return 0;
+}
+
+void SdkOwner::stop() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  if (m_worker.joinable()) {
+    // stop may be called at exit, from a signal handler running on the
+    // owner itself
+    if (m_worker.get_id() == std::this_thread::get_id())
+      m_worker.detach();
+    else
+      m_worker.join();
+  }
+  m_owner_id.store(std::thread::id(), std::memory_order_release);
+}
+
+std::size_t SdkOwner::pending() const noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_commands.size();
+}
+
+bool SdkOwner::enqueue(std::function<void()> &&command,
+                       SdkAccess access) noexcept {
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_stop)
+      return false;
+    try {
+      m_commands.push_back(Command{std::move(command), access});
+    } catch (std::exception &) {
+      return false;
+    }
+  }
+  m_cv.notify_one();
+  return true;
+}
+
+/// Commands are run with the mutex released, so that anyone may queue more
+/// meanwhile; on stop, the commands already queued are run first (their
+/// submitters may be waiting for the results).
+void SdkOwner::work() noexcept {
+  g_thread_setup.setup_this_thread("andor-sdk", ThreadRole::Acquisition);
+  std::unique_lock<std::mutex> lock(m_mtx);
+  for (;;) {
+    m_cv.wait(lock, [this] { return m_stop || !m_commands.empty(); });
+    if (m_commands.empty())
+      return;
+    auto command = std::move(m_commands.front().run);
+    m_commands.pop_front();
+    lock.unlock();
+    command();
+    m_executed.fetch_add(1, std::memory_order_relaxed);
+    lock.lock();
+  }
+}
+
+/// Only the commands queued when yield is called are considered (those
+/// queued meanwhile wait for the next yield), so that a steady stream of
+/// queries cannot hold up the caller. Commands are only ever appended by
+/// others, so the position of the ones left behind does not change.
+int SdkOwner::yield() noexcept {
+  if (!on_owner_thread())
+    return 0;
+  int executed = 0;
+  std::unique_lock<std::mutex> lock(m_mtx);
+  std::size_t left = m_commands.size();
+  for (std::size_t i = 0; left > 0 && i < m_commands.size(); left--) {
+    if (m_commands[i].access != SdkAccess::Query) {
+      ++i;
+      continue;
+    }
+    auto command = std::move(m_commands[i].run);
+    m_commands.erase(m_commands.begin() + i);
+    lock.unlock();
+    command();
+    m_executed.fetch_add(1, std::memory_order_relaxed);
+    ++executed;
+    lock.lock();
+  }
+  return executed;
+}
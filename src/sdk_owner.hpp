@@ -0,0 +1,172 @@
+#ifndef __ANDOR2K_SDK_OWNER_HPP__
+#define __ANDOR2K_SDK_OWNER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/// @brief Longest time an acquisition waits for a frame without serving the
+///        queries queued on the SDK owner (see SdkOwner::yield)
+constexpr std::chrono::milliseconds SDK_YIELD_INTERVAL{250};
+
+/// @brief What a command sent to the SDK owner does to the camera
+enum class SdkAccess : int_fast8_t {
+  Exclusive, ///< e.g. sets the camera up; only runs between acquisitions
+  Query      ///< e.g. reads the temperature; safe while acquiring, so it may
+             ///< run whenever an acquisition yields
+}; // SdkAccess
+
+/// @brief The single thread allowed to talk to the Andor SDK.
+/// The SDK is not thread-safe (and SetCurrentCamera only applies to the
+/// calling thread), so every interaction is sent to this thread as a command
+/// and executed in FIFO order. submit returns a future for the command's
+/// result; call waits for it. Commands issued from the owner thread itself
+/// run inline, so that an acquisition (which runs on the owner as a whole,
+/// keeping its cache and core hot) may freely use code that calls the SDK
+/// through the owner.
+/// The one exception is CancelWait, which the SDK documents as the way to
+/// release a WaitForAcquisition blocked in another thread; abort paths call
+/// it directly.
+/// A command keeps the owner busy until it returns, except that a long one
+/// (an acquisition) calls yield while it waits, to run the queries (see
+/// SdkAccess) queued meanwhile; other commands wait for it to return.
+/// Periodic readers (e.g. the telemetry sampler) should use SdkPoll, so
+/// that they neither block nor pile up requests while the owner is busy.
+class SdkOwner {
+public:
+  SdkOwner() noexcept;
+  SdkOwner(const SdkOwner &) = delete;
+  SdkOwner &operator=(const SdkOwner &) = delete;
+  ~SdkOwner() noexcept { stop(); }
+
+  /// @brief Start the owner thread
+  /// @return 0 on success; anything else denotes an error
+  int start() noexcept;
+
+  /// @brief Stop the owner thread, once the commands already queued have
+  ///        run; from then on, commands run on the calling thread
+  void stop() noexcept;
+
+  bool running() const noexcept {
+    return m_owner_id.load(std::memory_order_acquire) != std::thread::id();
+  }
+
+  /// @brief Whether the calling thread is the owner thread
+  bool on_owner_thread() const noexcept {
+    return m_owner_id.load(std::memory_order_acquire) ==
+           std::this_thread::get_id();
+  }
+
+  /// @brief Queue f (a callable taking no arguments) for execution on the
+  ///        owner thread. f may outlive the caller, so it should capture by
+  ///        value unless the caller waits for the result.
+  /// @return A future for the result of f; an invalid future (valid() is
+  ///         false) if the owner is not running or on allocation failure
+  template <typename F>
+  auto submit(F &&f, SdkAccess access = SdkAccess::Exclusive) noexcept
+      -> std::future<decltype(f())>;
+
+  /// @brief Run f on the owner thread and wait for its result; f runs
+  ///        inline if called from the owner thread or if the owner is not
+  ///        running
+  template <typename F>
+  auto call(F &&f, SdkAccess access = SdkAccess::Exclusive) noexcept
+      -> decltype(f()) {
+    if (!on_owner_thread()) {
+      auto result = submit([&f] { return f(); }, access);
+      if (result.valid())
+        return result.get();
+    }
+    return f();
+  }
+
+  /// @brief Run (inline) the queries queued so far, skipping any other
+  ///        command; for a long command (e.g. an acquisition waiting for a
+  ///        frame) to serve others meanwhile. A no-op off the owner thread.
+  /// @return The number of queries run
+  int yield() noexcept;
+
+  /// @brief Commands waiting to be executed
+  std::size_t pending() const noexcept;
+
+  /// @brief Commands executed so far
+  uint64_t executed() const noexcept {
+    return m_executed.load(std::memory_order_relaxed);
+  }
+
+private:
+  mutable std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::thread m_worker;
+  struct Command {
+    std::function<void()> run;
+    SdkAccess access{SdkAccess::Exclusive};
+  }; // Command
+
+  std::deque<Command> m_commands;
+  std::atomic<std::thread::id> m_owner_id{std::thread::id()};
+  std::atomic<uint64_t> m_executed{0};
+  bool m_stop = false;
+
+  bool enqueue(std::function<void()> &&command, SdkAccess access) noexcept;
+  void work() noexcept;
+}; // SdkOwner
+
+template <typename F>
+auto SdkOwner::submit(F &&f, SdkAccess access) noexcept
+    -> std::future<decltype(f())> {
+  using R = decltype(f());
+  if (!running())
+    return std::future<R>();
+  try {
+    // std::function needs a copyable target, hence the shared task
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    auto result = task->get_future();
+    if (enqueue([task] { (*task)(); }, access))
+      return result;
+  } catch (std::exception &) {
+  }
+  return std::future<R>();
+}
+
+/// @brief A periodic request to the SDK owner, with at most one outstanding.
+/// poll waits (for a bounded time) for the result of the request; if the
+/// owner is busy (e.g. acquiring) the request is left queued and picked up
+/// by a later poll, instead of submitting another one. Polls are queries
+/// (see SdkAccess) unless told otherwise, so they are served while an
+/// acquisition yields.
+template <typename R> class SdkPoll {
+public:
+  /// @brief Submit f (unless a previous request is still pending) and wait
+  ///        up to timeout for the result; f runs inline if the owner is not
+  ///        running. f must capture by value.
+  /// @return true if result was set; false if the owner is busy
+  template <typename F>
+  bool poll(SdkOwner &owner, F &&f, std::chrono::milliseconds timeout,
+            R &result, SdkAccess access = SdkAccess::Query) noexcept {
+    if (!m_pending.valid()) {
+      m_pending = owner.submit(f, access);
+      if (!m_pending.valid()) {
+        result = f();
+        return true;
+      }
+    }
+    if (m_pending.wait_for(timeout) != std::future_status::ready)
+      return false;
+    result = m_pending.get();
+    return true;
+  }
+
+private:
+  std::future<R> m_pending;
+}; // SdkPoll
+
+#endif
@@ -0,0 +1,176 @@
+#include "series_writer.hpp"
+#include "andor2kd.hpp"
+#include "async_logger.hpp"
+#include "thread_setup.hpp"
+#include <cstring>
+#include <fitsio.h>
+#include <string>
+
+extern AsyncLogger g_logger;
+extern ThreadSetup g_thread_setup;
+
+SeriesWriter::SeriesWriter(TaskPool &pool,
+                           const andor2k::Socket *socket) noexcept
+    : m_pool(pool), m_socket(socket),
+      m_fits_reentrant(fits_is_reentrant()) {}
+
+SeriesWriter::~SeriesWriter() noexcept {
+  finish();
+  for (auto &slot : m_slots)
+    if (slot->locked)
+      g_thread_setup.unlock_memory(slot->pixels.data(),
+                                   sizeof(at_32) * slot->pixels.size());
+}
+
+/// Waits for a free slot; a new one is allocated while there are fewer than
+/// SERIES_WRITER_SLOTS.
+SeriesWriter::Slot *SeriesWriter::acquire(std::size_t pixels) noexcept {
+  Slot *slot = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(m_mtx);
+    if (m_free.empty() &&
+        static_cast<int>(m_slots.size()) >= SERIES_WRITER_SLOTS)
+      m_cv.wait(lock, [this] { return !m_free.empty(); });
+    if (!m_free.empty()) {
+      slot = m_free.back();
+      m_free.pop_back();
+    } else {
+      try {
+        // reserved up front, so that returning a slot never allocates
+        m_slots.reserve(SERIES_WRITER_SLOTS);
+        m_free.reserve(SERIES_WRITER_SLOTS);
+        m_slots.push_back(std::make_unique<Slot>());
+      } catch (std::exception &) {
+        return nullptr;
+      }
+      slot = m_slots.back().get();
+    }
+  }
+
+  // (re-)size the pixel buffer; frames of a series are all the same size
+  if (slot->pixels.size() != pixels) {
+    if (slot->locked)
+      g_thread_setup.unlock_memory(slot->pixels.data(),
+                                   sizeof(at_32) * slot->pixels.size());
+    slot->locked = false;
+    try {
+      slot->pixels.resize(pixels);
+      slot->pixels.shrink_to_fit();
+    } catch (std::exception &) {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_free.push_back(slot);
+      return nullptr;
+    }
+    slot->locked = !g_thread_setup.lock_memory(slot->pixels.data(),
+                                               sizeof(at_32) * pixels);
+  }
+  return slot;
+}
+
+int SeriesWriter::write(const char *filename, const FitsHeaders &headers,
+                        int xpixels, int ypixels,
+                        const at_32 *pixels) noexcept {
+  if (int error = this->error(); error)
+    return error;
+
+  std::size_t size = static_cast<std::size_t>(xpixels) * ypixels;
+  Slot *slot = acquire(size);
+  if (!slot) {
+    g_logger.error("Failed to allocate memory for a frame to write "
+                   "(traceback: %s)",
+                   __func__);
+    int expected = 0;
+    m_error.compare_exchange_strong(expected, 1);
+    return error();
+  }
+  std::memcpy(slot->pixels.data(), pixels, sizeof(at_32) * size);
+  try {
+    slot->headers.mvec = headers.mvec;
+  } catch (std::exception &) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_free.push_back(slot);
+    int expected = 0;
+    m_error.compare_exchange_strong(expected, 1);
+    return error();
+  }
+  std::strcpy(slot->filename, filename);
+  slot->width = xpixels;
+  slot->height = ypixels;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    ++m_pending;
+  }
+  if (!m_pool.submit(TaskType::FitsWrite, TaskPriority::Frame,
+                     [this, slot] { write_slot(*slot); }))
+    write_slot(*slot);
+  return error();
+}
+
+void SeriesWriter::write_slot(Slot &slot) noexcept {
+  char sbuf[MAX_SOCKET_BUFFER_SIZE];
+  std::unique_lock<std::mutex> fits_lock(m_fits_mtx, std::defer_lock);
+  if (!m_fits_reentrant)
+    fits_lock.lock();
+  int status = write_fits_frame(slot.filename, slot.headers, slot.width,
+                                slot.height, slot.pixels.data());
+  if (fits_lock.owns_lock())
+    fits_lock.unlock();
+  if (status) {
+    int expected = 0;
+    m_error.compare_exchange_strong(expected, 15, std::memory_order_release);
+  } else if (m_socket) {
+    socket_sprintf(*m_socket, sbuf,
+                   "info:image saved to FITS;status:FITS file created %s",
+                   slot.filename);
+  }
+  std::lock_guard<std::mutex> lock(m_mtx);
+  m_free.push_back(&slot);
+  --m_pending;
+  m_cv.notify_all();
+}
+
+void SeriesWriter::write_table(const FrameTimes &frame_times,
+                               const char *filename) noexcept {
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    ++m_pending;
+  }
+  try {
+    std::string name(filename);
+    if (m_pool.submit(TaskType::FrameTable, TaskPriority::Background,
+                      [this, &frame_times, name] {
+                        write_table_now(frame_times, name.c_str());
+                        done();
+                      }))
+      return;
+  } catch (std::exception &) {
+  }
+  write_table_now(frame_times, filename);
+  done();
+}
+
+void SeriesWriter::write_table_now(const FrameTimes &frame_times,
+                                   const char *filename) noexcept {
+  std::unique_lock<std::mutex> fits_lock(m_fits_mtx, std::defer_lock);
+  if (!m_fits_reentrant)
+    fits_lock.lock();
+  if (frame_times.write_table(filename))
+    g_logger.warning("Failed saving frame times to FITS file %s (traceback: "
+                     "%s)",
+                     filename, __func__);
+}
+
+/// Notified with the lock held: as soon as m_pending drops to 0, the writer
+/// may be destroyed.
+void SeriesWriter::done() noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  --m_pending;
+  m_cv.notify_all();
+}
+
+int SeriesWriter::finish() noexcept {
+  std::unique_lock<std::mutex> lock(m_mtx);
+  m_cv.wait(lock, [this] { return m_pending == 0; });
+  return error();
+}
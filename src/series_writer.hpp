@@ -0,0 +1,88 @@
+#ifndef __ANDOR2K_SERIES_WRITER_HPP__
+#define __ANDOR2K_SERIES_WRITER_HPP__
+
+#include "andor2k.hpp"
+#include "cpp_socket.hpp"
+#include "fits_header.hpp"
+#include "frame_times.hpp"
+#include "task_pool.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// @brief Max frames of a series being written at once; beyond that, write
+///        waits for a frame to be written
+constexpr int SERIES_WRITER_SLOTS = 4;
+
+/// @brief Writes the frames of a series to FITS files on the task pool, so
+///        that the acquisition thread only reads frames out of the SDK.
+/// Each frame (pixels and headers) is copied into one of
+/// SERIES_WRITER_SLOTS buffers (allocated on first use, and locked in RAM if
+/// so configured) and written by a frame-priority task; the copy bounds the
+/// memory used and lets the acquisition thread reuse its own buffer at once.
+/// If the pool is not running, frames are written inline. Unless cfitsio is
+/// reentrant, only one file is written at a time.
+/// Errors are sticky: once a write fails, further writes are refused, so
+/// that the acquisition can be stopped at the next frame.
+class SeriesWriter {
+public:
+  /// @param[in] socket If not nullptr, every file written is reported to it
+  ///            ("info:image saved to FITS;..."); must outlive the writer
+  explicit SeriesWriter(TaskPool &pool,
+                        const andor2k::Socket *socket = nullptr) noexcept;
+  SeriesWriter(const SeriesWriter &) = delete;
+  SeriesWriter &operator=(const SeriesWriter &) = delete;
+  /// @brief Waits for the frames still being written
+  ~SeriesWriter() noexcept;
+
+  /// @brief Write a frame to (new) FITS file filename
+  /// @return 0 if the frame is written or queued; anything else denotes an
+  ///         error (of this or of an earlier frame)
+  int write(const char *filename, const FitsHeaders &headers, int xpixels,
+            int ypixels, const at_32 *pixels) noexcept;
+
+  /// @brief Write the frame-times table of the series (as a background
+  ///        task); frame_times must not change until finish returns
+  void write_table(const FrameTimes &frame_times,
+                   const char *filename) noexcept;
+
+  /// @brief Wait until everything queued has been written
+  /// @return 0 if all frames were written; else the first error
+  int finish() noexcept;
+
+  /// @brief First error of a write (0 if none so far)
+  int error() const noexcept {
+    return m_error.load(std::memory_order_acquire);
+  }
+
+private:
+  struct Slot {
+    std::vector<at_32> pixels;
+    FitsHeaders headers;
+    char filename[MAX_FITS_FILE_SIZE];
+    int width{0};
+    int height{0};
+    bool locked{false};
+  };
+
+  TaskPool &m_pool;
+  const andor2k::Socket *m_socket;
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::vector<std::unique_ptr<Slot>> m_slots;
+  std::vector<Slot *> m_free;
+  int m_pending{0}; ///< tasks queued or running; guarded by m_mtx
+  std::atomic<int> m_error{0};
+  std::mutex m_fits_mtx; ///< serializes cfitsio calls, if not reentrant
+  bool m_fits_reentrant;
+
+  Slot *acquire(std::size_t pixels) noexcept;
+  void write_slot(Slot &slot) noexcept;
+  void write_table_now(const FrameTimes &frame_times,
+                       const char *filename) noexcept;
+  void done() noexcept;
+}; // SeriesWriter
+
+#endif
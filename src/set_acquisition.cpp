@@ -3,11 +3,57 @@
 #include "aristarchos.hpp"
 #include "atmcdLXd.h"
 #include "fits_header.hpp"
+#include "latency_stats.hpp"
+#include "metrics.hpp"
+#include "setup_cache.hpp"
+#include "telemetry.hpp"
 #include <cstdio>
 #include <cstring>
 
 using namespace std::chrono_literals;
 
+extern LatencyStats g_latency_stats;
+extern DaemonMetrics g_metrics;
+extern TelemetrySampler g_telemetry;
+extern SetupCache g_setup_cache;
+
+/// @brief Setup the shutter for an acquisition.
+/// If we are taking a dark (or bias) image, the shutter is kept closed;
+/// else it is set according to the params' shutter mode and times. When
+/// closing the shutter, it is given (1 sec) time to close. Nothing is done
+/// if the shutter is already set so (see SetupCache).
+/// @return 0 on success; anything else denotes an error
+int setup_shutter(const AndorParameters *params) noexcept {
+  char buf[32];
+  auto &applied = g_setup_cache.applied();
+  ShutterSetup shutter{ShutterMode2int(params->shutter_mode_),
+                       params->shutter_closing_time_,
+                       params->shutter_opening_time_};
+  bool closed = !std::strncmp(params->type_, "dark", 4) ||
+                !std::strncmp(params->type_, "bias", 4);
+  if (closed)
+    shutter.mode = ShutterMode2int(ShutterMode::PermanentlyClosed);
+  bool unchanged = (applied.shutter == shutter);
+  g_setup_cache.count(unchanged);
+  if (unchanged)
+    return 0;
+  applied.shutter.reset();
+  if (closed)
+    printf("[DEBUG][%s] Taking dark/bias frame so i am closing the shutter\n",
+           date_str(buf));
+  if (SetShutter(1, shutter.mode, shutter.closing_ms, shutter.opening_ms) !=
+      DRV_SUCCESS) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to initialize shutter! (traceback: %s)\n",
+            date_str(buf), __func__);
+    return 1;
+  }
+  applied.shutter = shutter;
+  if (closed)
+    std::this_thread::sleep_for(1000ms);
+  return 0;
+}
+
 /// @brief Setup an acquisition (single or multiple scans).
 /// The function will:
 /// * setup the Read Mode
@@ -19,6 +65,9 @@ using namespace std::chrono_literals;
 /// * allocate memory for (temporarily) storing image data
 /// On sucess, a call to get_acquisition should follow to actually perform
 /// the acquisition.
+/// Only settings that changed since the previous acquisition are passed to
+/// the SDK, and camera invariants are read off the SetupCache; back-to-back
+/// identical requests thus start (almost) at once.
 /// @param[in] params An AndorParameters instance holding information on the
 ///            acquisition we are going to setup.
 /// @param[in] fheaders A FitsHeaders instance; where needed, the function will
@@ -49,6 +98,9 @@ int setup_acquisition(const AndorParameters *params, FitsHeaders *fheaders,
 
   char buf[32] = {'\0'}; // buffer for datetime string
 
+  // recorded on return (whatever the outcome)
+  auto setup_timer = g_latency_stats.timer(LatencyPhase::Setup);
+
   // check and set read-out mode
   if (params->read_out_mode_ != ReadOutMode::Image) {
     fprintf(stderr,
@@ -82,32 +134,28 @@ int setup_acquisition(const AndorParameters *params, FitsHeaders *fheaders,
   // set pre-amp gain
   set_preampgain(*params);
 
-  // initialize shutter. Note that if we are taking a dark image, the shutter
-  // should be closed!
-  unsigned serror;
-  if (!std::strncmp(params->type_, "dark", 4) ||
-      !std::strncmp(params->type_, "bias", 4)) {
-    printf("[DEBUG][%s] Taking dark/bias frame so i am closing the shutter\n",
-           date_str(buf));
-    serror = SetShutter(1, ShutterMode2int(ShutterMode::PermanentlyClosed),
-                        params->shutter_closing_time_,
-                        params->shutter_opening_time_);
-    std::this_thread::sleep_for(1000ms);
-  } else {
-    serror = SetShutter(1, ShutterMode2int(params->shutter_mode_),
-                        params->shutter_closing_time_,
-                        params->shutter_opening_time_);
-  }
-  if (serror != DRV_SUCCESS) {
-    fprintf(stderr,
-            "[ERROR][%s] Failed to initialize shutter! (traceback: %s)\n",
-            date_str(buf), __func__);
+  // initialize shutter
+  if (setup_shutter(params))
     return 10;
+  auto &applied = g_setup_cache.applied();
+
+  // metadata lets the SDK report the start time of each frame relative to
+  // the first (GetRelativeImageTimes); without it, frame times are estimated
+  // on the host
+  if (!applied.metadata) {
+    if (SetMetaData(1) != DRV_SUCCESS)
+      fprintf(stderr,
+              "[WRNNG][%s] Failed to enable metadata; frame times will be "
+              "estimated on the host (traceback: %s)\n",
+              date_str(buf), __func__);
+    else
+      applied.metadata = true;
   }
 
   // get detector pixels
   int xpixels, ypixels;
-  if (GetDetector(&xpixels, &ypixels) != DRV_SUCCESS) {
+  if (g_setup_cache.detector(xpixels, ypixels) &&
+      GetDetector(&xpixels, &ypixels) != DRV_SUCCESS) {
     fprintf(stderr,
             "[ERROR][%s] Failed getting detector size! (traceback: %s)\n",
             date_str(buf), __func__);
@@ -141,20 +189,27 @@ int setup_acquisition(const AndorParameters *params, FitsHeaders *fheaders,
 
   // set the trigger mode to internal; this is default but still recommended
   // by the ANDOR guys
-  SetTriggerMode(0);
+  if (!applied.trigger_mode)
+    applied.trigger_mode = (SetTriggerMode(0) == DRV_SUCCESS);
 
   // try to get/decode Aristarchos headers if requested
   // TODO that could be done in another thread to save us some time!
   if (params->ar_hdr_tries_ > 0) {
     std::vector<FitsHeader> ar_headers;
     ar_headers.reserve(150);
-    if (get_aristarchos_headers(params->ar_hdr_tries_, ar_headers)) {
+    auto ar_timer = g_latency_stats.timer(LatencyPhase::Aristarchos);
+    int ar_status = get_aristarchos_headers(params->ar_hdr_tries_, ar_headers);
+    ar_timer.stop();
+    if (ar_status) {
+      g_metrics.aristarchos_failed.fetch_add(1, std::memory_order_relaxed);
       fprintf(stderr,
               "[ERROR][%s] Failed to fetch/decode Aristarchos headers "
               "(traceback: %s)\n",
               date_str(buf), __func__);
       // return 2;
       // do not stop if fetching headers fails!
+    } else {
+      g_metrics.aristarchos_ok.fetch_add(1, std::memory_order_relaxed);
     }
     if (ar_headers.size()) {
       if (fheaders->merge(ar_headers, true) < 0) {
@@ -205,7 +260,8 @@ int setup_acquisition(const AndorParameters *params, FitsHeaders *fheaders,
 
   float factor = -1;
   {
-    if (GetPreAmpGain(params->preampgain, &factor) != DRV_SUCCESS) {
+    if (g_setup_cache.preampgain(params->preampgain, factor) &&
+        GetPreAmpGain(params->preampgain, &factor) != DRV_SUCCESS) {
       fprintf(stderr,
               "[ERROR][%s] Failed retrieving Pre-Amp Gain for FITS header "
               "(traceback: %s)\n",
@@ -307,9 +363,18 @@ int setup_acquisition(const AndorParameters *params, FitsHeaders *fheaders,
     fprintf(stderr, "[WRNNG][%s] Failed to update header for TIMECORR\n",
             date_str(buf));
 
-  // get the camera's temperature for reporting in header
+  // get the camera's temperature for reporting in header; the latest
+  // telemetry sample if the sampler is running, else ask the SDK
   float tempf;
-  if (GetTemperatureF(&tempf) != DRV_TEMP_STABILIZED) {
+  unsigned temp_status;
+  if (g_telemetry.running()) {
+    auto tel = g_telemetry.snapshot();
+    tempf = tel.temp;
+    temp_status = tel.valid() ? tel.temp_status : DRV_NOT_INITIALIZED;
+  } else {
+    temp_status = GetTemperatureF(&tempf);
+  }
+  if (temp_status != DRV_TEMP_STABILIZED) {
     fprintf(stderr,
             "[ERROR][%s] Tried to get temperature for headers, but did not get "
             "a stabilized one! (traceback %s)\n",
@@ -1,8 +1,11 @@
 #include "andor2k.hpp"
 #include "atmcdLXd.h"
+#include "setup_cache.hpp"
 #include <cstdio>
 #include <limits>
 
+extern SetupCache g_setup_cache;
+
 /// @bief Set AcquisitionMode for Andor2k camera
 /// @see USER’S GUIDE TO SDK, Software Version 2.102
 ///
@@ -41,10 +44,21 @@
 /// @return An integer deonting the status of the AcquisitionSetup; anything
 ///         other than 0, denotes an error and a corresponding error message
 ///         will be written to stderr.
+/// @note If the camera is already set up so (see SetupCache), nothing is
+///       done.
 int setup_acquisition_mode(const AndorParameters *params) noexcept {
 
   unsigned int status;
   char buf[32] = {'\0'}; /* buffer to hold datetime string for reporting */
+
+  /* skip if nothing changed since last set */
+  auto &applied = g_setup_cache.applied();
+  AcquisitionModeSetup setup = AcquisitionModeSetup::of(*params);
+  g_setup_cache.count(applied.acquisition_mode == setup);
+  if (applied.acquisition_mode == setup)
+    return 0;
+  applied.acquisition_mode.reset();
+
   int imode = AcquisitionMode2int(params->acquisition_mode_);
   printf("[DEBUG][%s] Setting AcquisitionMode to %1d\n", date_str(buf), imode);
 
@@ -128,6 +142,7 @@ int setup_acquisition_mode(const AndorParameters *params) noexcept {
   /* Check the status of parameter setting done above */
   switch (status) {
   case DRV_SUCCESS:
+    applied.acquisition_mode = setup;
     return 0;
 
   case DRV_NOT_INITIALIZED:
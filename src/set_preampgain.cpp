@@ -1,16 +1,27 @@
 #include "andor2k.hpp"
 #include "aristarchos.hpp"
 #include "atmcdLXd.h"
+#include "setup_cache.hpp"
 #include <cstdio>
 #include <cstring>
 
+extern SetupCache g_setup_cache;
+
+/// @brief Set the Pre-Amp Gain to the index in params, unless already set
+///        (see SetupCache)
 int set_preampgain(const AndorParameters &params) noexcept {
   char buf[32] = {'\0'}; // buffer for datetime string
   int preampgain_index = params.preampgain;
+  auto &applied = g_setup_cache.applied();
+  g_setup_cache.count(applied.preampgain == preampgain_index);
+  if (applied.preampgain == preampgain_index)
+    return 0;
+  applied.preampgain.reset();
 
   /* make sure passed in index is ok */
   int noGains;
-  if (GetNumberPreAmpGains(&noGains) != DRV_SUCCESS) {
+  if (g_setup_cache.num_preampgains(noGains) &&
+      GetNumberPreAmpGains(&noGains) != DRV_SUCCESS) {
     fprintf(stderr,
             "[ERROR][%s] Failed getting number of PreAmpGain from camera! "
             "(traceback: %s)\n",
@@ -33,9 +44,11 @@ int set_preampgain(const AndorParameters &params) noexcept {
             date_str(buf), preampgain_index, __func__);
     return 1;
   }
+  applied.preampgain = preampgain_index;
 
   float factor;
-  if (GetPreAmpGain(preampgain_index, &factor) != DRV_SUCCESS) {
+  if (g_setup_cache.preampgain(preampgain_index, factor) &&
+      GetPreAmpGain(preampgain_index, &factor) != DRV_SUCCESS) {
     fprintf(stderr,
             "[ERROR][%s] Failed retrieving Pre-Amp Gain; wierd ..."
             "(traceback: %s)\n",
@@ -1,8 +1,11 @@
 #include "andor2k.hpp"
 #include "atmcdLXd.h"
+#include "setup_cache.hpp"
 #include <cstdio>
 #include <limits>
 
+extern SetupCache g_setup_cache;
+
 /// @bief Set ReadOutMode for Andor2k camera
 /// @see USER’S GUIDE TO SDK, Software Version 2.102
 ///
@@ -27,10 +30,21 @@
 /// @return An integer deonting the status of the Read Out Mode Setup; anything
 ///         other than 0, denotes an error and a corresponding error message
 ///         will be written to stderr.
+/// @note If the camera is already set up so (see SetupCache), nothing is
+///       done.
 int setup_read_out_mode(const AndorParameters *params) noexcept {
 
   char buf[32] = {'\0'}; /* buffer to store datetime string */
   unsigned int status;
+
+  /* skip if nothing changed since last set */
+  auto &applied = g_setup_cache.applied();
+  ReadModeSetup setup = ReadModeSetup::of(*params);
+  g_setup_cache.count(applied.read_mode == setup);
+  if (applied.read_mode == setup)
+    return 0;
+  applied.read_mode.reset();
+
   int irom = ReadOutMode2int(params->read_out_mode_);
   printf("[DEBUG][%s] Setting ReadOutMode to %1d\n", date_str(buf), irom);
 
@@ -103,6 +117,7 @@ int setup_read_out_mode(const AndorParameters *params) noexcept {
   switch (status) {
 
   case DRV_SUCCESS:
+    applied.read_mode = setup;
     retcode = 0;
     break;
 
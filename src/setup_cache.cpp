@@ -0,0 +1,169 @@
+#include "setup_cache.hpp"
+#include "atmcdLXd.h"
+#include <cstdio>
+
+ReadModeSetup ReadModeSetup::of(const AndorParameters &params) noexcept {
+  ReadModeSetup s{params.read_out_mode_, 0, 0, 0, 0, 0, 0, 0, 0};
+  if (params.read_out_mode_ == ReadOutMode::Image) {
+    s.hbin = params.image_hbin_;
+    s.vbin = params.image_vbin_;
+    s.hstart = params.image_hstart_;
+    s.hend = params.image_hend_;
+    s.vstart = params.image_vstart_;
+    s.vend = params.image_vend_;
+  } else if (params.read_out_mode_ == ReadOutMode::SingleTrack) {
+    s.track_center = params.singe_track_center_;
+    s.track_height = params.single_track_height_;
+  }
+  return s;
+}
+
+bool ReadModeSetup::operator==(const ReadModeSetup &other) const noexcept {
+  return mode == other.mode && hbin == other.hbin && vbin == other.vbin &&
+         hstart == other.hstart && hend == other.hend &&
+         vstart == other.vstart && vend == other.vend &&
+         track_center == other.track_center &&
+         track_height == other.track_height;
+}
+
+AcquisitionModeSetup
+AcquisitionModeSetup::of(const AndorParameters &params) noexcept {
+  AcquisitionModeSetup s{params.acquisition_mode_, params.exposure_, 0, 0, 0,
+                         0};
+  switch (params.acquisition_mode_) {
+  case AcquisitionMode::KineticSeries:
+    s.kinetic_cycle = params.kinetics_cycle_time_;
+    s.kinetics = params.num_images_;
+    [[fallthrough]];
+  case AcquisitionMode::Accumulate:
+    s.accumulation_cycle = params.accumulation_cycle_time_;
+    s.accumulations = params.num_accumulations_;
+    break;
+  case AcquisitionMode::RunTillAbort:
+    s.kinetic_cycle = params.kinetics_cycle_time_;
+    break;
+  default:
+    break;
+  }
+  return s;
+}
+
+bool AcquisitionModeSetup::operator==(
+    const AcquisitionModeSetup &other) const noexcept {
+  return mode == other.mode && exposure == other.exposure &&
+         accumulation_cycle == other.accumulation_cycle &&
+         kinetic_cycle == other.kinetic_cycle &&
+         accumulations == other.accumulations && kinetics == other.kinetics;
+}
+
+// out of line; too large to inline (see -Winline)
+SetupCache::SetupCache() noexcept = default;
+
+/// The tables are filled in before the cache is marked as loaded, so that
+/// readers on other threads either see them complete or fall back to the
+/// SDK.
+int SetupCache::load() noexcept {
+  char buf[32];
+  m_loaded.store(false, std::memory_order_release);
+  m_applied = Applied{};
+
+  int xpixels, ypixels, num_hs, num_gains, vs_index;
+  float vs;
+  if (GetDetector(&xpixels, &ypixels) != DRV_SUCCESS ||
+      GetNumberHSSpeeds(0, 0, &num_hs) != DRV_SUCCESS ||
+      GetNumberPreAmpGains(&num_gains) != DRV_SUCCESS ||
+      GetFastestRecommendedVSSpeed(&vs_index, &vs) != DRV_SUCCESS) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to query camera capabilities (traceback: "
+            "%s)\n",
+            date_str(buf), __func__);
+    return 1;
+  }
+  if (num_hs < 1 || num_hs > SETUP_CACHE_MAX_ENTRIES || num_gains < 1 ||
+      num_gains > SETUP_CACHE_MAX_ENTRIES) {
+    fprintf(stderr,
+            "[ERROR][%s] Unexpected number of speeds (%d) or pre-amp gains "
+            "(%d) (traceback: %s)\n",
+            date_str(buf), num_hs, num_gains, __func__);
+    return 1;
+  }
+  for (int i = 0; i < num_hs; i++) {
+    if (GetHSSpeed(0, 0, i, &m_hsspeeds[i]) != DRV_SUCCESS) {
+      fprintf(stderr,
+              "[ERROR][%s] Failed to query horizontal speed %d (traceback: "
+              "%s)\n",
+              date_str(buf), i, __func__);
+      return 1;
+    }
+  }
+  for (int i = 0; i < num_gains; i++) {
+    if (GetPreAmpGain(i, &m_preampgains[i]) != DRV_SUCCESS) {
+      fprintf(stderr,
+              "[ERROR][%s] Failed to query pre-amp gain %d (traceback: %s)\n",
+              date_str(buf), i, __func__);
+      return 1;
+    }
+  }
+  m_xpixels = xpixels;
+  m_ypixels = ypixels;
+  m_num_hsspeeds = num_hs;
+  m_num_preampgains = num_gains;
+  m_vsspeed_index = vs_index;
+  m_vsspeed = vs;
+  m_loaded.store(true, std::memory_order_release);
+
+  printf("[DEBUG][%s] Cached camera capabilities: detector %dx%d, %d "
+         "horizontal speeds, %d pre-amp gains, fastest recommended vertical "
+         "speed %.2f microsec (index %d)\n",
+         date_str(buf), xpixels, ypixels, num_hs, num_gains, vs, vs_index);
+  return 0;
+}
+
+void SetupCache::clear() noexcept {
+  m_loaded.store(false, std::memory_order_release);
+  m_applied = Applied{};
+}
+
+int SetupCache::detector(int &xpixels, int &ypixels) const noexcept {
+  if (!loaded())
+    return 1;
+  xpixels = m_xpixels;
+  ypixels = m_ypixels;
+  return 0;
+}
+
+int SetupCache::num_hsspeeds(int &num) const noexcept {
+  if (!loaded())
+    return 1;
+  num = m_num_hsspeeds;
+  return 0;
+}
+
+int SetupCache::hsspeed(int index, float &mhz) const noexcept {
+  if (!loaded() || index < 0 || index >= m_num_hsspeeds)
+    return 1;
+  mhz = m_hsspeeds[index];
+  return 0;
+}
+
+int SetupCache::num_preampgains(int &num) const noexcept {
+  if (!loaded())
+    return 1;
+  num = m_num_preampgains;
+  return 0;
+}
+
+int SetupCache::preampgain(int index, float &factor) const noexcept {
+  if (!loaded() || index < 0 || index >= m_num_preampgains)
+    return 1;
+  factor = m_preampgains[index];
+  return 0;
+}
+
+int SetupCache::fastest_vsspeed(int &index, float &us) const noexcept {
+  if (!loaded())
+    return 1;
+  index = m_vsspeed_index;
+  us = m_vsspeed;
+  return 0;
+}
@@ -0,0 +1,121 @@
+#ifndef __ANDOR2K_SETUP_CACHE_HPP__
+#define __ANDOR2K_SETUP_CACHE_HPP__
+
+#include "andor2k.hpp"
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+/// @brief Max number of horizontal speeds/pre-amp gains kept by SetupCache
+constexpr int SETUP_CACHE_MAX_ENTRIES = 16;
+
+/// @brief Read-out mode and area, as set by setup_read_out_mode; fields not
+///        used by the mode are left at 0
+struct ReadModeSetup {
+  ReadOutMode mode;
+  int hbin, vbin, hstart, hend, vstart, vend;
+  int track_center, track_height;
+
+  static ReadModeSetup of(const AndorParameters &params) noexcept;
+  bool operator==(const ReadModeSetup &other) const noexcept;
+}; // ReadModeSetup
+
+/// @brief Acquisition mode and timings, as set by setup_acquisition_mode;
+///        fields not used by the mode are left at 0
+struct AcquisitionModeSetup {
+  AcquisitionMode mode;
+  float exposure, accumulation_cycle, kinetic_cycle;
+  int accumulations, kinetics;
+
+  static AcquisitionModeSetup of(const AndorParameters &params) noexcept;
+  bool operator==(const AcquisitionModeSetup &other) const noexcept;
+}; // AcquisitionModeSetup
+
+/// @brief Shutter mode and timings, as passed to SetShutter
+struct ShutterSetup {
+  int mode;
+  int closing_ms, opening_ms;
+
+  bool operator==(const ShutterSetup &other) const noexcept {
+    return mode == other.mode && closing_ms == other.closing_ms &&
+           opening_ms == other.opening_ms;
+  }
+}; // ShutterSetup
+
+/// @brief What the camera was last told, so that setting up an acquisition
+///        only calls the SDK setters whose values changed.
+/// Invariants of the camera (detector size, horizontal speeds, pre-amp
+/// gains, fastest recommended vertical speed) are queried once, by load,
+/// after the SDK is initialized; they may be read from any thread. The
+/// settings last applied (see applied) are only used by the thread setting
+/// up acquisitions (see SdkOwner). A setting that is not known (never set,
+/// or its setter failed) is std::nullopt, and is always set.
+class SetupCache {
+public:
+  /// @brief Settings last applied to the camera
+  struct Applied {
+    std::optional<ReadModeSetup> read_mode;
+    std::optional<AcquisitionModeSetup> acquisition_mode;
+    std::optional<int> vsspeed; ///< index
+    std::optional<int> hsspeed; ///< index
+    std::optional<int> preampgain; ///< index
+    std::optional<ShutterSetup> shutter;
+    bool metadata{false};     ///< SetMetaData(1) done
+    bool trigger_mode{false}; ///< SetTriggerMode(0) done
+  }; // Applied
+
+  SetupCache() noexcept;
+  SetupCache(const SetupCache &) = delete;
+  SetupCache &operator=(const SetupCache &) = delete;
+
+  /// @brief Query the invariants of the (initialized) camera; forgets
+  ///        whatever was applied
+  /// @return 0 on success; anything else denotes an error (the cache is
+  ///         then not loaded, and callers query the SDK themselves)
+  int load() noexcept;
+
+  /// @brief Forget everything (e.g. once the SDK is shut down)
+  void clear() noexcept;
+
+  bool loaded() const noexcept {
+    return m_loaded.load(std::memory_order_acquire);
+  }
+
+  /// @return 0 if the value is cached; anything else if not loaded (or
+  ///         index out of range)
+  int detector(int &xpixels, int &ypixels) const noexcept;
+  int num_hsspeeds(int &num) const noexcept;
+  int hsspeed(int index, float &mhz) const noexcept;
+  int num_preampgains(int &num) const noexcept;
+  int preampgain(int index, float &factor) const noexcept;
+  int fastest_vsspeed(int &index, float &us) const noexcept;
+
+  Applied &applied() noexcept { return m_applied; }
+
+  /// @brief Account for a setup step, either skipped (value unchanged) or
+  ///        issued to the SDK
+  void count(bool skipped) noexcept {
+    (skipped ? m_skipped : m_issued).fetch_add(1, std::memory_order_relaxed);
+  }
+  uint64_t skipped() const noexcept {
+    return m_skipped.load(std::memory_order_relaxed);
+  }
+  uint64_t issued() const noexcept {
+    return m_issued.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<bool> m_loaded{false};
+  int m_xpixels{0}, m_ypixels{0};
+  int m_num_hsspeeds{0};
+  float m_hsspeeds[SETUP_CACHE_MAX_ENTRIES];
+  int m_num_preampgains{0};
+  float m_preampgains[SETUP_CACHE_MAX_ENTRIES];
+  int m_vsspeed_index{0};
+  float m_vsspeed{0};
+  Applied m_applied;
+  std::atomic<uint64_t> m_skipped{0};
+  std::atomic<uint64_t> m_issued{0};
+}; // SetupCache
+
+#endif
@@ -1,41 +1,53 @@
 #include "andor2k.hpp"
+#include "acquisition_state.hpp"
 #include "atmcdLXd.h"
+#include "sdk_owner.hpp"
+#include "setup_cache.hpp"
+#include "telemetry.hpp"
+#include "temperature_controller.hpp"
 #include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <limits>
 #include <thread>
 
 using namespace std::chrono_literals;
 
+extern TemperatureController g_temp_controller;
+extern TelemetrySampler g_telemetry;
+extern AcquisitionState g_acq_state;
+extern SdkOwner g_sdk;
+extern SetupCache g_setup_cache;
+
 /// @brief Max seconds to wait for when shuting down camera
 constexpr std::chrono::seconds MAX_DURATION_SEC =
     std::chrono::minutes{MAX_SHUTDOWN_DURATION};
 
-/// @brief Gracefully shutdown the ANDOR2K camera
-/// @see USER’S GUIDE TO SDK, Software Version 2.102
-///
-/// The shutdown procedure will perform the following tasks:
-/// * set the cooler to OFF state
-/// * monitor temperature untill we reach SHUTDOWN_TEMPERATURE
-/// * call ShutDown
-///
-/// @return Always returns 0
-int system_shutdown() noexcept {
+namespace {
+/// @brief The part of system_shutdown talking to the SDK (run on the SDK
+///        owner)
+/// @param[in] tel Latest telemetry, for the temperature; nullptr to read it
+int shutdown_camera(bool keep_cold, const TelemetrySnapshot *tel) noexcept {
 
   unsigned int status;
   int current_temp;
   char buf[32] = {'\0'}; /* buffer for datetime string */
 
+  // the status is read afresh; an acquisition may have started since the
+  // last sample
   int stat;
   GetStatus(&stat);
   if (stat == DRV_ACQUIRING)
     AbortAcquisition();
   char status_str[MAX_STATUS_STRING_SIZE];
   printf("[DEBUG][%s] Shutting down camera; last know state was: %s\n",
-         date_str(buf), get_status_string(status_str));
+         date_str(buf), get_status_string(stat, status_str));
 
   // get temperature for reporting
-  GetTemperature(&current_temp);
+  if (tel)
+    current_temp = static_cast<int>(std::lround(tel->temp));
+  else
+    GetTemperature(&current_temp);
   printf("[DEBUG][%s] Shutting down system ... (temperatue: %+3dC)\n",
          date_str(buf), current_temp);
 
@@ -66,6 +78,21 @@ int system_shutdown() noexcept {
   } else {
   } */
 
+  /* planned restart: keep the camera cold and shutdown right away */
+  if (keep_cold) {
+    status = SetCoolerMode(1);
+    if (status != DRV_SUCCESS)
+      fprintf(stderr,
+              "[ERROR][%s] Failed to set cooler mode; the camera may warm up "
+              "(error: %u, traceback: %s)\n",
+              date_str(buf), status, __func__);
+    else
+      printf("[DEBUG][%s] Cooler will maintain temperature after shutdown\n",
+             date_str(buf));
+    ShutDown();
+    return 0;
+  }
+
   /* if cooler is on, close it off */
   int cooler_on;
   status = IsCoolerOn(&cooler_on);
@@ -148,3 +175,44 @@ int system_shutdown() noexcept {
 
   return 0;
 }
+} // namespace
+
+/// @brief Gracefully shutdown the ANDOR2K camera
+/// @see USER’S GUIDE TO SDK, Software Version 2.102
+///
+/// The shutdown procedure will perform the following tasks:
+/// * stop the (background) temperature controller and telemetry sampler
+/// * abort the acquisition in progress, if any
+/// * set the cooler to OFF state
+/// * monitor temperature untill we reach SHUTDOWN_TEMPERATURE
+/// * call ShutDown
+///
+/// If keep_cold is set (e.g. when the daemon is restarted), the cooler is
+/// instead set to maintain the temperature after ShutDown (SetCoolerMode(1))
+/// and the warm-up steps are skipped.
+///
+/// @return Always returns 0
+int system_shutdown(bool keep_cold) noexcept {
+
+  // no more temperature control (or sampling) from here on; the last
+  // telemetry sample, if any, provides the temperature to start from
+  g_temp_controller.stop();
+  bool sampled = g_telemetry.running();
+  g_telemetry.stop();
+  auto tel = g_telemetry.snapshot();
+
+  // an acquisition (running on the SDK owner) is aborted first, so that the
+  // owner is free to shut the camera down; CancelWait may be called from
+  // any thread
+  if (acquisition_active(g_acq_state.snapshot().phase)) {
+    g_acq_state.request_abort();
+    CancelWait();
+  }
+  // whatever the camera was set up to is lost with the SDK
+  return g_sdk.call([&] {
+    int status =
+        shutdown_camera(keep_cold, sampled && tel.valid() ? &tel : nullptr);
+    g_setup_cache.clear();
+    return status;
+  });
+}
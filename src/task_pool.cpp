@@ -0,0 +1,272 @@
+#include "task_pool.hpp"
+#include "andor2k.hpp"
+#include "thread_setup.hpp"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+extern ThreadSetup g_thread_setup;
+
+namespace {
+/// the pool (and index) of the worker running on this thread, if any
+thread_local const TaskPool *t_pool = nullptr;
+thread_local int t_worker = -1;
+
+int64_t steady_ns() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int64_t thread_cpu_ns() noexcept {
+  timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+    return 0;
+  return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+} // namespace
+
+const char *TaskType2str(TaskType t) noexcept {
+  switch (t) {
+  case TaskType::FitsWrite:
+    return "fitswrite";
+  case TaskType::FrameTable:
+    return "frametable";
+  case TaskType::Other:
+    return "other";
+  }
+  return "unknown";
+}
+
+// out of line; too large to inline (see -Winline)
+TaskPool::TaskPool() noexcept = default;
+
+int TaskPool::start(int num_threads) noexcept {
+  char buf[32];
+  std::lock_guard<std::mutex> lock(m_mtx);
+  if (m_num_workers || m_stopped)
+    return 1;
+  if (num_threads < 1)
+    num_threads = 1;
+  if (num_threads > TASK_POOL_MAX_THREADS)
+    num_threads = TASK_POOL_MAX_THREADS;
+
+  try {
+    m_workers = std::make_unique<Worker[]>(num_threads);
+  } catch (std::exception &) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to allocate task pool (traceback: %s)\n",
+            date_str(buf), __func__);
+    return 1;
+  }
+  // workers (and their queues) are all set up before any thread runs; the
+  // queue of a worker whose thread failed to start is emptied by the others
+  m_num_workers = num_threads;
+  int started = 0;
+  for (int i = 0; i < num_threads; i++) {
+    try {
+      m_workers[i].thread = std::thread(&TaskPool::work, this, i);
+      ++started;
+    } catch (std::exception &) {
+      fprintf(stderr,
+              "[WRNNG][%s] Failed to start task pool thread %d (traceback: "
+              "%s)\n",
+              date_str(buf), i, __func__);
+    }
+  }
+  if (!started) {
+    m_stop = m_stopped = true;
+    return 1;
+  }
+  m_running.store(true, std::memory_order_release);
+  return 0;
+}
+
+void TaskPool::stop() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stop = m_stopped = true;
+    ++m_events;
+  }
+  m_cv.notify_all();
+  for (int i = 0; i < m_num_workers; i++) {
+    std::thread &t = m_workers[i].thread;
+    if (!t.joinable())
+      continue;
+    if (t.get_id() == std::this_thread::get_id())
+      t.detach();
+    else
+      t.join();
+  }
+  m_running.store(false, std::memory_order_release);
+}
+
+bool TaskPool::submit(TaskType type, TaskPriority priority,
+                      Task &&task) noexcept {
+  if (!running())
+    return false;
+  {
+    // the pool lock is held while queuing, so that stop never misses a task
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_stop)
+      return false;
+    int w = (t_pool == this)
+                ? t_worker
+                : static_cast<int>(m_next.fetch_add(1) % m_num_workers);
+    try {
+      std::lock_guard<std::mutex> wlock(m_workers[w].mtx);
+      m_workers[w].queue[static_cast<int>(priority)].push_back(
+          Item{std::move(task), type, priority, steady_ns(), w});
+    } catch (std::exception &) {
+      return false;
+    }
+    m_queued.fetch_add(1, std::memory_order_relaxed);
+    m_accounts[static_cast<int>(type)].submitted.fetch_add(
+        1, std::memory_order_relaxed);
+    ++m_events;
+  }
+  m_cv.notify_all();
+  return true;
+}
+
+/// Own queue first, then the others', frame tasks before background ones;
+/// queues are FIFO (frames of a series are written oldest first). Background
+/// tasks are left for later if all workers but one are already running one.
+bool TaskPool::take(int self, Item &item) noexcept {
+  for (int p = 0; p < NUM_TASK_PRIORITIES; p++) {
+    bool background = (p == static_cast<int>(TaskPriority::Background));
+    if (background && m_num_workers > 1 &&
+        m_background.fetch_add(1) >= m_num_workers - 1) {
+      m_background.fetch_sub(1);
+      return false;
+    }
+    for (int k = 0; k < m_num_workers; k++) {
+      Worker &w = m_workers[(self + k) % m_num_workers];
+      std::lock_guard<std::mutex> lock(w.mtx);
+      if (!w.queue[p].empty()) {
+        item = std::move(w.queue[p].front());
+        w.queue[p].pop_front();
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    if (background && m_num_workers > 1)
+      m_background.fetch_sub(1);
+  }
+  return false;
+}
+
+void TaskPool::run(int self, Item &item) noexcept {
+  char buf[32];
+  int64_t start = steady_ns();
+  int64_t cpu_start = thread_cpu_ns();
+  try {
+    item.task();
+  } catch (std::exception &) {
+    fprintf(stderr, "[ERROR][%s] Task of type %s threw (traceback: %s)\n",
+            date_str(buf), TaskType2str(item.type), __func__);
+  }
+  int64_t end = steady_ns();
+
+  Accounts &a = m_accounts[static_cast<int>(item.type)];
+  int64_t wait = start - item.queued_ns;
+  a.completed.fetch_add(1, std::memory_order_relaxed);
+  if (item.owner != self)
+    a.stolen.fetch_add(1, std::memory_order_relaxed);
+  a.wait_ns.fetch_add(wait, std::memory_order_relaxed);
+  a.run_ns.fetch_add(end - start, std::memory_order_relaxed);
+  a.cpu_ns.fetch_add(thread_cpu_ns() - cpu_start, std::memory_order_relaxed);
+  int64_t max = a.max_wait_ns.load(std::memory_order_relaxed);
+  while (wait > max && !a.max_wait_ns.compare_exchange_weak(
+                           max, wait, std::memory_order_relaxed))
+    ;
+  item.task = nullptr;
+
+  // a background slot is free again; wake whoever left one queued
+  if (item.priority == TaskPriority::Background && m_num_workers > 1) {
+    m_background.fetch_sub(1);
+    {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      ++m_events;
+    }
+    m_cv.notify_all();
+  }
+}
+
+void TaskPool::work(int self) noexcept {
+  char name[THREAD_NAME_MAX + 1];
+  std::snprintf(name, sizeof(name), "andor-pool-%d", self);
+  g_thread_setup.setup_this_thread(name, ThreadRole::Writer);
+  t_pool = this;
+  t_worker = self;
+
+  for (;;) {
+    uint64_t seen;
+    {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      seen = m_events;
+    }
+    Item item;
+    if (take(self, item)) {
+      run(self, item);
+      continue;
+    }
+    // nothing (we may run) left; sleep until something changes
+    std::unique_lock<std::mutex> lock(m_mtx);
+    if (m_stop && !m_queued.load(std::memory_order_relaxed))
+      return;
+    m_cv.wait(lock, [&] {
+      return m_events != seen ||
+             (m_stop && !m_queued.load(std::memory_order_relaxed));
+    });
+  }
+}
+
+TaskTypeStats TaskPool::stats(TaskType type) const noexcept {
+  const Accounts &a = m_accounts[static_cast<int>(type)];
+  TaskTypeStats s;
+  s.submitted = a.submitted.load(std::memory_order_relaxed);
+  s.completed = a.completed.load(std::memory_order_relaxed);
+  s.stolen = a.stolen.load(std::memory_order_relaxed);
+  s.wait_ns = a.wait_ns.load(std::memory_order_relaxed);
+  s.max_wait_ns = a.max_wait_ns.load(std::memory_order_relaxed);
+  s.run_ns = a.run_ns.load(std::memory_order_relaxed);
+  s.cpu_ns = a.cpu_ns.load(std::memory_order_relaxed);
+  return s;
+}
+
+void TaskPool::reset_stats() noexcept {
+  for (auto &a : m_accounts) {
+    a.submitted.store(0, std::memory_order_relaxed);
+    a.completed.store(0, std::memory_order_relaxed);
+    a.stolen.store(0, std::memory_order_relaxed);
+    a.wait_ns.store(0, std::memory_order_relaxed);
+    a.max_wait_ns.store(0, std::memory_order_relaxed);
+    a.run_ns.store(0, std::memory_order_relaxed);
+    a.cpu_ns.store(0, std::memory_order_relaxed);
+  }
+}
+
+int TaskPool::format(char *buf, int buf_sz) const noexcept {
+  int len = 0;
+  if (buf_sz > 0)
+    buf[0] = '\0';
+  for (int i = 0; i < NUM_TASK_TYPES; i++) {
+    TaskTypeStats s = stats(static_cast<TaskType>(i));
+    int sz = buf_sz - len;
+    int w = std::snprintf(
+        buf + len, sz > 0 ? sz : 0,
+        "%s%s:n=%lu,stolen=%lu,wait=%.3f,maxwait=%.3f,run=%.3f,cpu=%.3f",
+        i ? ";" : "", TaskType2str(static_cast<TaskType>(i)),
+        static_cast<unsigned long>(s.completed),
+        static_cast<unsigned long>(s.stolen), s.wait_ns / 1e6,
+        s.max_wait_ns / 1e6, s.run_ns / 1e6, s.cpu_ns / 1e6);
+    if (w < 0 || w >= sz) {
+      if (len < buf_sz)
+        buf[len] = '\0';
+      break;
+    }
+    len += w;
+  }
+  return len;
+}
@@ -0,0 +1,145 @@
+#ifndef __ANDOR2K_TASK_POOL_HPP__
+#define __ANDOR2K_TASK_POOL_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/// @brief Default number of pool threads; overridden by the
+///        ANDOR2KD_POOL_THREADS environment variable
+constexpr int TASK_POOL_THREADS = 2;
+
+/// @brief Max number of pool threads
+constexpr int TASK_POOL_MAX_THREADS = 16;
+
+/// @brief Priority of a task; workers always pick frame tasks first, and
+///        never run background tasks on all threads at once, so that frame
+///        tasks are not stuck behind background ones
+enum class TaskPriority : int_fast8_t {
+  Frame,     ///< keeps up with the frames of a series (e.g. FITS writes)
+  Background ///< anything that may wait (e.g. frame-times tables)
+}; // TaskPriority
+
+constexpr int NUM_TASK_PRIORITIES = 2;
+
+/// @brief What a task does; the pool keeps accounts per type
+enum class TaskType : int_fast8_t {
+  FitsWrite,  ///< writing a frame (data, headers) to a FITS file
+  FrameTable, ///< writing the frame-times table of a series
+  Other
+}; // TaskType
+
+constexpr int NUM_TASK_TYPES = 3;
+
+/// @brief Short name of a task type, e.g. "fitswrite"
+const char *TaskType2str(TaskType t) noexcept;
+
+/// @brief Accounts of the tasks of one type (times in nanoseconds)
+struct TaskTypeStats {
+  uint64_t submitted{0};
+  uint64_t completed{0};
+  uint64_t stolen{0};    ///< run by another worker than the one queued to
+  int64_t wait_ns{0};    ///< total time spent queued
+  int64_t max_wait_ns{0};
+  int64_t run_ns{0};     ///< total (wall) time spent running
+  int64_t cpu_ns{0};     ///< total CPU time of the worker while running
+}; // TaskTypeStats
+
+/// @brief A daemon-wide pool of worker threads for post-readout processing.
+/// Each worker has its own queues (one per priority); tasks submitted from
+/// outside the pool are dealt round-robin, tasks submitted by a worker go to
+/// its own queues. An idle worker takes from its own queues first and then
+/// steals from the others, frame tasks before background ones. Queues are
+/// short (a few frames in flight), so they are plain mutex-guarded deques.
+/// Workers are set up as writer threads (see ThreadSetup).
+class TaskPool {
+public:
+  using Task = std::function<void()>;
+
+  TaskPool() noexcept;
+  TaskPool(const TaskPool &) = delete;
+  TaskPool &operator=(const TaskPool &) = delete;
+  ~TaskPool() noexcept { stop(); }
+
+  /// @brief Start num_threads workers (at most TASK_POOL_MAX_THREADS)
+  /// @return 0 on success; anything else denotes an error
+  int start(int num_threads = TASK_POOL_THREADS) noexcept;
+
+  /// @brief Stop the workers, once the tasks already queued have run; the
+  ///        pool cannot be restarted
+  void stop() noexcept;
+
+  bool running() const noexcept {
+    return m_running.load(std::memory_order_acquire);
+  }
+
+  int size() const noexcept { return m_num_workers; }
+
+  /// @brief Queue a task
+  /// @return false if the pool is not running (or on allocation failure);
+  ///         the task is not run then
+  bool submit(TaskType type, TaskPriority priority, Task &&task) noexcept;
+
+  /// @brief Tasks queued and not yet started
+  int pending() const noexcept {
+    return m_queued.load(std::memory_order_relaxed);
+  }
+
+  /// @brief Accounts of the tasks of a type (since start or reset_stats)
+  TaskTypeStats stats(TaskType type) const noexcept;
+
+  void reset_stats() noexcept;
+
+  /// @brief Write the accounts as a ';'-separated list, one entry per task
+  ///        type, of the form "<type>:n=<completed>,stolen=<count>,
+  ///        wait=<ms>,maxwait=<ms>,run=<ms>,cpu=<ms>" (totals)
+  /// @return Number of chars written (excluding the null terminator)
+  int format(char *buf, int buf_sz) const noexcept;
+
+private:
+  struct Item {
+    Task task;
+    TaskType type;
+    TaskPriority priority;
+    int64_t queued_ns;
+    int owner; ///< worker queued to
+  };
+  struct Worker {
+    std::mutex mtx;
+    std::deque<Item> queue[NUM_TASK_PRIORITIES];
+    std::thread thread;
+  };
+  struct Accounts {
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> stolen{0};
+    std::atomic<int64_t> wait_ns{0};
+    std::atomic<int64_t> max_wait_ns{0};
+    std::atomic<int64_t> run_ns{0};
+    std::atomic<int64_t> cpu_ns{0};
+  };
+
+  std::unique_ptr<Worker[]> m_workers;
+  int m_num_workers{0};
+  Accounts m_accounts[NUM_TASK_TYPES];
+  std::atomic<unsigned> m_next{0};       ///< round-robin for submissions
+  std::atomic<int> m_queued{0};          ///< tasks in all queues
+  std::atomic<int> m_background{0};      ///< background tasks running
+  std::atomic<bool> m_running{false};
+  std::mutex m_mtx; ///< idle workers sleep on m_cv
+  std::condition_variable m_cv;
+  uint64_t m_events{0}; ///< bumped (under m_mtx) on anything waking workers
+  bool m_stop = false;
+  bool m_stopped = false;
+
+  bool take(int self, Item &item) noexcept;
+  void run(int self, Item &item) noexcept;
+  void work(int self) noexcept;
+}; // TaskPool
+
+#endif
@@ -0,0 +1,185 @@
+#include "telemetry.hpp"
+#include "andor2k.hpp"
+#include "atmcdLXd.h"
+#include "sdk_owner.hpp"
+#include "thread_setup.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+
+extern SdkOwner g_sdk;
+extern ThreadSetup g_thread_setup;
+
+namespace {
+constexpr int64_t BUCKET_NS = TELEMETRY_HISTORY_BUCKET_SEC * 1000000000ll;
+
+int64_t now_utc_ns() noexcept {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+} // namespace
+
+int TelemetrySampler::start(std::chrono::milliseconds interval) noexcept {
+  char buf[32];
+  std::lock_guard<std::mutex> lock(m_mtx);
+  if (m_worker.joinable() || m_stop || interval.count() <= 0)
+    return 1;
+  m_interval = interval;
+  sample();
+  try {
+    m_worker = std::thread(&TelemetrySampler::work, this);
+  } catch (std::exception &) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to start telemetry sampler (traceback: %s)\n",
+            date_str(buf), __func__);
+    return 1;
+  }
+  m_running.store(true, std::memory_order_release);
+  return 0;
+}
+
+void TelemetrySampler::stop() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  if (m_worker.joinable())
+    m_worker.join();
+  m_running.store(false, std::memory_order_release);
+}
+
+void TelemetrySampler::work() noexcept {
+  g_thread_setup.setup_this_thread("andor-telemetry", ThreadRole::Service);
+  auto next = std::chrono::steady_clock::now() + m_interval;
+  std::unique_lock<std::mutex> lock(m_mtx);
+  while (!m_cv.wait_until(lock, next, [this] { return m_stop; })) {
+    lock.unlock();
+    sample();
+    lock.lock();
+    // keep the rate, but do not try to catch up after a stall
+    next = std::max(next + m_interval, std::chrono::steady_clock::now());
+  }
+}
+
+/// Query the SDK (via the owner thread); while acquiring, GetTemperatureF
+/// does not return a temperature (DRV_ACQUIRING), so the last valid one is
+/// kept. An owner busy for more than half the interval is running an
+/// acquisition (which serves the poll at its next yield, see
+/// SdkOwner::yield), and the sample is recorded as such.
+void TelemetrySampler::sample() noexcept {
+  TelemetryReading r;
+  if (!m_poll.poll(g_sdk, [] {
+        TelemetryReading reading;
+        reading.temp_status = GetTemperatureF(&reading.temp);
+        if (GetStatus(&reading.driver_status) != DRV_SUCCESS)
+          reading.driver_status = DRV_ERROR_ACK;
+        reading.cooler_status = IsCoolerOn(&reading.cooler_on);
+        return reading;
+      }, m_interval / 2, r)) {
+    r.temp_status = DRV_ACQUIRING;
+    r.driver_status = DRV_ACQUIRING;
+    r.cooler_status = DRV_ACQUIRING;
+  }
+  bool temp_valid = r.temp_status != DRV_ACQUIRING &&
+                    r.temp_status != DRV_NOT_INITIALIZED &&
+                    r.temp_status != DRV_ERROR_ACK;
+  bool cooler_on = r.cooler_status == DRV_SUCCESS
+                       ? r.cooler_on
+                       : m_cooler_on.load(std::memory_order_relaxed);
+  record(now_utc_ns(), r.temp, temp_valid, r.temp_status, r.driver_status,
+         cooler_on);
+}
+
+void TelemetrySampler::record(int64_t utc_ns, float temp, bool temp_valid,
+                              unsigned temp_status, int driver_status,
+                              bool cooler_on) noexcept {
+  // publish; there is a single writer, so no need to spin against others
+  m_seq.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_samples.fetch_add(1, std::memory_order_relaxed);
+  m_sampled_ns.store(utc_ns, std::memory_order_relaxed);
+  if (temp_valid) {
+    m_temp.store(temp, std::memory_order_relaxed);
+    m_temp_ns.store(utc_ns, std::memory_order_relaxed);
+    m_temp_status.store(temp_status, std::memory_order_relaxed);
+  }
+  m_driver_status.store(driver_status, std::memory_order_relaxed);
+  m_cooler_on.store(cooler_on, std::memory_order_relaxed);
+  m_seq.fetch_add(1, std::memory_order_release);
+
+  // downsample; an interval is pushed to the ring once it is over
+  int64_t start_ns = utc_ns - utc_ns % BUCKET_NS;
+  std::lock_guard<std::mutex> lock(m_hist_mtx);
+  if (m_current.samples && m_current.start_ns != start_ns) {
+    if (m_ring.empty())
+      m_ring.resize(TELEMETRY_HISTORY_SIZE);
+    m_ring[m_ring_next] = m_current;
+    m_ring_next = (m_ring_next + 1) % TELEMETRY_HISTORY_SIZE;
+    m_ring_size = std::min(m_ring_size + 1, TELEMETRY_HISTORY_SIZE);
+    m_current = TelemetryBucket{};
+  }
+  m_current.start_ns = start_ns;
+  ++m_current.samples;
+  m_current.cooler_on += cooler_on;
+  m_current.acquiring += (driver_status == DRV_ACQUIRING);
+  if (temp_valid) {
+    if (!m_current.temp_samples) {
+      m_current.temp_min = m_current.temp_max = m_current.temp_mean = temp;
+    } else {
+      m_current.temp_min = std::min(m_current.temp_min, temp);
+      m_current.temp_max = std::max(m_current.temp_max, temp);
+      m_current.temp_mean +=
+          (temp - m_current.temp_mean) / (m_current.temp_samples + 1);
+    }
+    ++m_current.temp_samples;
+  }
+}
+
+TelemetrySnapshot TelemetrySampler::snapshot() const noexcept {
+  TelemetrySnapshot s;
+  uint64_t seq2;
+  do {
+    s.seq = m_seq.load(std::memory_order_acquire);
+    if (s.seq & 1) { // sample being published
+      std::this_thread::yield();
+      seq2 = s.seq + 1;
+      continue;
+    }
+    s.samples = m_samples.load(std::memory_order_relaxed);
+    s.sampled_ns = m_sampled_ns.load(std::memory_order_relaxed);
+    s.temp = m_temp.load(std::memory_order_relaxed);
+    s.temp_ns = m_temp_ns.load(std::memory_order_relaxed);
+    s.temp_status = m_temp_status.load(std::memory_order_relaxed);
+    s.driver_status = m_driver_status.load(std::memory_order_relaxed);
+    s.cooler_on = m_cooler_on.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    seq2 = m_seq.load(std::memory_order_relaxed);
+  } while (s.seq != seq2);
+  return s;
+}
+
+void TelemetrySampler::history(std::vector<TelemetryBucket> &buckets,
+                               int max_buckets) const noexcept {
+  buckets.clear();
+  std::lock_guard<std::mutex> lock(m_hist_mtx);
+  // the current interval counts towards the TELEMETRY_HISTORY_SIZE reported
+  int n = m_ring_size + (m_current.samples > 0);
+  int max_n = (max_buckets > 0 && max_buckets < TELEMETRY_HISTORY_SIZE)
+                  ? max_buckets
+                  : TELEMETRY_HISTORY_SIZE;
+  int skip = std::max(n - max_n, 0);
+  try {
+    buckets.reserve(n - skip);
+    int first = (m_ring_next - m_ring_size + TELEMETRY_HISTORY_SIZE) %
+                TELEMETRY_HISTORY_SIZE;
+    for (int i = skip; i < m_ring_size; i++)
+      buckets.push_back(m_ring[(first + i) % TELEMETRY_HISTORY_SIZE]);
+    if (m_current.samples)
+      buckets.push_back(m_current);
+  } catch (std::exception &) {
+    buckets.clear();
+  }
+}
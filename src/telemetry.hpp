@@ -0,0 +1,139 @@
+#ifndef __ANDOR2K_TELEMETRY_HPP__
+#define __ANDOR2K_TELEMETRY_HPP__
+
+#include "sdk_owner.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief Default interval between telemetry samples; overridden by the
+///        ANDOR2KD_TELEMETRY_INTERVAL_MS environment variable
+constexpr std::chrono::milliseconds TELEMETRY_SAMPLE_INTERVAL{1000};
+
+/// @brief Samples are downsampled to one history entry per this many seconds
+constexpr int TELEMETRY_HISTORY_BUCKET_SEC = 60;
+
+/// @brief Number of history entries kept (24 hours of one-minute entries)
+constexpr int TELEMETRY_HISTORY_SIZE = 24 * 60;
+
+/// @brief One reading of the camera's state, as published by the sampler
+struct TelemetrySnapshot {
+  uint64_t seq{0};         ///< incremented (by 2) on every sample
+  uint64_t samples{0};     ///< samples taken since the sampler started
+  int64_t sampled_ns{0};   ///< time of the sample, nanoseconds since epoch
+  float temp{0};           ///< CCD temperature (C); kept from the last valid
+                           ///< reading while acquiring
+  int64_t temp_ns{0};      ///< time of the last valid temperature reading
+  unsigned temp_status{0}; ///< status returned by GetTemperatureF along
+                           ///< with temp (e.g. DRV_TEMP_STABILIZED)
+  int driver_status{0};    ///< status returned by GetStatus (e.g. DRV_IDLE)
+  bool cooler_on{false};   ///< as returned by IsCoolerOn
+  /// @brief True if at least one valid temperature has been read
+  bool valid() const noexcept { return temp_ns > 0; }
+}; // TelemetrySnapshot
+
+/// @brief Downsampled telemetry, covering TELEMETRY_HISTORY_BUCKET_SEC
+struct TelemetryBucket {
+  int64_t start_ns{0};   ///< start of the interval, nanoseconds since epoch
+  float temp_min{0};     ///< temperature statistics (C), over temp_samples
+  float temp_max{0};
+  float temp_mean{0};
+  int samples{0};        ///< samples in the interval
+  int temp_samples{0};   ///< samples with a valid temperature
+  int cooler_on{0};      ///< samples with the cooler on
+  int acquiring{0};      ///< samples taken while acquiring
+}; // TelemetryBucket
+
+/// @brief The SDK's answers, for one sample
+struct TelemetryReading {
+  float temp{0};
+  unsigned temp_status{0};
+  int driver_status{0};
+  int cooler_on{0};
+  unsigned cooler_status{0};
+}; // TelemetryReading
+
+/// @brief Background sampler of the camera's telemetry.
+/// A dedicated thread polls temperature, cooler and driver status (through
+/// the SDK owner) at a fixed rate and publishes the latest reading via a
+/// seqlock (as AcquisitionState does), so that status requests and FITS
+/// headers read it in constant time, without waiting for the SDK (which is
+/// busy while acquiring). Samples are also downsampled into a ring buffer
+/// covering the last TELEMETRY_HISTORY_SIZE * TELEMETRY_HISTORY_BUCKET_SEC
+/// seconds.
+/// The sampler only reads; the cooler is controlled by the
+/// TemperatureController.
+class TelemetrySampler {
+public:
+  TelemetrySampler() noexcept = default;
+  TelemetrySampler(const TelemetrySampler &) = delete;
+  TelemetrySampler &operator=(const TelemetrySampler &) = delete;
+  ~TelemetrySampler() noexcept { stop(); }
+
+  /// @brief Start sampling (the camera must be initialized); the first
+  ///        sample is taken before returning
+  /// @return 0 on success; anything else denotes an error
+  int start(std::chrono::milliseconds interval =
+                TELEMETRY_SAMPLE_INTERVAL) noexcept;
+
+  /// @brief Stop the sampler thread; the last snapshot and the history
+  ///        remain available
+  void stop() noexcept;
+
+  /// @brief Whether the sampler thread is running (i.e. the snapshot is
+  ///        kept up to date)
+  bool running() const noexcept {
+    return m_running.load(std::memory_order_acquire);
+  }
+
+  /// @brief Get a consistent snapshot of the latest sample; lock-free
+  TelemetrySnapshot snapshot() const noexcept;
+
+  /// @brief Copy the history, oldest first, including the (partial) current
+  ///        interval
+  /// @param[in] max_buckets If > 0, only the most recent max_buckets entries
+  void history(std::vector<TelemetryBucket> &buckets,
+               int max_buckets = 0) const noexcept;
+
+  /// @brief Publish a sample and add it to the history; called by the
+  ///        sampler thread for every sample taken (exposed for testing)
+  /// @param[in] temp_valid Whether temp is an actual reading; if not, the
+  ///            last valid temperature (and its status) is kept
+  void record(int64_t utc_ns, float temp, bool temp_valid, unsigned temp_status,
+              int driver_status, bool cooler_on) noexcept;
+
+private:
+  // published via seqlock; only the sampler thread writes
+  std::atomic<uint64_t> m_seq{0};
+  std::atomic<uint64_t> m_samples{0};
+  std::atomic<int64_t> m_sampled_ns{0};
+  std::atomic<float> m_temp{0};
+  std::atomic<int64_t> m_temp_ns{0};
+  std::atomic<unsigned> m_temp_status{0};
+  std::atomic<int> m_driver_status{0};
+  std::atomic<bool> m_cooler_on{false};
+  std::atomic<bool> m_running{false};
+
+  // history; guarded by m_hist_mtx
+  mutable std::mutex m_hist_mtx;
+  std::vector<TelemetryBucket> m_ring;
+  int m_ring_next{0};
+  int m_ring_size{0};
+  TelemetryBucket m_current;
+
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::thread m_worker;
+  std::chrono::milliseconds m_interval{0};
+  SdkPoll<TelemetryReading> m_poll;
+  bool m_stop = false;
+
+  void work() noexcept;
+  void sample() noexcept;
+}; // TelemetrySampler
+
+#endif
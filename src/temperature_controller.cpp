@@ -0,0 +1,278 @@
+#include "temperature_controller.hpp"
+#include "andor2k.hpp"
+#include "andor2kd.hpp"
+#include "atmcdLXd.h"
+#include "thread_setup.hpp"
+#include <cerrno>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+
+extern SdkOwner g_sdk;
+extern ThreadSetup g_thread_setup;
+
+/// @brief Longest wait for the SDK owner in one go; while acquiring, the
+///        owner only serves queries between frames
+constexpr std::chrono::milliseconds TEMP_SDK_WAIT{1000};
+
+const char *TempControlState2str(TempControlState s) noexcept {
+  switch (s) {
+  case TempControlState::Idle:
+    return "idle";
+  case TempControlState::Cooling:
+    return "cooling";
+  case TempControlState::Stabilized:
+    return "stabilized";
+  case TempControlState::Failed:
+    return "failed";
+  }
+  return "unknown";
+}
+
+int TemperatureController::start() noexcept {
+  char buf[32];
+  std::lock_guard<std::mutex> lock(m_mtx);
+  if (m_worker.joinable() || m_stop)
+    return 1;
+  try {
+    m_worker = std::thread(&TemperatureController::work, this);
+  } catch (std::exception &) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to start temperature controller (traceback: "
+            "%s)\n",
+            date_str(buf), __func__);
+    return 1;
+  }
+  return 0;
+}
+
+void TemperatureController::stop() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stop = true;
+    m_socket.reset();
+  }
+  m_cv.notify_all();
+  if (m_worker.joinable()) {
+    if (m_worker.get_id() == std::this_thread::get_id())
+      m_worker.detach();
+    else
+      m_worker.join();
+  }
+}
+
+/// Must be called with m_mtx locked; the event is only formatted here, and
+/// must be sent (Event::send) after m_mtx is released
+void TemperatureController::publish(Event &event, const char *fmt,
+                                    ...) noexcept {
+  event.socket = m_socket;
+  if (!m_socket)
+    return;
+  va_list va;
+  va_start(va, fmt);
+  int len = std::vsnprintf(event.msg, sizeof(event.msg) - 32, fmt, va);
+  va_end(va);
+  if (len < 0)
+    len = 0;
+  else if (len > (int)sizeof(event.msg) - 33)
+    len = sizeof(event.msg) - 33;
+  len += std::sprintf(event.msg + len, ";time:");
+  date_str(event.msg + len);
+}
+
+void TemperatureController::Event::send() noexcept {
+  if (!socket)
+    return;
+  if (socket->send(msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0 &&
+      (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    char buf[32];
+    fprintf(stderr,
+            "[WRNNG][%s] Client not reading; dropped temperature event "
+            "(traceback: %s)\n",
+            date_str(buf), __func__);
+  }
+  socket.reset();
+}
+
+int TemperatureController::set_target(int tempC, const andor2k::Socket *socket,
+                                       uint64_t &job_id,
+                                       bool already_stable) noexcept {
+  Event event;
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_stop || !m_worker.joinable())
+      return 1;
+    if (m_reading.state == TempControlState::Cooling)
+      publish(event, "temp;id:%lu;state:superseded", m_reading.job_id);
+    m_socket = socket ? socket->duplicate() : nullptr;
+    job_id = m_reading.job_id = m_next_id++;
+    m_reading.target = tempC;
+    m_reading.state = already_stable ? TempControlState::Stabilized
+                                     : TempControlState::Cooling;
+    m_job_start = std::chrono::steady_clock::now();
+    m_target_pending = true;
+  }
+  m_cv.notify_all();
+  event.send();
+  return 0;
+}
+
+TemperatureReading TemperatureController::reading() const noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_reading;
+}
+
+int TemperatureController::wait_within(
+    float tolerance, std::chrono::seconds timeout) const noexcept {
+  std::unique_lock<std::mutex> lock(m_mtx);
+  if (m_reading.state == TempControlState::Idle)
+    return 2;
+  bool within = m_cv.wait_for(lock, timeout, [&] {
+    return m_stop || (m_reading.status &&
+                      std::abs(m_reading.ctemp - m_reading.target) <=
+                          tolerance);
+  });
+  return (within && !m_stop) ? 0 : 1;
+}
+
+int TemperatureController::wait_stabilized(
+    std::chrono::seconds timeout) const noexcept {
+  std::unique_lock<std::mutex> lock(m_mtx);
+  bool stable = m_cv.wait_for(lock, timeout, [this] {
+    return m_stop || m_reading.state == TempControlState::Stabilized;
+  });
+  return (stable && !m_stop) ? 0 : 1;
+}
+
+void TemperatureController::work() noexcept {
+  g_thread_setup.setup_this_thread("andor-tempctl", ThreadRole::Service);
+  char buf[32];
+  char status_str[MAX_STATUS_STRING_SIZE];
+
+  std::unique_lock<std::mutex> lock(m_mtx);
+  while (!m_stop) {
+    Event event;
+
+    // apply a new target temperature if one was requested
+    if (m_target_pending) {
+      m_target_pending = false;
+      int target = m_reading.target;
+      uint64_t id = m_reading.job_id;
+      lock.unlock();
+      printf("[DEBUG][%s] Setting camera temperature to %+3dC (request %lu)\n",
+             date_str(buf), target, id);
+      auto apply = [target] {
+        unsigned error = SetTemperature(target);
+        if (error != DRV_SUCCESS)
+          return SdkReply{error, "Failed to set target temperature!", 0};
+        return SdkReply{CoolerON(), "Failed to startup the cooler!", 0};
+      };
+      // wait for the owner (served between frames of an acquisition),
+      // unless the controller is stopped meanwhile; the camera may refuse
+      // while acquiring, then try again a bit later
+      SdkReply result;
+      bool done = false;
+      while (!done) {
+        done = m_set_poll.poll(g_sdk, apply, TEMP_SDK_WAIT, result);
+        bool refused = done && result.status == DRV_ACQUIRING;
+        lock.lock();
+        if (refused)
+          m_cv.wait_for(lock, TEMP_SDK_WAIT, [this] { return m_stop; });
+        bool stopping = m_stop;
+        lock.unlock();
+        if (stopping)
+          return;
+        done = done && !refused;
+      }
+      unsigned error = result.status;
+      const char *what = result.what;
+      lock.lock();
+      if (error != DRV_SUCCESS && id == m_reading.job_id) {
+        fprintf(stderr, "[ERROR][%s] %s (traceback: %s)\n", date_str(buf),
+                what, __func__);
+        m_reading.state = TempControlState::Failed;
+        publish(event, "temp;id:%lu;error:%u;state:failed;status:%s", id,
+                error, what);
+        m_socket.reset();
+      }
+    }
+
+    lock.unlock();
+    event.send();
+    float ctemp = 0;
+    unsigned status = DRV_ACQUIRING; // if the owner is busy acquiring
+    SdkReply tresult;
+    if (m_read_poll.poll(
+            g_sdk,
+            [] {
+              float t;
+              unsigned s = GetTemperatureF(&t);
+              return SdkReply{s, nullptr, t};
+            },
+            TEMP_SDK_WAIT, tresult)) {
+      status = tresult.status;
+      ctemp = tresult.temp;
+    }
+    lock.lock();
+
+    // during an acquisition (or on error) the reading is not valid
+    if (status != DRV_ACQUIRING && status != DRV_NOT_INITIALIZED &&
+        status != DRV_ERROR_ACK)
+      m_reading.ctemp = ctemp;
+    m_reading.status = status;
+
+    if (m_reading.state == TempControlState::Cooling) {
+      auto elapsed = std::chrono::duration_cast<std::chrono::minutes>(
+                         std::chrono::steady_clock::now() - m_job_start)
+                         .count();
+      if (status == DRV_TEMP_STABILIZED) {
+        printf("[DEBUG][%s] Temperature reached and stabilized at %+.1fC\n",
+               date_str(buf), m_reading.ctemp);
+        m_reading.state = TempControlState::Stabilized;
+        publish(event,
+                "temp;id:%lu;ctemp:%+.1f;state:stabilized;status:Target "
+                "temperature reached and stabilized",
+                m_reading.job_id, m_reading.ctemp);
+        m_socket.reset();
+      } else if (elapsed > MAX_COOLING_DURATION) {
+        fprintf(stderr,
+                "[ERROR][%s] Failed to reach temperature after %3ld minutes; "
+                "giving up! (traceback: %s)\n",
+                date_str(buf), elapsed, __func__);
+        m_reading.state = TempControlState::Failed;
+        publish(event,
+                "temp;id:%lu;error:1;ctemp:%+.1f;state:failed;status:Failed "
+                "to reach temperature after %ld minutes",
+                m_reading.job_id, m_reading.ctemp, elapsed);
+        m_socket.reset();
+      } else {
+        get_get_temperature_string(status, status_str);
+        printf("[DEBUG][%s] Temperature: %+.1fC (target %+3dC); %s\n",
+               date_str(buf), m_reading.ctemp, m_reading.target, status_str);
+        publish(event,
+                "temp;id:%lu;ctemp:%+.1f;target:%+d;state:cooling;status:%s "
+                "(%u)",
+                m_reading.job_id, m_reading.ctemp, m_reading.target,
+                status_str, status);
+      }
+    } else if (m_reading.state == TempControlState::Stabilized &&
+               status == DRV_TEMP_DRIFT) {
+      fprintf(stderr,
+              "[WRNNG][%s] Temperature has drifted from set point (%+.1fC)\n",
+              date_str(buf), m_reading.ctemp);
+      m_reading.state = TempControlState::Cooling;
+      m_job_start = std::chrono::steady_clock::now();
+    }
+
+    // wake anyone waiting for the temperature to settle; report progress
+    // (if any) with m_mtx released
+    m_cv.notify_all();
+    if (event.socket) {
+      lock.unlock();
+      event.send();
+      lock.lock();
+    }
+    m_cv.wait_for(lock, TEMP_POLL_INTERVAL,
+                  [this] { return m_stop || m_target_pending; });
+  }
+}
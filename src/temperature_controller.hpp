@@ -0,0 +1,119 @@
+#ifndef __ANDOR2K_TEMPERATURE_CONTROLLER_HPP__
+#define __ANDOR2K_TEMPERATURE_CONTROLLER_HPP__
+
+#include "andor2k.hpp"
+#include "cpp_socket.hpp"
+#include "sdk_owner.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/// @brief Interval between consecutive temperature readings
+constexpr std::chrono::seconds TEMP_POLL_INTERVAL{5};
+
+enum class TempControlState : int_fast8_t {
+  Idle,       ///< no target temperature set
+  Cooling,    ///< target set, not yet stabilized
+  Stabilized, ///< target temperature reached and stabilized
+  Failed      ///< failed to set target or to reach it in time
+}; // TempControlState
+
+const char *TempControlState2str(TempControlState s) noexcept;
+
+/// @brief A snapshot of the controller's state
+struct TemperatureReading {
+  float ctemp{0};     ///< last temperature read, in Celsius
+  int target{0};      ///< target temperature in Celsius (if any)
+  unsigned status{0}; ///< status returned by the last GetTemperatureF call
+  uint64_t job_id{0}; ///< id of the last settemp request
+  TempControlState state{TempControlState::Idle};
+}; // TemperatureReading
+
+/// @brief Background temperature control.
+/// A dedicated thread sets the target temperature, switches the cooler on and
+/// monitors the temperature until it stabilizes, so that requesting a new
+/// temperature never blocks the caller. Progress is published as events
+/// (messages of type "temp;id:...") to the client that made the request, and
+/// acquisitions may wait for the temperature to be within some tolerance of
+/// the target (see wait_within). The SDK is reached through the SDK owner,
+/// as queries that an acquisition serves between frames (see
+/// SdkOwner::yield); while acquiring, the SDK reports no temperature.
+class TemperatureController {
+public:
+  TemperatureController() noexcept = default;
+  TemperatureController(const TemperatureController &) = delete;
+  TemperatureController &operator=(const TemperatureController &) = delete;
+  ~TemperatureController() noexcept { stop(); }
+
+  /// @brief Start the controller thread
+  int start() noexcept;
+
+  /// @brief Stop the controller thread (the cooler is left as is); a stopped
+  ///        controller cannot be restarted
+  void stop() noexcept;
+
+  /// @brief Request a new target temperature; returns immediately
+  /// @param[in] tempC Target temperature in Celsius
+  /// @param[in] socket If not null, progress events are sent to (a duplicate
+  ///            of) this socket until the temperature stabilizes or the
+  ///            request fails
+  /// @param[out] job_id Id assigned to the request
+  /// @param[in] already_stable Set if the CCD is known to be at the target
+  ///            temperature already (e.g. after a warm restart); the state is
+  ///            then set to Stabilized right away
+  /// @return 0 on success; anything else denotes an error
+  int set_target(int tempC, const andor2k::Socket *socket, uint64_t &job_id,
+                 bool already_stable = false) noexcept;
+
+  /// @brief Get a snapshot of the current state
+  TemperatureReading reading() const noexcept;
+
+  /// @brief Block until the temperature is within ±tolerance Celsius of the
+  ///        target, or until timeout
+  /// @return 0 if the temperature is within tolerance, 1 on timeout, 2 if
+  ///         no target temperature is set
+  int wait_within(float tolerance, std::chrono::seconds timeout) const noexcept;
+
+  /// @brief Block until the target temperature is reached and stabilized,
+  ///        or until timeout (or until the controller is stopped)
+  /// @return 0 if stabilized, 1 otherwise
+  int wait_stabilized(std::chrono::seconds timeout) const noexcept;
+
+private:
+  /// @brief Answer to a request to the SDK owner
+  struct SdkReply {
+    unsigned status{0};
+    const char *what{nullptr}; ///< what failed, if status denotes an error
+    float temp{0};
+  }; // SdkReply
+
+  /// @brief An event, formatted while m_mtx is held and sent (see send)
+  ///        once it is released, so that a client that does not read its
+  ///        socket never holds up callers waiting for m_mtx
+  struct Event {
+    std::shared_ptr<andor2k::Socket> socket;
+    char msg[MAX_SOCKET_BUFFER_SIZE] = {'\0'};
+    /// @brief Send (if any) without blocking; dropped if the client's socket
+    ///        buffer is full
+    void send() noexcept;
+  }; // Event
+
+  mutable std::mutex m_mtx;
+  mutable std::condition_variable m_cv;
+  std::thread m_worker;
+  SdkPoll<SdkReply> m_set_poll, m_read_poll; ///< only used by the worker
+  TemperatureReading m_reading;
+  std::shared_ptr<andor2k::Socket> m_socket; ///< where to publish events
+  std::chrono::steady_clock::time_point m_job_start;
+  uint64_t m_next_id = 1;
+  bool m_target_pending = false;
+  bool m_stop = false;
+
+  void work() noexcept;
+  void publish(Event &event, const char *fmt, ...) noexcept;
+}; // TemperatureController
+
+#endif
@@ -0,0 +1,215 @@
+#include "thread_setup.hpp"
+#include "andor2k.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sys/mman.h>
+
+int parse_cpu_list(const char *str, cpu_set_t &set) noexcept {
+  CPU_ZERO(&set);
+  if (!str)
+    return 1;
+  const char *c = str;
+  int count = 0;
+  for (;;) {
+    char *end;
+    errno = 0;
+    long first = std::strtol(c, &end, 10);
+    if (end == c || errno || *c == '-' || *c == '+')
+      return 1;
+    long last = first;
+    c = end;
+    if (*c == '-') {
+      const char *start = ++c;
+      last = std::strtol(start, &end, 10);
+      if (end == start || errno || *start == '-' || *start == '+')
+        return 1;
+      c = end;
+    }
+    if (first < 0 || last < first || last >= CPU_SETSIZE)
+      return 1;
+    for (long cpu = first; cpu <= last; cpu++, count++)
+      CPU_SET(cpu, &set);
+    if (!*c)
+      break;
+    if (*c++ != ',')
+      return 1;
+  }
+  return !count;
+}
+
+char *format_cpu_list(const cpu_set_t &set, char *buf, int buf_sz) noexcept {
+  int len = 0;
+  if (buf_sz > 0)
+    buf[0] = '\0';
+  for (int cpu = 0; cpu < CPU_SETSIZE && len < buf_sz; cpu++) {
+    if (!CPU_ISSET(cpu, &set))
+      continue;
+    int last = cpu;
+    while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set))
+      ++last;
+    int w = (last == cpu)
+                ? std::snprintf(buf + len, buf_sz - len, "%s%d",
+                                len ? "," : "", cpu)
+                : std::snprintf(buf + len, buf_sz - len, "%s%d-%d",
+                                len ? "," : "", cpu, last);
+    if (w < 0)
+      break;
+    len += w;
+    cpu = last;
+  }
+  return buf;
+}
+
+// out of line; too large to inline (see -Winline)
+ThreadSetup::ThreadSetup() noexcept {
+  CPU_ZERO(&m_config.acq_cpus);
+  CPU_ZERO(&m_config.writer_cpus);
+}
+
+void ThreadSetup::configure(const ThreadSetupConfig &config) noexcept {
+  m_config = config;
+}
+
+int ThreadSetup::configure_from_env() noexcept {
+  char buf[32];
+  char cpus[64];
+  int invalid = 0;
+  ThreadSetupConfig config = m_config;
+
+  if (const char *str = std::getenv("ANDOR2KD_ACQ_CPUS"); str && *str) {
+    config.pin_acq = !parse_cpu_list(str, config.acq_cpus);
+    if (!config.pin_acq) {
+      fprintf(stderr,
+              "[WRNNG][%s] Invalid ANDOR2KD_ACQ_CPUS \"%s\"; acquisition "
+              "thread will not be pinned (traceback: %s)\n",
+              date_str(buf), str, __func__);
+      ++invalid;
+    }
+  }
+  if (const char *str = std::getenv("ANDOR2KD_WRITER_CPUS"); str && *str) {
+    config.pin_writer = !parse_cpu_list(str, config.writer_cpus);
+    if (!config.pin_writer) {
+      fprintf(stderr,
+              "[WRNNG][%s] Invalid ANDOR2KD_WRITER_CPUS \"%s\"; writer "
+              "threads will not be pinned (traceback: %s)\n",
+              date_str(buf), str, __func__);
+      ++invalid;
+    }
+  }
+  if (const char *str = std::getenv("ANDOR2KD_ACQ_FIFO_PRIORITY");
+      str && *str) {
+    char *end;
+    long prio = std::strtol(str, &end, 10);
+    if (*end || prio < 0 || prio > sched_get_priority_max(SCHED_FIFO)) {
+      fprintf(stderr,
+              "[WRNNG][%s] Invalid ANDOR2KD_ACQ_FIFO_PRIORITY \"%s\"; "
+              "acquisition thread will run under SCHED_OTHER (traceback: "
+              "%s)\n",
+              date_str(buf), str, __func__);
+      ++invalid;
+      prio = 0;
+    }
+    config.acq_fifo_priority = static_cast<int>(prio);
+  }
+  if (const char *str = std::getenv("ANDOR2KD_MLOCK"); str && *str)
+    config.lock_memory = !std::strcmp(str, "1");
+  configure(config);
+
+  char wcpus[64];
+  char policy[32] = "SCHED_OTHER";
+  if (config.acq_fifo_priority)
+    std::snprintf(policy, sizeof(policy), "SCHED_FIFO priority %d",
+                  config.acq_fifo_priority);
+  printf("[DEBUG][%s] Thread setup: acquisition CPUs %s, %s; writer CPUs "
+         "%s; frame memory %s\n",
+         date_str(buf),
+         config.pin_acq ? format_cpu_list(config.acq_cpus, cpus, sizeof(cpus))
+                        : "any",
+         policy,
+         config.pin_writer
+             ? format_cpu_list(config.writer_cpus, wcpus, sizeof(wcpus))
+             : "any",
+         config.lock_memory ? "locked" : "not locked");
+  return invalid;
+}
+
+int ThreadSetup::setup_this_thread(const char *name,
+                                   ThreadRole role) noexcept {
+  char buf[32];
+  char cpus[64];
+  char tname[THREAD_NAME_MAX + 1];
+  std::snprintf(tname, sizeof(tname), "%s", name);
+  // naming is only an aid for profiling; never reported
+  pthread_setname_np(pthread_self(), tname);
+
+  const cpu_set_t *set = nullptr;
+  int priority = 0;
+  if (role == ThreadRole::Acquisition) {
+    set = m_config.pin_acq ? &m_config.acq_cpus : nullptr;
+    priority = m_config.acq_fifo_priority;
+  } else if (role == ThreadRole::Writer) {
+    set = m_config.pin_writer ? &m_config.writer_cpus : nullptr;
+  }
+
+  int failed = 0;
+  if (set) {
+    format_cpu_list(*set, cpus, sizeof(cpus));
+    if (int error = pthread_setaffinity_np(pthread_self(), sizeof(*set), set);
+        error) {
+      fprintf(stderr,
+              "[WRNNG][%s] Failed to pin thread %s to CPU(s) %s: %s "
+              "(traceback: %s)\n",
+              date_str(buf), tname, cpus, std::strerror(error), __func__);
+      ++failed;
+    } else {
+      printf("[DEBUG][%s] Thread %s pinned to CPU(s) %s\n", date_str(buf),
+             tname, cpus);
+    }
+  }
+  if (priority > 0) {
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    if (int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        error) {
+      fprintf(stderr,
+              "[WRNNG][%s] Failed to run thread %s under SCHED_FIFO "
+              "(priority %d): %s (traceback: %s)\n",
+              date_str(buf), tname, priority, std::strerror(error), __func__);
+      ++failed;
+    } else {
+      printf("[DEBUG][%s] Thread %s running under SCHED_FIFO (priority %d)\n",
+             date_str(buf), tname, priority);
+    }
+  }
+
+  m_failures.fetch_add(failed, std::memory_order_relaxed);
+  return failed;
+}
+
+int ThreadSetup::lock_memory(const void *addr, std::size_t bytes) noexcept {
+  char buf[32];
+  if (!m_config.lock_memory || !addr || !bytes)
+    return 0;
+  if (mlock(addr, bytes)) {
+    int error = errno;
+    fprintf(stderr,
+            "[WRNNG][%s] Failed to lock %zu bytes of frame memory: %s "
+            "(traceback: %s)\n",
+            date_str(buf), bytes, std::strerror(error), __func__);
+    m_failures.fetch_add(1, std::memory_order_relaxed);
+    return error;
+  }
+  m_locked_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  return 0;
+}
+
+void ThreadSetup::unlock_memory(const void *addr, std::size_t bytes) noexcept {
+  if (!m_config.lock_memory || !addr || !bytes)
+    return;
+  if (!munlock(addr, bytes))
+    m_locked_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
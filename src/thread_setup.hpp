@@ -0,0 +1,99 @@
+#ifndef __ANDOR2K_THREAD_SETUP_HPP__
+#define __ANDOR2K_THREAD_SETUP_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sched.h>
+
+/// @brief Max length of a thread name (as shown by top -H, perf, gdb),
+///        excluding the null terminator; longer names are truncated
+constexpr int THREAD_NAME_MAX = 15;
+
+/// @brief What a daemon thread does; affinity and scheduling are configured
+///        per role
+enum class ThreadRole : int_fast8_t {
+  Acquisition, ///< the SDK owner, on which acquisitions run
+  Writer,      ///< threads writing data out (e.g. the asynchronous logger)
+  Service      ///< anything else; only named
+}; // ThreadRole
+
+/// @brief Affinity, scheduling and memory locking of the daemon's threads.
+/// Read from the environment:
+/// * ANDOR2KD_ACQ_CPUS, ANDOR2KD_WRITER_CPUS: CPUs (a list of ranges, e.g.
+///   "2-3,6") to pin the acquisition and the writer threads to
+/// * ANDOR2KD_ACQ_FIFO_PRIORITY: run the acquisition thread under SCHED_FIFO
+///   with this priority (1 to 99); 0 (default) keeps SCHED_OTHER
+/// * ANDOR2KD_MLOCK: if 1, lock the frame memory (image buffers, shared
+///   memory frame ring) in RAM
+struct ThreadSetupConfig {
+  cpu_set_t acq_cpus;
+  cpu_set_t writer_cpus;
+  bool pin_acq{false};
+  bool pin_writer{false};
+  int acq_fifo_priority{0};
+  bool lock_memory{false};
+}; // ThreadSetupConfig
+
+/// @brief Parse a list of CPUs, e.g. "2", "0,2" or "2-3,6"
+/// @return 0 on success; anything else denotes an error (syntax, empty list
+///         or CPU out of range)
+int parse_cpu_list(const char *str, cpu_set_t &set) noexcept;
+
+/// @brief Format a CPU set as a list of ranges (the inverse of
+///        parse_cpu_list); truncated to fit buf
+/// @return buf
+char *format_cpu_list(const cpu_set_t &set, char *buf, int buf_sz) noexcept;
+
+/// @brief Names daemon threads and applies the configured affinity and
+///        scheduling to them (each thread sets itself up, at its start), and
+///        locks frame memory. Every setting is reported (on stdout/stderr) as
+///        it takes effect, or fails to, e.g. for lack of privileges; failures
+///        are never fatal.
+class ThreadSetup {
+public:
+  ThreadSetup() noexcept;
+  ThreadSetup(const ThreadSetup &) = delete;
+  ThreadSetup &operator=(const ThreadSetup &) = delete;
+
+  /// @brief Set the configuration; call before starting any thread that
+  ///        sets itself up
+  void configure(const ThreadSetupConfig &config) noexcept;
+
+  /// @brief Configure from the environment (see ThreadSetupConfig); invalid
+  ///        settings are reported and ignored
+  /// @return Number of invalid settings
+  int configure_from_env() noexcept;
+
+  const ThreadSetupConfig &config() const noexcept { return m_config; }
+
+  /// @brief Name the calling thread and apply the settings of its role
+  /// @return 0 if everything configured took effect; else the number of
+  ///         settings that failed
+  int setup_this_thread(const char *name, ThreadRole role) noexcept;
+
+  /// @brief Lock (and fault in) frame memory, if so configured
+  /// @return 0 on success or if not configured; else an errno value
+  int lock_memory(const void *addr, std::size_t bytes) noexcept;
+
+  /// @brief Unlock memory locked by lock_memory (i.e. for which it returned
+  ///        0), before releasing it
+  void unlock_memory(const void *addr, std::size_t bytes) noexcept;
+
+  /// @brief Bytes currently locked by lock_memory
+  std::size_t locked_bytes() const noexcept {
+    return m_locked_bytes.load(std::memory_order_relaxed);
+  }
+
+  /// @brief Settings that failed to take effect so far
+  int failures() const noexcept {
+    return m_failures.load(std::memory_order_relaxed);
+  }
+
+private:
+  ThreadSetupConfig m_config;
+  std::atomic<std::size_t> m_locked_bytes{0};
+  std::atomic<int> m_failures{0};
+}; // ThreadSetup
+
+#endif
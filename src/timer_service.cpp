@@ -0,0 +1,131 @@
+#include "timer_service.hpp"
+#include "andor2k.hpp"
+#include "thread_setup.hpp"
+#include <cstdio>
+
+extern ThreadSetup g_thread_setup;
+
+int TimerService::start() noexcept {
+  char buf[32];
+  std::lock_guard<std::mutex> lock(m_mtx);
+  if (m_worker.joinable())
+    return 1;
+  m_stop = false;
+  try {
+    m_worker = std::thread(&TimerService::work, this);
+  } catch (std::exception &) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to start timer service (traceback: %s)\n",
+            date_str(buf), __func__);
+    return 1;
+  }
+  return 0;
+}
+
+void TimerService::stop() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  if (m_worker.joinable()) {
+    if (m_worker.get_id() == std::this_thread::get_id())
+      m_worker.detach();
+    else
+      m_worker.join();
+  }
+  std::lock_guard<std::mutex> lock(m_mtx);
+  m_timers.clear();
+  m_heap = decltype(m_heap)();
+}
+
+bool TimerService::running() const noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_worker.joinable() && !m_stop;
+}
+
+uint64_t TimerService::schedule_every(std::chrono::milliseconds period,
+                                      Callback callback,
+                                      clock::time_point first) noexcept {
+  if (period.count() <= 0 || !callback)
+    return 0;
+  uint64_t id;
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_stop || !m_worker.joinable())
+      return 0;
+    try {
+      id = m_next_id++;
+      m_timers.emplace(id, Timer{period, std::move(callback)});
+      m_heap.push(Deadline{first, id});
+    } catch (std::exception &) {
+      m_timers.erase(id);
+      return 0;
+    }
+  }
+  m_cv.notify_all();
+  return id;
+}
+
+int TimerService::cancel(uint64_t id) noexcept {
+  std::unique_lock<std::mutex> lock(m_mtx);
+  // never wait on ourselves (cancel called from within a callback)
+  if (m_worker.get_id() != std::this_thread::get_id())
+    m_cv.wait(lock, [&] { return m_firing != id; });
+  int status = m_timers.erase(id) ? 0 : 1;
+  lock.unlock();
+  m_cv.notify_all();
+  return status;
+}
+
+std::size_t TimerService::size() const noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_timers.size();
+}
+
+void TimerService::work() noexcept {
+  g_thread_setup.setup_this_thread("andor-timer", ThreadRole::Service);
+  std::unique_lock<std::mutex> lock(m_mtx);
+  while (!m_stop) {
+    if (m_heap.empty()) {
+      m_cv.wait(lock, [this] { return m_stop || !m_heap.empty(); });
+      continue;
+    }
+
+    // drop heap entries of cancelled timers
+    Deadline next = m_heap.top();
+    auto it = m_timers.find(next.id);
+    if (it == m_timers.end()) {
+      m_heap.pop();
+      continue;
+    }
+
+    // sleep until the deadline; a new (earlier) timer or a stop request
+    // wakes us up, in which case we re-examine the heap
+    if (clock::now() < next.at) {
+      m_cv.wait_until(lock, next.at);
+      continue;
+    }
+    m_heap.pop();
+
+    // fire; the timer can not be erased while m_firing is set, so the
+    // callback stays valid while the lock is released
+    m_firing = next.id;
+    Timer *timer = &it->second;
+    lock.unlock();
+    timer->callback();
+    lock.lock();
+    m_firing = 0;
+
+    // re-schedule one period later; if we have fallen behind (e.g. a slow
+    // callback), skip the missed ticks instead of firing them in a burst
+    if (m_timers.count(next.id)) {
+      auto at = next.at + timer->period;
+      auto now = clock::now();
+      if (at <= now)
+        at = now + timer->period;
+      m_heap.push(Deadline{at, next.id});
+    }
+    m_cv.notify_all();
+  }
+}
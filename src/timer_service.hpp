@@ -0,0 +1,90 @@
+#ifndef __ANDOR2K_TIMER_SERVICE_HPP__
+#define __ANDOR2K_TIMER_SERVICE_HPP__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// @brief A single, long-lived thread firing periodic callbacks.
+/// Timers are kept in a min-heap ordered by their next deadline; the thread
+/// sleeps until the earliest deadline (or until a timer is added/removed),
+/// fires the callback and re-schedules it one period later. All progress
+/// reporting during acquisitions is done via this service, so that no thread
+/// is created or joined while frames are being acquired.
+/// Callbacks are run on the service thread and should be short (e.g. format
+/// and send a message); they must not call schedule_every or cancel.
+class TimerService {
+public:
+  using clock = std::chrono::steady_clock;
+  using Callback = std::function<void()>;
+
+  TimerService() noexcept = default;
+  TimerService(const TimerService &) = delete;
+  TimerService &operator=(const TimerService &) = delete;
+  ~TimerService() noexcept { stop(); }
+
+  /// @brief Start the service thread
+  /// @return 0 on success; anything else denotes an error
+  int start() noexcept;
+
+  /// @brief Stop the service thread; pending timers are dropped
+  void stop() noexcept;
+
+  bool running() const noexcept;
+
+  /// @brief Fire callback every period, starting at first
+  /// @return An id for the timer, to be used with cancel; 0 if the timer
+  ///         could not be scheduled (e.g. the service is not running)
+  uint64_t schedule_every(std::chrono::milliseconds period, Callback callback,
+                          clock::time_point first) noexcept;
+
+  /// @brief Fire callback every period, starting one period from now
+  uint64_t schedule_every(std::chrono::milliseconds period,
+                          Callback callback) noexcept {
+    return schedule_every(period, std::move(callback), clock::now() + period);
+  }
+
+  /// @brief Remove a timer. If its callback is currently running, wait for
+  ///        it to return, so that on exit the callback is guaranteed to not
+  ///        be running and to never run again.
+  /// @return 0 if the timer was removed, 1 if no such timer exists
+  int cancel(uint64_t id) noexcept;
+
+  /// @brief Number of active timers
+  std::size_t size() const noexcept;
+
+private:
+  struct Timer {
+    std::chrono::milliseconds period;
+    Callback callback;
+  };
+  struct Deadline {
+    clock::time_point at;
+    uint64_t id;
+    bool operator>(const Deadline &other) const noexcept {
+      return at > other.at;
+    }
+  };
+
+  mutable std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::thread m_worker;
+  // cancelled timers are removed from m_timers only; their (stale) heap
+  // entries are skipped when they reach the top
+  std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>>
+      m_heap;
+  std::unordered_map<uint64_t, Timer> m_timers;
+  uint64_t m_next_id = 1;
+  uint64_t m_firing = 0; ///< id of the timer whose callback is running
+  bool m_stop = false;
+
+  void work() noexcept;
+}; // TimerService
+
+#endif
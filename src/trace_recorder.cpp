@@ -0,0 +1,169 @@
+#include "trace_recorder.hpp"
+#include "andor2k.hpp"
+#include "andor_time_utils.hpp"
+#include <cstdio>
+#include <cstring>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const char *TraceMode2str(TraceMode m) noexcept {
+  switch (m) {
+  case TraceMode::Off:
+    return "off";
+  case TraceMode::PerRequest:
+    return "request";
+  case TraceMode::PerNight:
+    return "night";
+  }
+  return "unknown";
+}
+
+uint32_t TraceRecorder::thread_id() noexcept {
+  static thread_local uint32_t tid =
+      static_cast<uint32_t>(syscall(SYS_gettid));
+  return tid;
+}
+
+int TraceRecorder::set_mode(TraceMode m) noexcept {
+  if (m != TraceMode::Off) {
+    // allocate once; never re-allocated afterwards, so that recording never
+    // allocates
+    std::lock_guard<std::mutex> wlock(m_write_mtx);
+    std::lock_guard<std::mutex> lock(m_mtx);
+    try {
+      m_events.reserve(TRACE_MAX_EVENTS);
+      m_spare.reserve(TRACE_MAX_EVENTS);
+    } catch (std::exception &) {
+      char buf[32];
+      fprintf(stderr,
+              "[ERROR][%s] Failed to allocate trace buffers (traceback: %s)\n",
+              date_str(buf), __func__);
+      return 1;
+    }
+  }
+  m_mode.store(m, std::memory_order_relaxed);
+  return 0;
+}
+
+void TraceRecorder::add(const char *name, int64_t ts_ns, int64_t dur_ns,
+                        char ph) noexcept {
+  uint32_t tid = thread_id();
+  std::lock_guard<std::mutex> lock(m_mtx);
+  if (m_events.size() >= static_cast<std::size_t>(TRACE_MAX_EVENTS) ||
+      m_events.capacity() < static_cast<std::size_t>(TRACE_MAX_EVENTS)) {
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  m_events.push_back(TraceEvent{name, ts_ns, dur_ns, tid, ph});
+}
+
+void TraceRecorder::name_thread(const char *name) noexcept {
+  if (!enabled())
+    return;
+  uint32_t tid = thread_id();
+  std::lock_guard<std::mutex> lock(m_mtx);
+  for (int i = 0; i < m_num_threads; i++) {
+    if (m_threads[i].tid == tid) {
+      m_threads[i].name = name;
+      return;
+    }
+  }
+  // when full, recycle the oldest entry (threads come and go)
+  if (m_num_threads == TRACE_MAX_THREADS) {
+    std::memmove(m_threads, m_threads + 1,
+                 sizeof(ThreadName) * (TRACE_MAX_THREADS - 1));
+    --m_num_threads;
+  }
+  m_threads[m_num_threads++] = ThreadName{tid, name};
+}
+
+std::size_t TraceRecorder::size() const noexcept {
+  std::lock_guard<std::mutex> lock(m_mtx);
+  return m_events.size();
+}
+
+int TraceRecorder::write(const char *filename, bool append) noexcept {
+  char buf[32];
+  std::lock_guard<std::mutex> wlock(m_write_mtx);
+
+  // take the pending events; recording goes on in the (empty) spare buffer
+  ThreadName threads[TRACE_MAX_THREADS];
+  int num_threads;
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    std::swap(m_events, m_spare);
+    num_threads = m_num_threads;
+    std::memcpy(threads, m_threads, sizeof(ThreadName) * num_threads);
+  }
+
+  FILE *fp = std::fopen(filename, append ? "a" : "w");
+  if (!fp) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to open trace file %s; %lu events lost "
+            "(traceback: %s)\n",
+            date_str(buf), filename, (unsigned long)m_spare.size(), __func__);
+    m_spare.clear();
+    return 1;
+  }
+
+  // events are separated by ",\n"; a new file starts with '['
+  std::fseek(fp, 0, SEEK_END);
+  bool first = (std::ftell(fp) == 0);
+  if (first)
+    std::fputs("[\n", fp);
+  const int pid = static_cast<int>(getpid());
+  for (int i = 0; i < num_threads; i++) {
+    std::fprintf(fp,
+                 "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                 "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                 first ? "" : ",\n", pid, threads[i].tid, threads[i].name);
+    first = false;
+  }
+  for (const auto &e : m_spare) {
+    std::fprintf(fp,
+                 "%s{\"name\":\"%s\",\"cat\":\"andor2k\",\"ph\":\"%c\","
+                 "\"ts\":%.3f,",
+                 first ? "" : ",\n", e.name, e.ph, e.ts_ns / 1e3);
+    if (e.ph == 'X')
+      std::fprintf(fp, "\"dur\":%.3f,", e.dur_ns / 1e3);
+    else
+      std::fputs("\"s\":\"t\",", fp);
+    std::fprintf(fp, "\"pid\":%d,\"tid\":%u}", pid, e.tid);
+    first = false;
+  }
+  if (!append)
+    std::fputs("\n]\n", fp);
+  m_spare.clear();
+
+  if (std::fclose(fp)) {
+    fprintf(stderr,
+            "[ERROR][%s] Failed to write trace file %s (traceback: %s)\n",
+            date_str(buf), filename, __func__);
+    return 1;
+  }
+  return 0;
+}
+
+int TraceRecorder::flush(const char *dir, char *filename) noexcept {
+  TraceMode m = mode();
+  if (m == TraceMode::Off || !size())
+    return 0;
+
+  char fn[256];
+  char tbuf[32];
+  auto now = std::chrono::system_clock::now();
+  if (m == TraceMode::PerNight) {
+    // a night is named after the date it starts at
+    strfdt<DateTimeFormat::YMD>(now - std::chrono::hours(12), tbuf);
+    std::snprintf(fn, sizeof(fn), "%s/andor2k_trace_%.4s%.2s%.2s.json", dir,
+                  tbuf, tbuf + 5, tbuf + 8);
+  } else {
+    strfdt<DateTimeFormat::YMDHMS>(now, tbuf);
+    std::snprintf(fn, sizeof(fn),
+                  "%s/andor2k_trace_%.4s%.2s%.2sT%.2s%.2s%.2s.json", dir, tbuf,
+                  tbuf + 5, tbuf + 8, tbuf + 11, tbuf + 14, tbuf + 17);
+  }
+  if (filename)
+    std::strcpy(filename, fn);
+  return write(fn, m == TraceMode::PerNight);
+}
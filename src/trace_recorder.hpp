@@ -0,0 +1,154 @@
+#ifndef __ANDOR2K_TRACE_RECORDER_HPP__
+#define __ANDOR2K_TRACE_RECORDER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/// @brief Max number of events held in memory between two flushes; further
+///        events are dropped (and counted)
+constexpr int TRACE_MAX_EVENTS = 1 << 17;
+
+/// @brief Max number of threads that can be given a name in a trace
+constexpr int TRACE_MAX_THREADS = 32;
+
+enum class TraceMode : int_fast8_t {
+  Off,        ///< no tracing
+  PerRequest, ///< one trace file per acquisition request
+  PerNight    ///< one trace file per night; every request is appended to it
+}; // TraceMode
+
+const char *TraceMode2str(TraceMode m) noexcept;
+
+/// @brief A single event in the trace
+struct TraceEvent {
+  const char *name; ///< must be a string literal (it is not copied)
+  int64_t ts_ns;    ///< start (steady clock), in nanoseconds
+  int64_t dur_ns;   ///< duration, in nanoseconds (complete events only)
+  uint32_t tid;     ///< (kernel) id of the thread that recorded the event
+  char ph;          ///< event type: 'X' for complete, 'i' for instant
+}; // TraceEvent
+
+/// @brief Records timelines of acquisitions (which stage ran on which thread,
+///        when and for how long) and writes them in the Chrome trace-event
+///        (JSON Array) format, to be opened in chrome://tracing or Perfetto.
+/// Tracing is off by default; when off, recording costs a single relaxed
+/// load. Events are kept in a buffer of at most TRACE_MAX_EVENTS events,
+/// which is written to disk and emptied by flush (after each request).
+/// In PerNight mode the events of successive requests are appended to the
+/// same file, which is left without the closing ']' (as the format allows)
+/// so that it can be appended to at any time.
+class TraceRecorder {
+public:
+  using clock = std::chrono::steady_clock;
+
+  TraceRecorder() noexcept = default;
+  TraceRecorder(const TraceRecorder &) = delete;
+  TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+  /// @brief Switch tracing mode; the event buffers are allocated the first
+  ///        time tracing is switched on. Pending events are kept (see flush)
+  /// @return 0 on success; anything else denotes an error (e.g. failed to
+  ///         allocate memory)
+  int set_mode(TraceMode m) noexcept;
+
+  TraceMode mode() const noexcept {
+    return m_mode.load(std::memory_order_relaxed);
+  }
+  bool enabled() const noexcept { return mode() != TraceMode::Off; }
+
+  /// @brief Record a complete event, i.e. a stage that started at start and
+  ///        lasted dur_ns nanoseconds
+  void complete(const char *name, clock::time_point start,
+                int64_t dur_ns) noexcept {
+    if (enabled())
+      add(name, start.time_since_epoch().count(), dur_ns, 'X');
+  }
+
+  /// @brief Record an instant event (e.g. an abort request)
+  void instant(const char *name) noexcept {
+    if (enabled())
+      add(name, clock::now().time_since_epoch().count(), 0, 'i');
+  }
+
+  /// @brief Give the calling thread a name, shown in the trace viewer (only
+  ///        while tracing)
+  void name_thread(const char *name) noexcept;
+
+  /// @brief Number of events pending (not yet written)
+  std::size_t size() const noexcept;
+
+  /// @brief Number of events dropped because the buffer was full
+  uint64_t dropped() const noexcept {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+
+  /// @brief Write all pending events to filename and empty the buffer. If
+  ///        append is set, events are appended to the file (if it exists)
+  ///        and the file is not terminated; else the file is overwritten
+  /// @return 0 on success; anything else denotes an error
+  int write(const char *filename, bool append) noexcept;
+
+  /// @brief Write all pending events to a file in directory dir, according
+  ///        to the current mode: "andor2k_trace_YYYYmmddTHHMMSS.json" (one
+  ///        per request) or "andor2k_trace_YYYYmmdd.json" (one per night,
+  ///        named after the UTC date at the start of the night). Does
+  ///        nothing if there are no pending events.
+  /// @param[out] filename If not null, the file written (should be able to
+  ///            hold at least 256 chars)
+  /// @return 0 on success; anything else denotes an error
+  int flush(const char *dir, char *filename = nullptr) noexcept;
+
+  /// @brief Current thread's (kernel) id
+  static uint32_t thread_id() noexcept;
+
+private:
+  std::atomic<TraceMode> m_mode{TraceMode::Off};
+  std::atomic<uint64_t> m_dropped{0};
+  mutable std::mutex m_mtx;  ///< guards m_events and m_threads
+  std::mutex m_write_mtx;    ///< serializes writers
+  std::vector<TraceEvent> m_events;
+  std::vector<TraceEvent> m_spare; ///< swapped with m_events when writing
+  struct ThreadName {
+    uint32_t tid;
+    const char *name;
+  };
+  ThreadName m_threads[TRACE_MAX_THREADS];
+  int m_num_threads = 0;
+
+  void add(const char *name, int64_t ts_ns, int64_t dur_ns, char ph) noexcept;
+}; // TraceRecorder
+
+/// @brief Record a complete event spanning the lifetime of the instance (or
+///        until end is called)
+class TraceSpan {
+public:
+  TraceSpan(TraceRecorder &tracer, const char *name) noexcept
+      : m_tracer(tracer.enabled() ? &tracer : nullptr), m_name(name) {
+    if (m_tracer)
+      m_start = TraceRecorder::clock::now();
+  }
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+  ~TraceSpan() noexcept { end(); }
+
+  void end() noexcept {
+    if (!m_tracer)
+      return;
+    m_tracer->complete(
+        m_name, m_start,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            TraceRecorder::clock::now() - m_start)
+            .count());
+    m_tracer = nullptr;
+  }
+
+private:
+  TraceRecorder *m_tracer;
+  const char *m_name;
+  TraceRecorder::clock::time_point m_start;
+}; // TraceSpan
+
+#endif
@@ -1,8 +1,11 @@
 #include "andor2k.hpp"
 #include "atmcdLXd.h"
+#include "setup_cache.hpp"
 #include <cstdio>
 #include <cstring>
 
+extern SetupCache g_setup_cache;
+
 /// @brief Set Vertical and Horizontal Shift Speeds
 /// This function will set the Vertical Shift Speed to the fastest recommended
 /// by the ANDOR2K system. It will also set the Horizontal Shift Speed to the
@@ -16,21 +19,28 @@
 /// @note Note that while the ANDOR2K SDK has a function to get the recommended
 /// vertical shift speed (aka GetFastestRecommendedVSSpeed), no such function
 /// is available for the horizontal speed.
+/// @note Speeds already set (see SetupCache) are not set again.
 /// @todo does this need the SetFrameTransferMode to be set to 1?
 int set_fastest_recomended_vh_speeds(float &vspeed, int hsspeed_index,
                                      float &hsspeed_mhz) noexcept {
   char buf[32];
+  auto &applied = g_setup_cache.applied();
 
-  // set vertical shift speed to fastest recommended
+  // set vertical shift speed to fastest recommended (as cached, else ask)
   int index;
-  unsigned int error = GetFastestRecommendedVSSpeed(&index, &vspeed);
+  unsigned int error = DRV_SUCCESS;
+  if (g_setup_cache.fastest_vsspeed(index, vspeed))
+    error = GetFastestRecommendedVSSpeed(&index, &vspeed);
   if (error != DRV_SUCCESS) {
     fprintf(stderr,
             "[ERROR][%s] Failed to get fastest recommended VSSpeed (traceback: "
             "%s)\n",
             date_str(buf), __func__);
     return 1;
-  } else {
+  }
+  g_setup_cache.count(applied.vsspeed == index);
+  if (applied.vsspeed != index) {
+    applied.vsspeed.reset();
     error = SetVSSpeed(index);
     if (error != DRV_SUCCESS) {
       fprintf(stderr,
@@ -39,24 +49,30 @@ int set_fastest_recomended_vh_speeds(float &vspeed, int hsspeed_index,
               date_str(buf), __func__);
       return 1;
     }
+    applied.vsspeed = index;
     printf("[DEBUG][%s] Set Vertical Speed Shift to fastest recommended; that "
            "is %8.2f microseconds per pixel shift\n",
            date_str(buf), vspeed);
   }
 
-  // set horizontal speed shift
-  error = SetHSSpeed(0, hsspeed_index);
-  if (error == DRV_SUCCESS) {
-    // get the speed (horizontal) in MHz for the specified index
-    GetHSSpeed(0, 0, hsspeed_index, &hsspeed_mhz);
-    printf(
-        "[DEBUG][%s] Set Horizontal Shift Speed to index %d (i.e. %.3fMHz)\n",
-        date_str(buf), hsspeed_index, hsspeed_mhz);
-  } else {
-    fprintf(stderr,
-            "[ERROR][%s] Failed to set HSSpeed to index %d (traceback: %s)\n",
-            date_str(buf), hsspeed_index, __func__);
+  // set horizontal speed shift, unless already set
+  g_setup_cache.count(applied.hsspeed == hsspeed_index);
+  if (applied.hsspeed != hsspeed_index) {
+    applied.hsspeed.reset();
+    error = SetHSSpeed(0, hsspeed_index);
+    if (error != DRV_SUCCESS) {
+      fprintf(stderr,
+              "[ERROR][%s] Failed to set HSSpeed to index %d (traceback: %s)\n",
+              date_str(buf), hsspeed_index, __func__);
+      return 1;
+    }
+    applied.hsspeed = hsspeed_index;
   }
 
-  return (error == DRV_SUCCESS ? 0 : 1);
+  // get the speed (horizontal) in MHz for the specified index
+  if (g_setup_cache.hsspeed(hsspeed_index, hsspeed_mhz))
+    GetHSSpeed(0, 0, hsspeed_index, &hsspeed_mhz);
+  printf("[DEBUG][%s] Set Horizontal Shift Speed to index %d (i.e. %.3fMHz)\n",
+         date_str(buf), hsspeed_index, hsspeed_mhz);
+  return 0;
 }
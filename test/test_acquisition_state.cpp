@@ -0,0 +1,126 @@
+#include "acquisition_state.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+// A writer thread runs a few "acquisitions" as fast as it can, while reader
+// threads take snapshots and check that they are always consistent (all
+// fields written by the same update). A waiting reader must see every
+// acquisition come to an end.
+
+using namespace std::chrono;
+
+constexpr int NUM_ACQUISITIONS = 200;
+constexpr int NUM_IMAGES = 50;
+
+int main() {
+  AcquisitionState state;
+  std::atomic<bool> writer_done{false};
+  std::atomic<long> inconsistent{0}, snapshots{0};
+
+  // a fresh state is idle
+  if (state.snapshot().phase != AcquisitionPhase::Idle) {
+    fprintf(stderr, "[ERROR] Initial state is not idle\n");
+    return 1;
+  }
+
+  auto writer = [&] {
+    for (int a = 0; a < NUM_ACQUISITIONS; a++) {
+      // each acquisition has a different number of images, so that readers
+      // can tell mixed-up snapshots
+      int nimg = NUM_IMAGES + a;
+      state.begin(nimg);
+      for (int i = 1; i <= nimg; i++) {
+        if (i > 1)
+          state.set_phase(AcquisitionPhase::Exposing);
+        state.frame_done(i);
+      }
+      state.set_phase(AcquisitionPhase::Done);
+    }
+    writer_done = true;
+  };
+
+  auto reader = [&] {
+    while (!writer_done) {
+      auto s = state.snapshot();
+      ++snapshots;
+      if (s.seq & 1)
+        ++inconsistent;
+      if (s.phase == AcquisitionPhase::Idle)
+        continue;
+      bool ok = s.images_done + 1 == s.cur_image &&
+                s.images_done <= s.num_images &&
+                s.num_images >= NUM_IMAGES &&
+                (s.phase != AcquisitionPhase::Done ||
+                 s.images_done == s.num_images) &&
+                (s.phase != AcquisitionPhase::Reading || s.images_done > 0) &&
+                (!s.images_done || s.frame_ns >= s.start_ns);
+      if (!ok)
+        ++inconsistent;
+    }
+  };
+
+  // count acquisitions seen finishing, by waiting on every update
+  std::atomic<int> waits{0};
+  auto waiter = [&] {
+    auto s = state.snapshot();
+    while (!writer_done) {
+      s = state.wait(s.seq, milliseconds(100));
+      ++waits;
+    }
+  };
+
+  std::thread r1(reader), r2(reader), w1(waiter);
+  std::thread w(writer);
+  w.join();
+  r1.join();
+  r2.join();
+  w1.join();
+
+  printf("%ld snapshots, %ld inconsistent, %d wake-ups\n", snapshots.load(),
+         inconsistent.load(), waits.load());
+  if (inconsistent) {
+    fprintf(stderr, "[ERROR] Inconsistent snapshots\n");
+    return 1;
+  }
+
+  auto s = state.snapshot();
+  if (s.phase != AcquisitionPhase::Done ||
+      s.num_images != NUM_IMAGES + NUM_ACQUISITIONS - 1 ||
+      s.images_done != s.num_images) {
+    fprintf(stderr, "[ERROR] Unexpected final state\n");
+    return 1;
+  }
+
+  // an abort request wakes up waiters and is cleared by the next begin
+  std::thread aborter([&] {
+    std::this_thread::sleep_for(milliseconds(20));
+    state.request_abort();
+  });
+  auto t0 = steady_clock::now();
+  auto sa = state.wait(s.seq, milliseconds(2000));
+  aborter.join();
+  long waited =
+      duration_cast<milliseconds>(steady_clock::now() - t0).count();
+  if (!sa.abort_requested || !state.abort_requested() || waited > 1000) {
+    fprintf(stderr, "[ERROR] Abort request not seen by waiter\n");
+    return 1;
+  }
+  state.begin(1);
+  if (state.abort_requested() || state.snapshot().abort_requested) {
+    fprintf(stderr, "[ERROR] Abort request not cleared\n");
+    return 1;
+  }
+
+  // waiting with no update times out
+  s = state.snapshot();
+  sa = state.wait(s.seq, milliseconds(20));
+  if (sa.seq != s.seq) {
+    fprintf(stderr, "[ERROR] Unexpected update\n");
+    return 1;
+  }
+
+  printf("all ok\n");
+  return 0;
+}
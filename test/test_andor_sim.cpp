@@ -0,0 +1,175 @@
+#include "andor_sim.hpp"
+#include "atmcdLXd.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Drive the simulated SDK the way the daemon drives the camera (cooling,
+// single scan, run till abort, kinetic series) with time running 1000 times
+// faster; check timings, images, the circular buffer and injected faults.
+// Checks that count frames hold the camera clock and step it, so that they
+// do not depend on how the test threads are scheduled.
+
+constexpr int W = 1024, H = 1024; // 2x2 binned
+
+#define CHECK(expr, what)                                                      \
+  if (!(expr)) {                                                               \
+    fprintf(stderr, "[ERROR] %s (line %d)\n", what, __LINE__);                 \
+    return 1;                                                                  \
+  }
+
+int main() {
+  auto &cfg = andor_sim_config();
+  cfg.time_scale = 1e-3;
+  cfg.buffer_bytes = 4LL * W * H * sizeof(at_32); // 4 images
+  CHECK(Initialize((char *)"/usr/local/etc/andor") == DRV_SUCCESS,
+        "Initialize failed");
+  int xpixels, ypixels;
+  GetDetector(&xpixels, &ypixels);
+  CHECK(xpixels == 2048 && ypixels == 2048, "Wrong detector size");
+
+  // cooling: not reached, then stabilized (in ~1 sec)
+  int temp;
+  CHECK(GetTemperature(&temp) == DRV_TEMP_OFF && temp == 20,
+        "Unexpected temperature with cooler off");
+  SetTemperature(-60);
+  CoolerON();
+  CHECK(GetTemperature(&temp) == DRV_TEMP_NOT_REACHED, "Cooled instantly");
+  auto t0 = std::chrono::steady_clock::now();
+  while (GetTemperature(&temp) != DRV_TEMP_STABILIZED &&
+         std::chrono::steady_clock::now() - t0 < std::chrono::seconds(5))
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  CHECK(temp >= -61 && temp <= -59, "Temperature not stabilized");
+  CHECK(SetTemperature(-200) == DRV_P1INVALID, "Set point out of range");
+
+  // readout time follows the horizontal speed and binning
+  SetReadMode(4);
+  SetImage(2, 2, 1, 2048, 1, 2048);
+  float fast, slow;
+  GetReadOutTime(&fast);
+  SetHSSpeed(0, 3); // 0.05 MHz
+  GetReadOutTime(&slow);
+  CHECK(fast > 0.2f && fast < 0.3f && slow > 20.f && slow < 21.5f,
+        "Unexpected readout times");
+  SetHSSpeed(0, 0);
+
+  // single scan
+  SetAcquisitionMode(1);
+  SetExposureTime(50.f); // 50 millisec
+  SetShutter(1, 0, 50, 50);
+  float exposure, accumulate, kinetic;
+  GetAcquisitionTimings(&exposure, &accumulate, &kinetic);
+  CHECK(exposure == 50.f && kinetic > exposure + fast + 0.09f &&
+            kinetic < exposure + fast + 0.11f,
+        "Unexpected acquisition timings");
+  std::vector<at_32> img(W * H), img2(W * H);
+  const float latency = cfg.start_latency;
+  andor_sim_hold();
+  CHECK(StartAcquisition() == DRV_SUCCESS, "StartAcquisition failed");
+  int status;
+  GetStatus(&status);
+  CHECK(status == DRV_ACQUIRING, "Not acquiring");
+  CHECK(GetAcquiredData(img.data(), W * H) == DRV_ACQUIRING,
+        "Got data while acquiring");
+  andor_sim_step(latency + kinetic);
+  CHECK(WaitForAcquisition() == DRV_SUCCESS, "WaitForAcquisition failed");
+  GetStatus(&status);
+  CHECK(status == DRV_IDLE, "Still acquiring");
+  CHECK(GetAcquiredData(img.data(), W * H - 1) == DRV_P2INVALID,
+        "Wrong size accepted");
+  CHECK(GetAcquiredData(img.data(), W * H) == DRV_SUCCESS &&
+            GetAcquiredData(img2.data(), W * H) == DRV_SUCCESS &&
+            img == img2,
+        "Failed to get (the same) data");
+  double sum = 0;
+  at_32 max = 0;
+  for (auto v : img) {
+    sum += v;
+    max = std::max(max, v);
+  }
+  // bias + 4 * 20 ADU/sec of sky, plus stars
+  CHECK(sum / (W * H) > 375. && max > 2000, "Not a star field");
+  CHECK(WaitForAcquisition() == DRV_NO_NEW_DATA, "Wait returned when idle");
+
+  // run till abort, with a 4-image buffer
+  SetAcquisitionMode(5);
+  SetExposureTime(.1f);
+  SetShutter(1, 1, 0, 0);
+  GetAcquisitionTimings(&exposure, &accumulate, &kinetic);
+  CHECK(StartAcquisition() == DRV_SUCCESS, "StartAcquisition failed");
+  int first, last, vfirst, vlast;
+  andor_sim_step(latency + 1.5f * kinetic); // 1 image
+  CHECK(WaitForAcquisition() == DRV_SUCCESS, "WaitForAcquisition failed");
+  CHECK(GetNumberNewImages(&first, &last) == DRV_SUCCESS && first == 1,
+        "No new images");
+  CHECK(GetImages(1, 1, img.data(), W * H, &vfirst, &vlast) == DRV_SUCCESS &&
+            vfirst == 1 && vlast == 1,
+        "GetImages failed");
+  andor_sim_step(20 * kinetic); // 21 images
+  CHECK(GetImages(2, 2, img.data(), W * H, &vfirst, &vlast) ==
+                DRV_GENERAL_ERRORS &&
+            vfirst == 18 && vlast == 21,
+        "Overwritten image retrieved");
+  CHECK(GetNumberNewImages(&first, &last) == DRV_SUCCESS && first == 18 &&
+            last == 21 && andor_sim_images_lost() == 16,
+        "Lost images not accounted for");
+  CHECK(GetImages(last, last, img.data(), W * H, &vfirst, &vlast) ==
+            DRV_SUCCESS,
+        "GetImages failed");
+
+  // injected faults
+  andor_sim_inject(AndorSimFault::NoNewData);
+  CHECK(WaitForAcquisition() == DRV_NO_NEW_DATA, "NoNewData not injected");
+  andor_sim_inject(AndorSimFault::ErrorAck);
+  CHECK(GetImages(last, last, img.data(), W * H, &vfirst, &vlast) ==
+            DRV_ERROR_ACK,
+        "ErrorAck not injected");
+  CHECK(AbortAcquisition() == DRV_SUCCESS, "AbortAcquisition failed");
+  CHECK(AbortAcquisition() == DRV_IDLE, "Aborted twice");
+  andor_sim_release();
+
+  // a big buffer, but an injected overrun
+  SetImage(8, 8, 1, 2048, 1, 2048);
+  andor_sim_inject(AndorSimFault::Overrun);
+  CHECK(StartAcquisition() == DRV_SUCCESS, "StartAcquisition failed");
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  CHECK(GetNumberNewImages(&first, &last) == DRV_SUCCESS && first == last &&
+            first > 1,
+        "Overrun not injected");
+  AbortAcquisition();
+
+  // CancelWait releases a blocked WaitForAcquisition
+  SetExposureTime(1000.f); // 1 sec
+  CHECK(StartAcquisition() == DRV_SUCCESS, "StartAcquisition failed");
+  std::thread canceller([] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CancelWait();
+  });
+  t0 = std::chrono::steady_clock::now();
+  status = WaitForAcquisition();
+  canceller.join();
+  CHECK(status == DRV_NO_NEW_DATA && std::chrono::steady_clock::now() - t0 <
+                                         std::chrono::milliseconds(500),
+        "CancelWait did not release WaitForAcquisition");
+  AbortAcquisition();
+
+  // kinetic series: the whole series with GetAcquiredData
+  SetImage(2, 2, 1, 2048, 1, 2048);
+  SetAcquisitionMode(3);
+  SetExposureTime(.5f);
+  SetNumberKinetics(3);
+  std::vector<at_32> series(3 * W * H);
+  CHECK(StartAcquisition() == DRV_SUCCESS, "StartAcquisition failed");
+  for (int i = 0; i < 3; i++)
+    CHECK(WaitForAcquisition() == DRV_SUCCESS, "WaitForAcquisition failed");
+  CHECK(WaitForAcquisition() == DRV_NO_NEW_DATA, "Too many images");
+  CHECK(GetAcquiredData(series.data(), 3 * W * H) == DRV_SUCCESS,
+        "Failed to get the series");
+
+  ShutDown();
+  CHECK(StartAcquisition() == DRV_NOT_INITIALIZED, "Still initialized");
+
+  printf("all ok\n");
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include "async_logger.hpp"
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Format a few records and compare with printf; then have several threads
+// log (a lot) at once and check that every message is either written or
+// counted as dropped.
+
+constexpr int NUM_THREADS = 4;
+constexpr int NUM_MESSAGES = 50000;
+
+int count_lines(FILE *fp) {
+  std::rewind(fp);
+  int lines = 0;
+  char line[1024];
+  while (std::fgets(line, sizeof(line), fp))
+    ++lines;
+  return lines;
+}
+
+int main() {
+  FILE *out = std::tmpfile(), *err = std::tmpfile();
+  if (!out || !err)
+    return 1;
+
+  // formatting, written synchronously (logger thread not started)
+  AsyncLogger logger;
+  char name[] = "foo.fits";
+  logger.start(out, err);
+  logger.stop();
+  std::rewind(out);
+  logger.log(LogLevel::Debug,
+             "image %03d/%-4ld|%s|%.2f|%5.1fC|%u|%x|%%|%c|%s (traceback: %s)", 7,
+             12L, name, 3.14159, -49.96f, 42u, 255, 'A', "literal", __func__);
+  logger.warning("no arguments");
+  logger.set_level(LogLevel::Warning);
+  logger.debug("filtered out %d", 1);
+  std::fflush(out);
+  std::fflush(err);
+
+  char line[1024], expected[1024];
+  std::rewind(out);
+  if (!std::fgets(line, sizeof(line), out)) {
+    fprintf(stderr, "[ERROR] No output\n");
+    return 1;
+  }
+  std::sprintf(expected,
+               "image %03d/%-4ld|%s|%.2f|%5.1fC|%u|%x|%%|%c|%s (traceback: "
+               "%s)\n",
+               7, 12L, name, 3.14159, -49.96f, 42u, 255, 'A', "literal",
+               "main");
+  const char *msg = std::strstr(line, "] ");
+  if (std::strncmp(line, "[DEBUG][", 8) || !msg || std::strcmp(msg + 2, expected)) {
+    fprintf(stderr, "[ERROR] Got: %sExpected: %s", line, expected);
+    return 1;
+  }
+  if (count_lines(out) != 1 || count_lines(err) != 1) {
+    fprintf(stderr, "[ERROR] Level filtering failed\n");
+    return 1;
+  }
+
+  // many producers, one logger thread
+  std::fclose(out);
+  out = std::tmpfile();
+  AsyncLogger alogger;
+  if (alogger.start(out, err))
+    return 1;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < NUM_THREADS; t++)
+    threads.emplace_back([&alogger, t] {
+      for (int i = 0; i < NUM_MESSAGES; i++)
+        alogger.debug("thread %d message %d of %d (%s)", t, i, NUM_MESSAGES,
+                      "some text to copy");
+    });
+  for (auto &t : threads)
+    t.join();
+  alogger.stop();
+
+  int written = count_lines(out);
+  long dropped = alogger.dropped();
+  printf("%d messages written, %ld dropped\n", written, dropped);
+  if (written + dropped != NUM_THREADS * NUM_MESSAGES) {
+    fprintf(stderr, "[ERROR] Messages lost\n");
+    return 1;
+  }
+
+  printf("all ok\n");
+  return 0;
+}
@@ -0,0 +1,167 @@
+#include "clock_monitor.hpp"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+// Track the offset of a local stand-in NTP server, whose clock runs ahead of
+// the system clock by a configurable amount; check the timestamp conversions
+// (fractions are in units of 2^-32 sec), that replies not matching the
+// request are rejected, and that a step of the server's clock is followed.
+
+int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+/// @brief Answers NTP requests with its clock offset by offset_ns
+struct StandInServer {
+  int fd{-1};
+  int port{0};
+  std::atomic<int64_t> offset_ns{0};
+  std::atomic<bool> bad_origin{false};
+  std::atomic<bool> stop{false};
+  std::thread worker;
+
+  int start() {
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    timeval tv{0, 50000};
+    if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) ||
+        getsockname(fd, (sockaddr *)&addr, &len) ||
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
+      return 1;
+    port = ntohs(addr.sin_port);
+    worker = std::thread([this] { serve(); });
+    return 0;
+  }
+
+  void serve() {
+    uint32_t p[12];
+    sockaddr_in client;
+    socklen_t len = sizeof(client);
+    while (!stop) {
+      if (recvfrom(fd, p, sizeof(p), 0, (sockaddr *)&client, &len) != 48)
+        continue;
+      uint32_t s, f;
+      unix_ns_to_ntp(now_ns() + offset_ns, s, f);
+      p[0] = htonl(0x1c020000); // li 0, vn 3, mode 4 (server), stratum 2
+      p[6] = p[10];             // originate is the client's transmit time
+      p[7] = bad_origin ? p[11] ^ htonl(1) : p[11];
+      p[8] = p[10] = htonl(s); // receive and transmit times
+      p[9] = p[11] = htonl(f);
+      sendto(fd, p, sizeof(p), 0, (sockaddr *)&client, len);
+    }
+  }
+
+  ~StandInServer() {
+    stop = true;
+    if (worker.joinable())
+      worker.join();
+    close(fd);
+  }
+}; // StandInServer
+
+/// @brief Wait until the correction is within 5 ms of expected_ns
+bool converges(const ClockMonitor &monitor, int64_t expected_ns) {
+  auto t0 = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - t0 < std::chrono::seconds(5)) {
+    if (monitor.synchronized() &&
+        std::abs(monitor.correction_ns() - expected_ns) < 5000000)
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+int main() {
+  // timestamp conversions
+  if (ntp_fraction_to_ns(0x80000000u) != 500000000 ||
+      ntp_fraction_to_ns(0x40000000u) != 250000000 ||
+      ntp_fraction_to_ns(0xffffffffu) != 999999999 ||
+      ntp_fraction_to_ns(ns_to_ntp_fraction(123456789)) / 10 != 12345678) {
+    fprintf(stderr, "[ERROR] Wrong NTP fraction conversion\n");
+    return 1;
+  }
+  uint32_t s, f;
+  unix_ns_to_ntp(1600000000250000000ll, s, f);
+  if (s != 1600000000u + NTP_TIMESTAMP_DELTA || f != 0x40000000u ||
+      ntp_to_unix_ns(s, f) != 1600000000250000000ll) {
+    fprintf(stderr, "[ERROR] Wrong NTP timestamp conversion\n");
+    return 1;
+  }
+
+  StandInServer server;
+  server.offset_ns = 250000000; // 250 ms ahead
+  if (server.start()) {
+    fprintf(stderr, "[ERROR] Failed to start stand-in NTP server\n");
+    return 1;
+  }
+  char name[64];
+  std::snprintf(name, sizeof(name), "127.0.0.1:%d", server.port);
+
+  // a single exchange
+  sockaddr_in addr;
+  NtpSample sample;
+  if (ntp_resolve(name, addr) || ntp_query(addr, sample) ||
+      std::abs(sample.offset_ns - 250000000) > 5000000 ||
+      sample.delay_ns < 0 || sample.delay_ns > 50000000) {
+    fprintf(stderr, "[ERROR] Failed to query stand-in NTP server\n");
+    return 1;
+  }
+  // a reply to some other request
+  server.bad_origin = true;
+  if (!ntp_query(addr, sample, 200)) {
+    fprintf(stderr, "[ERROR] Reply with wrong originate time accepted\n");
+    return 1;
+  }
+  server.bad_origin = false;
+
+  // background monitoring; an unreachable server does not get in the way
+  ClockMonitor monitor;
+  if (monitor.correction_ns() || monitor.synchronized()) {
+    fprintf(stderr, "[ERROR] Correction before any exchange\n");
+    return 1;
+  }
+  std::snprintf(name, sizeof(name), "127.0.0.1:1,127.0.0.1:%d", server.port);
+  if (monitor.start(name, std::chrono::milliseconds(20),
+                    std::chrono::milliseconds(5))) {
+    fprintf(stderr, "[ERROR] Failed to start clock monitor\n");
+    return 1;
+  }
+  if (!converges(monitor, 250000000)) {
+    fprintf(stderr, "[ERROR] Offset not tracked: %ld ns\n",
+            (long)monitor.correction_ns());
+    return 1;
+  }
+
+  // the server's clock steps back by 1 sec
+  server.offset_ns = -750000000;
+  if (!converges(monitor, -750000000) || monitor.estimate().steps != 1) {
+    fprintf(stderr, "[ERROR] Step not followed: %ld ns\n",
+            (long)monitor.correction_ns());
+    return 1;
+  }
+  monitor.stop();
+
+  // the last correction stays, once stopped
+  auto est = monitor.estimate();
+  if (std::abs(monitor.correction_ns() + 750000000) > 5000000 ||
+      est.servers_reached != 1 || est.polls < 2) {
+    fprintf(stderr, "[ERROR] Unexpected estimate after stop\n");
+    return 1;
+  }
+
+  printf("all ok\n");
+  return 0;
+}
@@ -0,0 +1,264 @@
+#include "andor2k.hpp"
+#include "andor2kd.hpp"
+#include "command_parser.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <random>
+#include <string>
+#include <unistd.h>
+
+// Options match exactly (--binx is not --bin), values are typed and range
+// checked, and errors say exactly what and where; random (fuzzed) commands
+// never crash the parser nor leave out-of-range parameters; thousands of
+// commands are parsed without a single allocation.
+
+namespace {
+std::size_t allocations = 0;
+}
+
+void *operator new(std::size_t size) {
+  ++allocations;
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+#define CHECK(expr, what)                                                      \
+  if (!(expr)) {                                                               \
+    fprintf(stderr, "[ERROR] %s (line %d)\n", what, __LINE__);                 \
+    return 1;                                                                  \
+  }
+
+namespace {
+struct Target {
+  int a{0};
+  double b{0};
+};
+using TOption = CommandOption<Target>;
+constexpr TOption target_options[] = {
+    {"a", OptionType::Int, -5, 5,
+     [](Target &t, const OptionValue &v) noexcept {
+       t.a = static_cast<int>(v.i);
+       return t.a == 3 ? 7 : 0;
+     }},
+    {"b", OptionType::Float, 0, 1,
+     [](Target &t, const OptionValue &v) noexcept {
+       t.b = v.f;
+       return 0;
+     }}};
+constexpr OptionTable target_table("set", OptionSyntax::Assign,
+                                   target_options);
+static_assert(target_table.valid() && target_table.find("a") &&
+                  !target_table.find("ab") && !target_table.find(""),
+              "Keyword lookup not resolved at compile time");
+
+/// silence stderr (warnings) or stdout (debug output) while in scope
+struct Quiet {
+  int fd, saved;
+  explicit Quiet(int fd_ = 2) : fd(fd_), saved(dup(fd_)) {
+    fflush(nullptr);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, fd);
+    close(null);
+  }
+  ~Quiet() {
+    fflush(nullptr);
+    dup2(saved, fd);
+    close(saved);
+  }
+};
+
+struct Expected {
+  const char *command;
+  ParseError error;
+  const char *option;
+  std::size_t offset;
+};
+} // namespace
+
+int main() {
+  // exact keywords
+  const char *names[] = {"--nimages",  "--bin",      "--hbin",
+                         "--vbin",     "--hstart",   "--hend",
+                         "--vstart",   "--vend",     "--filename",
+                         "--type",     "--object",   "--filter",
+                         "--exposure", "--ar-tries", "--stable-within",
+                         "--at"};
+  KeywordMap<16> map([&](std::size_t i) { return std::string_view(names[i]); });
+  CHECK(map.valid(), "No perfect hash");
+  for (int i = 0; i < 16; i++)
+    CHECK(map.find(names[i]) == i, "Keyword not found");
+  for (const char *miss : {"--binx", "--bi", "--bin2", "bin", "", "--AT"})
+    CHECK(map.find(miss) == -1, "Near miss found");
+
+  // a full command
+  AndorParameters params;
+  CommandError error;
+  CHECK(!resolve_image_parameters(
+            "image --nimages 10 --bin 2 --hstart 513 --hend 1536 --vstart "
+            "513 --vend 1536 --exposure +30.5 --type object --filename m31_r "
+            "--object M31 --filter R --ar-tries 0 --stable-within -1",
+            params, &error),
+        "Valid command refused");
+  CHECK(params.num_images_ == 10 &&
+            params.acquisition_mode_ == AcquisitionMode::RunTillAbort &&
+            params.image_hbin_ == 2 && params.image_vbin_ == 2 &&
+            params.image_hstart_ == 513 && params.image_hend_ == 1536 &&
+            params.image_vstart_ == 513 && params.image_vend_ == 1536 &&
+            params.exposure_ == 30.5f && !std::strcmp(params.type_, "object") &&
+            !std::strcmp(params.image_filename_, "m31_r") &&
+            !std::strcmp(params.object_name_, "M31") &&
+            !std::strcmp(params.filter_name_, "R") &&
+            params.ar_hdr_tries_ == 0 && params.temp_tolerance_ == -1 &&
+            error.error == ParseError::None,
+        "Command not resolved");
+
+  // options match exactly; any whitespace separates tokens
+  {
+    Quiet quiet;
+    CHECK(!resolve_image_parameters("image --binx 3 --bin 4", params) &&
+              params.image_hbin_ == 4 && params.image_vbin_ == 4,
+          "Prefix of an option matched");
+    CHECK(!resolve_image_parameters("image\t--hbin 3\r\n--vbin\t5\n",
+                                    params) &&
+              params.image_hbin_ == 3 && params.image_vbin_ == 5,
+          "Whitespace not handled");
+  }
+
+  // exact errors
+  const Expected expected[] = {
+      {"imagine --bin 2", ParseError::WrongCommand, "image", 0},
+      {"image --bin", ParseError::MissingValue, "--bin", 6},
+      {"image --bin 2x", ParseError::NotANumber, "--bin", 12},
+      {"image --bin  0", ParseError::OutOfRange, "--bin", 13},
+      {"image --vend 2049", ParseError::OutOfRange, "--vend", 13},
+      {"image --nimages 99999999999999999999", ParseError::OutOfRange,
+       "--nimages", 16},
+      {"image --exposure nan", ParseError::OutOfRange, "--exposure", 17},
+      {"image --exposure -1", ParseError::OutOfRange, "--exposure", 17},
+      {"image --exposure 1e", ParseError::NotANumber, "--exposure", 17},
+      {"image --ar-tries +-1", ParseError::NotANumber, "--ar-tries", 17},
+      {"image --type abcdefghijklmnop", ParseError::TooLong, "--type", 13},
+      {"image --at tomorrow", ParseError::InvalidTime, "--at", 11},
+      {"image --at 2020-01-01T00:00:00", ParseError::PastTime, "--at", 11},
+      {"image --bin 2 --hbin 1.5", ParseError::NotANumber, "--hbin", 21}};
+  for (const auto &e : expected) {
+    params.set_defaults();
+    CHECK(resolve_image_parameters(e.command, params, &error) == 1 &&
+              error.error == e.error && error.option == e.option &&
+              error.offset == e.offset,
+          e.command);
+  }
+  char buf[256];
+  resolve_image_parameters("image --bin  0", params, &error);
+  error.format(buf, sizeof(buf));
+  CHECK(!std::strcmp(buf, "--bin: value \"0\" out of range [1, 2048] (offset "
+                          "13)"),
+        buf);
+  resolve_image_parameters("image --filename a;b --bin", params, &error);
+  error.format(buf, sizeof(buf));
+  CHECK(!std::strcmp(buf, "--bin: missing value (offset 21)"), buf);
+
+  // name=value syntax; a rejected value
+  Target target;
+  CHECK(target_table.parse("set a=-5 x=1 b=0.25", target, &error) ==
+                ParseError::None &&
+            target.a == -5 && target.b == 0.25,
+        "Assignments not parsed");
+  CHECK(target_table.parse("set b=1 a=3 b=0", target, &error) ==
+                ParseError::Rejected &&
+            error.status == 7 && error.offset == 10 && target.b == 1,
+        "Rejected value not reported");
+  CHECK(target_table.parse("set a=", target, &error) ==
+                ParseError::MissingValue &&
+            error.offset == 4,
+        "Missing value not reported");
+
+  // fuzz: random tokens, mutated options and random bytes
+  {
+    Quiet quiet, quiet_stdout(1);
+    std::mt19937 rng(20211019);
+    const char *values[] = {"0",  "1",   "2",   "-1",   "2048", "2049",
+                            "1.5", "+3", "1e3", "inf",  "x",    "",
+                            "99999999999999999999", "2099-01-01T00:00:00"};
+    std::string command;
+    for (int i = 0; i < 20000; i++) {
+      command = "image";
+      int ntokens = rng() % 12;
+      for (int t = 0; t < ntokens; t++) {
+        command += (rng() % 8) ? ' ' : '\t';
+        switch (rng() % 4) {
+        case 0:
+          command += names[rng() % 16];
+          break;
+        case 1: {
+          std::string name = names[rng() % 16];
+          name[rng() % name.size()] = static_cast<char>(rng() % 255 + 1);
+          command += name;
+          break;
+        }
+        case 2:
+          command += values[rng() % (sizeof(values) / sizeof(values[0]))];
+          break;
+        default:
+          for (int c = rng() % 40; c > 0; c--)
+            command += static_cast<char>(rng() % 255 + 1);
+        }
+      }
+      params.set_defaults();
+      int status = resolve_image_parameters(command.c_str(), params, &error);
+      if (status == 1 && error.error != ParseError::None &&
+          error.offset >= command.size())
+        status = -1;
+      if (!status &&
+          (params.image_hbin_ < 1 || params.image_vbin_ < 1 ||
+           params.image_hend_ > MAX_PIXELS_IN_DIM || params.exposure_ < 0 ||
+           params.num_images_ < 1 ||
+           std::strlen(params.type_) >= MAX_IMAGE_TYPE_CHARS))
+        status = -1;
+      if (status < 0 || status > 2) {
+        quiet.~Quiet();
+        quiet_stdout.~Quiet();
+        fprintf(stderr, "[ERROR] Fuzzed command \"%s\" gave %d\n",
+                command.c_str(), status);
+        std::exit(1);
+      }
+    }
+  }
+
+  // throughput; nothing allocated
+  const char *commands[] = {
+      "image --nimages 1 --exposure 0 --type bias --filename bias",
+      "image --nimages 10 --bin 2 --hstart 513 --hend 1536 --vstart 513 "
+      "--vend 1536 --exposure 30 --type object --filename m31_r --object M31 "
+      "--filter R --ar-tries 0",
+      "image --exposure 5 --type flat --filter V --stable-within 0.5"};
+  const int n = 30000;
+  std::size_t before = allocations;
+  int failed = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  {
+    Quiet quiet(1); // (debug output)
+    for (int i = 0; i < n; i++) {
+      params.set_defaults();
+      failed += resolve_image_parameters(commands[i % 3], params) != 0;
+    }
+  }
+  double secs = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - t0)
+                    .count();
+  CHECK(!failed, "Valid commands refused");
+  CHECK(allocations == before, "Parsing allocated memory");
+  printf("parsed %d commands in %.1f ms (%.2f microsec each)\n", n,
+         secs * 1e3, secs * 1e6 / n);
+  CHECK(secs < 2, "Parsing too slow");
+
+  printf("all ok\n");
+  return 0;
+}
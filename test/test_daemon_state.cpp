@@ -0,0 +1,73 @@
+#include "daemon_state.hpp"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+// Save a daemon state to a temporary file, read it back and compare; values
+// out of the limits of setparam (e.g. from a corrupt or old file) are
+// ignored.
+
+int main() {
+  const char *fn = "/tmp/test_andor2kd.state";
+
+  AndorParameters params;
+  params.set_defaults();
+  params.acquisition_mode_ = AcquisitionMode::KineticSeries;
+  params.kinetics_cycle_time_ = 2.5;
+  params.hsspeed = 2;
+  params.preampgain = 1;
+  std::strcpy(params.observer_name_, "xanthos");
+
+  DaemonState state;
+  state.target_temp = -65;
+  state.planned_restart = 1;
+  state.saved_at = std::time(nullptr);
+
+  if (save_daemon_state(params, state, fn)) {
+    fprintf(stderr, "[ERROR] Failed to save daemon state\n");
+    return 1;
+  }
+
+  AndorParameters rparams;
+  rparams.set_defaults();
+  DaemonState rstate;
+  if (load_daemon_state(rparams, rstate, fn)) {
+    fprintf(stderr, "[ERROR] Failed to load daemon state\n");
+    return 1;
+  }
+  std::remove(fn);
+
+  int errors = 0;
+  errors += rstate.target_temp != state.target_temp;
+  errors += rstate.planned_restart != state.planned_restart;
+  errors += rstate.saved_at != state.saved_at;
+  errors += rparams.acquisition_mode_ != params.acquisition_mode_;
+  errors += rparams.kinetics_cycle_time_ != params.kinetics_cycle_time_;
+  errors += rparams.hsspeed != params.hsspeed;
+  errors += rparams.preampgain != params.preampgain;
+  errors += std::strcmp(rparams.observer_name_, params.observer_name_) != 0;
+
+  // a missing file is not an error, but is reported as such
+  errors += load_daemon_state(rparams, rstate, fn) != 1;
+
+  // invalid values leave the parameters untouched
+  if (FILE *fout = std::fopen(fn, "w")) {
+    std::fputs("target_temp=-500\nacqmode=7\nkineticcycletime=nan\n"
+               "hsspeed=-1\npreampgain=3x\nobservername="
+               "a_name_longer_than_thirty_one_chars\nplanned_restart=0\n",
+               fout);
+    std::fclose(fout);
+  }
+  errors += load_daemon_state(rparams, rstate, fn) != 0;
+  std::remove(fn);
+  errors += rstate.target_temp != state.target_temp;
+  errors += rstate.planned_restart != 0;
+  errors += rparams.acquisition_mode_ != params.acquisition_mode_;
+  errors += rparams.kinetics_cycle_time_ != params.kinetics_cycle_time_;
+  errors += rparams.hsspeed != params.hsspeed;
+  errors += rparams.preampgain != params.preampgain;
+  errors += std::strcmp(rparams.observer_name_, params.observer_name_) != 0;
+
+  printf("Daemon state round trip: %s\n", errors ? "FAILED" : "OK");
+  return errors;
+}
@@ -125,6 +125,17 @@ int main() {
 
   print_headers(headers);
 
+  // merging past the reserved capacity keeps the existing headers
+  FitsHeaders small(2);
+  small.update("KEYA", 1, "existing");
+  small.update("KEYB", 2, "existing");
+  if (small.merge(headers.mvec, false) < 0 ||
+      small.mvec.size() != headers.mvec.size() + 2 ||
+      std::strcmp(small.mvec[0].key, "KEYA")) {
+    fprintf(stderr, "Failed merging headers at line %d\n", __LINE__);
+    return 1;
+  }
+
   printf("\n");
   return 0;
 }
\ No newline at end of file
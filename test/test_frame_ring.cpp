@@ -0,0 +1,70 @@
+#include "frame_ring.hpp"
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// A writer publishes frames filled with their frame number, while a reader
+// thread keeps copying the latest frame and checking it is not torn.
+
+constexpr char shm_name[] = "/andor2k_test_frames";
+constexpr int width = 512;
+constexpr int height = 256;
+constexpr int num_frames = 2000;
+
+int main() {
+  FrameRingWriter writer;
+  if (writer.open(shm_name, FRAME_RING_NUM_SLOTS,
+                  sizeof(int32_t) * width * height)) {
+    fprintf(stderr, "ERROR. Failed to create frame ring\n");
+    return 1;
+  }
+
+  int reader_errors = 0;
+  int reader_frames = 0;
+  std::thread reader([&]() {
+    FrameRingReader ring;
+    if (ring.open(shm_name)) {
+      ++reader_errors;
+      return;
+    }
+    std::vector<int32_t> pixels(width * height);
+    FrameInfo info;
+    uint64_t last = 0;
+    while (last < num_frames) {
+      if (ring.read_latest(info, pixels.data(), pixels.size()))
+        continue;
+      if (info.frame_nr == last)
+        continue;
+      for (const auto px : pixels) {
+        if (px != (int32_t)info.frame_nr) {
+          ++reader_errors;
+          break;
+        }
+      }
+      if (info.image_nr != (int32_t)info.frame_nr)
+        ++reader_errors;
+      last = info.frame_nr;
+      ++reader_frames;
+    }
+  });
+
+  std::vector<int32_t> frame(width * height);
+  FrameInfo info;
+  info.width = width;
+  info.height = height;
+  info.num_images = num_frames;
+  for (int i = 1; i <= num_frames; i++) {
+    for (auto &px : frame)
+      px = i;
+    info.image_nr = i;
+    if (writer.publish(frame.data(), info) != (uint64_t)i) {
+      fprintf(stderr, "ERROR. Unexpected frame number for frame %d\n", i);
+      return 1;
+    }
+  }
+  reader.join();
+
+  printf("Reader saw %d/%d frames, errors: %d\n", reader_frames, num_frames,
+         reader_errors);
+  return reader_errors != 0;
+}
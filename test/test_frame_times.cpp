@@ -0,0 +1,136 @@
+#include "andor2k.hpp"
+#include "frame_times.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Check the formatting of frame times and the names of the times tables;
+// check the start/end of exposure derived from the time WaitForAcquisition
+// returns (no camera here, hence no SDK relative times), the FITS cards set
+// per frame, that the table is written, and that capturing a frame time is
+// cheap.
+
+const FitsHeader *find(const FitsHeaders &headers, const char *key) {
+  for (const auto &h : headers.mvec)
+    if (!std::strcmp(h.key, key))
+      return &h;
+  return nullptr;
+}
+
+int main() {
+  char buf[MAX_FITS_FILE_SIZE];
+
+  // formatting
+  if (std::strcmp(format_frame_time(1600000000123456789ll, true, buf),
+                  "2020-09-13T12:26:40.123456") ||
+      std::strcmp(format_frame_time(1600000000123456789ll, false, buf),
+                  "12:26:40.123456") ||
+      std::strcmp(format_frame_time(-1000ll, true, buf),
+                  "1969-12-31T23:59:59.999999")) {
+    fprintf(stderr, "[ERROR] Wrong frame time format: %s\n", buf);
+    return 1;
+  }
+  if (unix_ns_to_mjd(0) != 40587e0 ||
+      std::abs(unix_ns_to_mjd(1600000000000000000ll) - 59105.518518518) >
+          1e-8) {
+    fprintf(stderr, "[ERROR] Wrong MJD\n");
+    return 1;
+  }
+
+  // table names
+  if (frame_times_filename("/data/20220311_0001.fits", buf) ||
+      std::strcmp(buf, "/data/20220311_0001.times.fits") ||
+      frame_times_filename("noext", buf) ||
+      std::strcmp(buf, "noext.times.fits")) {
+    fprintf(stderr, "[ERROR] Wrong frame times filename: %s\n", buf);
+    return 1;
+  }
+  std::string too_long(MAX_FITS_FILE_SIZE, 'a');
+  if (!frame_times_filename(too_long.c_str(), buf)) {
+    fprintf(stderr, "[ERROR] Too long frame times filename accepted\n");
+    return 1;
+  }
+
+  // a series of 3 frames, 2 sec exposure plus 0.5 sec readout
+  FrameTimes times;
+  if (times.begin(3, 2e0, 2500000000l)) {
+    fprintf(stderr, "[ERROR] Failed to start series\n");
+    return 1;
+  }
+  for (int i = 1; i <= 3; i++) {
+    FrameTime *ft = times.capture();
+    if (!ft) {
+      fprintf(stderr, "[ERROR] Failed to capture frame %d\n", i);
+      return 1;
+    }
+    times.resolve(*ft, i);
+    if (ft->image_nr != i || ft->sdk_rel_ns != -1 ||
+        ft->end_utc_ns != ft->wait_utc_ns - 500000000 ||
+        ft->start_utc_ns != ft->end_utc_ns - 2000000000 ||
+        ft->wait_mono_ns <= 0) {
+      fprintf(stderr, "[ERROR] Wrong times for frame %d\n", i);
+      return 1;
+    }
+  }
+  if (times.capture() || times.frames().size() != 3) {
+    fprintf(stderr, "[ERROR] Captured more frames than reserved\n");
+    return 1;
+  }
+
+  // FITS cards
+  FitsHeaders headers;
+  const FrameTime &last = times.frames().back();
+  if (times.apply_headers(last, headers)) {
+    fprintf(stderr, "[ERROR] Failed to apply frame time headers\n");
+    return 1;
+  }
+  const FitsHeader *date_obs = find(headers, "DATE-OBS");
+  const FitsHeader *ut_start = find(headers, "UT-START");
+  const FitsHeader *ut_end = find(headers, "UT-END");
+  const FitsHeader *mjd_obs = find(headers, "MJD-OBS");
+  char start[32], end[32];
+  format_frame_time(last.start_utc_ns, true, buf);
+  format_frame_time(last.start_utc_ns, false, start);
+  format_frame_time(last.end_utc_ns, false, end);
+  if (!date_obs || !ut_start || !ut_end || !mjd_obs ||
+      std::strcmp(date_obs->cval, buf) || std::strcmp(ut_start->cval, start) ||
+      std::strcmp(ut_end->cval, end) ||
+      mjd_obs->dval != unix_ns_to_mjd(last.start_utc_ns)) {
+    fprintf(stderr, "[ERROR] Wrong frame time headers\n");
+    return 1;
+  }
+
+  // the table
+  char table[] = "/tmp/test_frame_times.times.fits";
+  std::snprintf(buf, sizeof(buf), "!%s", table);
+  struct stat st;
+  if (times.write_table(buf) || stat(table, &st) || !st.st_size) {
+    fprintf(stderr, "[ERROR] Failed to write frame times table\n");
+    return 1;
+  }
+  unlink(table);
+
+  // capture cost; should be a few hundred nanosec, at most
+  constexpr int CAPTURES = 100000;
+  times.begin(CAPTURES, 0e0, 0);
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < CAPTURES; i++)
+    times.capture();
+  auto per_capture = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - t0)
+                         .count() /
+                     CAPTURES;
+  if (times.frames().size() != CAPTURES || per_capture > 1000) {
+    fprintf(stderr, "[ERROR] Capturing a frame time takes %ld ns\n",
+            (long)per_capture);
+    return 1;
+  }
+
+  printf("all ok\n");
+  return 0;
+}
@@ -0,0 +1,128 @@
+#include "latency_stats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Record random durations in a latency histogram and check the percentiles
+// against the exact ones (they should be within the histogram's resolution);
+// record from several threads at once and check that no sample is lost; then
+// measure the cost of timing a phase.
+
+using namespace std::chrono;
+
+constexpr double TOLERANCE = 1e0 / LatencyHistogram::SUB_BUCKETS;
+
+int main() {
+  // all values map to a bucket whose upper limit is not below the value and
+  // is within the histogram's resolution
+  for (uint64_t v = 0; v < (1ULL << 41); v = v * 5 / 4 + 1) {
+    int idx = LatencyHistogram::bucket(v);
+    uint64_t up = LatencyHistogram::bucket_upper(idx);
+    if (idx < 0 || idx >= LatencyHistogram::NUM_BUCKETS ||
+        (v < (1ULL << LatencyHistogram::MAX_BITS) &&
+         (up < v || up - v > v * TOLERANCE))) {
+      fprintf(stderr, "[ERROR] Value %lu mapped to bucket %d (upper: %lu)\n",
+              (unsigned long)v, idx, (unsigned long)up);
+      return 1;
+    }
+  }
+
+  // percentiles of log-normally distributed durations (~1 ms to ~10 s)
+  LatencyStats stats;
+  std::mt19937_64 gen(42);
+  std::lognormal_distribution<double> dist(std::log(5e7), 2e0);
+  std::vector<int64_t> values;
+  for (int i = 0; i < 100000; i++) {
+    int64_t v = static_cast<int64_t>(dist(gen));
+    values.push_back(v);
+    stats.record(LatencyPhase::Exposure, v);
+  }
+  std::sort(values.begin(), values.end());
+  const LatencyHistogram &h = stats.histogram(LatencyPhase::Exposure);
+  for (double q : {1e0, 50e0, 90e0, 99e0, 99.9e0, 100e0}) {
+    int64_t exact = values[static_cast<std::size_t>(
+        std::ceil(q / 1e2 * values.size()) - 1)];
+    uint64_t got = h.percentile(q);
+    if (std::abs((double)got - exact) > exact * TOLERANCE) {
+      fprintf(stderr, "[ERROR] p%.1f: got %lu expected %ld\n", q,
+              (unsigned long)got, (long)exact);
+      return 1;
+    }
+  }
+  if (h.count() != values.size() ||
+      h.max() != static_cast<uint64_t>(values.back())) {
+    fprintf(stderr, "[ERROR] Wrong count/max\n");
+    return 1;
+  }
+
+  // the formatted output has an entry per phase
+  char buf[1024];
+  stats.format(buf, sizeof(buf));
+  printf("%s\n", buf);
+  if (!std::strstr(buf, "exposure:n=100000,") ||
+      !std::strstr(buf, ";report:n=0,")) {
+    fprintf(stderr, "[ERROR] Unexpected formatting of statistics\n");
+    return 1;
+  }
+  // a buffer too small is truncated at the last complete entry
+  int len = stats.format(buf, 60);
+  if (len != (int)std::strlen(buf) ||
+      std::strcmp(buf, "setup:n=0,p50=0.000,p90=0.000,p99=0.000,max=0.000")) {
+    fprintf(stderr, "[ERROR] Wrong truncation of statistics: \"%s\"\n", buf);
+    return 1;
+  }
+
+  stats.reset();
+  if (h.count() || h.max() || h.percentile(50e0)) {
+    fprintf(stderr, "[ERROR] Statistics not cleared\n");
+    return 1;
+  }
+
+  // concurrent recording; timers record on destruction
+  constexpr int NTHREADS = 4, NSAMPLES = 100000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < NTHREADS; t++)
+    threads.emplace_back([&] {
+      for (int i = 0; i < NSAMPLES; i++)
+        auto timer = stats.timer(LatencyPhase::Readout);
+    });
+  for (auto &t : threads)
+    t.join();
+  if (stats.histogram(LatencyPhase::Readout).count() !=
+      (uint64_t)NTHREADS * NSAMPLES) {
+    fprintf(stderr, "[ERROR] Lost samples while recording concurrently\n");
+    return 1;
+  }
+
+  // cost of timing a phase (two clock readings plus recording the sample)
+  constexpr int NBENCH = 1000000;
+  auto t0 = steady_clock::now();
+  for (int i = 0; i < NBENCH; i++) {
+    auto timer = stats.timer(LatencyPhase::Report);
+    timer.stop();
+  }
+  double ns_timer =
+      duration_cast<nanoseconds>(steady_clock::now() - t0).count() /
+      (double)NBENCH;
+  t0 = steady_clock::now();
+  for (int i = 0; i < NBENCH; i++)
+    stats.record(LatencyPhase::Close, i);
+  double ns_record =
+      duration_cast<nanoseconds>(steady_clock::now() - t0).count() /
+      (double)NBENCH;
+  printf("ns per sample: record %.1f, timed phase %.1f\n", ns_record,
+         ns_timer);
+  // generous; the target is < 100 ns, but leave room for instrumented builds
+  if (ns_timer > 1e3) {
+    fprintf(stderr, "[ERROR] Timing a phase is too expensive\n");
+    return 1;
+  }
+
+  printf("all ok\n");
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include "cpp_socket.hpp"
+#include "metrics.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+// Serve a few metrics on localhost and scrape them the way Prometheus does
+// (an HTTP GET on /metrics); check the response and the text format, and
+// that unknown paths are answered with a 404.
+
+using andor2k::ClientSocket;
+
+constexpr int PORT = 18082;
+
+std::string http_get(const char *path) {
+  std::string response;
+  ClientSocket client("localhost", PORT);
+  char buf[1024];
+  std::snprintf(buf, sizeof(buf), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n",
+                path);
+  client.send(buf);
+  int bytes;
+  while ((bytes = client.recv(buf, sizeof(buf))) > 0)
+    response.append(buf, bytes);
+  return response;
+}
+
+int main() {
+  DaemonMetrics metrics;
+  metrics.frame_acquired(true);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  metrics.frame_acquired(false);
+  metrics.frame_written(16, 1000);
+  if (metrics.frames_acquired != 2 || metrics.frame_interval_ns < 20000000 ||
+      metrics.bytes_written != 16) {
+    fprintf(stderr, "[ERROR] Wrong counters\n");
+    return 1;
+  }
+
+  // the text format
+  char buf[512];
+  int len = prometheus_append(buf, sizeof(buf), 0, "x_total", "counter",
+                              "Some x.", 3);
+  len = prometheus_append(buf, sizeof(buf), len, "y", "gauge", "Some y.", 1.5,
+                          "state=\"a\"");
+  len = prometheus_append(buf, sizeof(buf), len, "y", nullptr, nullptr, 0,
+                          "state=\"b\"");
+  if (std::strcmp(buf, "# HELP x_total Some x.\n# TYPE x_total counter\n"
+                       "x_total 3\n# HELP y Some y.\n# TYPE y gauge\n"
+                       "y{state=\"a\"} 1.5\ny{state=\"b\"} 0\n") ||
+      len != (int)std::strlen(buf)) {
+    fprintf(stderr, "[ERROR] Unexpected format:\n%s\n", buf);
+    return 1;
+  }
+  // metrics that do not fit are left out
+  if (prometheus_append(buf, 20, 0, "x_total", "counter", "Some x.", 3) ||
+      buf[0]) {
+    fprintf(stderr, "[ERROR] Metric appended past the end of the buffer\n");
+    return 1;
+  }
+
+  MetricsServer server;
+  if (server.start(PORT, [&](char *b, int sz) {
+        return prometheus_append(
+            b, sz, 0, "andor2k_frames_acquired_total", "counter",
+            "Frames acquired.",
+            metrics.frames_acquired.load(std::memory_order_relaxed));
+      })) {
+    fprintf(stderr, "[ERROR] Failed to start metrics server\n");
+    return 1;
+  }
+
+  std::string response = http_get("/metrics");
+  if (response.compare(0, 15, "HTTP/1.1 200 OK") ||
+      response.find("\r\n\r\n# HELP andor2k_frames_acquired_total") ==
+          std::string::npos ||
+      response.find("\nandor2k_frames_acquired_total 2\n") ==
+          std::string::npos) {
+    fprintf(stderr, "[ERROR] Unexpected response:\n%s\n", response.c_str());
+    return 1;
+  }
+  metrics.frame_acquired(false);
+  response = http_get("/metrics");
+  if (response.find("\nandor2k_frames_acquired_total 3\n") ==
+      std::string::npos) {
+    fprintf(stderr, "[ERROR] Stale metrics:\n%s\n", response.c_str());
+    return 1;
+  }
+  response = http_get("/other");
+  if (response.compare(0, 22, "HTTP/1.1 404 Not Found")) {
+    fprintf(stderr, "[ERROR] Unexpected response:\n%s\n", response.c_str());
+    return 1;
+  }
+
+  // stop returns even though the server is blocked waiting for connections
+  server.stop();
+  if (server.served() != 3) {
+    fprintf(stderr, "[ERROR] Served %lu requests, expected 3\n",
+            (unsigned long)server.served());
+    return 1;
+  }
+
+  printf("all ok\n");
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include "andor2k.hpp"
+#include "cpp_socket.hpp"
+#include "obs_queue.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Check that plain images (inserted via insert_immediate) run ahead of the
+// queued jobs, but in the order they were sent, both with the queue paused
+// and while a job is running; and that a moved job is no longer immediate.
+
+namespace {
+std::vector<int> executed; // number of images of each job, as executed
+std::atomic<bool> blocking{false}; // make the next job wait for release
+std::atomic<bool> released{false};
+
+int record(AndorParameters &params, const andor2k::Socket &) noexcept {
+  executed.push_back(params.num_images_);
+  while (blocking && !released)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  blocking = false;
+  return 0;
+}
+
+bool wait_idle(const ObservationQueue &queue) {
+  for (int i = 0; i < 5000; i++) {
+    if (!queue.pending() && !queue.running())
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return false;
+}
+
+bool submit(ObservationQueue &queue, const andor2k::Socket &socket,
+            int nimages, bool immediate) {
+  char command[64];
+  std::snprintf(command, sizeof(command), "image --nimages %d", nimages);
+  AndorParameters params;
+  uint64_t id;
+  return immediate ? !queue.insert_immediate(command, params, socket, id)
+                   : !queue.insert(command, params, socket, -1, id);
+}
+} // namespace
+
+int main() {
+  // (nobody reads the job messages; the buffer of the pair is large enough)
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+    fprintf(stderr, "[ERROR] Failed to create socket pair\n");
+    return 1;
+  }
+  andor2k::Socket socket(fds[0], sockaddr_in{});
+
+  // paused (e.g. camera initialising): queued 10, 11, then plain 1, 2, 3
+  ObservationQueue queue;
+  if (queue.start(record, true)) {
+    fprintf(stderr, "[ERROR] Failed to start queue\n");
+    return 1;
+  }
+  if (!submit(queue, socket, 10, false) || !submit(queue, socket, 11, false) ||
+      !submit(queue, socket, 1, true) || !submit(queue, socket, 2, true) ||
+      !submit(queue, socket, 3, true)) {
+    fprintf(stderr, "[ERROR] Failed to submit jobs\n");
+    return 1;
+  }
+  queue.resume();
+  if (!wait_idle(queue) || executed != std::vector<int>{1, 2, 3, 10, 11}) {
+    fprintf(stderr, "[ERROR] Plain images not run in the order sent "
+                    "(paused queue)\n");
+    return 1;
+  }
+
+  // while a job runs: queued 12, then plain 4, 5
+  executed.clear();
+  blocking = true;
+  released = false;
+  submit(queue, socket, 9, false);
+  while (!queue.running())
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  submit(queue, socket, 12, false);
+  submit(queue, socket, 4, true);
+  submit(queue, socket, 5, true);
+  released = true;
+  if (!wait_idle(queue) || executed != std::vector<int>{9, 4, 5, 12}) {
+    fprintf(stderr, "[ERROR] Plain images not run in the order sent "
+                    "(running job)\n");
+    return 1;
+  }
+
+  // a plain image moved back is an ordinary job: the next plain image
+  // goes ahead of it
+  executed.clear();
+  queue.pause();
+  uint64_t id;
+  AndorParameters params;
+  queue.insert_immediate("image --nimages 6", params, socket, id);
+  submit(queue, socket, 13, false);
+  queue.move(id, -1);
+  submit(queue, socket, 7, true);
+  queue.resume();
+  if (!wait_idle(queue) || executed != std::vector<int>{7, 13, 6}) {
+    fprintf(stderr, "[ERROR] Moved job still treated as immediate\n");
+    return 1;
+  }
+
+  queue.stop();
+  close(fds[1]);
+  printf("all ok\n");
+  return 0;
+}
@@ -17,9 +17,7 @@
 
 using andor2k::Socket;
 
-extern std::mutex g_mtx;
 extern std::mutex g_mtx_abort;
-extern int abort_set;
 extern int abort_socket_fd;
 extern std::condition_variable cv;
 
@@ -0,0 +1,143 @@
+#include "andor2k.hpp"
+#include "andor_sim.hpp"
+#include "atmcdLXd.h"
+#include "readout_plan.hpp"
+#include "setup_cache.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// The plan with the lowest read noise (slowest horizontal speed, then
+// smallest binning, highest pre-amp gain) that meets the cadence, with the
+// timings of the simulated SDK; the fastest readout if none does; data rate
+// and disk usage of the series. Runs against the simulated SDK.
+
+extern SetupCache g_setup_cache;
+
+#define CHECK(expr, what)                                                      \
+  if (!(expr)) {                                                               \
+    fprintf(stderr, "[ERROR] %s (line %d)\n", what, __LINE__);                 \
+    return 1;                                                                  \
+  }
+
+namespace {
+/// kinetic cycle of the simulated SDK (shutter open, fastest vertical speed)
+double sim_cycle(double exposure, int width, int height, int bin,
+                 double mhz) {
+  const auto &cfg = andor_sim_config();
+  return exposure + cfg.height * cfg.vs_speeds_us[cfg.fastest_recommended_vs] *
+                        1e-6 +
+         static_cast<double>(width / bin) * (height / bin) / (mhz * 1e6) +
+         cfg.readout_overhead;
+}
+
+bool near(double a, double b) { return std::abs(a - b) < 1e-3 * b + 1e-4; }
+} // namespace
+
+int main() {
+  andor_sim_config().time_scale = 1e-3;
+  CHECK(Initialize((char *)"/usr/local/etc/andor") == DRV_SUCCESS,
+        "Initialize failed");
+  CHECK(!g_setup_cache.load(), "Load failed");
+  const auto &cfg = andor_sim_config();
+  // (speeds: 5, 3, 1, 0.05 MHz; gains: 1x, 2x, 4x)
+
+  AndorParameters params;
+  params.shutter_mode_ = ShutterMode::PermanentlyOpen;
+  std::strcpy(params.type_, "object");
+  std::strcpy(params.save_dir_, "/tmp");
+
+  // command
+  PlanRequest request;
+  CommandError error;
+  CHECK(!resolve_plan_parameters("plan --cadence 2.5 --exposure 1 --width "
+                                 "1024 --height 512 --nimages 10 --max-bin 4",
+                                 request) &&
+            request.cadence == 2.5f && request.exposure == 1.f &&
+            request.width == 1024 && request.height == 512 &&
+            request.nimages == 10 && request.max_bin == 4,
+        "Plan command not resolved");
+  PlanRequest bad;
+  CHECK(resolve_plan_parameters("plan --exposure 1", bad, &error) &&
+            error.error == ParseError::MissingValue &&
+            error.option == "--cadence",
+        "Missing cadence accepted");
+  CHECK(resolve_plan_parameters("plan --cadence 1 --max-bin 17", bad, &error) &&
+            error.error == ParseError::OutOfRange && error.offset == 27,
+        "Binning out of range accepted");
+
+  // a slow cadence: the slowest readout, highest gain, no binning
+  ReadoutPlan plan;
+  request = PlanRequest{};
+  request.cadence = 100;
+  request.exposure = 1;
+  CHECK(!plan_readout(request, params, plan), "Plan failed");
+  CHECK(plan.hsspeed == 3 && plan.bin == 1 && plan.preampgain == 2 &&
+            plan.preampgain_factor == 4.f && plan.hstart == 1 &&
+            plan.hend == cfg.width && plan.vend == cfg.height,
+        "Not the lowest noise readout");
+  CHECK(near(plan.cycle, sim_cycle(1, cfg.width, cfg.height, 1, 0.05)) &&
+            plan.cycle <= request.cadence && plan.readout < plan.cycle,
+        "Wrong cycle");
+
+  // faster: binning at the slowest speed, before a faster speed
+  double cycle4 = sim_cycle(1, cfg.width, cfg.height, 4, 0.05);
+  request.cadence = static_cast<float>(cycle4) + 0.01f;
+  request.max_bin = 4;
+  CHECK(!plan_readout(request, params, plan) && plan.hsspeed == 3 &&
+            plan.bin == 4 && near(plan.cycle, cycle4),
+        "Binning not preferred to a faster readout");
+  request.max_bin = 1;
+  CHECK(!plan_readout(request, params, plan) && plan.hsspeed == 2 &&
+            plan.bin == 1,
+        "Not the slowest speed meeting the cadence");
+
+  // a field; data rate and disk usage
+  request = PlanRequest{};
+  request.cadence = 2.5;
+  request.exposure = 1;
+  request.width = 1024;
+  request.height = 512;
+  request.nimages = 10;
+  CHECK(!plan_readout(request, params, plan), "Plan of a field failed");
+  CHECK(plan.hstart == 513 && plan.hend == 1536 && plan.vstart == 769 &&
+            plan.vend == 1280 && plan.frame_bytes == 1024 * 512 * 4 &&
+            plan.series_bytes ==
+                10 * (PLAN_FITS_HEADER_BYTES + 729 * 2880) &&
+            near(plan.data_rate, plan.frame_bytes / 2.5) &&
+            plan.free_bytes > 0,
+        "Wrong field, data rate or disk usage");
+  CHECK(near(plan.cycle, sim_cycle(1, 1024, 512, 1, plan.hsspeed_mhz)),
+        "Wrong cycle of a field");
+
+  // binning of an odd field
+  request.width = 1001;
+  request.max_bin = 2;
+  request.cadence = static_cast<float>(sim_cycle(1, 1000, 512, 2, 0.05)) +
+                    0.01f;
+  CHECK(!plan_readout(request, params, plan) && plan.bin == 2 &&
+            plan.hend - plan.hstart + 1 == 1000,
+        "Odd field not binned");
+
+  // unreachable: the fastest readout
+  request = PlanRequest{};
+  request.cadence = 0.5;
+  request.exposure = 1;
+  request.max_bin = 2;
+  CHECK(plan_readout(request, params, plan) == 1 && plan.hsspeed == 0 &&
+            plan.bin == 2 &&
+            near(plan.cycle, sim_cycle(1, cfg.width, cfg.height, 2, 5)),
+        "Fastest readout not reported");
+
+  // the camera is left set up as the last candidate, and the cache knows
+  params.image_hbin_ = params.image_vbin_ = 2;
+  int64_t calls = andor_sim_setting_calls();
+  CHECK(!setup_read_out_mode(&params) && andor_sim_setting_calls() == calls,
+        "Setup of the last candidate not cached");
+  params.image_hbin_ = params.image_vbin_ = 1;
+  CHECK(!setup_read_out_mode(&params) && andor_sim_setting_calls() > calls,
+        "Read-out mode not set");
+  ShutDown();
+  printf("all ok\n");
+  return 0;
+}
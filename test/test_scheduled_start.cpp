@@ -0,0 +1,106 @@
+#include "andor2k.hpp"
+#include "andor2kd.hpp"
+#include "andor_time_utils.hpp"
+#include "scheduled_start.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+// Check the parsing of "image --at" times, and that waits for a UTC instant
+// end on time (within a millisecond, allowing for a loaded machine; spinning
+// gets within microseconds), can be aborted, and return at once for a time
+// that has passed.
+
+std::atomic<bool> abort_wait{false};
+
+int main() {
+  // parsing
+  struct {
+    const char *str;
+    int64_t ns;
+  } valid[] = {
+      {"1970-01-01T00:00:00", 0},
+      {"2020-09-13T12:26:40.123456789Z", 1600000000123456789ll},
+      {"2020-09-13 12:26:40.5", 1600000000500000000ll},
+      {"2024-02-29T00:00:00Z", 1709164800000000000ll},
+  };
+  for (const auto &v : valid) {
+    int64_t ns;
+    if (parse_utc(v.str, ns) || ns != v.ns) {
+      fprintf(stderr, "[ERROR] Failed to parse \"%s\"\n", v.str);
+      return 1;
+    }
+  }
+  const char *invalid[] = {"2020-09-13",
+                           "2020-09-13T12:26",
+                           "2020-09-13T25:00:00",
+                           "2023-02-29T00:00:00",
+                           "2020-13-01T00:00:00",
+                           "2020-09-13T12:26:40.",
+                           "2020-09-13T12:26:40.1234567891",
+                           "2020-09-13T12:26:40 trailing",
+                           "20-09-13T12:26:40"};
+  for (const char *str : invalid) {
+    int64_t ns;
+    if (!parse_utc(str, ns)) {
+      fprintf(stderr, "[ERROR] Invalid time \"%s\" accepted\n", str);
+      return 1;
+    }
+  }
+  if (days_from_civil(2020, 9, 13) != 18518) {
+    fprintf(stderr, "[ERROR] Wrong days from civil date\n");
+    return 1;
+  }
+
+  // "image --at" is a one-shot option
+  AndorParameters params;
+  params.set_defaults();
+  char command[MAX_SOCKET_BUFFER_SIZE] = {'\0'};
+  std::strcpy(command, "image --at 2099-01-01T00:00:00 --exposure 1");
+  if (resolve_image_parameters(command, params) || params.start_at_ns_ <= 0) {
+    fprintf(stderr, "[ERROR] Failed to resolve \"%s\"\n", command);
+    return 1;
+  }
+  std::strcpy(command, "image --exposure 1");
+  if (resolve_image_parameters(command, params) || params.start_at_ns_) {
+    fprintf(stderr, "[ERROR] Scheduled start not cleared\n");
+    return 1;
+  }
+  std::strcpy(command, "image --at 2000-01-01T00:00:00");
+  if (!resolve_image_parameters(command, params)) {
+    fprintf(stderr, "[ERROR] Start time in the past accepted\n");
+    return 1;
+  }
+
+  // waits
+  ScheduledStart scheduled(nullptr, first_isolated_cpu());
+  for (int i = 0; i < 5; i++) {
+    int64_t target = scheduled.now_utc_ns() + 30000000; // in 30 ms
+    int status = scheduled.wait_until(target, nullptr);
+    int64_t late = scheduled.now_utc_ns() - target;
+    scheduled.unpin();
+    if (status || late < 0 || late > 1000000) {
+      fprintf(stderr, "[ERROR] Wait ended %ld ns off (status %d)\n",
+              (long)late, status);
+      return 1;
+    }
+  }
+
+  // abort, well before the target
+  abort_wait = true;
+  int64_t target = scheduled.now_utc_ns() + 10000000000ll; // in 10 sec
+  if (scheduled.wait_until(target, [] { return abort_wait.load(); }) != 1 ||
+      scheduled.now_utc_ns() > target - 9000000000ll) {
+    fprintf(stderr, "[ERROR] Wait not aborted\n");
+    return 1;
+  }
+
+  // a time that has passed
+  if (scheduled.wait_until(scheduled.now_utc_ns() - 1000, nullptr) != 2) {
+    fprintf(stderr, "[ERROR] Wait for a past time\n");
+    return 1;
+  }
+
+  printf("all ok\n");
+  return 0;
+}
@@ -0,0 +1,170 @@
+#include "sdk_owner.hpp"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Check that commands sent to the SDK owner from several threads all run on
+// the owner thread, one at a time and in order per sender; that calls from
+// the owner itself (or with the owner stopped) run inline; that periodic
+// polls do not pile up while the owner is busy; that a long command may
+// yield to the queries (only) queued meanwhile; and that stop runs the
+// commands already queued.
+
+constexpr int THREADS = 8;
+constexpr int COMMANDS = 2000;
+
+int main() {
+  SdkOwner owner;
+
+  // not running: call runs inline, submit fails
+  if (owner.running() ||
+      owner.call([] { return std::this_thread::get_id(); }) !=
+          std::this_thread::get_id() ||
+      owner.submit([] { return 0; }).valid()) {
+    fprintf(stderr, "[ERROR] Stopped owner did not run the command inline\n");
+    return 1;
+  }
+
+  if (owner.start() || !owner.running() || owner.on_owner_thread()) {
+    fprintf(stderr, "[ERROR] Failed to start owner\n");
+    return 1;
+  }
+  std::thread::id owner_id =
+      owner.call([] { return std::this_thread::get_id(); });
+
+  // concurrent senders
+  std::atomic<int> inside{0}, overlaps{0}, foreign{0}, disorder{0};
+  std::vector<std::thread> senders;
+  for (int t = 0; t < THREADS; t++) {
+    senders.emplace_back([&] {
+      int last = -1;
+      for (int i = 0; i < COMMANDS; i++) {
+        int r = owner.call([&, i] {
+          if (inside.fetch_add(1) != 0)
+            ++overlaps;
+          if (std::this_thread::get_id() != owner_id)
+            ++foreign;
+          inside.fetch_sub(1);
+          return i;
+        });
+        if (r != last + 1)
+          ++disorder;
+        last = r;
+      }
+    });
+  }
+  for (auto &t : senders)
+    t.join();
+  if (overlaps || foreign || disorder ||
+      owner.executed() < static_cast<uint64_t>(THREADS * COMMANDS)) {
+    fprintf(stderr,
+            "[ERROR] Commands overlapped (%d), ran elsewhere (%d) or out of "
+            "order (%d)\n",
+            overlaps.load(), foreign.load(), disorder.load());
+    return 1;
+  }
+
+  // nested calls run inline (no deadlock)
+  if (owner.call([&] {
+        return owner.on_owner_thread() &&
+               owner.call([] { return std::this_thread::get_id(); }) ==
+                   owner_id;
+      }) != true) {
+    fprintf(stderr, "[ERROR] Nested call did not run inline\n");
+    return 1;
+  }
+
+  // a busy owner: polls give up after the timeout, and only one request is
+  // outstanding; it is picked up once the owner is free
+  std::atomic<bool> release{false};
+  auto busy = owner.submit([&] {
+    while (!release)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return 0;
+  });
+  SdkPoll<int> poll;
+  std::atomic<int> polled{0};
+  int result = -1;
+  for (int i = 0; i < 5; i++) {
+    if (poll.poll(owner, [&polled] { return ++polled; },
+                  std::chrono::milliseconds(5), result)) {
+      fprintf(stderr, "[ERROR] Poll succeeded while the owner was busy\n");
+      return 1;
+    }
+  }
+  if (owner.pending() != 1) {
+    fprintf(stderr, "[ERROR] Polls piled up (%zu pending)\n", owner.pending());
+    return 1;
+  }
+  release = true;
+  busy.get();
+  if (!poll.poll(owner, [&polled] { return ++polled; },
+                 std::chrono::milliseconds(1000), result) ||
+      result != 1 || polled != 1) {
+    fprintf(stderr, "[ERROR] Pending poll not picked up\n");
+    return 1;
+  }
+
+  // a yielding command (e.g. an acquisition) serves queries, in order, but
+  // no other command; off the owner, yield does nothing
+  std::atomic<bool> queued_both{false};
+  std::vector<int> order;
+  auto acquisition = owner.submit([&] {
+    while (!queued_both)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    int yielded = owner.yield();
+    order.push_back(0);
+    return yielded;
+  });
+  auto exclusive = owner.submit([&] {
+    order.push_back(3);
+    return 0;
+  });
+  auto query1 = owner.submit(
+      [&] {
+        order.push_back(1);
+        return 0;
+      },
+      SdkAccess::Query);
+  auto query2 = owner.submit(
+      [&] {
+        order.push_back(2);
+        return 0;
+      },
+      SdkAccess::Query);
+  queued_both = true;
+  if (owner.yield() != 0 || acquisition.get() != 2 || query1.get() ||
+      query2.get() || exclusive.get() ||
+      order != std::vector<int>{1, 2, 0, 3}) {
+    fprintf(stderr, "[ERROR] Yield did not serve (only) the queries\n");
+    return 1;
+  }
+
+  // stop runs what is queued, then calls run inline
+  std::atomic<bool> gate{false};
+  std::atomic<int> ran{0};
+  owner.submit([&] {
+    while (!gate)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return 0;
+  });
+  std::vector<std::future<int>> queued;
+  for (int i = 0; i < 10; i++)
+    queued.push_back(owner.submit([&ran] { return ++ran; }));
+  std::thread stopper([&] { owner.stop(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  gate = true;
+  stopper.join();
+  for (auto &f : queued)
+    f.get();
+  if (ran != 10 || owner.running() ||
+      owner.call([] { return std::this_thread::get_id(); }) !=
+          std::this_thread::get_id()) {
+    fprintf(stderr, "[ERROR] Queued commands lost on stop\n");
+    return 1;
+  }
+
+  printf("all ok\n");
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include "andor2k.hpp"
+#include "andor_sim.hpp"
+#include "atmcdLXd.h"
+#include "fits_header.hpp"
+#include "setup_cache.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// Camera invariants are cached at load; setting up the same acquisition
+// twice calls no SDK setter the second time, a changed setting calls only
+// its own setter, and the shutter is only waited for when it closes. Runs
+// against the simulated SDK.
+
+extern SetupCache g_setup_cache;
+
+#define CHECK(expr, what)                                                      \
+  if (!(expr)) {                                                               \
+    fprintf(stderr, "[ERROR] %s (line %d)\n", what, __LINE__);                 \
+    return 1;                                                                  \
+  }
+
+namespace {
+/// setup an acquisition; returns the SDK setter calls made, or -1 on error
+int64_t setup(const AndorParameters &params, double &seconds) {
+  FitsHeaders headers;
+  int width, height;
+  float vsspeed, hsspeed_mhz;
+  at_32 *img_mem = nullptr;
+  int64_t calls = andor_sim_setting_calls();
+  auto t0 = std::chrono::steady_clock::now();
+  int status = setup_acquisition(&params, &headers, width, height, vsspeed,
+                                 hsspeed_mhz, img_mem);
+  seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          t0)
+                .count();
+  delete[] img_mem;
+  if (status)
+    return -1;
+  return andor_sim_setting_calls() - calls;
+}
+} // namespace
+
+int main() {
+  andor_sim_config().time_scale = 1e-3;
+  CHECK(Initialize((char *)"/usr/local/etc/andor") == DRV_SUCCESS,
+        "Initialize failed");
+
+  // invariants
+  int xpixels, ypixels, num;
+  float value;
+  CHECK(g_setup_cache.detector(xpixels, ypixels), "Loaded before load");
+  CHECK(!g_setup_cache.load() && g_setup_cache.loaded(), "Load failed");
+  CHECK(!g_setup_cache.detector(xpixels, ypixels) && xpixels == 2048 &&
+            ypixels == 2048,
+        "Wrong detector size");
+  int sdk_num;
+  GetNumberHSSpeeds(0, 0, &sdk_num);
+  CHECK(!g_setup_cache.num_hsspeeds(num) && num == sdk_num,
+        "Wrong number of horizontal speeds");
+  float sdk_value;
+  GetHSSpeed(0, 0, num - 1, &sdk_value);
+  CHECK(!g_setup_cache.hsspeed(num - 1, value) && value == sdk_value &&
+            g_setup_cache.hsspeed(num, value),
+        "Wrong horizontal speed");
+  GetNumberPreAmpGains(&sdk_num);
+  CHECK(!g_setup_cache.num_preampgains(num) && num == sdk_num &&
+            !g_setup_cache.preampgain(0, value),
+        "Wrong pre-amp gains");
+  int index, sdk_index;
+  GetFastestRecommendedVSSpeed(&sdk_index, &sdk_value);
+  CHECK(!g_setup_cache.fastest_vsspeed(index, value) && index == sdk_index &&
+            value == sdk_value,
+        "Wrong vertical speed");
+
+  // the same acquisition twice: nothing set the second time
+  AndorParameters params;
+  params.image_hbin_ = params.image_vbin_ = 2;
+  std::strcpy(params.type_, "object");
+  double seconds;
+  CHECK(setup(params, seconds) > 0, "First setup failed");
+  uint64_t skipped = g_setup_cache.skipped();
+  uint64_t issued = g_setup_cache.issued();
+  CHECK(setup(params, seconds) == 0, "Settings issued again");
+  CHECK(g_setup_cache.skipped() > skipped && g_setup_cache.issued() == issued,
+        "Skipped settings not accounted for");
+
+  // a changed setting is the only one set
+  params.hsspeed = 2;
+  CHECK(setup(params, seconds) == 1, "Unchanged settings issued");
+  params.exposure_ = 2.5f;
+  CHECK(setup(params, seconds) > 0, "Changed exposure not set");
+  CHECK(setup(params, seconds) == 0, "Settings issued again");
+
+  // dark: the shutter is given time to close only when it closes
+  std::strcpy(params.type_, "dark");
+  CHECK(setup(params, seconds) == 1 && seconds >= 0.9, "Shutter not closed");
+  CHECK(setup(params, seconds) == 0 && seconds < 0.5,
+        "Waited for a closed shutter");
+  std::strcpy(params.type_, "object");
+  CHECK(setup(params, seconds) == 1 && seconds < 0.5, "Shutter not opened");
+
+  // cleared (e.g. at shutdown): everything is set again
+  g_setup_cache.clear();
+  CHECK(!g_setup_cache.loaded() && g_setup_cache.detector(xpixels, ypixels),
+        "Cache not cleared");
+  int64_t calls = setup(params, seconds);
+  CHECK(calls > 1, "Settings not set after clear");
+  CHECK(!g_setup_cache.load() && setup(params, seconds) == calls,
+        "Settings not set after load");
+  CHECK(setup(params, seconds) == 0, "Settings issued again");
+
+  ShutDown();
+  printf("all ok\n");
+  return 0;
+}
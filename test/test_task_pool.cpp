@@ -0,0 +1,250 @@
+#include "andor2k.hpp"
+#include "series_writer.hpp"
+#include "task_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+// Frame tasks run before background ones, and are not stuck behind them; an
+// idle worker steals from a blocked one; per-type accounts; stop runs what
+// is queued and refuses more. SeriesWriter writes a series of frames (on
+// the pool and inline), numbered by get_following_fits_filename.
+
+using namespace std::chrono_literals;
+
+namespace {
+/// a gate tasks can be held at
+struct Gate {
+  std::atomic<bool> open{false};
+  std::atomic<int> waiting{0};
+  void pass() {
+    waiting.fetch_add(1);
+    while (!open.load())
+      std::this_thread::sleep_for(1ms);
+  }
+};
+
+bool wait_for(const std::atomic<int> &n, int value) {
+  for (int i = 0; i < 5000 && n.load() < value; i++)
+    std::this_thread::sleep_for(1ms);
+  return n.load() >= value;
+}
+} // namespace
+
+int main() {
+  // one worker, held at a gate: what is queued meanwhile runs frame first
+  {
+    TaskPool pool;
+    if (pool.start(1) || pool.size() != 1) {
+      fprintf(stderr, "[ERROR] Failed to start task pool\n");
+      return 1;
+    }
+    Gate gate;
+    std::mutex mtx;
+    std::vector<char> order;
+    pool.submit(TaskType::Other, TaskPriority::Frame, [&] { gate.pass(); });
+    if (!wait_for(gate.waiting, 1)) {
+      fprintf(stderr, "[ERROR] Task not run\n");
+      return 1;
+    }
+    for (int i = 0; i < 3; i++) {
+      pool.submit(TaskType::FrameTable, TaskPriority::Background, [&] {
+        std::lock_guard<std::mutex> lock(mtx);
+        order.push_back('b');
+      });
+      pool.submit(TaskType::FitsWrite, TaskPriority::Frame, [&] {
+        std::lock_guard<std::mutex> lock(mtx);
+        order.push_back('f');
+      });
+    }
+    if (pool.pending() != 6) {
+      fprintf(stderr, "[ERROR] Expected 6 tasks pending, got %d\n",
+              pool.pending());
+      return 1;
+    }
+    gate.open = true;
+    pool.stop();
+    if (std::string(order.begin(), order.end()) != "fffbbb") {
+      fprintf(stderr, "[ERROR] Tasks not run by priority\n");
+      return 1;
+    }
+  }
+
+  // two workers: background tasks never hold both, so frame tasks still run
+  {
+    TaskPool pool;
+    pool.start(2);
+    Gate gate;
+    std::atomic<int> frames{0};
+    for (int i = 0; i < 2; i++)
+      pool.submit(TaskType::FrameTable, TaskPriority::Background,
+                  [&] { gate.pass(); });
+    if (!wait_for(gate.waiting, 1)) {
+      fprintf(stderr, "[ERROR] Background task not run\n");
+      return 1;
+    }
+    std::this_thread::sleep_for(20ms);
+    if (gate.waiting.load() != 1) {
+      fprintf(stderr, "[ERROR] Background tasks ran on all workers\n");
+      return 1;
+    }
+    for (int i = 0; i < 4; i++)
+      pool.submit(TaskType::FitsWrite, TaskPriority::Frame,
+                  [&] { frames.fetch_add(1); });
+    if (!wait_for(frames, 4)) {
+      fprintf(stderr, "[ERROR] Frame tasks stuck behind background ones\n");
+      return 1;
+    }
+    // tasks queued to the worker held at the gate were stolen
+    if (pool.stats(TaskType::FitsWrite).stolen < 1) {
+      fprintf(stderr, "[ERROR] No tasks stolen from a busy worker\n");
+      return 1;
+    }
+    gate.open = true;
+    pool.stop();
+    if (gate.waiting.load() != 2) {
+      fprintf(stderr, "[ERROR] Background tasks not run\n");
+      return 1;
+    }
+
+    // accounts
+    TaskTypeStats fs = pool.stats(TaskType::FitsWrite);
+    TaskTypeStats bs = pool.stats(TaskType::FrameTable);
+    if (fs.submitted != 4 || fs.completed != 4 || bs.completed != 2 ||
+        pool.stats(TaskType::Other).completed || bs.run_ns < 20000000 ||
+        bs.max_wait_ns < 20000000 || bs.wait_ns < bs.max_wait_ns) {
+      fprintf(stderr, "[ERROR] Tasks not accounted for\n");
+      return 1;
+    }
+    char buf[512];
+    pool.format(buf, sizeof(buf));
+    if (!std::strstr(buf, "fitswrite:n=4,stolen=") ||
+        !std::strstr(buf, ";frametable:n=2,") ||
+        !std::strstr(buf, ";other:n=0,")) {
+      fprintf(stderr, "[ERROR] Unexpected accounts \"%s\"\n", buf);
+      return 1;
+    }
+    pool.reset_stats();
+    if (pool.stats(TaskType::FitsWrite).completed) {
+      fprintf(stderr, "[ERROR] Accounts not cleared\n");
+      return 1;
+    }
+  }
+
+  // CPU time of a busy task; stop runs what is queued, then refuses tasks
+  {
+    TaskPool pool;
+    pool.start(3);
+    std::atomic<int> done{0};
+    pool.submit(TaskType::Other, TaskPriority::Frame, [&] {
+      timespec ts;
+      do
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+      while (ts.tv_sec == 0 && ts.tv_nsec < 20000000);
+      done.fetch_add(1);
+    });
+    for (int i = 0; i < 100; i++)
+      pool.submit(TaskType::Other,
+                  i % 2 ? TaskPriority::Frame : TaskPriority::Background,
+                  [&] { done.fetch_add(1); });
+    pool.stop();
+    if (done.load() != 101 || pool.pending() ||
+        pool.stats(TaskType::Other).cpu_ns < 10000000) {
+      fprintf(stderr, "[ERROR] Queued tasks not run on stop (%d)\n",
+              done.load());
+      return 1;
+    }
+    if (pool.running() ||
+        pool.submit(TaskType::Other, TaskPriority::Frame, [] {}) ||
+        !pool.start(1)) {
+      fprintf(stderr, "[ERROR] Stopped pool accepted tasks\n");
+      return 1;
+    }
+  }
+
+  // following filenames ([GENERIC_FN][YYYYMMDD][INDEX].fits)
+  AndorParameters params;
+  std::strcpy(params.image_filename_, "foo1");
+  const char *names[][2] = {
+      {"/data/foo1202110199.fits", "/data/foo12021101910.fits"},
+      {"foo1202110191.fits", "foo1202110192.fits"}};
+  char next[MAX_FITS_FILE_SIZE];
+  for (const auto &n : names) {
+    if (get_following_fits_filename(&params, n[0], next) ||
+        std::strcmp(next, n[1])) {
+      fprintf(stderr, "[ERROR] Wrong filename following \"%s\"\n", n[0]);
+      return 1;
+    }
+  }
+  const char *invalid[] = {"foo120211019.fits", "foo1202110191.fit",
+                           "bar1202110191.fits", "foo120211019x.fits"};
+  for (const char *n : invalid) {
+    if (!get_following_fits_filename(&params, n, next)) {
+      fprintf(stderr, "[ERROR] Accepted filename \"%s\"\n", n);
+      return 1;
+    }
+  }
+
+  // a series of frames, written on the pool and inline (pool not running)
+  const int width = 64, height = 32;
+  std::vector<at_32> pixels(width * height);
+  FitsHeaders headers;
+  for (int run = 0; run < 2; run++) {
+    TaskPool pool;
+    if (!run)
+      pool.start(2);
+    char fn[MAX_FITS_FILE_SIZE];
+    const int frames = 2 * SERIES_WRITER_SLOTS + 1;
+    for (int i = 1; i <= frames; i++) {
+      std::snprintf(fn, sizeof(fn), "/tmp/test_task_pool%d_20211019%d.fits",
+                    run, i);
+      std::remove(fn);
+    }
+    std::snprintf(fn, sizeof(fn), "/tmp/test_task_pool%d_202110191.fits", run);
+    std::snprintf(params.image_filename_, MAX_FITS_FILENAME_SIZE,
+                  "test_task_pool%d_", run);
+    {
+      SeriesWriter writer(pool);
+      for (int i = 0; i < frames; i++) {
+        if (i)
+          get_following_fits_filename(&params, fn, fn);
+        pixels[0] = i;
+        if (writer.write(fn, headers, width, height, pixels.data())) {
+          fprintf(stderr, "[ERROR] Failed to write frame %d\n", i);
+          return 1;
+        }
+      }
+      if (writer.finish()) {
+        fprintf(stderr, "[ERROR] Failed to write series\n");
+        return 1;
+      }
+    }
+    // (accounted for once a task returns, maybe after finish)
+    pool.stop();
+    if (pool.stats(TaskType::FitsWrite).completed != (run ? 0u : frames)) {
+      fprintf(stderr, "[ERROR] Frames not written on the pool\n");
+      return 1;
+    }
+    for (int i = 1; i <= frames; i++) {
+      std::snprintf(fn, sizeof(fn), "/tmp/test_task_pool%d_20211019%d.fits",
+                    run, i);
+      struct stat st;
+      if (stat(fn, &st) ||
+          st.st_size < static_cast<off_t>(sizeof(at_32) * pixels.size())) {
+        fprintf(stderr, "[ERROR] Frame \"%s\" not written\n", fn);
+        return 1;
+      }
+      std::remove(fn);
+    }
+  }
+
+  printf("all ok\n");
+  return 0;
+}
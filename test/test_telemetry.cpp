@@ -0,0 +1,120 @@
+#include "telemetry.hpp"
+#include "atmcdLXd.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Feed the telemetry sampler synthetic samples: check the snapshot (last
+// valid temperature kept while acquiring, consistent under a concurrent
+// writer), the downsampling into one-minute entries and the wrap-around of
+// the 24 h ring; then run the sampler thread for a few intervals.
+
+constexpr int64_t SEC = 1000000000ll;
+constexpr int64_t T0 = 1600000020ll * SEC; // a whole minute
+
+int main() {
+  TelemetrySampler sampler;
+  if (sampler.snapshot().valid() || sampler.running()) {
+    fprintf(stderr, "[ERROR] Fresh sampler has a valid snapshot\n");
+    return 1;
+  }
+
+  // first minute: -50, -52, then acquiring (no temperature)
+  sampler.record(T0, -50.f, true, DRV_TEMP_STABILIZED, DRV_IDLE, true);
+  sampler.record(T0 + 20 * SEC, -52.f, true, DRV_TEMP_DRIFT, DRV_IDLE, true);
+  sampler.record(T0 + 40 * SEC, 0.f, false, DRV_ACQUIRING, DRV_ACQUIRING,
+                 true);
+  auto s = sampler.snapshot();
+  if (!s.valid() || s.temp != -52.f || s.temp_status != DRV_TEMP_DRIFT ||
+      s.temp_ns != T0 + 20 * SEC || s.sampled_ns != T0 + 40 * SEC ||
+      s.driver_status != DRV_ACQUIRING || !s.cooler_on || s.samples != 3 ||
+      (s.seq & 1)) {
+    fprintf(stderr, "[ERROR] Unexpected snapshot\n");
+    return 1;
+  }
+
+  // second minute: one sample, cooler off
+  sampler.record(T0 + 61 * SEC, -40.f, true, DRV_TEMP_OFF, DRV_IDLE, false);
+  std::vector<TelemetryBucket> history;
+  sampler.history(history);
+  if (history.size() != 2 || history[0].start_ns != T0 ||
+      history[0].samples != 3 || history[0].temp_samples != 2 ||
+      history[0].temp_min != -52.f || history[0].temp_max != -50.f ||
+      history[0].temp_mean != -51.f || history[0].cooler_on != 3 ||
+      history[0].acquiring != 1 || history[1].start_ns != T0 + 60 * SEC ||
+      history[1].samples != 1 || history[1].cooler_on) {
+    fprintf(stderr, "[ERROR] Unexpected history\n");
+    return 1;
+  }
+
+  // a day and a half later; only the last TELEMETRY_HISTORY_SIZE minutes
+  // are kept, oldest first
+  int64_t t = T0 + 120 * SEC;
+  for (int i = 0; i < 36 * 60; i++, t += 60 * SEC)
+    sampler.record(t, static_cast<float>(i), true, DRV_TEMP_STABILIZED,
+                   DRV_IDLE, true);
+  sampler.history(history);
+  if (static_cast<int>(history.size()) != TELEMETRY_HISTORY_SIZE ||
+      history.back().start_ns != t - 60 * SEC) {
+    fprintf(stderr, "[ERROR] Unexpected history after wrap-around\n");
+    return 1;
+  }
+  for (std::size_t i = 1; i < history.size(); i++) {
+    if (history[i].start_ns - history[i - 1].start_ns != 60 * SEC) {
+      fprintf(stderr, "[ERROR] History out of order\n");
+      return 1;
+    }
+  }
+  sampler.history(history, 10);
+  if (history.size() != 10 || history.back().temp_mean != 36 * 60 - 1) {
+    fprintf(stderr, "[ERROR] Unexpected recent history\n");
+    return 1;
+  }
+
+  // snapshots are consistent while a writer keeps publishing
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (int i = 1; i <= 200000; i++)
+      sampler.record(t + i, static_cast<float>(i), true, DRV_TEMP_STABILIZED,
+                     DRV_IDLE, i & 1);
+    done = true;
+  });
+  int torn = 0;
+  while (!done) {
+    s = sampler.snapshot();
+    int64_t i = s.sampled_ns - t;
+    if (i > 0 &&
+        (s.temp != static_cast<float>(i) || s.temp_ns != s.sampled_ns ||
+         s.cooler_on != static_cast<bool>(i & 1)))
+      ++torn;
+  }
+  writer.join();
+  if (torn) {
+    fprintf(stderr, "[ERROR] %d torn snapshots\n", torn);
+    return 1;
+  }
+
+  // the sampler thread: a sample at start, then one per interval
+  TelemetrySampler live;
+  if (live.start(std::chrono::milliseconds(10)) || !live.running() ||
+      live.snapshot().samples < 1) {
+    fprintf(stderr, "[ERROR] Failed to start sampler\n");
+    return 1;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  live.stop();
+  uint64_t samples = live.snapshot().samples;
+  if (live.running() || samples < 5 || samples > 25) {
+    fprintf(stderr, "[ERROR] Unexpected number of samples (%lu)\n",
+            (unsigned long)samples);
+    return 1;
+  }
+  if (!live.start(std::chrono::milliseconds(10))) {
+    fprintf(stderr, "[ERROR] Stopped sampler restarted\n");
+    return 1;
+  }
+
+  printf("all ok\n");
+  return 0;
+}
@@ -0,0 +1,127 @@
+#include "thread_setup.hpp"
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+
+// Parse and format CPU lists; set up threads of each role (name, affinity,
+// SCHED_FIFO) and check that what is reported as done actually took effect
+// (SCHED_FIFO and mlock need privileges, so they may fail, but must say so);
+// lock and unlock a buffer.
+
+int main() {
+  const char *valid[][2] = {{"0", "0"},         {"3", "3"},
+                            {"0,2", "0,2"},     {"2-3,6", "2-3,6"},
+                            {"1,2,3,7", "1-3,7"}, {"4-4", "4"}};
+  char buf[64];
+  for (const auto &v : valid) {
+    cpu_set_t set;
+    if (parse_cpu_list(v[0], set) ||
+        std::strcmp(format_cpu_list(set, buf, sizeof(buf)), v[1])) {
+      fprintf(stderr, "[ERROR] Failed to parse CPU list \"%s\" (got \"%s\")\n",
+              v[0], buf);
+      return 1;
+    }
+  }
+  const char *invalid[] = {"",    "-1",  "a",   "1,",   ",1",  "3-2",
+                           "1-",  "1-a", "1;2", "1--2", "1 2", "99999"};
+  for (const char *v : invalid) {
+    cpu_set_t set;
+    if (!parse_cpu_list(v, set)) {
+      fprintf(stderr, "[ERROR] Accepted invalid CPU list \"%s\"\n", v);
+      return 1;
+    }
+  }
+
+  // pin acquisition and writer threads to the first CPU we may run on
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+    fprintf(stderr, "[ERROR] Failed to get CPU affinity\n");
+    return 1;
+  }
+  int cpu = 0;
+  while (!CPU_ISSET(cpu, &allowed))
+    ++cpu;
+  ThreadSetupConfig config;
+  CPU_ZERO(&config.acq_cpus);
+  CPU_SET(cpu, &config.acq_cpus);
+  config.writer_cpus = config.acq_cpus;
+  config.pin_acq = config.pin_writer = true;
+  config.acq_fifo_priority = 1;
+  config.lock_memory = true;
+  ThreadSetup setup;
+  setup.configure(config);
+
+  struct Result {
+    int failed;
+    char name[THREAD_NAME_MAX + 1];
+    int cpus;
+    int policy;
+  };
+  auto run = [&setup](const char *name, ThreadRole role) {
+    Result r;
+    std::thread t([&] {
+      r.failed = setup.setup_this_thread(name, role);
+      pthread_getname_np(pthread_self(), r.name, sizeof(r.name));
+      cpu_set_t set;
+      pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+      r.cpus = CPU_COUNT(&set);
+      sched_param param;
+      pthread_getschedparam(pthread_self(), &r.policy, &param);
+    });
+    t.join();
+    return r;
+  };
+
+  Result acq = run("andor-sdk", ThreadRole::Acquisition);
+  if (std::strcmp(acq.name, "andor-sdk") || acq.cpus != 1 ||
+      acq.failed != (acq.policy != SCHED_FIFO)) {
+    fprintf(stderr, "[ERROR] Acquisition thread not set up as reported\n");
+    return 1;
+  }
+  Result writer = run("andor-logger", ThreadRole::Writer);
+  if (std::strcmp(writer.name, "andor-logger") || writer.cpus != 1 ||
+      writer.failed || writer.policy != SCHED_OTHER) {
+    fprintf(stderr, "[ERROR] Writer thread not set up as configured\n");
+    return 1;
+  }
+  // services are only named; long names are truncated
+  Result service = run("andor-telemetry-sampler", ThreadRole::Service);
+  if (std::strcmp(service.name, "andor-telemetry") ||
+      service.cpus != CPU_COUNT(&allowed) || service.failed ||
+      service.policy != SCHED_OTHER) {
+    fprintf(stderr, "[ERROR] Service thread not set up as configured (%s)\n",
+            service.name);
+    return 1;
+  }
+  if (setup.failures() != acq.failed) {
+    fprintf(stderr, "[ERROR] Failures not accounted for\n");
+    return 1;
+  }
+
+  // memory locking; a page, which is within the default RLIMIT_MEMLOCK
+  std::vector<char> frame(4096);
+  int error = setup.lock_memory(frame.data(), frame.size());
+  if (error ? setup.locked_bytes() != 0
+            : setup.locked_bytes() != frame.size()) {
+    fprintf(stderr, "[ERROR] Locked memory not accounted for\n");
+    return 1;
+  }
+  if (!error)
+    setup.unlock_memory(frame.data(), frame.size());
+  if (setup.locked_bytes()) {
+    fprintf(stderr, "[ERROR] Memory still locked\n");
+    return 1;
+  }
+
+  // nothing configured: nothing locked
+  ThreadSetup off;
+  if (off.lock_memory(frame.data(), frame.size()) || off.locked_bytes()) {
+    fprintf(stderr, "[ERROR] Locked memory while not configured to\n");
+    return 1;
+  }
+
+  printf("all ok\n");
+  return 0;
+}
@@ -0,0 +1,167 @@
+#include "andor_time_utils.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Check format_utc (aka strfdt) and format_local (aka date_str) against the
+// strftime-based implementations they replace, for random time points and
+// from several threads at once; then time both implementations.
+
+using namespace std::chrono;
+
+// the previous implementation of strfdt (std::gmtime + strftime + sprintf)
+char *strftime_utc(const std_time_point &t, DateTimeFormat f,
+                   char *buf) noexcept {
+  long long ms = duration_cast<milliseconds>(t.time_since_epoch()).count();
+  long long sec = ms / 1000, fsec = ms % 1000;
+  if (fsec < 0) {
+    fsec += 1000;
+    --sec;
+  }
+  std::time_t tt = static_cast<std::time_t>(sec);
+  std::tm tm;
+  gmtime_r(&tt, &tm);
+  int btw;
+  switch (f) {
+  case DateTimeFormat::YMD:
+    std::strftime(buf, 64, "%F", &tm);
+    break;
+  case DateTimeFormat::YMDHMS:
+    std::strftime(buf, 64, "%FT%T", &tm);
+    break;
+  case DateTimeFormat::YMDHMfS:
+    btw = std::strftime(buf, 64, "%FT%T.", &tm);
+    std::sprintf(buf + btw, "%03lld", fsec);
+    break;
+  case DateTimeFormat::HMS:
+    std::strftime(buf, 64, "%T", &tm);
+    break;
+  case DateTimeFormat::HMfS:
+    btw = std::strftime(buf, 64, "%T.", &tm);
+    std::sprintf(buf + btw, "%03lld", fsec);
+    break;
+  }
+  return buf;
+}
+
+// the previous implementation of date_str
+char *strftime_local(std::time_t t, char *buf) noexcept {
+  std::tm tm;
+  localtime_r(&t, &tm);
+  std::strftime(buf, 32, "%F %T", &tm);
+  return buf;
+}
+
+constexpr DateTimeFormat formats[] = {
+    DateTimeFormat::YMD, DateTimeFormat::YMDHMfS, DateTimeFormat::YMDHMS,
+    DateTimeFormat::HMS, DateTimeFormat::HMfS};
+
+// compare n random time points in [1901, 2099]; returns number of mismatches
+int compare(int n, unsigned seed) {
+  std::mt19937_64 gen(seed);
+  std::uniform_int_distribution<long long> dist(-2177452800000LL,
+                                                4102444799999LL);
+  char a[64], b[64];
+  int errors = 0;
+  for (int i = 0; i < n; i++) {
+    // also hit consecutive calls within the same second (cached path)
+    long long ms = (i % 4) ? dist(gen) : dist(gen) / 1000 * 1000 + i % 1000;
+    std_time_point t{milliseconds(ms)};
+    for (auto f : formats) {
+      format_utc(t, f, a);
+      strftime_utc(t, f, b);
+      if (std::strcmp(a, b)) {
+        if (++errors < 10)
+          fprintf(stderr, "[ERROR] %lld ms: got \"%s\" expected \"%s\"\n", ms,
+                  a, b);
+      }
+    }
+    std::time_t tt = static_cast<std::time_t>(ms / 1000);
+    format_local(tt, a);
+    strftime_local(tt, b);
+    if (std::strcmp(a, b)) {
+      if (++errors < 10)
+        fprintf(stderr, "[ERROR] %ld sec: got \"%s\" expected \"%s\"\n",
+                (long)tt, a, b);
+    }
+  }
+  return errors;
+}
+
+template <typename F> double ns_per_call(int n, F &&f) {
+  auto start = steady_clock::now();
+  for (int i = 0; i < n; i++)
+    f(i);
+  return duration_cast<nanoseconds>(steady_clock::now() - start).count() /
+         static_cast<double>(n);
+}
+
+int main() {
+  // a few known values
+  char buf[64];
+  std_time_point t0{milliseconds(0)};
+  std_time_point t1{milliseconds(951782400123LL)}; // 2000-02-29T00:00:00.123
+  std_time_point t2{milliseconds(-1)};
+  if (std::strcmp(strfdt<DateTimeFormat::YMDHMfS>(t0, buf),
+                  "1970-01-01T00:00:00.000") ||
+      std::strcmp(strfdt<DateTimeFormat::YMDHMfS>(t1, buf),
+                  "2000-02-29T00:00:00.123") ||
+      std::strcmp(strfdt<DateTimeFormat::YMDHMfS>(t2, buf),
+                  "1969-12-31T23:59:59.999") ||
+      std::strcmp(strfdt<DateTimeFormat::HMS>(t1, buf), "00:00:00")) {
+    fprintf(stderr, "[ERROR] Wrong formatting of known time points\n");
+    return 1;
+  }
+
+  // random time points, from several threads at once
+  std::vector<std::thread> threads;
+  std::vector<int> errors(4, 0);
+  for (int i = 0; i < 4; i++)
+    threads.emplace_back([&errors, i] { errors[i] = compare(100000, i + 1); });
+  for (auto &t : threads)
+    t.join();
+  for (int e : errors) {
+    if (e) {
+      fprintf(stderr, "[ERROR] Formatting differs from strftime\n");
+      return 1;
+    }
+  }
+
+  // benchmark: time points 1 ms apart (e.g. log lines), and random ones
+  constexpr int N = 1000000;
+  auto now = system_clock::now();
+  volatile char sink = 0;
+  double old_seq = ns_per_call(N, [&](int i) {
+    sink = sink + *strftime_utc(now + milliseconds(i),
+                                DateTimeFormat::YMDHMfS, buf);
+  });
+  double new_seq = ns_per_call(N, [&](int i) {
+    sink = sink + *format_utc(now + milliseconds(i), DateTimeFormat::YMDHMfS,
+                              buf);
+  });
+  double old_rnd = ns_per_call(N, [&](int i) {
+    sink = sink + *strftime_utc(now + seconds(i * 7919L % 100000),
+                                DateTimeFormat::YMDHMfS, buf);
+  });
+  double new_rnd = ns_per_call(N, [&](int i) {
+    sink = sink + *format_utc(now + seconds(i * 7919L % 100000),
+                              DateTimeFormat::YMDHMfS, buf);
+  });
+  double old_loc = ns_per_call(
+      N, [&](int) { sink = sink + *strftime_local(std::time(nullptr), buf); });
+  double new_loc = ns_per_call(
+      N, [&](int) { sink = sink + *format_local(std::time(nullptr), buf); });
+
+  printf("%-36s %10s %10s\n", "ns per call", "strftime", "new");
+  printf("%-36s %10.1f %10.1f\n", "strfdt, consecutive milliseconds", old_seq,
+         new_seq);
+  printf("%-36s %10.1f %10.1f\n", "strfdt, random seconds", old_rnd, new_rnd);
+  printf("%-36s %10.1f %10.1f\n", "date_str", old_loc, new_loc);
+
+  printf("all ok\n");
+  return 0;
+}
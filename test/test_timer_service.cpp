@@ -0,0 +1,83 @@
+#include "timer_service.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+// Run a few periodic timers on the timer service and check that they fire
+// (roughly) at the requested rate, and that a cancelled timer never fires
+// again.
+
+using namespace std::chrono;
+
+int main() {
+  TimerService service;
+  if (service.start()) {
+    fprintf(stderr, "[ERROR] Failed to start timer service\n");
+    return 1;
+  }
+
+  std::atomic<int> fast{0}, slow{0}, self{0};
+  uint64_t fast_id = service.schedule_every(milliseconds(10), [&] { ++fast; });
+  uint64_t slow_id = service.schedule_every(milliseconds(50), [&] { ++slow; });
+  // a slow callback must not delay the others by more than its own duration
+  uint64_t self_id = service.schedule_every(milliseconds(30), [&] {
+    ++self;
+    std::this_thread::sleep_for(milliseconds(5));
+  });
+  if (!fast_id || !slow_id || !self_id || service.size() != 3) {
+    fprintf(stderr, "[ERROR] Failed to schedule timers\n");
+    return 1;
+  }
+
+  std::this_thread::sleep_for(milliseconds(520));
+  int nfast = fast, nslow = slow, nself = self;
+  printf("fired: fast %d (~50), slow %d (~10), self %d (~17)\n", nfast, nslow,
+         nself);
+  if (nfast < 35 || nfast > 60 || nslow < 8 || nslow > 12 || nself < 12 ||
+      nself > 19) {
+    fprintf(stderr, "[ERROR] Unexpected number of ticks\n");
+    return 1;
+  }
+
+  // cancel returns after the callback (if running) is done; no more ticks
+  if (service.cancel(fast_id)) {
+    fprintf(stderr, "[ERROR] Failed to cancel timer\n");
+    return 1;
+  }
+  nfast = fast;
+  std::this_thread::sleep_for(milliseconds(50));
+  if (fast != nfast || service.cancel(fast_id) != 1 || service.size() != 2) {
+    fprintf(stderr, "[ERROR] Cancelled timer still active\n");
+    return 1;
+  }
+
+  // a timer scheduled in the future fires first
+  auto t0 = TimerService::clock::now();
+  std::atomic<long> first_ms{-1};
+  uint64_t id = service.schedule_every(
+      milliseconds(1000),
+      [&] {
+        if (first_ms < 0)
+          first_ms =
+              duration_cast<milliseconds>(TimerService::clock::now() - t0)
+                  .count();
+      },
+      t0 + milliseconds(20));
+  std::this_thread::sleep_for(milliseconds(60));
+  service.cancel(id);
+  printf("first tick after %ld ms (20)\n", first_ms.load());
+  if (first_ms < 20 || first_ms > 40) {
+    fprintf(stderr, "[ERROR] Timer fired at the wrong time\n");
+    return 1;
+  }
+
+  service.stop();
+  if (service.schedule_every(milliseconds(10), [] {})) {
+    fprintf(stderr, "[ERROR] Scheduled timer on stopped service\n");
+    return 1;
+  }
+
+  printf("all ok\n");
+  return 0;
+}
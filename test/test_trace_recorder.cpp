@@ -0,0 +1,129 @@
+#include "latency_stats.hpp"
+#include "trace_recorder.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Record spans from a few threads (directly and via latency timers), write
+// them as a Chrome trace file and check its contents; check that nothing is
+// recorded while tracing is off, that the buffer is bounded, and that in
+// per-night mode successive flushes are appended to the same file.
+
+std::string read_file(const char *fn) {
+  std::string str;
+  FILE *fp = std::fopen(fn, "r");
+  if (!fp)
+    return str;
+  char buf[4096];
+  std::size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), fp)))
+    str.append(buf, n);
+  std::fclose(fp);
+  return str;
+}
+
+int count(const std::string &str, const char *what) {
+  int n = 0;
+  for (auto pos = str.find(what); pos != std::string::npos;
+       pos = str.find(what, pos + 1))
+    ++n;
+  return n;
+}
+
+int main() {
+  TraceRecorder tracer;
+  LatencyStats stats;
+  stats.set_tracer(&tracer);
+  const char *fn = "/tmp/andor2k_test_trace.json";
+
+  // off: nothing recorded
+  {
+    TraceSpan span(tracer, "ignored");
+    auto timer = stats.timer(LatencyPhase::Exposure);
+  }
+  tracer.instant("ignored");
+  if (tracer.size()) {
+    fprintf(stderr, "[ERROR] Events recorded while tracing is off\n");
+    return 1;
+  }
+
+  if (tracer.set_mode(TraceMode::PerRequest)) {
+    fprintf(stderr, "[ERROR] Failed to switch tracing on\n");
+    return 1;
+  }
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 3; t++)
+    threads.emplace_back([&] {
+      tracer.name_thread("worker");
+      for (int i = 0; i < 10; i++) {
+        TraceSpan span(tracer, "span");
+        auto timer = stats.timer(LatencyPhase::Readout);
+      }
+    });
+  for (auto &t : threads)
+    t.join();
+  tracer.instant("abort requested");
+  if (tracer.size() != 61) {
+    fprintf(stderr, "[ERROR] Expected 61 events, got %lu\n",
+            (unsigned long)tracer.size());
+    return 1;
+  }
+
+  std::remove(fn);
+  if (tracer.write(fn, false) || tracer.size()) {
+    fprintf(stderr, "[ERROR] Failed to write trace file\n");
+    return 1;
+  }
+  std::string json = read_file(fn);
+  if (json.compare(0, 2, "[\n") || json.compare(json.size() - 3, 3, "\n]\n") ||
+      count(json, "\"ph\":\"X\"") != 60 || count(json, "\"ph\":\"i\"") != 1 ||
+      count(json, "\"name\":\"readout\"") != 30 ||
+      count(json, "\"thread_name\"") != 3 ||
+      count(json, "},\n{") != 60 + 3) {
+    fprintf(stderr, "[ERROR] Unexpected trace file contents:\n%s\n",
+            json.c_str());
+    return 1;
+  }
+
+  // bounded: events past TRACE_MAX_EVENTS are dropped
+  for (int i = 0; i < TRACE_MAX_EVENTS + 10; i++)
+    tracer.instant("flood");
+  if (tracer.size() != (std::size_t)TRACE_MAX_EVENTS ||
+      tracer.dropped() != 10) {
+    fprintf(stderr, "[ERROR] Trace buffer not bounded\n");
+    return 1;
+  }
+
+  // per night: flushes are appended to the same (unterminated) file
+  tracer.set_mode(TraceMode::PerNight);
+  std::remove(fn);
+  tracer.write(fn, true);
+  tracer.instant("second");
+  tracer.write(fn, true);
+  json = read_file(fn);
+  if (json.compare(0, 2, "[\n") || json.back() != '}' ||
+      count(json, "\"name\":\"flood\"") != TRACE_MAX_EVENTS ||
+      count(json, "\"name\":\"second\"") != 1 ||
+      // (3 thread names + events) twice, minus the first record
+      count(json, "},\n{") != TRACE_MAX_EVENTS + 1 + 2 * 3 - 1) {
+    fprintf(stderr, "[ERROR] Unexpected per-night trace file\n");
+    return 1;
+  }
+
+  // flush names the file after the mode
+  char written[256];
+  tracer.instant("named");
+  if (tracer.flush("/tmp", written) ||
+      std::strncmp(written, "/tmp/andor2k_trace_", 19) ||
+      std::strlen(written) != 19 + 8 + 5) {
+    fprintf(stderr, "[ERROR] Failed to flush trace (%s)\n", written);
+    return 1;
+  }
+  std::remove(written);
+  std::remove(fn);
+
+  printf("all ok\n");
+  return 0;
+}